@@ -9,12 +9,14 @@
 #include <math.h>
 
 #include "typedefs.h"
+#include "rng.h"
 #include "iface_globals.h"
 #include "is_fileio.h"
 #include "gfx.h"
 #include "interface.h"
 #include "starmap.h"
 #include "combat.h"
+#include "gamedata.h"
 
 #include "cards.h"
 
@@ -32,6 +34,7 @@ const char *ecard_keywords[eckMax] =
 	"PARM",
 	"END",
 };
+t_inikeys ecard_keys = { ecard_keywords, eckMax };
 
 // ----------------
 // GLOBAL VARIABLES
@@ -50,23 +53,26 @@ int32						num_ecards;
 
 void cards_init()
 {
-	FILE* ini;
-	char s1[64], s2[256];
-	char end;
+	t_inifile *ini;
+	char *s1, *s2;
+	int32 ln;
 	int num;
 	int flag;
 	int n, com;
 	int numtypes = 0;
 	char cardtypenames[16][32];
 
-	ini = myopen("gamedata/cards.ini", "rb");
+	if (gamedata_cached)
+		return;
+
+	ini = ini_open("gamedata/cards.ini", 1);
 	if (!ini)
 		return;
 
-	end = 0; num = 0; flag = 0;
-	while (!end)
+	num = 0; flag = 0;
+	for (ln = 0; ln < ini->num; ln++)
 	{
-		end = read_line(ini, s1, s2);
+		s1 = ini->line[ln].key; s2 = ini->line[ln].par;
 		if (!strcmp(s1, ecard_keywords[eckBegin]))
 			num++;
 		else if (!strcmp(s1, "CARDTYPES"))
@@ -81,23 +87,17 @@ void cards_init()
 				strcpy(cardtypenames[n++], s1);
 		}
 	}
-	fclose(ini);
 
 	ecards = (t_eventcard*)calloc(num, sizeof(t_eventcard));
 	if (!ecards)
-		return;
+	{ ini_close(ini); return; }
 	num_ecards = num;
 
-	ini = myopen("gamedata/cards.ini", "rb");
-
-	end = 0; num = 0; flag = 0;
-	while (!end)
+	num = 0; flag = 0;
+	for (ln = 0; ln < ini->num; ln++)
 	{
-		end = read_line(ini, s1, s2);
-		com = -1;
-		for (n = 0; n < eckMax; n++)
-			if (!strcmp(s1, ecard_keywords[n]))
-				com = n;
+		s1 = ini->line[ln].key; s2 = ini->line[ln].par;
+		com = ini_keyword(&ecard_keys, &ini->line[ln]);
 
 		if (flag == 0)
 		{
@@ -160,7 +160,7 @@ void cards_init()
 		}
 
 	}
-	fclose(ini);
+	ini_close(ini);
 }
 
 void cards_deinit()
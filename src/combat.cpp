@@ -2,6 +2,8 @@
 //     INCLUDES
 // ----------------
 
+#include <stdexcept>
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -9,6 +11,7 @@
 #include <math.h>
 
 #include "typedefs.h"
+#include "rng.h"
 #include "iface_globals.h"
 #include "is_fileio.h"
 #include "gfx.h"
@@ -27,26 +30,7 @@
 // LOCAL VARIABLES
 // ----------------
 
-t_combatcamera		camera;
-t_ship						cships[MAX_COMBAT_SHIPS];
-t_wepbeam					cbeams[MAX_COMBAT_BEAMS];
-t_wepproj					cprojs[MAX_COMBAT_PROJECTILES];
-t_explosion				cexplo[MAX_COMBAT_EXPLOS];
-
-int32 numships;
-int32 playership;
-int32 sortship[MAX_COMBAT_SHIPS];
-
-int32 t_move, t_disp, g_pause;
-
-int32 nebula;
-int32 retreat;
-int32 rett;				// retreat time
-int32 klaktime;
-int32 klakavail;
-int32 gongavail;
-
-int32 simulated;
+t_combatworld			combat_world;		// the battle on screen
 
 #ifdef DEBUG_COMBAT
 char combatdebug[64];
@@ -56,23 +40,25 @@ char combatdebug[64];
 // LOCAL PROTOTYPES
 // ----------------
 
-void combat_start(int32 flt);
-void combat_end(int32 flt);
+void combat_poolinit(t_combatpool *pool, int32 itemsize, int32 size);
+void combat_poolfree(t_combatpool *pool, int32 c);
+void combat_pooldeinit(t_combatpool *pool);
+void combat_sweep(t_combatworld *cw);
+void combat_setsides(t_combatworld *cw, int32 flt);
+void combat_end(t_combatworld *cw, int32 flt);
 
 int32 combat_prepare(int32 flt);
-void combat_movement(int32 t);
 
-void combat_checkalttargets(int32 s, int32 t);
-void combat_checkescapes(int32 t);
+void combat_checkalttargets(t_combatworld *cw, int32 s, int32 t);
 
-int32 combat_findship(int32 mx, int32 my);
-int32 shiptonum(t_ship *s);
+int32 combat_findship(t_combatworld *cw, int32 mx, int32 my);
+int32 shiptonum(t_combatworld *cw, t_ship *s);
 
-void combat_summon_klakar(int32 t);
+void combat_summon_klakar(t_combatworld *cw, int32 t);
 void combat_removeenemyship(int32 flt, int32 s);
-int32 combat_use_gong(int32 t);
+int32 combat_use_gong(t_combatworld *cw, int32 t);
 
-void combat_launch_fighter(int32 s, int32 t);
+void combat_launch_fighter(t_combatworld *cw, int32 s, int32 t);
 
 
 int32 calc_leadangle(int32 tx, int32 ty, int32 vtx, int32 vty,
@@ -85,39 +71,56 @@ int32 calc_leadangle(int32 tx, int32 ty, int32 vtx, int32 vty,
 
 int32 combat(int32 flt, int32 sim)
 {
-	int32 t, t0;
+	int32 t, d, d0;
 	int32 c, mc, s;
 	int32 b;
 	int32 f;
 	int32 end;
-	int32 klak;
+	int32 klak, kf;
+	int32 pause, drag, zoom, frac;
+	uint32 seed;
+	t_combatworld *cw = &combat_world;
 
-	simulated = sim;
+	cw->simulated = sim;
+	cw->headless = 0;
 
-	combat_start(flt);
+	combat_setsides(cw, flt);
+	seed = rng_next(&sm_rng);
+	combat_start(cw, seed);
+	combat_recstart(cw, seed);
 
 	ik_inkey();
 
-	t_move = 0; t_disp = 0; g_pause = 0; end = 0; rett=0;
+	cw->t_move = 0; cw->t_disp = 0; cw->g_pause = 0; end = 0; cw->rett=0;
 
-	if (simulated)
+	if (cw->simulated)
 		Play_Sound(WAV_MUS_SIMULATOR, 15, 1, 85);
-	else if (!nebula)
+	else if (!cw->nebula)
 		Play_Sound(WAV_MUS_COMBAT, 15, 1);
 	else
 		Play_Sound(WAV_MUS_NEBULA, 15, 1);
-	start_ik_timer(1, 1000/COMBAT_FRAMERATE); t0 = t = 0;
+
+	// the battle runs on its own thread from here, the interface reads
+	// snapshots of it and draws them in between ticks
+	combat_threadstart(cw);
+	pause = 0; drag = 0;
+	start_ik_timer(1, 1000/COMBAT_FRAMERATE); t = 0;
+	start_ik_timer(4, 1000/COMBAT_DISPLAYRATE); d = 0;
 	while (!must_quit && (t<end || end==0))
 	{
-		t0 = t;
+		d0 = d;
 		ik_eventhandler();  // always call every frame
 		t = get_ik_timer(1);
+		d = get_ik_timer(4);
+		cw = combat_snapshot(&frac);
+		combat_playsounds();
 
 		if (must_quit)
 		{
+			combat_threadhold(1);
 			must_quit = 0;
 			Play_SoundFX(WAV_DESELECT);
-			if (simulated)
+			if (cw->simulated)
 			{
 				if (!interface_popup(font_6x8, 240, 200, 160, 72, COMBAT_INTERFACE_COLOR, 0,
 						textstring[STR_QUIT_TITLE], textstring[STR_QUIT_SIMULATION],
@@ -131,179 +134,131 @@ int32 combat(int32 flt, int32 sim)
 						textstring[STR_YES], textstring[STR_NO]))
 				{	must_quit = 1; player.death = 666; }
 			}
+			combat_threadhold(0);
 			ik_eventhandler();  // always call every frame
 			t = get_ik_timer(1);
-			t0 = t;
 		}
 
 		mc = ik_mclick();
 		c = ik_inkey();
 		b = ik_mouse_b;
 
-		klak = klakavail;
+		klak = cw->klakavail;
 
 		if (IsMinimized)
-			g_pause=1;
+			pause=1;
 
 		if (c==32)
 		{
-			if (g_pause==1)
-				g_pause=0;
+			if (pause==1)
+				pause=0;
 			else
-				g_pause=1;
+				pause=1;
 		}
 
 		if (key_pressed(key_f[0]))
 		{
-			combat_help_screen();
+			combat_threadhold(1);
+			combat_help_screen(cw);
+			combat_threadhold(0);
 			ik_eventhandler();  // always call every frame
 			t = get_ik_timer(1);
-			t0 = t;
 		}
 
 #ifdef DEBUG_COMBAT
-			if (camera.ship_trg > -1)
+			// cheats change the battle itself, not the snapshot
+			if (cw->camera.ship_trg > -1 && c)
 			{
-				s = camera.ship_trg;
-				if (cships[s].type > -1 && cships[s].hits >= 0)
+				s = cw->camera.ship_trg;
+				if (cw->cships[s].type > -1 && cw->cships[s].hits >= 0)
 				{
+					t_combatworld *dw = &combat_world;
+
+					combat_threadhold(1);
 					switch(c)
 					{
 						case 'w':
-							cships[s].syshits[0] = 0;
-							combat_updateshipstats(s, t_move);
+							dw->cships[s].syshits[0] = 0;
+							combat_updateshipstats(dw, s, dw->t_move);
 						break;
 
 						case 'd':
-							combat_damageship(s, playership, cships[s].hits, t, &shipweapons[0], 1);
+							combat_damageship(dw, s, dw->playership, dw->cships[s].hits, t, &shipweapons[0], 1);
 						break;
 
 						case 'e':
-							combat_damageship(s, playership, cships[s].hits + hulls[shiptypes[cships[c].type].hull].hits + 1, t, &shipweapons[0], 1);
+							combat_damageship(dw, s, dw->playership, dw->cships[s].hits + hulls[shiptypes[dw->cships[c].type].hull].hits + 1, t, &shipweapons[0], 1);
 						break;
 
 						case 'f':
-							cships[s].flee = 1;
-							cships[s].tac = tac_flee;
-							cships[s].target = -1;
+							dw->cships[s].flee = 1;
+							dw->cships[s].tac = tac_flee;
+							dw->cships[s].target = -1;
 						break;
 					}
+					combat_threadhold(0);
 				}
 			}
 #endif
 
 		f=0;
 		for (s=0;s<MAX_COMBAT_SHIPS;s++)
-		if (cships[s].hits>0 && cships[s].type>-1 && cships[s].escaped==0 && cships[s].flee==0)
+		if (cw->cships[s].hits>0 && cw->cships[s].type>-1 && cw->cships[s].escaped==0 && cw->cships[s].flee==0)
 		{
-			if ((cships[s].own&1)==0)
+			if ((cw->cships[s].own&1)==0)
 				f |= 1;
 			else
 				f |= 2;
 		}
-		if ((f == 1 || cships[playership].type==-1) && retreat)
-		{
-			retreat = 0;
-			Play_SoundFX(WAV_SELECT, t);
-
-			if (simulated)
-				Play_Sound(WAV_MUS_SIMULATOR, 15, 1, 85);
-			else if (!nebula)
-				Play_Sound(WAV_MUS_COMBAT, 15, 1);
-			else
-				Play_Sound(WAV_MUS_NEBULA, 15, 1);
-			for (s = 0; s < MAX_COMBAT_SHIPS; s++)
-			{
-				if ((cships[s].own&1) == 0 && s != playership)
-					combat_findstuff2do(s, t);
-			}
-		}
+		if ((f == 1 || cw->cships[cw->playership].type==-1) && cw->retreat)
+			combat_command(cev_retreat, -1, 0, t);
 
 		if (ik_mouse_x < 160 && (mc&1))
 		{
 			if (ik_mouse_y > 24 && ik_mouse_y < 40)
 			{	// select ship by icon
 				s = (ik_mouse_x-16)/16;
-				if (s >= 0 && s < player.num_ships)
+				if (s >= 0 && s < cw->num_pships)
 				{
-					if (cships[s].type > -1 && cships[s].hits > 0)
+					if (cw->cships[s].type > -1 && cw->cships[s].hits > 0)
 					{
-						select_ship(s, t);
+						combat_command(cev_select, s, t);
 					}
 				}
 			}
-			if (ik_mouse_y > 288 && ik_mouse_y < 320 && cships[playership].hits>0)
+			if (ik_mouse_y > 288 && ik_mouse_y < 320 && cw->cships[cw->playership].hits>0)
 			{
 				s = (ik_mouse_x / 80) + ((ik_mouse_y - 288)/16)*2;
 				switch (s)
 				{
 					case 0: 				// cloak button
-					if (cships[playership].clo_type>0 && cships[playership].syshits[cships[playership].sys_clo]>=5 && t_move>cships[playership].cloaktime+100)
-					{
-						Play_SoundFX(WAV_DOT, 0);
-						if (cships[playership].cloaked)	// uncloak
-						{
-							cships[playership].cloaked = 0;
-							cships[playership].cloaktime = t_move;
-							//Play_SoundFX(WAV_CLOAKOUT, t);
-						}
-						else	// cloak
-						{
-
-							cships[playership].cloaked = 1;
-							cships[playership].cloaktime = t_move;
-							//Play_SoundFX(WAV_CLOAKIN, t);
-						}
-					}
+					if (cw->cships[cw->playership].clo_type>0 && cw->cships[cw->playership].syshits[cw->cships[cw->playership].sys_clo]>=5 && cw->t_move>cw->cships[cw->playership].cloaktime+100)
+						combat_command(cev_cloak, cw->playership);
 					break;
 
 					case 1:	// gong
-					if (gongavail==2)
-					{
-						combat_use_gong(t_move);
-						gongavail = 1;
-					}
+					if (cw->gongavail==2)
+						combat_command(cev_gong, -1);
 					break;
 
 					case 2:	// retreat button
 					if (f == 3)
-					{
-						if (!retreat)
-						{
-							retreat = 1;
-							rett = t_move;
-							Play_SoundFX(WAV_SELECT, t);
-							Play_Sound(WAV_FLARE, 15, 1);
-
-							for (s = 0; s < MAX_COMBAT_SHIPS; s++)
-							if ((cships[s].own&1) == 0)
-								combat_findstuff2do(s, t);
-						}
-						else
-						{
-							retreat = 0;
-							Play_SoundFX(WAV_SELECT, t);
-							if (simulated)
-								Play_Sound(WAV_MUS_SIMULATOR, 15, 1, 85);
-							else if (!nebula)
-								Play_Sound(WAV_MUS_COMBAT, 15, 1);
-							else
-								Play_Sound(WAV_MUS_NEBULA, 15, 1);
-
-							for (s = 0; s < MAX_COMBAT_SHIPS; s++)
-							{
-								if ((cships[s].own&1) == 0 && s != playership)
-									combat_findstuff2do(s, t);
-							}
-						}
-					}
+						combat_command(cev_retreat, -1, !cw->retreat, t);
 					break;
 
 					case 3:	// summon klakar
 					if (klak == 1)
 					{
-						combat_summon_klakar(t_move);
-						klakavail = 0;
+						// the klakar fleet follows the player, the rest happens in combat
+						kf = -1;
+						for (s = 0; s < STARMAP_MAX_FLEETS; s++)
+						{
+							if (sm_fleets[s].race == race_klakar)
+								kf = s;
+						}
+						if (kf > -1)
+							sm_fleets[kf].system = player.system;
+						combat_command(cev_klakar, -1, kf == -1);
 					}
 					break;
 				}
@@ -317,138 +272,139 @@ int32 combat(int32 flt, int32 sim)
 				if (mc & 1)
 				{
 					if (ik_mouse_x < 186)
-					    g_pause = 1;
+					    pause = 1;
 					else if (ik_mouse_x > 202)
-						g_pause = -1;
+						pause = -1;
 					else
-						g_pause = 0;
+						pause = 0;
 				}
 			}
 			else if ( mc & 1 )
 			{
-				if ( !camera.drag_trg )
+				if ( !drag )
 				{
-					s = combat_findship(ik_mouse_x, ik_mouse_y);
+					s = combat_findship(cw, ik_mouse_x, ik_mouse_y);
 					if (s > -1)
 					{
-						if (cships[s].own==0)	// select friendly
+						if (cw->cships[s].own==0)	// select friendly
 						{
-							select_ship(s, t);
+							combat_command(cev_select, s, t);
 						}
-						else if (camera.ship_sel>-1)	// target enemy
+						else if (cw->camera.ship_sel>-1)	// target enemy
 						{
-							camera.ship_trg = s;
-							cships[camera.ship_sel].target = camera.ship_trg;
-							cships[camera.ship_sel].tac = 0;
-							camera.time_trg = t;
-							camera.drag_trg = 1;
+							combat_command(cev_target, cw->camera.ship_sel, s, t);
+							drag = 1;
 						}
 					}
 					else
 					{
 						// check if dragging waypoint
-						if (camera.ship_sel > -1)
+						if (cw->camera.ship_sel > -1)
 						{
-							if (cships[camera.ship_sel].target > -1)
+							if (cw->cships[cw->camera.ship_sel].target > -1)
 							{
-								s = cships[camera.ship_sel].target;
-								if (abs (cships[s].ds_x - ((((sin1k[cships[camera.ship_sel].angle] * cships[camera.ship_sel].dist)>>16) * camera.z)>>12) - ik_mouse_x) < 8	&&
-										abs (cships[s].ds_y + ((((cos1k[cships[camera.ship_sel].angle] * cships[camera.ship_sel].dist)>>16) * camera.z)>>12) - ik_mouse_y) < 8)
-									camera.drag_trg = 1;
+								s = cw->cships[cw->camera.ship_sel].target;
+								if (abs (cw->cships[s].ds_x - ((((sin1k[cw->cships[cw->camera.ship_sel].angle] * cw->cships[cw->camera.ship_sel].dist)>>16) * cw->camera.z)>>12) - ik_mouse_x) < 8	&&
+										abs (cw->cships[s].ds_y + ((((cos1k[cw->cships[cw->camera.ship_sel].angle] * cw->cships[cw->camera.ship_sel].dist)>>16) * cw->camera.z)>>12) - ik_mouse_y) < 8)
+									drag = 1;
 							}
 							else
 							{
-								s = camera.ship_sel;
-								if (abs (160 + 240 + ((((cships[s].wp_x-camera.x)>>10) * camera.z)>>12) - ik_mouse_x) < 8	&&
-										abs (244 - ((((cships[s].wp_y-camera.y)>>10) * camera.z)>>12) - ik_mouse_y) < 8)
-									camera.drag_trg = 1;
+								s = cw->camera.ship_sel;
+								if (abs (160 + 240 + ((((cw->cships[s].wp_x-cw->camera.x)>>10) * cw->camera.z)>>12) - ik_mouse_x) < 8	&&
+										abs (244 - ((((cw->cships[s].wp_y-cw->camera.y)>>10) * cw->camera.z)>>12) - ik_mouse_y) < 8)
+									drag = 1;
 							}
 
 						}
 
-						if (!camera.drag_trg)
+						if (!drag)
 						{
-							if (camera.ship_sel > -1)
+							if (cw->camera.ship_sel > -1)
 							{
-								camera.drag_trg = 1;
-								cships[camera.ship_sel].target = -1;
-								cships[camera.ship_sel].tac = 2;
-								cships[camera.ship_sel].wp_x = camera.x + ((((ik_mouse_x - 400)<<12)/camera.z)<<10);
-								cships[camera.ship_sel].wp_y = camera.y + ((((244-ik_mouse_y)<<12)/camera.z)<<10);
+								drag = 1;
+								combat_command(cev_waypoint, cw->camera.ship_sel,
+															 cw->camera.x + ((((ik_mouse_x - 400)<<12)/cw->camera.z)<<10),
+															 cw->camera.y + ((((244-ik_mouse_y)<<12)/cw->camera.z)<<10), 1);
 							}
-	//						camera.ship_sel = -1;
-	//						camera.ship_trg = -1;
+	//						cw->camera.ship_sel = -1;
+	//						cw->camera.ship_trg = -1;
 						}
 					}
 				}
 			}
-			else if ( (mc & 2)>0 && camera.ship_sel>-1)
+			else if ( (mc & 2)>0 && cw->camera.ship_sel>-1)
 			{
 				// return to formation
-				if (camera.ship_sel != playership && cships[playership].hits > 0 && cships[playership].type > -1)
+				if (cw->camera.ship_sel != cw->playership && cw->cships[cw->playership].hits > 0 && cw->cships[cw->playership].type > -1)
 				{
-					cships[camera.ship_sel].target = playership;
-					cships[camera.ship_sel].tac = 0;
-					camera.ship_trg = cships[camera.ship_sel].target;
-					camera.time_trg = t;
-					camera.drag_trg = 1;
+					combat_command(cev_target, cw->camera.ship_sel, cw->playership, t);
+					drag = 1;
 				}
 				/*
-				if (camera.ship_trg > -1)
+				if (cw->camera.ship_trg > -1)
 				{
-					s = camera.ship_trg;
-					camera.ship_trg = combat_findship(ik_mouse_x, ik_mouse_y);
-					if (camera.ship_trg > -1 && camera.ship_trg != camera.ship_sel)
-					{	cships[camera.ship_sel].target = camera.ship_trg; }
-					cships[camera.ship_sel].tac = 0;
-					camera.ship_trg = cships[camera.ship_sel].target;
-					if (s != camera.ship_trg)
-						camera.time_trg = t;
-					camera.drag_trg = 1;
+					s = cw->camera.ship_trg;
+					cw->camera.ship_trg = combat_findship(cw, ik_mouse_x, ik_mouse_y);
+					if (cw->camera.ship_trg > -1 && cw->camera.ship_trg != cw->camera.ship_sel)
+					{	cw->cships[cw->camera.ship_sel].target = cw->camera.ship_trg; }
+					cw->cships[cw->camera.ship_sel].tac = 0;
+					cw->camera.ship_trg = cw->cships[cw->camera.ship_sel].target;
+					if (s != cw->camera.ship_trg)
+						cw->camera.time_trg = t;
+					drag = 1;
 				}*/
 			}
 
-			if (!(b&3) && camera.drag_trg > 0)
+			if (!(b&3) && drag > 0)
 			{
-				camera.drag_trg = 0;
-				if (camera.ship_sel > -1)
+				drag = 0;
+				if (cw->camera.ship_sel > -1)
 				{
-					if (cships[camera.ship_sel].target > -1)
+					if (cw->cships[cw->camera.ship_sel].target > -1)
 					{
-						s = camera.ship_sel;
-						cships[s].angle = get_direction( cships[camera.ship_trg].ds_x - ik_mouse_x,
-																						 ik_mouse_y - cships[camera.ship_trg].ds_y );
-						cships[s].dist = get_distance( cships[camera.ship_trg].ds_x - ik_mouse_x,
-																					 ik_mouse_y - cships[camera.ship_trg].ds_y );
-						if (cships[s].dist <= cships[camera.ship_trg].ds_s>>1)
+						s = cw->camera.ship_sel;
+						c = get_direction( cw->cships[cw->camera.ship_trg].ds_x - ik_mouse_x,
+															 ik_mouse_y - cw->cships[cw->camera.ship_trg].ds_y );
+						f = get_distance( cw->cships[cw->camera.ship_trg].ds_x - ik_mouse_x,
+															ik_mouse_y - cw->cships[cw->camera.ship_trg].ds_y );
+						if (f <= cw->cships[cw->camera.ship_trg].ds_s>>1)
 						{
-							if ((cships[s].own&1) == (cships[camera.ship_trg].own&1))
-								cships[s].dist = 64;
+							if ((cw->cships[s].own&1) == (cw->cships[cw->camera.ship_trg].own&1))
+								f = 64;
 							else
-								cships[s].dist = 0;
+								f = 0;
 						}
 						else
-							cships[s].dist = (cships[s].dist << 12) / camera.z;
+							f = (f << 12) / cw->camera.z;
+						combat_command(cev_formation, s, c, f);
 					}
 					else
 					{
-						cships[camera.ship_sel].wp_x = camera.x + ((((ik_mouse_x - 400)<<12)/camera.z)<<10);
-						cships[camera.ship_sel].wp_y = camera.y + ((((244-ik_mouse_y)<<12)/camera.z)<<10);
+						combat_command(cev_waypoint, cw->camera.ship_sel,
+													 cw->camera.x + ((((ik_mouse_x - 400)<<12)/cw->camera.z)<<10),
+													 cw->camera.y + ((((244-ik_mouse_y)<<12)/cw->camera.z)<<10), 0);
 					}
 				}
 			}
 		}
 
-		if (t>t0)
+		zoom = 0;
+		if (key_pressed(key_up))
+			zoom++;
+		if (key_pressed(key_down))
+			zoom--;
+		combat_threadspeed(pause, zoom);
+
+		if (d>d0)
 		{
-			combat_checkescapes(t_move);
 			f=0;
 			for (s=0;s<MAX_COMBAT_SHIPS;s++)
-			if (cships[s].type>-1 && cships[s].escaped==0 && cships[s].active>0)
+			if (cw->cships[s].type>-1 && cw->cships[s].escaped==0 && cw->cships[s].active>0)
 			{
-				if ((cships[s].own&1)==0)
+				if ((cw->cships[s].own&1)==0)
 				{
-					if (cships[playership].type>-1)
+					if (cw->cships[cw->playership].type>-1)
 						f |= 1;
 				}
 				else
@@ -465,70 +421,477 @@ int32 combat(int32 flt, int32 sim)
 			else
 				end = 0;
 
-			if (key_pressed(key_up) && camera.z < 256)
-				camera.z ++;
-			if (key_pressed(key_down) && camera.z > 4)
-				camera.z --;
-
 			prep_screen();
 			if (wants_screenshot)
 				ik_save_screenshot(screen, globalpal);
 
 			ik_drawbox(screen, 0, 0, 640, 480, 0);
 
-			if (g_pause < 1)
-			{
-				while (t0<t)
-				{
-					t0++;
-					s = 1 + 2*(g_pause == -1);
-					while (s--)
-					{
-						t_move++;
-						combat_movement(t_move);
-						if (t_move==klaktime+1 && klaktime>0)
-							Play_SoundFX(WAV_HYPERDRIVE, get_ik_timer(1));
-					}
-				}
-			}
-			if (t_move > t_disp || (g_pause==1))
-			{
-				t_disp = t_move;
-				combat_display(t_disp);
-			}
+			// interface state the snapshot doesn't carry
+			cw->g_pause = pause;
+			cw->camera.drag_trg = drag;
+			combat_interpolate(cw, frac);
+			combat_display(cw, cw->t_disp);
+			combat_interpolate(cw, -frac);
 
 			ik_blit();
 			if (settings.random_names & 4)
 			{
+				combat_threadhold(1);
 				interface_tutorial(tut_combat);
+				combat_threadhold(0);
 				ik_eventhandler();  // always call every frame
 				t = get_ik_timer(1);
-				t0 = t;
 			}
 		}
+
+		combat_release();
 	}
 
-	combat_end(flt);
+	combat_threadstop();
+	cw = &combat_world;
+	combat_recend();
+	combat_end(cw, flt);
 
-	if (!simulated)
+	if (!cw->simulated)
 		Stop_All_Sounds();
 
 	return 1;
 }
 
+// run a simulated battle with no display, sound, input or timer
+// steps combat_movement() as fast as possible until one side is gone
+// (or maxticks is reached) and reports the outcome in res.
+// the same seed and sides always give the same battle.
+// the sides (pships, eships...) in cw must be filled in by the caller;
+// no globals are written, so separate worlds may run in parallel.
+int32 combat_headless(t_combatworld *cw, int32 maxticks, uint32 seed, t_combatresult *res)
+{
+	int32 s;
+	int32 f;
+	int32 end;
+
+	cw->simulated = 1;
+	cw->headless = 1;
+
+	combat_start(cw, seed);
+	cw->wepdmg = res->wepdmg;
+
+	cw->t_move = 0; cw->t_disp = 0; cw->g_pause = 0; end = 0; cw->rett=0;
+	res->kill = 0;
+
+	for (s = 0; s < MAX_COMBAT_SHIPS; s++)
+		res->type[s] = cw->cships[s].type;
+
+	while (cw->t_move < maxticks && (cw->t_move<end || end==0))
+	{
+		combat_checkescapes(cw, cw->t_move);
+		f=0;
+		for (s=0;s<MAX_COMBAT_SHIPS;s++)
+		if (cw->cships[s].type>-1 && cw->cships[s].escaped==0 && cw->cships[s].active>0)
+		{
+			if ((cw->cships[s].own&1)==0)
+			{
+				if (cw->cships[cw->playership].type>-1)
+					f |= 1;
+			}
+			else
+				f |= 2;
+		}
+
+		if (f!=3)
+		{
+			if (end==0)
+			{	end = cw->t_move+100; res->kill = cw->t_move; }
+		}
+		else
+			end = 0;
+
+		cw->t_move++;
+		combat_movement(cw, cw->t_move);
+		combat_headless_update(cw, cw->t_move);
+
+		// remember types of ships launched during the battle
+		for (s = 0; s < MAX_COMBAT_SHIPS; s++)
+			if (cw->cships[s].type > -1)
+				res->type[s] = cw->cships[s].type;
+	}
+
+	combat_result(cw, res);
+
+	cw->headless = 0;
+	cw->wepdmg = NULL;
+
+	return res->winner;
+}
+
+// fill in res from the state the battle ended in. res->type must hold
+// the types seen in each slot while the battle ran.
+void combat_result(t_combatworld *cw, t_combatresult *res)
+{
+	int32 s, x;
+	int32 f;
+
+	res->ticks = cw->t_move;
+
+	f=0;
+	for (s = 0; s < MAX_COMBAT_SHIPS; s++)
+	{
+		res->own[s] = cw->cships[s].own;
+		res->hits[s] = MAX(0, cw->cships[s].hits);
+		res->maxhits[s] = 0;
+		res->sysdmg[s] = 0;
+		res->syslost[s] = 0;
+		res->fate[s] = fate_survived;
+		if (res->type[s] == -1)
+			continue;
+
+		if (cw->cships[s].hits <= 0)
+			res->fate[s] = fate_destroyed;
+		else if (cw->cships[s].type == -1 || cw->cships[s].escaped)
+			res->fate[s] = fate_escaped;
+		else
+		{
+			res->fate[s] = fate_survived;
+			if ((cw->cships[s].own&1)==0)
+				f |= 1;
+			else
+				f |= 2;
+		}
+
+		res->maxhits[s] = hulls[shiptypes[res->type[s]].hull].hits;
+		for (x = 0; x < shiptypes[res->type[s]].num_systems; x++)
+		{
+			if (cw->cships[s].syshits[x] <= 0)
+				res->syslost[s]++;
+			else if (cw->cships[s].syshits[x] < 10)
+				res->sysdmg[s]++;
+		}
+	}
+
+	if (f == 1)
+		res->winner = 0;
+	else if (f == 2)
+		res->winner = 1;
+	else
+		res->winner = -1;
+}
+
+// release the pools of a world that won't fight again
+void combat_freeworld(t_combatworld *cw)
+{
+	combat_pooldeinit(&cw->projs);
+	combat_pooldeinit(&cw->beams);
+	combat_pooldeinit(&cw->explos);
+	cw->cprojs = NULL;
+	cw->cbeams = NULL;
+	cw->cexplo = NULL;
+}
+
+// hand out a slot, doubling the pool when it's full. this may move the
+// items, so callers must refresh their cprojs/cbeams/cexplo pointer.
+int32 combat_pooladd(t_combatpool *pool)
+{
+	int32 c, n;
+	void *items;
+	int32 *live, *next;
+
+	if (pool->free == -1)
+	{
+		n = pool->size * 2;
+		items = realloc(pool->items, n * pool->itemsize);
+		if (items) pool->items = items;
+		live = (int32*)realloc(pool->live, n * sizeof(int32));
+		if (live) pool->live = live;
+		next = (int32*)realloc(pool->next, n * sizeof(int32));
+		if (next) pool->next = next;
+		if (!items || !live || !next)
+			throw std::runtime_error("out of memory");
+
+		memset((char*)pool->items + pool->size * pool->itemsize, 0, (n - pool->size) * pool->itemsize);
+		for (c = n-1; c >= pool->size; c--)
+			combat_poolfree(pool, c);
+		pool->size = n;
+	}
+
+	c = pool->free;
+	pool->free = pool->next[c];
+	pool->live[pool->num++] = c;
+
+	return c;
+}
+
+// bucket the ships by position. ships only move at the start of
+// combat_movement(), so one build per tick serves the rest of it.
+void combat_buildgrid(t_combatworld *cw)
+{
+	int32 s, g;
+
+	for (g = 0; g < COMBAT_GRID_SIZE*COMBAT_GRID_SIZE; g++)
+		cw->grid_head[g] = -1;
+	cw->grid_size = 0;
+
+	for (s = 0; s < MAX_COMBAT_SHIPS; s++)
+	if (cw->cships[s].type > -1)
+	{
+		g = (((cw->cships[s].y>>10)>>COMBAT_GRID_SHIFT) & (COMBAT_GRID_SIZE-1)) * COMBAT_GRID_SIZE +
+				(((cw->cships[s].x>>10)>>COMBAT_GRID_SHIFT) & (COMBAT_GRID_SIZE-1));
+		cw->grid_next[s] = cw->grid_head[g];
+		cw->grid_head[g] = s;
+		cw->grid_x[s] = cw->cships[s].x>>10;
+		cw->grid_y[s] = cw->cships[s].y>>10;
+		cw->grid_r[s] = hulls[shiptypes[cw->cships[s].type].hull].size>>1;
+		cw->grid_size = MAX(cw->grid_size, cw->grid_r[s]);
+	}
+}
+
+// list the ships that may be within r pixels of x,y (and some that aren't),
+// in ascending order so callers pick the same ship a full scan would.
+int32 combat_gridquery(t_combatworld *cw, int32 x, int32 y, int32 r, int32 *list)
+{
+	int32 x0, y0, x1, y1;
+	int32 gx, gy;
+	int32 s, c, n;
+
+	n = 0;
+	if (cw->grid_off)
+	{
+		for (s = 0; s < MAX_COMBAT_SHIPS; s++)
+			if (cw->cships[s].type > -1)
+				list[n++] = s;
+		return n;
+	}
+
+	x0 = (x-r)>>COMBAT_GRID_SHIFT; x1 = (x+r)>>COMBAT_GRID_SHIFT;
+	y0 = (y-r)>>COMBAT_GRID_SHIFT; y1 = (y+r)>>COMBAT_GRID_SHIFT;
+	if (x1 - x0 >= COMBAT_GRID_SIZE - 1)	// visit each wrapped cell once
+	{	x0 = 0; x1 = COMBAT_GRID_SIZE-1; }
+	if (y1 - y0 >= COMBAT_GRID_SIZE - 1)
+	{	y0 = 0; y1 = COMBAT_GRID_SIZE-1; }
+
+	for (gy = y0; gy <= y1; gy++)
+	for (gx = x0; gx <= x1; gx++)
+	for (s = cw->grid_head[(gy & (COMBAT_GRID_SIZE-1))*COMBAT_GRID_SIZE + (gx & (COMBAT_GRID_SIZE-1))]; s > -1; s = cw->grid_next[s])
+	{
+		for (c = n; c > 0 && list[c-1] > s; c--)
+			list[c] = list[c-1];
+		list[c] = s;
+		n++;
+	}
+
+	return n;
+}
+
 // ----------------
 // LOCAL FUNCTIONS
 // ----------------
 
-void select_ship(int32 s, int32 t)
+// allocate the pool on first use, then empty it
+void combat_poolinit(t_combatpool *pool, int32 itemsize, int32 size)
+{
+	int32 c;
+
+	if (!pool->items)
+	{
+		pool->items = calloc(size, itemsize);
+		pool->live = (int32*)calloc(size, sizeof(int32));
+		pool->next = (int32*)calloc(size, sizeof(int32));
+		if (!pool->items || !pool->live || !pool->next)
+			throw std::runtime_error("out of memory");
+		pool->itemsize = itemsize;
+		pool->size = size;
+	}
+
+	memset(pool->items, 0, pool->size * pool->itemsize);
+	pool->num = 0;
+	pool->free = -1;
+	for (c = pool->size-1; c >= 0; c--)
+		combat_poolfree(pool, c);
+}
+
+void combat_poolfree(t_combatpool *pool, int32 c)
+{
+	pool->next[c] = pool->free;
+	pool->free = c;
+}
+
+void combat_pooldeinit(t_combatpool *pool)
+{
+	free(pool->items);
+	free(pool->live);
+	free(pool->next);
+	memset(pool, 0, sizeof(t_combatpool));
+}
+
+// free the slots of dead projectiles, beams and explosions
+void combat_sweep(t_combatworld *cw)
+{
+	int32 c, p, n;
+
+	// beams fired from a projectile end with it, before its slot is reused
+	for (c = 0; c < cw->beams.num; c++)
+	{
+		p = cw->beams.live[c];
+		if (cw->cbeams[p].wep && cw->cbeams[p].stg > -1 && !cw->cprojs[cw->cbeams[p].stg].wep)
+			cw->cbeams[p].wep = NULL;
+	}
+
+	n = 0;
+	for (c = 0; c < cw->projs.num; c++)
+	{
+		p = cw->projs.live[c];
+		if (cw->cprojs[p].wep)
+			cw->projs.live[n++] = p;
+		else
+			combat_poolfree(&cw->projs, p);
+	}
+	cw->projs.num = n;
+
+	n = 0;
+	for (c = 0; c < cw->beams.num; c++)
+	{
+		p = cw->beams.live[c];
+		if (cw->cbeams[p].wep)
+			cw->beams.live[n++] = p;
+		else
+			combat_poolfree(&cw->beams, p);
+	}
+	cw->beams.num = n;
+
+	n = 0;
+	for (c = 0; c < cw->explos.num; c++)
+	{
+		p = cw->explos.live[c];
+		if (cw->cexplo[p].spr)
+			cw->explos.live[n++] = p;
+		else
+			combat_poolfree(&cw->explos, p);
+	}
+	cw->explos.num = n;
+}
+
+// carry out a player command. combat() queues these for its sim thread,
+// which records them, and a replay feeds them back on the same ticks.
+// the interface works from a snapshot a tick or so old, so commands that
+// no longer apply are dropped here.
+void combat_applyevent(t_combatworld *cw, t_combatevent *ev)
+{
+	int32 s;
+
+	s = ev->ship;
+	switch (ev->type)
+	{
+		case cev_select:
+		select_ship(cw, s, ev->par[0]);
+		break;
+
+		case cev_target:	// also "return to formation" on the player ship
+		cw->camera.ship_trg = ev->par[0];
+		cw->cships[s].target = ev->par[0];
+		cw->cships[s].tac = 0;
+		cw->camera.time_trg = ev->par[1];
+		break;
+
+		case cev_waypoint:
+		if (ev->par[2])	// new order, not just dragging the waypoint
+		{
+			cw->cships[s].target = -1;
+			cw->cships[s].tac = 2;
+		}
+		cw->cships[s].wp_x = ev->par[0];
+		cw->cships[s].wp_y = ev->par[1];
+		break;
+
+		case cev_formation:
+		cw->cships[s].angle = ev->par[0];
+		cw->cships[s].dist = ev->par[1];
+		break;
+
+		case cev_cloak:
+		if (cw->cships[s].clo_type <= 0 || cw->cships[s].syshits[cw->cships[s].sys_clo] < 5 || cw->t_move <= cw->cships[s].cloaktime+100)
+			break;
+		combat_sound(cw, WAV_DOT);
+		cw->cships[s].cloaked = !cw->cships[s].cloaked;
+		cw->cships[s].cloaktime = cw->t_move;
+		break;
+
+		case cev_gong:
+		if (cw->gongavail != 2)
+			break;
+		combat_use_gong(cw, cw->t_move);
+		cw->gongavail = 1;
+		break;
+
+		case cev_retreat:
+		if (ev->par[0] == cw->retreat)
+			break;
+		combat_sound(cw, WAV_SELECT, ev->par[1]);
+		if (ev->par[0])
+		{
+			cw->retreat = 1;
+			cw->rett = cw->t_move;
+			combat_sound(cw, WAV_FLARE, 0, 15);
+
+			for (s = 0; s < MAX_COMBAT_SHIPS; s++)
+			if ((cw->cships[s].own&1) == 0)
+				combat_findstuff2do(cw, s, ev->par[1]);
+		}
+		else
+		{
+			cw->retreat = 0;
+			if (cw->simulated)
+				combat_sound(cw, WAV_MUS_SIMULATOR, 0, 15, 85);
+			else if (!cw->nebula)
+				combat_sound(cw, WAV_MUS_COMBAT, 0, 15);
+			else
+				combat_sound(cw, WAV_MUS_NEBULA, 0, 15);
+
+			for (s = 0; s < MAX_COMBAT_SHIPS; s++)
+			{
+				if ((cw->cships[s].own&1) == 0 && s != cw->playership)
+					combat_findstuff2do(cw, s, ev->par[1]);
+			}
+		}
+		break;
+
+		case cev_klakar:
+		if (cw->klakavail != 1)
+			break;
+		if (ev->par[0])
+			combat_sound(cw, WAV_DESELECT);
+		else
+			combat_summon_klakar(cw, cw->t_move);
+		cw->klakavail = 0;
+		break;
+	}
+}
+
+void select_ship(t_combatworld *cw, int32 s, int32 t)
 {
-	camera.ship_sel = s;
-	camera.time_sel = t;
-	camera.ship_trg = cships[s].target;
-	camera.time_trg = t;
+	cw->camera.ship_sel = s;
+	cw->camera.time_sel = t;
+	cw->camera.ship_trg = cw->cships[s].target;
+	cw->camera.time_trg = t;
 }
 
-void combat_start(int32 flt)
+// copy the player's ships and fleet flt into the world's sides
+void combat_setsides(t_combatworld *cw, int32 flt)
+{
+	int32 p;
+
+	cw->num_pships = player.num_ships;
+	for (p = 0; p < player.num_ships; p++)
+		cw->pships[p] = player.ships[p];
+
+	cw->num_eships = sm_fleets[flt].num_ships;
+	for (p = 0; p < sm_fleets[flt].num_ships; p++)
+		cw->eships[p] = sm_fleets[flt].ships[p];
+	cw->erace = sm_fleets[flt].race;
+	cw->eflt = flt;
+	cw->esystem = sm_fleets[flt].system;
+}
+
+void combat_start(t_combatworld *cw, uint32 seed)
 {
 	int t, p;
 	int r, s;
@@ -536,75 +899,78 @@ void combat_start(int32 flt)
 	int nc, rc, nf;
 	int32 angle;
 
-	srand( (unsigned)time( NULL ) );
+	rng_seed(&cw->rng, seed);
 
-	retreat = 0;
+	cw->retreat = 0;
+	cw->wepdmg = NULL;
+	cw->queuesound = 0;
+	cw->numsounds = 0;
 
-	if (simulated)
-		nebula = 0;
+	if (cw->simulated)
+		cw->nebula = 0;
 	else if (sm_nebulamap[((240-player.y)<<9)+(240+player.x)]>0)
-		nebula = 1;
+		cw->nebula = 1;
 	else
-		nebula = 0;
+		cw->nebula = 0;
 
 
 	for (t = 0; t < MAX_COMBAT_SHIPS; t++)
 	{
-		cships[t].type = -1;
-		cships[t].own = -1;
+		cw->cships[t].type = -1;
+		cw->cships[t].own = -1;
 		for (p = 0; p < 8; p++)
-			cships[t].wepfire[p] = 0;
-		cships[t].target = -1;
-		cships[t].tac = -1;
-		cships[t].teltime = 0;
-		cships[t].bong_start = 0;
-		cships[t].bong_end = 0;
-		cships[t].aistart = 0;
-		cships[t].launchtime = 100;
-		cships[t].flee = 0;
+			cw->cships[t].wepfire[p] = 0;
+		cw->cships[t].target = -1;
+		cw->cships[t].tac = -1;
+		cw->cships[t].teltime = 0;
+		cw->cships[t].bong_start = 0;
+		cw->cships[t].bong_end = 0;
+		cw->cships[t].aistart = 0;
+		cw->cships[t].launchtime = 100;
+		cw->cships[t].flee = 0;
 	}
-	for (t = 0; t < MAX_COMBAT_PROJECTILES; t++)
-		cprojs[t].wep = NULL;
-	for (t = 0; t < MAX_COMBAT_BEAMS; t++)
-		cbeams[t].wep = NULL;
-	for (t = 0; t < MAX_COMBAT_EXPLOS; t++)
-		cexplo[t].spr = NULL;
-	camera.x = 0;
-	camera.y = 0;
-	camera.z = 4096;
+	combat_poolinit(&cw->projs, sizeof(t_wepproj), MAX_COMBAT_PROJECTILES);
+	combat_poolinit(&cw->beams, sizeof(t_wepbeam), MAX_COMBAT_BEAMS);
+	combat_poolinit(&cw->explos, sizeof(t_explosion), MAX_COMBAT_EXPLOS);
+	cw->cprojs = (t_wepproj*)cw->projs.items;
+	cw->cbeams = (t_wepbeam*)cw->beams.items;
+	cw->cexplo = (t_explosion*)cw->explos.items;
+	cw->camera.x = 0;
+	cw->camera.y = 0;
+	cw->camera.z = 4096;
 
-	camera.ship_sel = -1;
-	camera.ship_trg = -1;
+	cw->camera.ship_sel = -1;
+	cw->camera.ship_trg = -1;
 
-	angle = rand()%1024;
+	angle = rng_rand(&cw->rng)%1024;
 
 	t = 0;
-	for (p = 0; p < player.num_ships; p++)
+	for (p = 0; p < cw->num_pships; p++)
 	{
 		if (p == 0)
-		{	cships[t].x = 0; playership = t; }
+		{	cw->cships[t].x = 0; cw->playership = t; }
 		else {
-			cships[t].x = ((t+1)/2)*128;
+			cw->cships[t].x = ((t+1)/2)*128;
 			if (p&1)
-				cships[t].x = -cships[t].x;
+				cw->cships[t].x = -cw->cships[t].x;
 		}
-		cships[t].y = -700;
-		cships[t].a = 0;
-		cships[t].type = player.ships[p];
-		cships[t].own = 0;
+		cw->cships[t].y = -700;
+		cw->cships[t].a = 0;
+		cw->cships[t].type = cw->pships[p];
+		cw->cships[t].own = 0;
 		t++;
 	}
 
-	s = sm_fleets[flt].num_ships;		//rand()%4 + 1;
-	rc = sm_fleets[flt].race;
+	s = cw->num_eships;		//rng_rand(&cw->rng)%4 + 1;
+	rc = cw->erace;
 
 	// place enemy ships
 	nc = 0; nf = 0;
 	for (p = 0; p < s; p++)
 	{
-		if (hulls[shiptypes[sm_fleets[flt].ships[p]].hull].size>=32)
+		if (hulls[shiptypes[cw->eships[p]].hull].size>=32)
 		{
-			if (!(shiptypes[sm_fleets[flt].ships[p]].flag & 128))	// if not deep hunter
+			if (!(shiptypes[cw->eships[p]].flag & 128))	// if not deep hunter
 				nc++;
 		}
 		else
@@ -613,23 +979,23 @@ void combat_start(int32 flt)
 
 	for (p = 0; p < s; p++)
 	{
-		cships[t].type = sm_fleets[flt].ships[p];
-		cships[t].own = 1;
-		if (hulls[shiptypes[cships[t].type].hull].size>=32)
+		cw->cships[t].type = cw->eships[p];
+		cw->cships[t].own = 1;
+		if (hulls[shiptypes[cw->cships[t].type].hull].size>=32)
 		{ r = 1; }
 		else
 		{	r = 0; }
-		if (shiptypes[cships[t].type].flag & 128)
+		if (shiptypes[cw->cships[t].type].flag & 128)
 		{	r = 2; }
 
 		switch (rc)
 		{
 			case race_garthan:	// V formation
-			cships[t].x = ((p+1)/2)*96;
+			cw->cships[t].x = ((p+1)/2)*96;
 			if (p&1)
-				cships[t].x = -cships[t].x;
-			cships[t].y = 700+((p+1)/2)*64;
-			cships[t].a = 512;
+				cw->cships[t].x = -cw->cships[t].x;
+			cw->cships[t].y = 700+((p+1)/2)*64;
+			cw->cships[t].a = 512;
 			break;
 
 #ifndef DEMO_VERSION
@@ -637,40 +1003,40 @@ void combat_start(int32 flt)
 			if (r)	// corvette
 			{
 				if (nc == 3)
-					cships[t].x = 96 + 96*((p==1)-(p==2));
+					cw->cships[t].x = 96 + 96*((p==1)-(p==2));
 				else
-					cships[t].x = p*96;
-				cships[t].y = 700;
+					cw->cships[t].x = p*96;
+				cw->cships[t].y = 700;
 			}
 			else	// fighter circle
 			{
-				y = 1024 * (p-nc) / (sm_fleets[flt].num_ships-nc);
+				y = 1024 * (p-nc) / (cw->num_eships-nc);
 				x = MAX(nc-1, 0);
-				cships[t].x = x*48 + ((sin1k[y]*(128+x*64))>>16);
-				cships[t].y = 700 - ((cos1k[y]*128)>>16);
+				cw->cships[t].x = x*48 + ((sin1k[y]*(128+x*64))>>16);
+				cw->cships[t].y = 700 - ((cos1k[y]*128)>>16);
 			}
-			cships[t].a = 512;
+			cw->cships[t].a = 512;
 			break;
 
 			case race_tanru:	// grids
 			if (r)	// corvette
 			{
-				cships[t].x = -64 + 128 * (p & 1);
-				cships[t].y = 700 + 128 * (p/2);
+				cw->cships[t].x = -64 + 128 * (p & 1);
+				cw->cships[t].y = 700 + 128 * (p/2);
 			}
 			else	// fighter
 			{
-				cships[t].x = -512 + 1024*(flt&1) + 128 * ((p - nc)&1);
-				cships[t].y = 700 + 128 * ((p-nc)/2);
+				cw->cships[t].x = -512 + 1024*(cw->eflt&1) + 128 * ((p - nc)&1);
+				cw->cships[t].y = 700 + 128 * ((p-nc)/2);
 			}
-			cships[t].a = 512;
+			cw->cships[t].a = 512;
 			break;
 
 			case race_urluquai:
 			x = p;
 			if (r == 2)
 			{
-				y = rand()%1024;
+				y = rng_rand(&cw->rng)%1024;
 			}
 			else
 			{
@@ -678,100 +1044,103 @@ void combat_start(int32 flt)
 				// 	y = ((x+1)/2)*512/((sm_fleets[flt].num_ships+1)/2);
 				//if (x&1)
 				//	y = -y;
-				x = p - (sm_fleets[flt].num_ships - (nc+nf));
+				x = p - (cw->num_eships - (nc+nf));
 				y = (x * 1024) / (nc+nf);
 				y = y - ((nc/2) * 512) / (nc+nf);
 			}
 			y = (1024 + y) & 1023;
-			cships[t].x = (sin1k[y]*1400) >> 16;
-			cships[t].y = ((cos1k[y]*1400) >> 16) - 700;
-			cships[t].a = (y+512) & 1023;
+			cw->cships[t].x = (sin1k[y]*1400) >> 16;
+			cw->cships[t].y = ((cos1k[y]*1400) >> 16) - 700;
+			cw->cships[t].a = (y+512) & 1023;
 			break;
 #endif
 
 			default:
-			cships[t].x = ((p+1)/2)*128;
+			cw->cships[t].x = ((p+1)/2)*128;
 			if (p&1)
-				cships[t].x = -cships[t].x;
-			cships[t].y = 700;
-			cships[t].a = 512;
+				cw->cships[t].x = -cw->cships[t].x;
+			cw->cships[t].y = 700;
+			cw->cships[t].a = 512;
 		}
-		cships[t].aistart = 100;
+		cw->cships[t].aistart = 100;
 
 		t++;
 	}
 
 	for (t = 0; t < MAX_COMBAT_SHIPS; t++)
-	if (cships[t].type > -1)
+	if (cw->cships[t].type > -1)
 	{
-		x = cships[t].x; y = cships[t].y;
-		cships[t].x = (x * cos1k[angle] + y * sin1k[angle]) >> 6;
-		cships[t].y = (y * cos1k[angle] - x * sin1k[angle]) >> 6;
-		cships[t].a = (cships[t].a + angle) & 1023;
+		x = cw->cships[t].x; y = cw->cships[t].y;
+		cw->cships[t].x = (x * cos1k[angle] + y * sin1k[angle]) >> 6;
+		cw->cships[t].y = (y * cos1k[angle] - x * sin1k[angle]) >> 6;
+		cw->cships[t].a = (cw->cships[t].a + angle) & 1023;
 	}
 
 	for (t = 0; t < MAX_COMBAT_SHIPS; t++)
-	if (cships[t].type > -1)
+	if (cw->cships[t].type > -1)
 	{
-		cships[t].vx = 0;
-		cships[t].vy = 0;
-		cships[t].va = 0;
-		cships[t].hits = shiptypes[cships[t].type].hits/256; //hulls[shiptypes[cships[t].type].hull].hits;
-		cships[t].shld = 0;
-		cships[t].shld_time = 0;
-		cships[t].shld_charge = 0;
-		cships[t].damage_time = 0;
-		cships[t].dmgc_time = 0;
-		cships[t].tac = 0;
-		cships[t].escaped = 0;
-		cships[t].active = 2;
-		if (shiptypes[cships[t].type].race == race_unknown)
+		cw->cships[t].vx = 0;
+		cw->cships[t].vy = 0;
+		cw->cships[t].va = 0;
+		cw->cships[t].hits = shiptypes[cw->cships[t].type].hits/256; //hulls[shiptypes[cw->cships[t].type].hull].hits;
+		cw->cships[t].shld = 0;
+		cw->cships[t].shld_time = 0;
+		cw->cships[t].shld_charge = 0;
+		cw->cships[t].damage_time = 0;
+		cw->cships[t].dmgc_time = 0;
+		cw->cships[t].tac = 0;
+		cw->cships[t].escaped = 0;
+		cw->cships[t].active = 2;
+		if (shiptypes[cw->cships[t].type].race == race_unknown)
 		{
-			cships[t].active = 1; cships[t].va = (rand()%3+1)*( (rand()&1)*2-1 );
-			if (sm_fleets[flt].system & 1)	// 50% chance of being dead
+			cw->cships[t].active = 1; cw->cships[t].va = (rng_rand(&cw->rng)%3+1)*( (rng_rand(&cw->rng)&1)*2-1 );
+			if (cw->esystem & 1)	// 50% chance of being dead
 			{
-				cships[t].hits = 1;
+				cw->cships[t].hits = 1;
 			}
 		}
-		cships[t].cloaked = 0;
-		cships[t].cloaktime = 0;
+		cw->cships[t].cloaked = 0;
+		cw->cships[t].cloaktime = 0;
 
-		for (x = 0; x < shiptypes[cships[t].type].num_systems; x++)
+		for (x = 0; x < shiptypes[cw->cships[t].type].num_systems; x++)
 		{
-			cships[t].syshits[x] = 10*(shiptypes[cships[t].type].sysdmg[x]==0);
+			cw->cships[t].syshits[x] = 10*(shiptypes[cw->cships[t].type].sysdmg[x]==0);
 		}
-		combat_updateshipstats(t, 0);
+		combat_updateshipstats(cw, t, 0);
 
-		if (cships[t].clo_type > 0)
-			{	cships[t].cloaked = 1; cships[t].cloaktime = 0; }
-		if (cships[t].shld_type > -1)
-			cships[t].shld = shipsystems[cships[t].shld_type].par[0];
+		if (cw->cships[t].clo_type > 0)
+			{	cw->cships[t].cloaked = 1; cw->cships[t].cloaktime = 0; }
+		if (cw->cships[t].shld_type > -1)
+			cw->cships[t].shld = shipsystems[cw->cships[t].shld_type].par[0];
 
-		combat_findstuff2do(t, 0);
+		combat_findstuff2do(cw, t, 0);
 	}
 
 
-	klaktime = 0;
-	klakavail = 0;
-	for (t = 0; t < STARMAP_MAX_FLEETS; t++)
-	if (sm_fleets[t].race == race_klakar && sm_fleets[t].num_ships > 0)
+	cw->klaktime = 0;
+	cw->klakavail = 0;
+	cw->gongavail = 0;
+	if (!cw->simulated)	// the simulator has no cargo
 	{
-		for (s = 0; s < player.num_items; s++)
+		for (t = 0; t < STARMAP_MAX_FLEETS; t++)
+		if (sm_fleets[t].race == race_klakar && sm_fleets[t].num_ships > 0)
 		{
-			if (itemtypes[player.items[s]].flag & 4)
-				klakavail = 1;
+			for (s = 0; s < player.num_items; s++)
+			{
+				if (itemtypes[player.items[s]].flag & 4)
+					cw->klakavail = 1;
+			}
 		}
-	}
 
-	gongavail = 0;
-	for (t = 0; t < player.num_items; t++)
-	{
-		if (itemtypes[player.items[t]].flag & device_gong)
-			gongavail = 2;
+		for (t = 0; t < player.num_items; t++)
+		{
+			if (itemtypes[player.items[t]].flag & device_gong)
+				cw->gongavail = 2;
+		}
 	}
 
-	camera.ship_sel = playership;
-	camera.time_sel = 0;
+	cw->camera.ship_sel = cw->playership;
+	cw->camera.time_sel = 0;
 
 }
 
@@ -842,7 +1211,7 @@ void combat_removeenemyship(int32 flt, int32 s)
 	sm_fleets[flt].num_ships--;
 }
 
-void combat_sim_end()
+void combat_sim_end(t_combatworld *cw)
 {
 	int32 end;
 	int32 c, mc;
@@ -889,7 +1258,7 @@ void combat_sim_end()
 			ik_print(screen, font_6x8, bx+120-12*3, by+24, 4, textstring[STR_COMBAT_SIMALLY]);
 			for (c = 0; c < player.num_ships; c++)
 			{
-				s = (cships[c].hits > 0);
+				s = (cw->cships[c].hits > 0);
 				interface_thinborder(screen, bx+16+c*72, by+36, bx+80+c*72, by+108, s*STARMAP_INTERFACE_COLOR+(1-s), 0);
 				ik_drsprite(screen, bx+48+c*72, by+76, 0, 64, hulls[shiptypes[player.ships[c]].hull].sprite, 1+((s*15+(1-s)*26)<<8));
 				if (s)
@@ -916,8 +1285,8 @@ void combat_sim_end()
 			for (c = 0; c < sm_fleets[0].num_ships; c++)
 			{
 				s = 0;
-				if (cships[player.num_ships+c].hits <= 0) s = 2;
-				else if (cships[player.num_ships+c].type == -1) s = 1;
+				if (cw->cships[player.num_ships+c].hits <= 0) s = 2;
+				else if (cw->cships[player.num_ships+c].type == -1) s = 1;
 
 				co = 15*(s==0)+58*(s==1)+26*(s==2);
 				ik_drsprite(screen, bx+83+en[s]*12, by+143+s*22, 0, 16, hulls[shiptypes[sm_fleets[0].ships[c]].hull].sprite, 1+(co<<8));
@@ -940,7 +1309,7 @@ void combat_sim_end()
 	del_image(bg);
 }
 
-void combat_end(int32 flt)
+void combat_end(t_combatworld *cw, int32 flt)
 {
 	int32 c;
 	int32 it;
@@ -950,26 +1319,26 @@ void combat_end(int32 flt)
 	int32 de = -1;
 	char texty[256];
 
-	if (simulated)
+	if (cw->simulated)
 	{
-		combat_sim_end();
+		combat_sim_end(cw);
 		return;
 	}
 
 	for (c = 0; c < player.num_ships; c++)
-	if (cships[c].type>-1)
+	if (cw->cships[c].type>-1)
 	{
-		shiptypes[cships[c].type].hits = cships[c].hits*256;
-		for (x = 0; x < shiptypes[cships[c].type].num_systems; x++)
+		shiptypes[cw->cships[c].type].hits = cw->cships[c].hits*256;
+		for (x = 0; x < shiptypes[cw->cships[c].type].num_systems; x++)
 		{
-			if (cships[c].syshits[x] <= 0 && shipsystems[shiptypes[cships[c].type].system[x]].item > -1)
+			if (cw->cships[c].syshits[x] <= 0 && shipsystems[shiptypes[cw->cships[c].type].system[x]].item > -1)
 			{
-				shiptypes[cships[c].type].sysdmg[x] = 1;
-				if ((de == -1) && (c==playership) &&
-						(rand()%10==0) &&
-						(shipsystems[shiptypes[cships[c].type].system[x]].type!=sys_shield))
+				shiptypes[cw->cships[c].type].sysdmg[x] = 1;
+				if ((de == -1) && (c==cw->playership) &&
+						(rng_rand(&cw->rng)%10==0) &&
+						(shipsystems[shiptypes[cw->cships[c].type].system[x]].type!=sys_shield))
 				{
-					de = shiptypes[cships[c].type].system[x];
+					de = shiptypes[cw->cships[c].type].system[x];
 					starmap_destroysystem(x);
 				}
 			}
@@ -978,7 +1347,7 @@ void combat_end(int32 flt)
 
 	for (c = MAX_COMBAT_SHIPS-1; c >= player.num_ships; c--)
 	{
-		if (cships[c].own == 1 && (cships[c].hits<=0 || cships[c].type==-1))
+		if (cw->cships[c].own == 1 && (cw->cships[c].hits<=0 || cw->cships[c].type==-1))
 		{
 			if (c-player.num_ships < sm_fleets[flt].num_ships)
 				combat_removeenemyship(flt, c-player.num_ships);
@@ -987,7 +1356,7 @@ void combat_end(int32 flt)
 
 	for (c = player.num_ships-1; c >= 0; c--)
 	{
-		if (cships[c].hits < 1)
+		if (cw->cships[c].hits < 1)
 			starmap_removeship(c);
 	}
 
@@ -995,7 +1364,7 @@ void combat_end(int32 flt)
 
 	for (c = 0; c < MAX_COMBAT_SHIPS; c++)
 	{
-		if (cships[c].hits > 0 && cships[c].type > -1 && cships[c].own == 1)
+		if (cw->cships[c].hits > 0 && cw->cships[c].type > -1 && cw->cships[c].own == 1)
 		{
 			flt = -1;
 		}
@@ -1009,13 +1378,13 @@ void combat_end(int32 flt)
 
 	for (c = 0; c < MAX_COMBAT_SHIPS; c++)
 	{
-		if (cships[c].own == 2)			// klakar
+		if (cw->cships[c].own == 2)			// klakar
 		{
 			f = -1;
 			for (b = 0; b < STARMAP_MAX_FLEETS; b++)
 				if (sm_fleets[b].race == race_klakar)
 					f = b;
-			if (cships[c].type > -1 && cships[c].hits>0)	// survived
+			if (cw->cships[c].type > -1 && cw->cships[c].hits>0)	// survived
 			{
 				if (player.num_ships > 0 && player.ships[0] == 0)	// player survives to pay
 				{
@@ -1041,7 +1410,7 @@ void combat_end(int32 flt)
 					while (it == -1 && !must_quit)
 					{
 						ik_eventhandler();
-						it = rand()%num_stars;
+						it = rng_rand(&cw->rng)%num_stars;
 						b = get_distance(sm_stars[it].x - sm_stars[player.system].x,
 														 sm_stars[it].y - sm_stars[player.system].y);
 						if (b < 100)
@@ -1075,7 +1444,7 @@ void combat_end(int32 flt)
 
 }
 
-void combat_movement(int32 t)
+void combat_movement(t_combatworld *cw, int32 t)
 {
 	int32 c;
 	int32 d;
@@ -1085,216 +1454,226 @@ void combat_movement(int32 t)
 	int32 r, rm;
 	int32 tg, wx, wy;
 	int32 sp, sx, sy;
+	int32 n, q;
+	int32 pr, npr;
+	int32 rd, dx, dy;
+	int32 list[MAX_COMBAT_SHIPS];
 	t_hull *hull;
 
+	combat_sweep(cw);
+
 	// **** MOVE SHIPS ****
 	for (c = 0; c < MAX_COMBAT_SHIPS; c++)
-	if (cships[c].type > -1)
+	if (cw->cships[c].type > -1)
 	{
-		cships[c].x += cships[c].vx;
-		cships[c].y += cships[c].vy;
-		cships[c].a = (cships[c].a + cships[c].va) & 1023;
+		cw->cships[c].x += cw->cships[c].vx;
+		cw->cships[c].y += cw->cships[c].vy;
+		cw->cships[c].a = (cw->cships[c].a + cw->cships[c].va) & 1023;
 
 #ifndef DEMO_VERSION
-		if (cships[c].cloaktime > 0 && t == cships[c].cloaktime+1)
+		if (cw->cships[c].cloaktime > 0 && t == cw->cships[c].cloaktime+1)
 		{
-			if (cships[c].cloaked)
-				combat_SoundFX(WAV_CLOAKIN, cships[c].x);
+			if (cw->cships[c].cloaked)
+				combat_SoundFX(cw, WAV_CLOAKIN, cw->cships[c].x);
 			else
-				combat_SoundFX(WAV_CLOAKOUT, cships[c].x);
+				combat_SoundFX(cw, WAV_CLOAKOUT, cw->cships[c].x);
 		}
 #endif
 
-		if (cships[c].teltime > 0)
+		if (cw->cships[c].teltime > 0)
 		{
-			if (t - cships[c].teltime >= 32 && (cships[c].tel_x!=0 || cships[c].tel_y!=0))
+			if (t - cw->cships[c].teltime >= 32 && (cw->cships[c].tel_x!=0 || cw->cships[c].tel_y!=0))
 			{
-				cships[c].x += cships[c].tel_x;
-				cships[c].y += cships[c].tel_y;
-				cships[c].tel_x = 0;
-				cships[c].tel_y = 0;
-				//cexplo[combat_addexplo(cships[c].x, cships[c].y, spr_shockwave, 0, 96, 1, t, t+24, 1)].str = t-8;
-				combat_addexplo(cships[c].x, cships[c].y, spr_shockwave, 1, 112, 0, t, t+10, 4);
+				cw->cships[c].x += cw->cships[c].tel_x;
+				cw->cships[c].y += cw->cships[c].tel_y;
+				cw->cships[c].tel_x = 0;
+				cw->cships[c].tel_y = 0;
+				//cw->cexplo[combat_addexplo(cw, cw->cships[c].x, cw->cships[c].y, spr_shockwave, 0, 96, 1, t, t+24, 1)].str = t-8;
+				combat_addexplo(cw, cw->cships[c].x, cw->cships[c].y, spr_shockwave, 1, 112, 0, t, t+10, 4);
 			}
 		}
 
-		if (shiptypes[cships[c].type].flag & 16)
+		if (shiptypes[cw->cships[c].type].flag & 16)
 		{
-			if (t > cships[c].launchtime && cships[c].hits > 0)
+			if (t > cw->cships[c].launchtime && cw->cships[c].hits > 0)
 			{
-				p = racefleets[races[shiptypes[cships[c].type].race].fleet].stype[0];
+				p = racefleets[races[shiptypes[cw->cships[c].type].race].fleet].stype[0];
 				a = 0;
 				for (d = 0; d < MAX_COMBAT_SHIPS; d++)
-					if (cships[d].type == p && cships[d].hits > 0)
-						if (cships[d].own == cships[c].own)
+					if (cw->cships[d].type == p && cw->cships[d].hits > 0)
+						if (cw->cships[d].own == cw->cships[c].own)
 							a++;
 				if (a < 3)	// don't launch more than 3 at once
 				{
-					combat_SoundFX(WAV_FIGHTERLAUNCH, cships[c].x);
-					cships[c].launchtime = t + 200;
+					combat_SoundFX(cw, WAV_FIGHTERLAUNCH, cw->cships[c].x);
+					cw->cships[c].launchtime = t + 200;
 				}
 			}
-			if (t == cships[c].launchtime - 150)
-				combat_launch_fighter(c, t);
+			if (t == cw->cships[c].launchtime - 150)
+				combat_launch_fighter(cw, c, t);
 		}
 
 #ifndef DEMO_VERSION
-		if (cships[c].bong_start > 0 && cships[c].hits > 0 && cships[c].type > -1)
+		if (cw->cships[c].bong_start > 0 && cw->cships[c].hits > 0 && cw->cships[c].type > -1)
 		{
-			if (t < cships[c].bong_end)
+			if (t < cw->cships[c].bong_end)
 			{
-				if (t == cships[c].bong_start + 50)
-					Play_SoundFX(WAV_FIERYFURY, t);
-				else if (t > cships[c].bong_start + 50)
+				if (t == cw->cships[c].bong_start + 50)
+				{
+					combat_sound(cw, WAV_FIERYFURY, t);
+				}
+				else if (t > cw->cships[c].bong_start + 50)
 				{
 					d = t % 5;
-					p = (t-cships[c].bong_start-50);
+					p = (t-cw->cships[c].bong_start-50);
 					p = ((p+50)*(p+50)-2500) >> 6;
 					a = (205*d + p) & 1023;
-					r = 2000*(cships[c].bong_end-t)/(cships[c].bong_end-cships[c].bong_start-50);
-					sx = cships[c].x + ((sin1k[a]*r)>>6);
-					sy = cships[c].y + ((cos1k[a]*r)>>6);
+					r = 2000*(cw->cships[c].bong_end-t)/(cw->cships[c].bong_end-cw->cships[c].bong_start-50);
+					sx = cw->cships[c].x + ((sin1k[a]*r)>>6);
+					sy = cw->cships[c].y + ((cos1k[a]*r)>>6);
 
-					combat_addexplo(sx, sy, spr_explode1, 1, 96, 0, t, t+32,-1,0);
+					combat_addexplo(cw, sx, sy, spr_explode1, 1, 96, 0, t, t+32,-1,0);
 				}
 			}
 			else
 			{
 				if (settings.opt_lensflares)
 				{
-					combat_addexplo(cships[c].x, cships[c].y, spr_shockwave, 1, 112, 0, t, t+10, 4, 0);
-					combat_addexplo(cships[c].x, cships[c].y, spr_shockwave, 0, 512, 1, t, t+10, 3, 0);
+					combat_addexplo(cw, cw->cships[c].x, cw->cships[c].y, spr_shockwave, 1, 112, 0, t, t+10, 4, 0);
+					combat_addexplo(cw, cw->cships[c].x, cw->cships[c].y, spr_shockwave, 0, 512, 1, t, t+10, 3, 0);
 				}
-				combat_addexplo(cships[c].x, cships[c].y, spr_shockwave, 0, 512, 1, t, t+20, 2, 0);
-				combat_addexplo(cships[c].x, cships[c].y, spr_shockwave, 0, 512, 1, t, t+40, 1, 0);
-				cships[c].bong_start = 0;
+				combat_addexplo(cw, cw->cships[c].x, cw->cships[c].y, spr_shockwave, 0, 512, 1, t, t+20, 2, 0);
+				combat_addexplo(cw, cw->cships[c].x, cw->cships[c].y, spr_shockwave, 0, 512, 1, t, t+40, 1, 0);
+				cw->cships[c].bong_start = 0;
 
-				if (shiptypes[cships[c].type].race == race_unknown)	// stop space hulk
+				if (shiptypes[cw->cships[c].type].race == race_unknown)	// stop space hulk
 				{
-					cships[c].va = rand()%cships[c].turn+1;
-					if (rand()&1)
-						cships[c].va = -cships[c].va;
+					cw->cships[c].va = rng_rand(&cw->rng)%cw->cships[c].turn+1;
+					if (rng_rand(&cw->rng)&1)
+						cw->cships[c].va = -cw->cships[c].va;
 
-					cships[c].vx = cships[c].vy = 0;
+					cw->cships[c].vx = cw->cships[c].vy = 0;
 				}
 
-				combat_SoundFX(WAV_EXPLO1, cships[c].x);
-				combat_killship(c, t);
+				combat_SoundFX(cw, WAV_EXPLO1, cw->cships[c].x);
+				combat_killship(cw, c, t);
 			}
 		}
 #endif
 
 	}
 
+	combat_buildgrid(cw);
+
 	// **** COMBAT AI ****
 	for (c = 0; c < MAX_COMBAT_SHIPS; c++)
-	if (cships[c].type > -1 && cships[c].active>0 && t > cships[c].aistart)
+	if (cw->cships[c].type > -1 && cw->cships[c].active>0 && t > cw->cships[c].aistart)
 	{
-		if (cships[c].hits > 0 && cships[c].active==2)
+		if (cw->cships[c].hits > 0 && cw->cships[c].active==2)
 		{
 			// shield recharge
-			if (cships[c].shld_type>-1 && t > cships[c].shld_charge)
+			if (cw->cships[c].shld_type>-1 && t > cw->cships[c].shld_charge)
 			{
-				p = (shipsystems[cships[c].shld_type].par[1] * cships[c].syshits[cships[c].sys_shld]) / 10;
+				p = (shipsystems[cw->cships[c].shld_type].par[1] * cw->cships[c].syshits[cw->cships[c].sys_shld]) / 10;
 				if (p)
 				{
-					if (cships[c].shld < shipsystems[cships[c].shld_type].par[0])
+					if (cw->cships[c].shld < shipsystems[cw->cships[c].shld_type].par[0])
 					{
-						cships[c].shld++;
-						cships[c].shld_charge = t + 50/p;
+						cw->cships[c].shld++;
+						cw->cships[c].shld_charge = t + 50/p;
 					}
 				}
 			}
 			// damage control
-			if (t > cships[c].dmgc_time)
+			if (t > cw->cships[c].dmgc_time)
 			{
-				if (cships[c].dmgc_type>-1)
-					p = (shipsystems[cships[c].dmgc_type].par[0] * cships[c].syshits[cships[c].sys_dmgc]) / 10;
+				if (cw->cships[c].dmgc_type>-1)
+					p = (shipsystems[cw->cships[c].dmgc_type].par[0] * cw->cships[c].syshits[cw->cships[c].sys_dmgc]) / 10;
 #ifndef DEMO_VERSION
-				else if (shiptypes[cships[c].type].race == race_kawangi)
+				else if (shiptypes[cw->cships[c].type].race == race_kawangi)
 					p = 10;
 #endif
 				else
 					p = 0;
-				if (p > 0 && cships[c].hits < hulls[shiptypes[cships[c].type].hull].hits)
+				if (p > 0 && cw->cships[c].hits < hulls[shiptypes[cw->cships[c].type].hull].hits)
 				{
-					cships[c].hits++;
-					cships[c].dmgc_time = t + 50/p;
+					cw->cships[c].hits++;
+					cw->cships[c].dmgc_time = t + 50/p;
 				}
 
 				// repair broken systems
-				if (p == 0 && (shiptypes[cships[c].type].race==race_none || shiptypes[cships[c].type].race==race_terran))
+				if (p == 0 && (shiptypes[cw->cships[c].type].race==race_none || shiptypes[cw->cships[c].type].race==race_terran))
 					p = 1;
 				if (p > 0)
 				{
 					sys=-1; lsys=-1;
-					for (d = 0; d < shiptypes[cships[c].type].num_systems; d++)
-					if (cships[c].syshits[d] < 10 && (cships[c].syshits[d]>0 || p==10))
+					for (d = 0; d < shiptypes[cw->cships[c].type].num_systems; d++)
+					if (cw->cships[c].syshits[d] < 10 && (cw->cships[c].syshits[d]>0 || p==10))
 					{	// don't repair if zero (lost) unless kawangi
-						if (lsys==-1 || cships[c].syshits[d]<lsys)
+						if (lsys==-1 || cw->cships[c].syshits[d]<lsys)
 						{
-							lsys = cships[c].syshits[d];
+							lsys = cw->cships[c].syshits[d];
 							sys = d;
 						}
 					}
 					if (sys>-1)
 					{
-						cships[c].syshits[sys]++;
-						if (cships[c].syshits[sys]==10 && c==playership)	// fixed
-							Play_SoundFX(WAV_SYSFIXED, get_ik_timer(1));
+						cw->cships[c].syshits[sys]++;
+						if (cw->cships[c].syshits[sys]==10 && c==cw->playership)	// fixed
+							combat_sound(cw, WAV_SYSFIXED, get_ik_timer(1));
 
-						cships[c].dmgc_time = t + 50/p;
+						cw->cships[c].dmgc_time = t + 50/p;
 					}
-					combat_updateshipstats(c, t);
+					combat_updateshipstats(cw, c, t);
 				}
 			}
 
-			if (cships[c].flee == 0)
+			if (cw->cships[c].flee == 0)
 			{
-//				if (cships[c].own == 1 && cships[c].hits < hulls[shiptypes[cships[c].type].hull].hits)
-				if (cships[c].own == 1 && cships[c].frange == 0)	// lost guns, flee!
+//				if (cw->cships[c].own == 1 && cw->cships[c].hits < hulls[shiptypes[cw->cships[c].type].hull].hits)
+				if (cw->cships[c].own == 1 && cw->cships[c].frange == 0)	// lost guns, flee!
 				{
-					cships[c].flee = 1;
-					cships[c].tac = tac_flee;
-					cships[c].target = -1;
+					cw->cships[c].flee = 1;
+					cw->cships[c].tac = tac_flee;
+					cw->cships[c].target = -1;
 				}
 			}
 
-			if (cships[c].target > -1 && cships[cships[c].target].own != cships[c].own)
+			if (cw->cships[c].target > -1 && cw->cships[cw->cships[c].target].own != cw->cships[c].own)
 			{
 				// check if lost target due to cloaking
 				// change tactics here (?)
-				if (cships[cships[c].target].cloaked==1)
+				if (cw->cships[cw->cships[c].target].cloaked==1)
 				{
-					tg = cships[c].target;
-					cships[c].patx = cships[c].wp_x = cships[tg].x - ((sin1k[cships[c].angle]*cships[c].dist)>>6);
-					cships[c].paty = cships[c].wp_y = cships[tg].y - ((cos1k[cships[c].angle]*cships[c].dist)>>6);
-					cships[c].target = -1;
-					cships[c].tac = 2;
+					tg = cw->cships[c].target;
+					cw->cships[c].patx = cw->cships[c].wp_x = cw->cships[tg].x - ((sin1k[cw->cships[c].angle]*cw->cships[c].dist)>>6);
+					cw->cships[c].paty = cw->cships[c].wp_y = cw->cships[tg].y - ((cos1k[cw->cships[c].angle]*cw->cships[c].dist)>>6);
+					cw->cships[c].target = -1;
+					cw->cships[c].tac = 2;
 				}
 				// check if wants to cloak or decloak (enemy only)
-				if (c != playership && cships[c].clo_type && cships[c].syshits[cships[c].sys_clo]>=5)
+				if (c != cw->playership && cw->cships[c].clo_type && cw->cships[c].syshits[cw->cships[c].sys_clo]>=5)
 				{
-					rm = cships[c].frange;
-					if (rm > 0 && t - cships[c].cloaktime > 100)
+					rm = cw->cships[c].frange;
+					if (rm > 0 && t - cw->cships[c].cloaktime > 100)
 					{
-						d = cships[c].target;
-						r = get_distance( (cships[c].x - cships[d].x)>>10, (cships[c].y - cships[d].y)>>10);
-						if (r < rm && cships[c].tac==1)
+						d = cw->cships[c].target;
+						r = get_distance( (cw->cships[c].x - cw->cships[d].x)>>10, (cw->cships[c].y - cw->cships[d].y)>>10);
+						if (r < rm && cw->cships[c].tac==1)
 						{
-							if (cships[c].cloaked)	// uncloak when at weapon range
+							if (cw->cships[c].cloaked)	// uncloak when at weapon range
 							{
-								cships[c].cloaked = 0;
-								cships[c].cloaktime = t;
+								cw->cships[c].cloaked = 0;
+								cw->cships[c].cloaktime = t;
 //								Play_SoundFX(WAV_CLOAKOUT, get_ik_timer(1));
 							}
 						}
 						else
 						{
-							if (!cships[c].cloaked)
+							if (!cw->cships[c].cloaked)
 							{
-								cships[c].cloaked = 1;
-								cships[c].cloaktime = t;
+								cw->cships[c].cloaked = 1;
+								cw->cships[c].cloaktime = t;
 //								Play_SoundFX(WAV_CLOAKIN, get_ik_timer(1));
 							}
 						}
@@ -1303,345 +1682,346 @@ void combat_movement(int32 t)
 			}
 
 			// movement
-			sp = cships[c].speed;
-			if (cships[c].target > -1)
+			sp = cw->cships[c].speed;
+			if (cw->cships[c].target > -1)
 			{
-				if (cships[c].own != 0 && t%MAX_COMBAT_SHIPS == c)
-					combat_checkalttargets(c, t);
-				tg = cships[c].target;
-				if (cships[c].tac==0) // waypoint
+				if (cw->cships[c].own != 0 && t%MAX_COMBAT_SHIPS == c)
+					combat_checkalttargets(cw, c, t);
+				tg = cw->cships[c].target;
+				if (cw->cships[c].tac==0) // waypoint
 				{
-					wx = cships[tg].x - ((sin1k[cships[c].angle]*cships[c].dist)>>6);
-					wy = cships[tg].y - ((cos1k[cships[c].angle]*cships[c].dist)>>6);
+					wx = cw->cships[tg].x - ((sin1k[cw->cships[c].angle]*cw->cships[c].dist)>>6);
+					wy = cw->cships[tg].y - ((cos1k[cw->cships[c].angle]*cw->cships[c].dist)>>6);
 
-					if (cships[c].own != 0 && t > cships[c].wp_time)	// frustration time
-						cships[c].tac = 1;
+					if (cw->cships[c].own != 0 && t > cw->cships[c].wp_time)	// frustration time
+						cw->cships[c].tac = 1;
 				}
-				else if (cships[c].tac==1)	// attack
+				else if (cw->cships[c].tac==1)	// attack
 				{
-					wx = cships[tg].x;
-					wy = cships[tg].y;
+					wx = cw->cships[tg].x;
+					wy = cw->cships[tg].y;
 				}
 				else { wx = 0; wy = 0; } // appease compiler
-				a = get_direction( (wx - cships[c].x)>>10, (wy - cships[c].y)>>10 );
-				r = get_distance( (wx - cships[c].x)>>10, (wy - cships[c].y)>>10 );
+				a = get_direction( (wx - cw->cships[c].x)>>10, (wy - cw->cships[c].y)>>10 );
+				r = get_distance( (wx - cw->cships[c].x)>>10, (wy - cw->cships[c].y)>>10 );
 
 #ifndef DEMO_VERSION
-				if (r > 80 && cships[c].tac==0 && (shiptypes[cships[c].type].flag & 2)>0)
+				if (r > 80 && cw->cships[c].tac==0 && (shiptypes[cw->cships[c].type].flag & 2)>0)
 				{
-					if (t - cships[c].teltime > 4*50 || cships[c].teltime == 0)
+					if (t - cw->cships[c].teltime > 4*50 || cw->cships[c].teltime == 0)
 					{
-						cships[c].tel_x = wx - cships[c].x;
-						cships[c].tel_y = wy - cships[c].y;
-						cships[c].teltime = t;
-						combat_SoundFX(WAV_TELEPORT, cships[c].x);
-						//cexplo[combat_addexplo(cships[c].x, cships[c].y, spr_shockwave, 0, 96, 1, t, t+24, 1)].str = t-8;
-						combat_addexplo(cships[c].x, cships[c].y, spr_shockwave, 1, 112, 0, t, t+10, 4);
+						cw->cships[c].tel_x = wx - cw->cships[c].x;
+						cw->cships[c].tel_y = wy - cw->cships[c].y;
+						cw->cships[c].teltime = t;
+						combat_SoundFX(cw, WAV_TELEPORT, cw->cships[c].x);
+						//cw->cexplo[combat_addexplo(cw, cw->cships[c].x, cw->cships[c].y, spr_shockwave, 0, 96, 1, t, t+24, 1)].str = t-8;
+						combat_addexplo(cw, cw->cships[c].x, cw->cships[c].y, spr_shockwave, 1, 112, 0, t, t+10, 4);
 					}
 				}
 #endif
 
 
-				if ((cships[tg].own&1) == (cships[c].own&1)) // escort
+				if ((cw->cships[tg].own&1) == (cw->cships[c].own&1)) // escort
 				{
 					if (r < 64)
 					{
-						a = cships[tg].a;
-						sx = (((wx-cships[c].x)>>10)*cos1k[a] - ((wy-cships[c].y)>>10)*sin1k[a] ) >> 16;
-						sy = (((wy-cships[c].y)>>10)*cos1k[a] + ((wx-cships[c].x)>>10)*sin1k[a] ) >> 16;
+						a = cw->cships[tg].a;
+						sx = (((wx-cw->cships[c].x)>>10)*cos1k[a] - ((wy-cw->cships[c].y)>>10)*sin1k[a] ) >> 16;
+						sy = (((wy-cw->cships[c].y)>>10)*cos1k[a] + ((wx-cw->cships[c].x)>>10)*sin1k[a] ) >> 16;
 						if (sx < -5)  a = (1024 + a - 50) & 1023;
 						if (sx > 5)		a = (1024 + a + 50) & 1023;
-						sp = get_distance( (cships[tg].vx*50)>>10, (cships[tg].vy*50)>>10);
-//						sp = shiptypes[cships[tg].type].speed;
+						sp = get_distance( (cw->cships[tg].vx*50)>>10, (cw->cships[tg].vy*50)>>10);
+//						sp = shiptypes[cw->cships[tg].type].speed;
 						if (sy < -5)  sp = MAX(0, sp-50);
 						if (sy > 5)		sp += 50;
 						if (sp == 0)
-							a = cships[tg].a;
+							a = cw->cships[tg].a;
 					}
 				}
 				else // attack
 				{
-					if ( (r < 64 && cships[c].tac==0) || (r < 128 && cships[c].tac==1))
+					if ( (r < 64 && cw->cships[c].tac==0) || (r < 128 && cw->cships[c].tac==1))
 					{
-						if (cships[c].tac==0) // reached waypoint, start attack run
-							cships[c].tac=1;
-						else if (cships[c].tac==1)	// close proximity, return to waypoint
+						if (cw->cships[c].tac==0) // reached waypoint, start attack run
+							cw->cships[c].tac=1;
+						else if (cw->cships[c].tac==1)	// close proximity, return to waypoint
 						{
-							cships[c].tac=0;
-							cships[c].wp_time = t + 500 + rand()%500;
-							if (cships[c].own != 0)	// enemy or klakar
+							cw->cships[c].tac=0;
+							cw->cships[c].wp_time = t + 500 + rng_rand(&cw->rng)%500;
+							if (cw->cships[c].own != 0)	// enemy or klakar
 							{	// get a new angle of attack
-								cships[c].angle = (cships[tg].a + 768 + rand()%512)&1023;
+								cw->cships[c].angle = (cw->cships[tg].a + 768 + rng_rand(&cw->rng)%512)&1023;
 							}
 #ifndef DEMO_VERSION
-							else if (cships[cships[c].target].active>0 && (cships[c].cloaked == 1 || cships[cships[c].target].active==1))	// check for spacehulk sneak-up victory
+							else if (cw->cships[cw->cships[c].target].active>0 && (cw->cships[c].cloaked == 1 || cw->cships[cw->cships[c].target].active==1))	// check for spacehulk sneak-up victory
 							{
-								if (shiptypes[cships[cships[c].target].type].flag & 256)
+								if (shiptypes[cw->cships[cw->cships[c].target].type].flag & 256)
 								{
-									combat_SoundFX(WAV_BOARD, cships[c].x);
-									cships[cships[c].target].active = 0;
-									cships[cships[c].target].hits = 0;
+									combat_SoundFX(cw, WAV_BOARD, cw->cships[c].x);
+									cw->cships[cw->cships[c].target].active = 0;
+									cw->cships[cw->cships[c].target].hits = 0;
 								}
 							}
 #endif
 						}
-						//a = get_direction( (cships[tg].x - cships[c].x)>>10, (cships[tg].y - cships[c].y)>>10 );
+						//a = get_direction( (cw->cships[tg].x - cw->cships[c].x)>>10, (cw->cships[tg].y - cw->cships[c].y)>>10 );
 					}
 				}
-				if (cships[c].own==2 && cships[c].target==playership)	// klakar escort
-					combat_findstuff2do(c, t);
+				if (cw->cships[c].own==2 && cw->cships[c].target==cw->playership)	// klakar escort
+					combat_findstuff2do(cw, c, t);
 
 			}
 			else
 			{
-				if (cships[c].tac==2)	// move to waypoint
+				if (cw->cships[c].tac==2)	// move to waypoint
 				{
-					a = get_direction ( (cships[c].wp_x - cships[c].x)>>10, (cships[c].wp_y - cships[c].y)>>10);
-					r = get_distance ( (cships[c].wp_x - cships[c].x)>>10, (cships[c].wp_y - cships[c].y)>>10);
+					a = get_direction ( (cw->cships[c].wp_x - cw->cships[c].x)>>10, (cw->cships[c].wp_y - cw->cships[c].y)>>10);
+					r = get_distance ( (cw->cships[c].wp_x - cw->cships[c].x)>>10, (cw->cships[c].wp_y - cw->cships[c].y)>>10);
 #ifndef DEMO_VERSION
-					if (shiptypes[cships[c].type].flag & 2)
+					if (shiptypes[cw->cships[c].type].flag & 2)
 					{
-						if (r > 80 && (t - cships[c].teltime > 4*50 || cships[c].teltime == 0))
+						if (r > 80 && (t - cw->cships[c].teltime > 4*50 || cw->cships[c].teltime == 0))
 						{
-							cships[c].tel_x = cships[c].wp_x - cships[c].x;
-							cships[c].tel_y = cships[c].wp_y - cships[c].y;
-							cships[c].teltime = t;
-							combat_SoundFX(WAV_TELEPORT, cships[c].x);
-							//cexplo[combat_addexplo(cships[c].x, cships[c].y, spr_shockwave, 0, 96, 1, t, t+24, 1)].str = t-8;
-							combat_addexplo(cships[c].x, cships[c].y, spr_shockwave, 1, 112, 0, t, t+10, 4);
+							cw->cships[c].tel_x = cw->cships[c].wp_x - cw->cships[c].x;
+							cw->cships[c].tel_y = cw->cships[c].wp_y - cw->cships[c].y;
+							cw->cships[c].teltime = t;
+							combat_SoundFX(cw, WAV_TELEPORT, cw->cships[c].x);
+							//cw->cexplo[combat_addexplo(cw, cw->cships[c].x, cw->cships[c].y, spr_shockwave, 0, 96, 1, t, t+24, 1)].str = t-8;
+							combat_addexplo(cw, cw->cships[c].x, cw->cships[c].y, spr_shockwave, 1, 112, 0, t, t+10, 4);
 						}
 					}
 #endif
 
 					if (r > 80)
-						sp = cships[c].speed;
+						sp = cw->cships[c].speed;
 					else if (r > 16)
 					{
-//						if (!cships[c].own&1)
-							sp = (cships[c].speed * r) / 80 + 1;
+//						if (!cw->cships[c].own&1)
+							sp = (cw->cships[c].speed * r) / 80 + 1;
 //						else
-//							sp = cships[c].speed;
+//							sp = cw->cships[c].speed;
 					}
 					else
 					{
 						sp = 0;
-						if (cships[c].own != 0) // reached waypoint, do search pattern
+						if (cw->cships[c].own != 0) // reached waypoint, do search pattern
 						{
-							a = rand()&1023;
-							cships[c].wp_x = cships[c].patx + ((sin1k[a]*cships[c].dist)>>6);
-							cships[c].wp_y = cships[c].paty + ((cos1k[a]*cships[c].dist)>>6);
+							a = rng_rand(&cw->rng)&1023;
+							cw->cships[c].wp_x = cw->cships[c].patx + ((sin1k[a]*cw->cships[c].dist)>>6);
+							cw->cships[c].wp_y = cw->cships[c].paty + ((cos1k[a]*cw->cships[c].dist)>>6);
 						}
 					}
-					if (cships[c].own != 0)
-						combat_findstuff2do(c, t);
+					if (cw->cships[c].own != 0)
+						combat_findstuff2do(cw, c, t);
 				}
-				else if (cships[c].tac == tac_flee)
+				else if (cw->cships[c].tac == tac_flee)
 				{
 					rm = -1;
 					a = -1;
 					for (d = 0; d < MAX_COMBAT_SHIPS; d++)
-					if (!(cships[d].own&1) && cships[d].hits>0)
+					if (!(cw->cships[d].own&1) && cw->cships[d].hits>0)
 					{
-						r = get_distance ( (cships[d].x - cships[c].x)>>10, (cships[d].y - cships[c].y)>>10);
+						r = get_distance ( (cw->cships[d].x - cw->cships[c].x)>>10, (cw->cships[d].y - cw->cships[c].y)>>10);
 						if (rm == -1 || r < rm)
 						{ a = d; rm = r; }
 					}
 					if (a > -1)
 					{
-						a = get_direction ( (cships[c].x - cships[a].x)>>10, (cships[c].y - cships[a].y)>>10);
-						sp = cships[c].speed;
+						a = get_direction ( (cw->cships[c].x - cw->cships[a].x)>>10, (cw->cships[c].y - cw->cships[a].y)>>10);
+						sp = cw->cships[c].speed;
 					}
 					else
 					{
-						a = cships[c].a;
-						cships[c].flee = 0;
-						combat_findstuff2do(c, t);
+						a = cw->cships[c].a;
+						cw->cships[c].flee = 0;
+						combat_findstuff2do(cw, c, t);
 					}
 				}
-				else if (c != playership)
+				else if (c != cw->playership)
 				{
 					a = 0;
-					combat_findstuff2do(c, t);
+					combat_findstuff2do(cw, c, t);
 				}
 			}
-			a = (a + 1024 - cships[c].a) & 1023;
+			a = (a + 1024 - cw->cships[c].a) & 1023;
 			if (a > 512) a-=1024;
-			p = cships[c].turn;
-			cships[c].va = ((a > 0) - (a < 0))*MIN(p,ABS(a));
-			sx = (sin1k[cships[c].a] / 50 * sp) >> 6;
-			sy = (cos1k[cships[c].a] / 50 * sp) >> 6;	//    sp/50 << 10
+			p = cw->cships[c].turn;
+			cw->cships[c].va = ((a > 0) - (a < 0))*MIN(p,ABS(a));
+			sx = (sin1k[cw->cships[c].a] / 50 * sp) >> 6;
+			sy = (cos1k[cw->cships[c].a] / 50 * sp) >> 6;	//    sp/50 << 10
 
-			cships[c].vx = sx;
-			cships[c].vy = sy;
+			cw->cships[c].vx = sx;
+			cw->cships[c].vy = sy;
 
-			if ((cships[c].own != 2 || t-klaktime > 100) && (!cships[c].cloaked))
+			if ((cw->cships[c].own != 2 || t-cw->klaktime > 100) && (!cw->cships[c].cloaked))
 			{
-				hull = &hulls[shiptypes[cships[c].type].hull];
+				hull = &hulls[shiptypes[cw->cships[c].type].hull];
 				for (p = 0; p < hull->numh; p++)
 					if (hull->hardpts[p].type == hdpWeapon)
-					if ( t>cships[c].wepfire[p])
+					if ( t>cw->cships[c].wepfire[p])
 					{
-						tg = combat_findtarget(&cships[c], p);
+						tg = combat_findtarget(cw, &cw->cships[c], p);
 						if (tg > -1)
-							combat_fire(&cships[c], p, &cships[tg], t);
+							combat_fire(cw, &cw->cships[c], p, &cw->cships[tg], t);
 					}
 			}
 		}
 		else
 		{
-			if (cships[c].active==2)
+			if (cw->cships[c].active==2)
 			{
 #ifndef DEMO_VERSION
-				if (cships[c].cloaked)
+				if (cw->cships[c].cloaked)
 				{
-					cships[c].cloaked = 0;
-					cships[c].cloaktime = t;
-					combat_SoundFX(WAV_CLOAKOUT, cships[c].x);
+					cw->cships[c].cloaked = 0;
+					cw->cships[c].cloaktime = t;
+					combat_SoundFX(cw, WAV_CLOAKOUT, cw->cships[c].x);
 				}
 #endif
 
-				hull = &hulls[shiptypes[cships[c].type].hull];
-				if (!(rand()%16) || cships[c].hits < -hull->hits)
+				hull = &hulls[shiptypes[cw->cships[c].type].hull];
+				if (!(rng_rand(&cw->rng)%16) || cw->cships[c].hits < -hull->hits)
 				{
-					cships[c].hits--;
-					combat_SoundFX(WAV_EXPLO1, cships[c].x, 50);
-					combat_addexplo(cships[c].x + ((rand()%hull->size-hull->size/2)<<9),
-													cships[c].y + ((rand()%hull->size-hull->size/2)<<9),
+					cw->cships[c].hits--;
+					combat_SoundFX(cw, WAV_EXPLO1, cw->cships[c].x, 50);
+					combat_addexplo(cw, cw->cships[c].x + ((rng_rand(&cw->rng)%hull->size-hull->size/2)<<9),
+													cw->cships[c].y + ((rng_rand(&cw->rng)%hull->size-hull->size/2)<<9),
 													spr_explode1, 5, hull->size/2, 0, t, t+32);
-					if (cships[c].hits <= -hull->hits)
+					if (cw->cships[c].hits <= -hull->hits)
 					{
-						combat_killship(c, t);
+						combat_killship(cw, c, t);
 					}
 				}
 			}
-			else if (cships[c].active==1 && cships[c].hits>1)
+			else if (cw->cships[c].active==1 && cw->cships[c].hits>1)
 			{	// dormant space hulk waiting to activate
 				for (p = 0; p < MAX_COMBAT_SHIPS; p++)
-				if (cships[p].type>-1 && cships[p].own==0 && cships[p].cloaked==0)
+				if (cw->cships[p].type>-1 && cw->cships[p].own==0 && cw->cships[p].cloaked==0)
 				{
-					r = get_distance ( (cships[c].x - cships[p].x)>>10, (cships[c].y - cships[p].y)>>10);
+					r = get_distance ( (cw->cships[c].x - cw->cships[p].x)>>10, (cw->cships[c].y - cw->cships[p].y)>>10);
 					if (r < 400)
-						cships[c].active=2;
+						cw->cships[c].active=2;
 				}
 			}
 		}
 	}
 
 	// **** MOVE SHOTS ****
-	for (c = 0; c < MAX_COMBAT_BEAMS; c++)
-	if (cbeams[c].wep)
+	for (q = 0, n = cw->beams.num; q < n; q++)
+	if (cw->cbeams[c = cw->beams.live[q]].wep)
 	{
-		if (t > cbeams[c].dmt)
+		if (t > cw->cbeams[c].dmt)
 		{
-			if (cbeams[c].dst)
+			if (cw->cbeams[c].dst)
 			{
-				combat_addexplo(cbeams[c].dst->x, cbeams[c].dst->y, spr_explode1, 5, 32, 0, t, t+32);
-				a = shiptonum(cbeams[c].dst);
-				combat_damageship(a, 0, cbeams[c].wep->damage, t, cbeams[c].wep);
-				cbeams[c].dmt += 500;
-				d = ((cbeams[c].wep->flags & wpfShock1)>0)+2*((cbeams[c].wep->flags & wpfShock2)>0);
+				combat_addexplo(cw, cw->cbeams[c].dst->x, cw->cbeams[c].dst->y, spr_explode1, 5, 32, 0, t, t+32);
+				a = shiptonum(cw, cw->cbeams[c].dst);
+				combat_damageship(cw, a, 0, cw->cbeams[c].wep->damage, t, cw->cbeams[c].wep);
+				cw->cbeams[c].dmt += 500;
+				d = ((cw->cbeams[c].wep->flags & wpfShock1)>0)+2*((cw->cbeams[c].wep->flags & wpfShock2)>0);
 				if (d==1)
 				{
-					cexplo[combat_addexplo(cbeams[c].dst->x, cbeams[c].dst->y, spr_shockwave, 0, 96, 1, t, t+24, 1)].str = t-8;
+					combat_addexplo(cw, cw->cbeams[c].dst->x, cw->cbeams[c].dst->y, spr_shockwave, 0, 96, 1, t-8, t+24, 1);
 					if (settings.opt_lensflares)
-						combat_addexplo(cbeams[c].dst->x, cbeams[c].dst->y, spr_shockwave, 1, 112, 0, t, t+10, 4);
+						combat_addexplo(cw, cw->cbeams[c].dst->x, cw->cbeams[c].dst->y, spr_shockwave, 1, 112, 0, t, t+10, 4);
 				}
 				else if (d==2)
 				{
-					cexplo[combat_addexplo(cbeams[c].dst->x, cbeams[c].dst->y, spr_shockwave, 0, 96, 1, t, t+32, 3)].str = t-8;
+					combat_addexplo(cw, cw->cbeams[c].dst->x, cw->cbeams[c].dst->y, spr_shockwave, 0, 96, 1, t-8, t+32, 3);
 					if (settings.opt_lensflares)
-						combat_addexplo(cbeams[c].dst->x, cbeams[c].dst->y, spr_shockwave, 1, 144, 0, t, t+16, 4);
+						combat_addexplo(cw, cw->cbeams[c].dst->x, cw->cbeams[c].dst->y, spr_shockwave, 1, 144, 0, t, t+16, 4);
 				}
 			}
 		}
-		if (t > cbeams[c].end)
+		if (t > cw->cbeams[c].end)
 		{
-			cbeams[c].wep = NULL;
+			cw->cbeams[c].wep = NULL;
 		}
 	}
 
-	for (c = 0; c < MAX_COMBAT_PROJECTILES; c++)
-	if (cprojs[c].wep)
+	for (pr = 0, npr = cw->projs.num; pr < npr; pr++)
+	if (cw->cprojs[c = cw->projs.live[pr]].wep)
 	{
-		if ( cprojs[c].wep->flags & wpfHoming)
+		if ( cw->cprojs[c].wep->flags & wpfHoming)
 		{
-			if (cprojs[c].dst!=NULL)
+			if (cw->cprojs[c].dst!=NULL)
 			{
-				a = get_direction ( (cprojs[c].dst->x>>10)-(cprojs[c].x>>10), (cprojs[c].dst->y>>10)-(cprojs[c].y>>10) );
-				a = (a + 1024 - cprojs[c].a) & 1023;
+				a = get_direction ( (cw->cprojs[c].dst->x>>10)-(cw->cprojs[c].x>>10), (cw->cprojs[c].dst->y>>10)-(cw->cprojs[c].y>>10) );
+				a = (a + 1024 - cw->cprojs[c].a) & 1023;
 				while (a > 512) a-=1024;
 				if (a < -8) a=-8;
 				if (a > 8) a=8;
-				cprojs[c].va = a;
+				cw->cprojs[c].va = a;
 
-				if (cprojs[c].wep->flags & wpfSplit)
+				if (cw->cprojs[c].wep->flags & wpfSplit)
 				{
-					if ( t > cprojs[c].str + 50)
+					if ( t > cw->cprojs[c].str + 50)
 					{
-						r = get_distance ( (cprojs[c].dst->x>>10)-(cprojs[c].x>>10), (cprojs[c].dst->y>>10)-(cprojs[c].y>>10) );
-						if ( r < shipweapons[cprojs[c].wep->stage].range && cprojs[c].hits>0) // split
+						r = get_distance ( (cw->cprojs[c].dst->x>>10)-(cw->cprojs[c].x>>10), (cw->cprojs[c].dst->y>>10)-(cw->cprojs[c].y>>10) );
+						if ( r < shipweapons[cw->cprojs[c].wep->stage].range && cw->cprojs[c].hits>0) // split
 						{
-							cprojs[c].end = t;
-							cprojs[c].hits = 0;
-							if (cprojs[c].wep->item != -1)
+							cw->cprojs[c].end = t;
+							cw->cprojs[c].hits = 0;
+							if (cw->cprojs[c].wep->item != -1)
 							{
-								if (shipsystems[itemtypes[cprojs[c].wep->item].index].par[1])
-									combat_launchstages(c, shipsystems[itemtypes[cprojs[c].wep->item].index].par[1], t);
+								if (shipsystems[itemtypes[cw->cprojs[c].wep->item].index].par[1])
+									combat_launchstages(cw, c, shipsystems[itemtypes[cw->cprojs[c].wep->item].index].par[1], t);
 								else
-									combat_launchstages(c, 5, t);
+									combat_launchstages(cw, c, 5, t);
 							}
 							else
-								combat_launchstages(c, 3, t);
+								combat_launchstages(cw, c, 3, t);
 						}
 					}
 				}
 
 				/*
-				if (cprojs[c].dst->ecm_type > -1 && cprojs[c].dst->syshits[cprojs[c].dst->sys_ecm]>0)
+				if (cw->cprojs[c].dst->ecm_type > -1 && cw->cprojs[c].dst->syshits[cw->cprojs[c].dst->sys_ecm]>0)
 				{
-					a = shipsystems[cprojs[c].dst->ecm_type].par[0];
-					if (rand()%300 < a)
-						cprojs[c].dst = NULL;
+					a = shipsystems[cw->cprojs[c].dst->ecm_type].par[0];
+					if (rng_rand(&cw->rng)%300 < a)
+						cw->cprojs[c].dst = NULL;
 				}*/
-				if (cprojs[c].dst != NULL)
-					if (cprojs[c].dst->cloaked)
-						cprojs[c].dst = NULL;
+				if (cw->cprojs[c].dst != NULL)
+					if (cw->cprojs[c].dst->cloaked)
+						cw->cprojs[c].dst = NULL;
 			}
 
-			cprojs[c].vx = (cprojs[c].vx * 15 + ((sin1k[cprojs[c].a] * cprojs[c].wep->speed / COMBAT_FRAMERATE) >> 6)) >> 4;
-			cprojs[c].vy = (cprojs[c].vy * 15 + ((cos1k[cprojs[c].a] * cprojs[c].wep->speed / COMBAT_FRAMERATE) >> 6)) >> 4;
+			cw->cprojs[c].vx = (cw->cprojs[c].vx * 15 + ((sin1k[cw->cprojs[c].a] * cw->cprojs[c].wep->speed / COMBAT_FRAMERATE) >> 6)) >> 4;
+			cw->cprojs[c].vy = (cw->cprojs[c].vy * 15 + ((cos1k[cw->cprojs[c].a] * cw->cprojs[c].wep->speed / COMBAT_FRAMERATE) >> 6)) >> 4;
 
 		}
 		if (settings.opt_smoketrails)
-		if (cprojs[c].wep->flags & wpfStrail)
+		if (cw->cprojs[c].wep->flags & wpfStrail)
 			if (!((t+c)&3))
 			{
-				d = cprojs[c].wep->size;
-				combat_addexplo(cprojs[c].x-((sin1k[cprojs[c].a]*d)>>7), cprojs[c].y-((cos1k[cprojs[c].a]*d)>>7), spr_weapons, 10, (d*3)>>2, 2, t, t+35, 18, 0);
+				d = cw->cprojs[c].wep->size;
+				combat_addexplo(cw, cw->cprojs[c].x-((sin1k[cw->cprojs[c].a]*d)>>7), cw->cprojs[c].y-((cos1k[cw->cprojs[c].a]*d)>>7), spr_weapons, 10, (d*3)>>2, 2, t, t+35, 18, 0);
 			}
-		if (cprojs[c].wep->flags & wpfImplode)
+		if (cw->cprojs[c].wep->flags & wpfImplode)
 		{
 			if (!(t&3))
 			{
-				cexplo[combat_addexplo(cprojs[c].x, cprojs[c].y, spr_shockwave, 0, 40, 1, t, t+32, 2, 0)].str = t-8;
+				combat_addexplo(cw, cw->cprojs[c].x, cw->cprojs[c].y, spr_shockwave, 0, 40, 1, t-8, t+32, 2, 0);
 			}
 			if (!(t%25))	// shoot electric death at random targets
 			{
-				p = 0; d = shipweapons[cprojs[c].wep->stage].range;
-				for (a = 0; a < MAX_COMBAT_SHIPS; a++)
-				if (cships[a].type>-1 && (cships[a].own&1)!=(cprojs[c].src->own&1))
+				p = 0; d = shipweapons[cw->cprojs[c].wep->stage].range;
+				n = combat_gridquery(cw, cw->cprojs[c].x>>10, cw->cprojs[c].y>>10, d+1, list);
+				for (q = 0; q < n; q++)
+				if (cw->cships[a=list[q]].type>-1 && (cw->cships[a].own&1)!=(cw->cprojs[c].src->own&1))
 				{
-					if (get_distance( (cships[a].x - cprojs[c].x)>>10, (cships[a].y - cprojs[c].y)>>10) < d)
+					if (get_distance( (cw->cships[a].x - cw->cprojs[c].x)>>10, (cw->cships[a].y - cw->cprojs[c].y)>>10) < d)
 						p++;
 				}
 				if (p > 0)
 				{
-					d = rand()%p;
+					d = rng_rand(&cw->rng)%p;
 					p = -1;
-					for (a = 0; a < MAX_COMBAT_SHIPS; a++)
-					if (cships[a].type>-1 && (cships[a].own&1)!=(cprojs[c].src->own&1))
+					for (q = 0; q < n; q++)
+					if (cw->cships[a=list[q]].type>-1 && (cw->cships[a].own&1)!=(cw->cprojs[c].src->own&1))
 					{
-						if (get_distance( (cships[a].x - cprojs[c].x)>>10, (cships[a].y - cprojs[c].y)>>10) < shipweapons[cprojs[c].wep->stage].range)
+						if (get_distance( (cw->cships[a].x - cw->cprojs[c].x)>>10, (cw->cships[a].y - cw->cprojs[c].y)>>10) < shipweapons[cw->cprojs[c].wep->stage].range)
 						{
 							if (!d)
 								p = a;
@@ -1650,130 +2030,131 @@ void combat_movement(int32 t)
 					}
 					if (p > -1)
 					{
-						combat_addbeam(&shipweapons[cprojs[c].wep->stage], cprojs[c].src, 0, &cships[p], t, c);
-//						cexplo[combat_addexplo(cships[p].x, cships[p].y, spr_shockwave, 0, 128, 1, t, t+32, 3)].str = t-8;
-//						combat_addexplo(cships[p].x, cships[p].y, spr_shockwave, 1, 128, 0, t, t+16, 4);
+						combat_addbeam(cw, &shipweapons[cw->cprojs[c].wep->stage], cw->cprojs[c].src, 0, &cw->cships[p], t, c);
+//						cw->cexplo[combat_addexplo(cw, cw->cships[p].x, cw->cships[p].y, spr_shockwave, 0, 128, 1, t, t+32, 3)].str = t-8;
+//						combat_addexplo(cw, cw->cships[p].x, cw->cships[p].y, spr_shockwave, 1, 128, 0, t, t+16, 4);
 					}
 				}
 			}
 		}
-		cprojs[c].x += cprojs[c].vx;
-		cprojs[c].y += cprojs[c].vy;
-		cprojs[c].a = (cprojs[c].a + cprojs[c].va + 1024) & 1023;
-		for (p = 0; p < MAX_COMBAT_SHIPS; p++)
-		if (cships[p].type>-1 && (cships[p].own&1)!=(cprojs[c].src->own&1))
+		cw->cprojs[c].x += cw->cprojs[c].vx;
+		cw->cprojs[c].y += cw->cprojs[c].vy;
+		cw->cprojs[c].a = (cw->cprojs[c].a + cw->cprojs[c].va + 1024) & 1023;
+		// imploding and noclip shots never hit
+		n = 0; rd = 0;
+		if (!(cw->cprojs[c].wep->flags & (wpfImplode | wpfNoclip)))
 		{
-			a = hulls[shiptypes[cships[p].type].hull].size>>1;
-			if (cprojs[c].wep->flags & wpfDisperse)
-			{
-				a += (2 + ((cprojs[c].wep->size-4) * (t - cprojs[c].str)) / (cprojs[c].end - cprojs[c].str))>>1;
-			}
-			if (cprojs[c].wep->flags & (wpfImplode | wpfNoclip))
-			{
-				a = -100;
-			}
-//				if (t < cprojs[c].end - 2)
-//					a = -100;
-			if (get_distance( (cships[p].x>>10)-(cprojs[c].x>>10), (cships[p].y>>10)-(cprojs[c].y>>10) ) < a)
+			if ((cw->cprojs[c].wep->flags & wpfDisperse) && cw->cprojs[c].end > cw->cprojs[c].str)
+				rd = (2 + ((cw->cprojs[c].wep->size-4) * (t - cw->cprojs[c].str)) / (cw->cprojs[c].end - cw->cprojs[c].str))>>1;
+			n = combat_gridquery(cw, cw->cprojs[c].x>>10, cw->cprojs[c].y>>10, cw->grid_size + ABS(rd) + 1, list);
+		}
+		for (q = 0; q < n; q++)
+		if (cw->cships[p=list[q]].type>-1 && (cw->cships[p].own&1)!=(cw->cprojs[c].src->own&1))
+		{
+			// same as get_distance() < a, without the sqrt
+			a = cw->grid_r[p] + rd;
+			dx = cw->grid_x[p] - (cw->cprojs[c].x>>10);
+			dy = cw->grid_y[p] - (cw->cprojs[c].y>>10);
+			if (a > 0 && dx*dx + dy*dy < a*a)
 			{
-				if (cprojs[c].wep->flags & wpfDisperse)
+				if (cw->cprojs[c].wep->flags & wpfDisperse)
 				{
-					a = 2 + ((cprojs[c].wep->size-4) * (t - cprojs[c].str)) / (cprojs[c].end - cprojs[c].str);
-					if (a < hulls[shiptypes[cships[p].type].hull].size)
+					a = 2 + ((cw->cprojs[c].wep->size-4) * (t - cw->cprojs[c].str)) / (cw->cprojs[c].end - cw->cprojs[c].str);
+					if (a < hulls[shiptypes[cw->cships[p].type].hull].size)
 					{
-						d = 4 - ((4*a) / hulls[shiptypes[cships[p].type].hull].size);
+						d = 4 - ((4*a) / hulls[shiptypes[cw->cships[p].type].hull].size);
 						if (d < 1) d = 1;
 					}
 					else
 						d = 1;	// now gives damage one point at a time - much cooler!
-					//if (d > cprojs[c].hits) d = cprojs[c].hits;
-					combat_damageship(p, 0, d, t, cprojs[c].wep);
-					cprojs[c].hits -= d;
-					a = hulls[shiptypes[cships[p].type].hull].size>>1;
-					combat_addexplo(cships[p].x + ((rand()%(a*2) - a)<<8),
-													cships[p].y + ((rand()%(a*2) - a)<<8),
+					//if (d > cw->cprojs[c].hits) d = cw->cprojs[c].hits;
+					combat_damageship(cw, p, 0, d, t, cw->cprojs[c].wep);
+					cw->cprojs[c].hits -= d;
+					a = hulls[shiptypes[cw->cships[p].type].hull].size>>1;
+					combat_addexplo(cw, cw->cships[p].x + ((rng_rand(&cw->rng)%(a*2) - a)<<8),
+													cw->cships[p].y + ((rng_rand(&cw->rng)%(a*2) - a)<<8),
 													spr_explode1, 5, 32, 0, t, t+32);
-					if (cprojs[c].hits <= 0)
-					{	cprojs[c].wep = NULL; break; }
+					if (cw->cprojs[c].hits <= 0)
+					{	cw->cprojs[c].wep = NULL; break; }
 				}
 				else
 				{
-					combat_damageship(p, 0, cprojs[c].wep->damage, t, cprojs[c].wep);
-					combat_addexplo(cprojs[c].x, cprojs[c].y, spr_explode1, 5, 32, 0, t, t+32);
-					d = ((cprojs[c].wep->flags & wpfShock1)>0)+2*((cprojs[c].wep->flags & wpfShock2)>0);
+					combat_damageship(cw, p, 0, cw->cprojs[c].wep->damage, t, cw->cprojs[c].wep);
+					combat_addexplo(cw, cw->cprojs[c].x, cw->cprojs[c].y, spr_explode1, 5, 32, 0, t, t+32);
+					d = ((cw->cprojs[c].wep->flags & wpfShock1)>0)+2*((cw->cprojs[c].wep->flags & wpfShock2)>0);
 					if (d==1)
 					{
-						combat_addexplo(cprojs[c].x, cprojs[c].y, spr_shockwave, 0, 96, 1, t-8, t+24, 1);
+						combat_addexplo(cw, cw->cprojs[c].x, cw->cprojs[c].y, spr_shockwave, 0, 96, 1, t-8, t+24, 1);
 						if (settings.opt_lensflares)
-							combat_addexplo(cprojs[c].x, cprojs[c].y, spr_shockwave, 1, 112, 0, t, t+10, 4);
+							combat_addexplo(cw, cw->cprojs[c].x, cw->cprojs[c].y, spr_shockwave, 1, 112, 0, t, t+10, 4);
 					}
 					else if (d==2)
 					{
-						combat_addexplo(cprojs[c].x, cprojs[c].y, spr_shockwave, 0, 96, 1, t-8, t+32, 3);
+						combat_addexplo(cw, cw->cprojs[c].x, cw->cprojs[c].y, spr_shockwave, 0, 96, 1, t-8, t+32, 3);
 						if (settings.opt_lensflares)
-							combat_addexplo(cprojs[c].x, cprojs[c].y, spr_shockwave, 1, 144, 0, t, t+16, 4);
+							combat_addexplo(cw, cw->cprojs[c].x, cw->cprojs[c].y, spr_shockwave, 1, 144, 0, t, t+16, 4);
 					}
-					if (cprojs[c].wep->flags & wpfNova)
+					if (cw->cprojs[c].wep->flags & wpfNova)
 					{
-						combat_addexplo(cprojs[c].x, cprojs[c].y, spr_shockwave, 0, 96, 1, t-8, t+16, 1);
-						combat_addexplo(cprojs[c].x, cprojs[c].y, spr_shockwave, 0, 256, 1, t-8, t+40, 2);
+						combat_addexplo(cw, cw->cprojs[c].x, cw->cprojs[c].y, spr_shockwave, 0, 96, 1, t-8, t+16, 1);
+						combat_addexplo(cw, cw->cprojs[c].x, cw->cprojs[c].y, spr_shockwave, 0, 256, 1, t-8, t+40, 2);
 						if (settings.opt_lensflares)
-							combat_addexplo(cprojs[c].x, cprojs[c].y, spr_shockwave, 1, 160, 0, t, t+24, 4);
-						if (cships[p].hits <= 0)
-							cships[p].hits = 1 - hulls[shiptypes[cships[p].type].hull].hits;
+							combat_addexplo(cw, cw->cprojs[c].x, cw->cprojs[c].y, spr_shockwave, 1, 160, 0, t, t+24, 4);
+						if (cw->cships[p].hits <= 0)
+							cw->cships[p].hits = 1 - hulls[shiptypes[cw->cships[p].type].hull].hits;
 					}
-					cprojs[c].wep = NULL;
+					cw->cprojs[c].wep = NULL;
 					break;
 				}
 			}
 		}
 
-		if (t > cprojs[c].end && cprojs[c].wep != NULL)
+		if (t > cw->cprojs[c].end && cw->cprojs[c].wep != NULL)
 		{
-			if (cprojs[c].wep->flags & wpfSplit)	// end split ("flak")
-				if (!(cprojs[c].wep->flags & wpfHoming))
+			if (cw->cprojs[c].wep->flags & wpfSplit)	// end split ("flak")
+				if (!(cw->cprojs[c].wep->flags & wpfHoming))
 				{
-					if (cprojs[c].wep->item != -1)
+					if (cw->cprojs[c].wep->item != -1)
 					{
-						if (shipsystems[itemtypes[cprojs[c].wep->item].index].par[1])
-							combat_launchstages(c, shipsystems[itemtypes[cprojs[c].wep->item].index].par[1], t);
+						if (shipsystems[itemtypes[cw->cprojs[c].wep->item].index].par[1])
+							combat_launchstages(cw, c, shipsystems[itemtypes[cw->cprojs[c].wep->item].index].par[1], t);
 						else
-							combat_launchstages(c, 5, t);
+							combat_launchstages(cw, c, 5, t);
 					}
 					else
-						combat_launchstages(c, 3, t);
+						combat_launchstages(cw, c, 3, t);
 				}
 
-			cprojs[c].wep = NULL;
+			cw->cprojs[c].wep = NULL;
 		}
 	}
 }
 
-void combat_checkalttargets(int32 s, int32 t)
+void combat_checkalttargets(t_combatworld *cw, int32 s, int32 t)
 {
 	int b, c;
 	int r, rm;
 
-	if (cships[s].type == -1 || cships[s].hits <= 0)
+	if (cw->cships[s].type == -1 || cw->cships[s].hits <= 0)
 		return;
 
 	// has current target, but check to make sure if need to change
-	if (cships[s].target > -1 && cships[cships[s].target].hits > 0)
+	if (cw->cships[s].target > -1 && cw->cships[cw->cships[s].target].hits > 0)
 	{
 
 		// check range of target
-		c = cships[s].target;
-		r = get_distance( (cships[c].x-cships[s].x)>>10, (cships[c].y-cships[s].y)>>10 );
+		c = cw->cships[s].target;
+		r = get_distance( (cw->cships[c].x-cw->cships[s].x)>>10, (cw->cships[c].y-cw->cships[s].y)>>10 );
 
 		// if target is out of range, look for closer enemy ships
-		if (r > cships[s].frange)
+		if (r > cw->cships[s].frange)
 		{
-			b = -1; rm = cships[s].frange;
+			b = -1; rm = cw->cships[s].frange;
 			for (c = 0; c < MAX_COMBAT_SHIPS; c++)
-			if (cships[c].type>-1 && cships[c].hits>0 &&
-					(cships[c].own&1)!=(cships[s].own&1) && cships[c].cloaked==0 && cships[c].active==2)
+			if (cw->cships[c].type>-1 && cw->cships[c].hits>0 &&
+					(cw->cships[c].own&1)!=(cw->cships[s].own&1) && cw->cships[c].cloaked==0 && cw->cships[c].active==2)
 			{
-				r = get_distance( (cships[c].x-cships[s].x)>>10, (cships[c].y-cships[s].y)>>10 );
+				r = get_distance( (cw->cships[c].x-cw->cships[s].x)>>10, (cw->cships[c].y-cw->cships[s].y)>>10 );
 				if (r < rm)
 				{
 					b = c; rm = r;
@@ -1783,23 +2164,23 @@ void combat_checkalttargets(int32 s, int32 t)
 			if (b > -1)
 			{
 				rm = -1;
-				for (c = 0; c < shiptypes[cships[s].type].num_systems; c++)
-				if (shipsystems[shiptypes[cships[s].type].system[c]].type == sys_weapon &&
-						shipsystems[shiptypes[cships[s].type].system[c]].par[0] > -1)
+				for (c = 0; c < shiptypes[cw->cships[s].type].num_systems; c++)
+				if (shipsystems[shiptypes[cw->cships[s].type].system[c]].type == sys_weapon &&
+						shipsystems[shiptypes[cw->cships[s].type].system[c]].par[0] > -1)
 				{
-					r = shipweapons[shipsystems[shiptypes[cships[s].type].system[c]].par[0]].range;
+					r = shipweapons[shipsystems[shiptypes[cw->cships[s].type].system[c]].par[0]].range;
 					if (r < rm || rm == -1) rm=r;
 				}
 
-				cships[s].target = b;
-				// shiptypes[cships[s].type].speed > shiptypes[cships[b].type].speed+3 &&
-				if (cships[s].own != 2)
-					cships[s].dist = rm+64;
+				cw->cships[s].target = b;
+				// shiptypes[cw->cships[s].type].speed > shiptypes[cw->cships[b].type].speed+3 &&
+				if (cw->cships[s].own != 2)
+					cw->cships[s].dist = rm+64;
 				else	// klakar
-					cships[s].dist = 0;
-				cships[s].angle = get_direction(cships[b].x - cships[s].x, cships[b].y - cships[s].y);
-				cships[s].tac = 0;
-				cships[s].wp_time = t + 500 + rand()%500;
+					cw->cships[s].dist = 0;
+				cw->cships[s].angle = get_direction(cw->cships[b].x - cw->cships[s].x, cw->cships[b].y - cw->cships[s].y);
+				cw->cships[s].tac = 0;
+				cw->cships[s].wp_time = t + 500 + rng_rand(&cw->rng)%500;
 			}
 		}
 
@@ -1808,16 +2189,16 @@ void combat_checkalttargets(int32 s, int32 t)
 
 }
 
-void combat_findstuff2do(int32 s, int32 t)
+void combat_findstuff2do(t_combatworld *cw, int32 s, int32 t)
 {
 	int b, c;
 	int r, rm;
 	int fo;
 	int pla = 0;	// is this player ship?
 
-	if (cships[playership].hits > 0 && cships[s].own == 0)
+	if (cw->cships[cw->playership].hits > 0 && cw->cships[s].own == 0)
 	{
-		if (s < player.num_ships)
+		if (s < cw->num_pships)
 			pla = 1;
 	}
 
@@ -1826,9 +2207,9 @@ void combat_findstuff2do(int32 s, int32 t)
 		b = -1; rm = 30000;
 		// find closest enemy
 		for (c = 0; c < MAX_COMBAT_SHIPS; c++)
-		if (cships[c].type>-1 && cships[c].hits>0 && (cships[c].own&1)!=(cships[s].own&1) && cships[c].cloaked==0 && cships[c].active==2)
+		if (cw->cships[c].type>-1 && cw->cships[c].hits>0 && (cw->cships[c].own&1)!=(cw->cships[s].own&1) && cw->cships[c].cloaked==0 && cw->cships[c].active==2)
 		{
-			r = get_distance( (cships[c].x-cships[s].x)>>10, (cships[c].y-cships[s].y)>>10 );
+			r = get_distance( (cw->cships[c].x-cw->cships[s].x)>>10, (cw->cships[c].y-cw->cships[s].y)>>10 );
 			if (r < rm)
 			{
 				b = c; rm = r;
@@ -1836,85 +2217,85 @@ void combat_findstuff2do(int32 s, int32 t)
 		}
 		if (b > -1)
 		{
-			cships[s].target = b;
-			//	shiptypes[cships[s].type].speed > shiptypes[cships[b].type].speed+3 &&
-			if (cships[s].own != 2)
-				cships[s].dist = cships[s].frange+64;
+			cw->cships[s].target = b;
+			//	shiptypes[cw->cships[s].type].speed > shiptypes[cw->cships[b].type].speed+3 &&
+			if (cw->cships[s].own != 2)
+				cw->cships[s].dist = cw->cships[s].frange+64;
 			else // klakar
-				cships[s].dist = 0;
+				cw->cships[s].dist = 0;
 			// if in front, swoop to the side
-			c = get_direction(cships[s].x - cships[b].x, cships[s].y - cships[b].y);
-			c = (c + 1024 - cships[b].a)&1023;
+			c = get_direction(cw->cships[s].x - cw->cships[b].x, cw->cships[s].y - cw->cships[b].y);
+			c = (c + 1024 - cw->cships[b].a)&1023;
 			if (c > 512) c-=1024;
 			if (abs(c) < 128)	// in front
 			{
-				cships[s].angle = (cships[b].a + 512 + 256*((c>0)-(c<0)) + rand()%256 - 128)&1023;
+				cw->cships[s].angle = (cw->cships[b].a + 512 + 256*((c>0)-(c<0)) + rng_rand(&cw->rng)%256 - 128)&1023;
 			}
 			else		// attack directly
 			{
-				cships[s].angle = get_direction(cships[b].x - cships[s].x, cships[b].y - cships[s].y);
+				cw->cships[s].angle = get_direction(cw->cships[b].x - cw->cships[s].x, cw->cships[b].y - cw->cships[s].y);
 			}
-			cships[s].tac = 0;
+			cw->cships[s].tac = 0;
 			if (t>0)
-				cships[s].wp_time = t + 500 + rand()%500;
+				cw->cships[s].wp_time = t + 500 + rng_rand(&cw->rng)%500;
 			else
-				cships[s].wp_time = t + 1000 + rand()%500;
+				cw->cships[s].wp_time = t + 1000 + rng_rand(&cw->rng)%500;
 		}
 		else	// couldn't find enemy. Enter search pattern or formation
 		{
-			if (cships[playership].hits>0 && cships[s].own==0)	// autofighters
+			if (cw->cships[cw->playership].hits>0 && cw->cships[s].own==0)	// autofighters
 			{
 				pla = 1;
 			}
-			if (cships[playership].hits>0 && cships[s].own==2)	// klakar escorts player
+			if (cw->cships[cw->playership].hits>0 && cw->cships[s].own==2)	// klakar escorts player
 			{
-				cships[s].tac = 0;
-				cships[s].target = playership;
-				cships[s].dist = 128;
-				cships[s].angle = (cships[cships[s].target].a + 512) & 1023;
+				cw->cships[s].tac = 0;
+				cw->cships[s].target = cw->playership;
+				cw->cships[s].dist = 128;
+				cw->cships[s].angle = (cw->cships[cw->cships[s].target].a + 512) & 1023;
 			}
-			else if (cships[s].tac < 2)
+			else if (cw->cships[s].tac < 2)
 			{
-				cships[s].tac = 2;
-				cships[s].wp_x = cships[s].x + sin1k[cships[s].a];
-				cships[s].wp_y = cships[s].y + cos1k[cships[s].a];
-				cships[s].dist = cships[s].frange+64;
-				cships[s].patx = cships[s].wp_x;
-				cships[s].paty = cships[s].wp_y;
+				cw->cships[s].tac = 2;
+				cw->cships[s].wp_x = cw->cships[s].x + sin1k[cw->cships[s].a];
+				cw->cships[s].wp_y = cw->cships[s].y + cos1k[cw->cships[s].a];
+				cw->cships[s].dist = cw->cships[s].frange+64;
+				cw->cships[s].patx = cw->cships[s].wp_x;
+				cw->cships[s].paty = cw->cships[s].wp_y;
 			}
 		}
 	}
 	if (pla) // friendly
 	{
-		if (!retreat || (shiptypes[cships[s].type].flag & 2)>0)
+		if (!cw->retreat || (shiptypes[cw->cships[s].type].flag & 2)>0)
 		{
-			if (s != playership)
+			if (s != cw->playership)
 			{
 				fo = s;
-				if (fo >= player.num_ships)
+				if (fo >= cw->num_pships)
 				{
-					fo = player.num_ships + (MAX_COMBAT_SHIPS-1-fo);
+					fo = cw->num_pships + (MAX_COMBAT_SHIPS-1-fo);
 				}
-				cships[s].target = playership;
-				cships[s].dist = 128*((fo+1)/2);
-				cships[s].angle = (cships[playership].a + 768-512*(fo&1))&1023;
-				cships[s].tac = 0;
+				cw->cships[s].target = cw->playership;
+				cw->cships[s].dist = 128*((fo+1)/2);
+				cw->cships[s].angle = (cw->cships[cw->playership].a + 768-512*(fo&1))&1023;
+				cw->cships[s].tac = 0;
 			}
 			else
 			{
-				cships[s].target = -1;
-				cships[s].tac = 2;
-				cships[s].wp_x = cships[s].x + sin1k[cships[s].a]*2;
-				cships[s].wp_y = cships[s].y + cos1k[cships[s].a]*2;
+				cw->cships[s].target = -1;
+				cw->cships[s].tac = 2;
+				cw->cships[s].wp_x = cw->cships[s].x + sin1k[cw->cships[s].a]*2;
+				cw->cships[s].wp_y = cw->cships[s].y + cos1k[cw->cships[s].a]*2;
 			}
 		}
 		else
 		{
 			b = -1; rm = 30000;
 			for (c = 0; c < MAX_COMBAT_SHIPS; c++)
-			if (cships[c].own == 1 && cships[c].type>-1 && cships[c].hits>0 && cships[c].cloaked==0 && cships[c].active>0)
+			if (cw->cships[c].own == 1 && cw->cships[c].type>-1 && cw->cships[c].hits>0 && cw->cships[c].cloaked==0 && cw->cships[c].active>0)
 			{
-				r = get_distance( (cships[c].x-cships[s].x)>>10, (cships[c].y-cships[s].y)>>10 );
+				r = get_distance( (cw->cships[c].x-cw->cships[s].x)>>10, (cw->cships[c].y-cw->cships[s].y)>>10 );
 				if (r < rm)
 				{
 					b = c; rm = r;
@@ -1922,76 +2303,130 @@ void combat_findstuff2do(int32 s, int32 t)
 			}
 			if (b > -1)	// escape from closest enemy ship
 			{
-				c = get_direction ( (cships[b].x-cships[s].x)>>10, (cships[b].y-cships[s].y)>>10 );
+				c = get_direction ( (cw->cships[b].x-cw->cships[s].x)>>10, (cw->cships[b].y-cw->cships[s].y)>>10 );
 			}
 			else	// if no enemy found, escape from "camera"
 			{
-				c = get_direction ( (camera.x-cships[s].x)>>10, (camera.y-cships[s].y)>>10 );
+				c = get_direction ( (cw->camera.x-cw->cships[s].x)>>10, (cw->camera.y-cw->cships[s].y)>>10 );
 			}
 
 			c = ( c + 512 ) & 1023;
 
-			cships[s].target = -1;
-			cships[s].tac = 2;
-			cships[s].wp_x = cships[s].x + (sin1k[c]>>6)*30000;
-			cships[s].wp_y = cships[s].y + (cos1k[c]>>6)*30000;
+			cw->cships[s].target = -1;
+			cw->cships[s].tac = 2;
+			cw->cships[s].wp_x = cw->cships[s].x + (sin1k[c]>>6)*30000;
+			cw->cships[s].wp_y = cw->cships[s].y + (cos1k[c]>>6)*30000;
 		}
 	}
 
 }
 
-void combat_checkescapes(int32 t)
+void combat_checkescapes(t_combatworld *cw, int32 t)
 {
 	int c, s;
 	int r;
 	//int rm, h;
 
 	for (s = 0; s < MAX_COMBAT_SHIPS; s++)
-		if (cships[s].own == 1 && cships[s].type > -1 && cships[s].flee>0)
+		if (cw->cships[s].own == 1 && cw->cships[s].type > -1 && cw->cships[s].flee>0)
 		{
-			cships[s].flee = 2;
+			cw->cships[s].flee = 2;
 			for (c = 0; c < MAX_COMBAT_SHIPS; c++)
-			if (cships[c].type > -1 && cships[c].own != 1 && cships[c].hits > 0)
+			if (cw->cships[c].type > -1 && cw->cships[c].own != 1 && cw->cships[c].hits > 0)
 			{
-				r = get_distance( (cships[c].x-cships[s].x)>>10, (cships[c].y-cships[s].y)>>10);
-				if (r < (cships[c].frange*3)/2)
-					cships[s].flee = 1;
+				r = get_distance( (cw->cships[c].x-cw->cships[s].x)>>10, (cw->cships[c].y-cw->cships[s].y)>>10);
+				if (r < (cw->cships[c].frange*3)/2)
+					cw->cships[s].flee = 1;
 			}
 		}
 
-	if (!retreat)
+	if (!cw->retreat)
 	{
 		for (s = 0; s < MAX_COMBAT_SHIPS; s++)
-		if ((cships[s].own & 1) == 0)
-			cships[s].escaped = 0;
+		if ((cw->cships[s].own & 1) == 0)
+			cw->cships[s].escaped = 0;
 
 		return;
 	}
 
-	if (t < rett+100)
+	if (t < cw->rett+100)
 		return;
 
 	for (s = 0; s < MAX_COMBAT_SHIPS; s++)
-	if (cships[s].type > -1)
+	if (cw->cships[s].type > -1)
 	{
-		if ((cships[s].own&1) == 0)
+		if ((cw->cships[s].own&1) == 0)
 		{
-			cships[s].escaped = 1;
-			if (cships[s].cloaked==0)
+			cw->cships[s].escaped = 1;
+			if (cw->cships[s].cloaked==0)
 			{
 				for (c = 0; c < MAX_COMBAT_SHIPS; c++)
-				if (cships[c].type > -1 && cships[c].own == 1 && cships[c].hits > 0 && cships[c].active == 2)
+				if (cw->cships[c].type > -1 && cw->cships[c].own == 1 && cw->cships[c].hits > 0 && cw->cships[c].active == 2)
 				{
-					r = get_distance( (cships[c].x-cships[s].x)>>10, (cships[c].y-cships[s].y)>>10);
-					if (r < (cships[c].frange*3)/2)
-						cships[s].escaped = 0;
+					r = get_distance( (cw->cships[c].x-cw->cships[s].x)>>10, (cw->cships[c].y-cw->cships[s].y)>>10);
+					if (r < (cw->cships[c].frange*3)/2)
+						cw->cships[s].escaped = 0;
 				}
 			}
 		}
 	}
 }
 
-int32 combat_findship(int32 mx, int32 my)
+// the state of the battle that depends on what's on screen: camera
+// tracking, fleeing ships leaving it, expiring effects and the selection
+void combat_headless_update(t_combatworld *cw, int32 t)
+{
+	int32 c, q;
+	int32 cx = 160+240, cy = 244;
+
+	combat_autocamera(cw, t);
+
+	// dead ships drop out of the selection, as the interface shows it
+	c = cw->camera.ship_sel;
+	if (c == -1 || cw->cships[c].type == -1)
+		select_ship(cw, 0, t);
+	if (cw->cships[0].type == -1)
+	{	cw->camera.ship_sel = -1; cw->camera.ship_trg = -1; }
+	else if (cw->cships[cw->camera.ship_sel].target > -1)
+		cw->camera.ship_trg = cw->cships[cw->camera.ship_sel].target;
+
+	for (c = 0; c < MAX_COMBAT_SHIPS; c++)
+	if (cw->cships[c].type > -1)
+	{
+		cw->cships[c].ds_x = cx + ((((cw->cships[c].x - cw->camera.x)>>8) * cw->camera.z) >> 14);
+		cw->cships[c].ds_y = cy - ((((cw->cships[c].y - cw->camera.y)>>8) * cw->camera.z) >> 14);
+		cw->cships[c].ds_s = (hulls[shiptypes[cw->cships[c].type].hull].size * cw->camera.z) >> 12;
+	}
+
+	for (c = 0; c < MAX_COMBAT_SHIPS; c++)
+		if (cw->cships[c].type > -1 && cw->cships[c].own == 1 && cw->cships[c].flee == 2)
+		{
+			if (cw->cships[c].ds_x+cw->cships[c].ds_s < cx-240 ||
+					cw->cships[c].ds_x-cw->cships[c].ds_s > cx+240 ||
+					cw->cships[c].ds_y+cw->cships[c].ds_s < cy-240 ||
+					cw->cships[c].ds_y-cw->cships[c].ds_s > cy+240 ||
+					(cw->cships[c].cloaked && t > cw->cships[c].cloaktime+50))
+			{
+				combat_killship(cw, c, t, 1);
+			}
+		}
+
+	for (q = 0; q < cw->beams.num; q++)
+	if (cw->cbeams[c = cw->beams.live[q]].wep && cw->cbeams[c].stg > -1)	// staged from projectile
+	{
+		if (!cw->cprojs[cw->cbeams[c].stg].wep)
+			cw->cbeams[c].wep = NULL;
+	}
+
+	for (q = 0; q < cw->explos.num; q++)
+	if (cw->cexplo[c = cw->explos.live[q]].spr)
+	{
+		if (t > cw->cexplo[c].end)
+			cw->cexplo[c].spr = NULL;
+	}
+}
+
+int32 combat_findship(t_combatworld *cw, int32 mx, int32 my)
 {
 	int32 c;
 	int32 r;
@@ -2000,14 +2435,14 @@ int32 combat_findship(int32 mx, int32 my)
 
 	r = -1;
 
-	for (d = 0; d < numships; d++)
+	for (d = 0; d < cw->numships; d++)
 	{
-		c = sortship[d];
-		if (cships[c].hits > 0 && cships[c].type > -1 && (cships[c].cloaked==0 || cships[c].own==0))
+		c = cw->sortship[d];
+		if (cw->cships[c].hits > 0 && cw->cships[c].type > -1 && (cw->cships[c].cloaked==0 || cw->cships[c].own==0))
 		{
-			sz = (cships[c].ds_s >> 1)+5;
-			if (mx >= cships[c].ds_x-sz && mx <= cships[c].ds_x+sz &&
-					my >= cships[c].ds_y-sz && my <= cships[c].ds_y+sz)
+			sz = (cw->cships[c].ds_s >> 1)+5;
+			if (mx >= cw->cships[c].ds_x-sz && mx <= cw->cships[c].ds_x+sz &&
+					my >= cw->cships[c].ds_y-sz && my <= cw->cships[c].ds_y+sz)
 				r = c;
 		}
 	}
@@ -2015,79 +2450,79 @@ int32 combat_findship(int32 mx, int32 my)
 	return r;
 }
 
-int32 shiptonum(t_ship *s)
+int32 shiptonum(t_combatworld *cw, t_ship *s)
 {
 	int32 c;
 
 	for (c = 0; c < MAX_COMBAT_SHIPS; c++)
-	if (cships[c].type > -1)
+	if (cw->cships[c].type > -1)
 	{
-		if (s == &cships[c])
+		if (s == &cw->cships[c])
 			return c;
 	}
 
 	return -1;
 }
 
-void combat_updateshipstats(int32 s, int32 t)
+void combat_updateshipstats(t_combatworld *cw, int32 s, int32 t)
 {
 	int x;
 	int ty;
 
-	ty = cships[s].type;
+	ty = cw->cships[s].type;
 
 	if (ty==-1)
 		return;
 
-	cships[s].shld_type = -1;
-	cships[s].dmgc_type = -1;
-	cships[s].cpu_type = 0;
-	cships[s].ecm_type = -1;
-	cships[s].clo_type = 0;
-	cships[s].frange = 0;
+	cw->cships[s].shld_type = -1;
+	cw->cships[s].dmgc_type = -1;
+	cw->cships[s].cpu_type = 0;
+	cw->cships[s].ecm_type = -1;
+	cw->cships[s].clo_type = 0;
+	cw->cships[s].frange = 0;
 
-	cships[s].speed = 0;
-	cships[s].sys_thru = -1;
+	cw->cships[s].speed = 0;
+	cw->cships[s].sys_thru = -1;
 
 	for (x = 0; x < shiptypes[ty].num_systems; x++)
 	{
 		switch (shipsystems[shiptypes[ty].system[x]].type)
 		{
 			case sys_weapon:
-			if (cships[s].syshits[x]>0)
-				cships[s].frange = MAX(cships[s].frange, shipweapons[shipsystems[shiptypes[cships[s].type].system[x]].par[0]].range);
+			if (cw->cships[s].syshits[x]>0)
+				cw->cships[s].frange = MAX(cw->cships[s].frange, shipweapons[shipsystems[shiptypes[cw->cships[s].type].system[x]].par[0]].range);
 			break;
 
 			case sys_thruster:
-			cships[s].sys_thru = x;
+			cw->cships[s].sys_thru = x;
 			break;
 
 			case sys_shield:
-			if (cships[s].syshits[x]>0)
-			{	cships[s].shld_type = shiptypes[ty].system[x]; cships[s].sys_shld = x; }
+			if (cw->cships[s].syshits[x]>0)
+			{	cw->cships[s].shld_type = shiptypes[ty].system[x]; cw->cships[s].sys_shld = x; }
 			break;
 
 			case sys_damage:
-			if (cships[s].syshits[x]>0)
-			{	cships[s].dmgc_type = shiptypes[ty].system[x]; cships[s].sys_dmgc = x; }
+			if (cw->cships[s].syshits[x]>0)
+			{	cw->cships[s].dmgc_type = shiptypes[ty].system[x]; cw->cships[s].sys_dmgc = x; }
 			break;
 
 			case sys_computer:
-			if (cships[s].syshits[x]>0)
-			{	cships[s].cpu_type = shipsystems[shiptypes[ty].system[x]].par[0]; cships[s].sys_cpu = x; }
+			if (cw->cships[s].syshits[x]>0)
+			{	cw->cships[s].cpu_type = shipsystems[shiptypes[ty].system[x]].par[0]; cw->cships[s].sys_cpu = x; }
 			break;
 
 			case sys_ecm:
-			if (cships[s].syshits[x]>0)
-			{	cships[s].ecm_type = shiptypes[ty].system[x]; cships[s].sys_ecm = x; }
+			if (cw->cships[s].syshits[x]>0)
+			{	cw->cships[s].ecm_type = shiptypes[ty].system[x]; cw->cships[s].sys_ecm = x; }
 
 			case sys_misc:
-			if (cships[s].syshits[x]>0)
+			if (cw->cships[s].syshits[x]>0)
 			{
 				// cloaker
 				if (shipsystems[shiptypes[ty].system[x]].type == sys_misc && shipsystems[shiptypes[ty].system[x]].par[0] == 1)
-					if (cships[s].syshits[x]>=5)
-						{	cships[s].clo_type = 1; cships[s].sys_clo = x; }
+					if (cw->cships[s].syshits[x]>=5)
+						{	cw->cships[s].clo_type = 1; cw->cships[s].sys_clo = x; }
 			}
 			break;
 
@@ -2095,80 +2530,68 @@ void combat_updateshipstats(int32 s, int32 t)
 		}
 	}
 
-	if (cships[s].cloaked > 0 && cships[s].clo_type==0)	// decloak if cloaker destroyed
+	if (cw->cships[s].cloaked > 0 && cw->cships[s].clo_type==0)	// decloak if cloaker destroyed
 	{
-		cships[s].cloaked=0; cships[s].cloaktime=t;
+		cw->cships[s].cloaked=0; cw->cships[s].cloaktime=t;
 	}
 
-	if (cships[s].shld > 0 && cships[s].shld_type==-1)	// drop shield if damaged
+	if (cw->cships[s].shld > 0 && cw->cships[s].shld_type==-1)	// drop shield if damaged
 	{
-		cships[s].shld=0;
+		cw->cships[s].shld=0;
 	}
 
-	if (cships[s].sys_thru > -1)
-		cships[s].speed = (shiptypes[cships[s].type].speed * cships[s].syshits[cships[s].sys_thru]) / 10;
-	if (cships[s].speed == 0)
+	if (cw->cships[s].sys_thru > -1)
+		cw->cships[s].speed = (shiptypes[cw->cships[s].type].speed * cw->cships[s].syshits[cw->cships[s].sys_thru]) / 10;
+	if (cw->cships[s].speed == 0)
 	{
-		cships[s].speed = 1 + (3 * 32) / hulls[shiptypes[cships[s].type].hull].mass;
+		cw->cships[s].speed = 1 + (3 * 32) / hulls[shiptypes[cw->cships[s].type].hull].mass;
 	}
-	cships[s].turn = 1 + ((shiptypes[cships[s].type].turn-1) * cships[s].syshits[cships[s].sys_thru]) / 10;
+	cw->cships[s].turn = 1 + ((shiptypes[cw->cships[s].type].turn-1) * cw->cships[s].syshits[cw->cships[s].sys_thru]) / 10;
 
 }
 
-void reset_ship(int32 s, int32 st, int32 t)
+void reset_ship(t_combatworld *cw, int32 s, int32 st, int32 t)
 {
 	int32 c;
 
-	cships[s].hits = hulls[shiptypes[st].hull].hits;
-	cships[s].type = st;
-	cships[s].va = 0;
-	cships[s].vx = 0;
-	cships[s].vy = 0;
-	cships[s].shld = 0;
-	cships[s].shld_time = 0;
-	cships[s].shld_charge = 0;
-	cships[s].damage_time = 0;
-	cships[s].dmgc_time = 0;
-	cships[s].tac = 0;
-	cships[s].escaped = 0;
-	cships[s].active = 2;
-	cships[s].flee = 0;
+	cw->cships[s].hits = hulls[shiptypes[st].hull].hits;
+	cw->cships[s].type = st;
+	cw->cships[s].va = 0;
+	cw->cships[s].vx = 0;
+	cw->cships[s].vy = 0;
+	cw->cships[s].shld = 0;
+	cw->cships[s].shld_time = 0;
+	cw->cships[s].shld_charge = 0;
+	cw->cships[s].damage_time = 0;
+	cw->cships[s].dmgc_time = 0;
+	cw->cships[s].tac = 0;
+	cw->cships[s].escaped = 0;
+	cw->cships[s].active = 2;
+	cw->cships[s].flee = 0;
 
 	// find systems
 	for (c = 0; c < shiptypes[st].num_systems; c++)
 	{
-		cships[s].syshits[c] = 10;
+		cw->cships[s].syshits[c] = 10;
 	}
 
-	combat_updateshipstats(s, t);
+	combat_updateshipstats(cw, s, t);
 
-	if (cships[s].shld_type > -1)
-		cships[s].shld = shipsystems[cships[s].shld_type].par[0];
+	if (cw->cships[s].shld_type > -1)
+		cw->cships[s].shld = shipsystems[cw->cships[s].shld_type].par[0];
 }
 
-void combat_summon_klakar(int32 t)
+void combat_summon_klakar(t_combatworld *cw, int32 t)
 {
 	int32 b, c;
 	int32 s, st;
 
-	b = -1;
-	for (c = 0; c < STARMAP_MAX_FLEETS; c++)
-	{
-		if (sm_fleets[c].race == race_klakar)
-			b = c;
-	}
-	if (b == -1)
-	{
-		Play_SoundFX(WAV_DESELECT, get_ik_timer(1));
-		return;
-	}
-	Play_SoundFX(WAV_DOT, 0);
-	sm_fleets[b].system = player.system;
+	combat_sound(cw, WAV_DOT);
 
 	b = -1;
 	for (c = 0; c < MAX_COMBAT_SHIPS; c++)
 	{
-		if (c >= player.num_ships && cships[c].type == -1)
+		if (c >= cw->num_pships && cw->cships[c].type == -1)
 			b = c;
 	}
 
@@ -2186,34 +2609,34 @@ void combat_summon_klakar(int32 t)
 	// set up klakar ship
 
 	// find location
-	b = rand()%1024;
+	b = rng_rand(&cw->rng)%1024;
 
 	// basic resets
-	reset_ship(s, st, t);
+	reset_ship(cw, s, st, t);
 
-	cships[s].x = camera.x - ((sin1k[b]*1000)>>6);
-	cships[s].y = camera.y - ((cos1k[b]*1000)>>6);
-	cships[s].a = b;
-	cships[s].own = 2;
+	cw->cships[s].x = cw->camera.x - ((sin1k[b]*1000)>>6);
+	cw->cships[s].y = cw->camera.y - ((cos1k[b]*1000)>>6);
+	cw->cships[s].a = b;
+	cw->cships[s].own = 2;
 
-	combat_findstuff2do(s, 0);
+	combat_findstuff2do(cw, s, 0);
 
 //	Play_SoundFX(WAV_HYPERDRIVE, get_ik_timer(1));
-	klaktime = t;
+	cw->klaktime = t;
 }
 
-void combat_launch_fighter(int32 s, int32 t)
+void combat_launch_fighter(t_combatworld *cw, int32 s, int32 t)
 {
 	int32 c, b;
 	int32 st;
 	int32 x, y;
 
-	st = racefleets[races[shiptypes[cships[s].type].race].fleet].stype[0];
+	st = racefleets[races[shiptypes[cw->cships[s].type].race].fleet].stype[0];
 
 	/*
 	b = 0;
 	for (c = 0; c < MAX_COMBAT_SHIPS; c++)
-		if (cships[c].type == st && cships[c].hits > 0)
+		if (cw->cships[c].type == st && cw->cships[c].hits > 0)
 			b++;
 
 	if (b >= 3)	// don't launch more than 3 at once
@@ -2223,7 +2646,7 @@ void combat_launch_fighter(int32 s, int32 t)
 
 	b = -1;
 	for (c = 0; c < MAX_COMBAT_SHIPS; c++)
-	if (c >= player.num_ships && cships[c].type == -1)
+	if (c >= cw->num_pships && cw->cships[c].type == -1)
 	{
 		b = c;
 	}
@@ -2231,23 +2654,23 @@ void combat_launch_fighter(int32 s, int32 t)
 	if (b == -1)
 		return;
 
-	x = cships[s].x; y = cships[s].y;
+	x = cw->cships[s].x; y = cw->cships[s].y;
 
-	for (c = 0; c < hulls[shiptypes[cships[s].type].hull].numh; c++)
-		if (hulls[shiptypes[cships[s].type].hull].hardpts[c].type == hdpFighter)
-			combat_gethardpoint(&cships[s], c, &x, &y);
+	for (c = 0; c < hulls[shiptypes[cw->cships[s].type].hull].numh; c++)
+		if (hulls[shiptypes[cw->cships[s].type].hull].hardpts[c].type == hdpFighter)
+			combat_gethardpoint(&cw->cships[s], c, &x, &y);
 
-	reset_ship(b, st, t);
+	reset_ship(cw, b, st, t);
 
-	cships[b].a = cships[s].a;
-	cships[b].x = x;
-	cships[b].y = y;
-	cships[b].own = cships[s].own;
+	cw->cships[b].a = cw->cships[s].a;
+	cw->cships[b].x = x;
+	cw->cships[b].y = y;
+	cw->cships[b].own = cw->cships[s].own;
 
-	combat_findstuff2do(b, t);
+	combat_findstuff2do(cw, b, t);
 }
 
-int32 combat_use_gong(int32 t)
+int32 combat_use_gong(t_combatworld *cw, int32 t)
 {
 	int32 c,b;
 	int32 mh;
@@ -2255,9 +2678,9 @@ int32 combat_use_gong(int32 t)
 	b = -1; mh = 0;
 	for (c = 0; c < MAX_COMBAT_SHIPS; c++)
 	{
-		if (cships[c].type>-1 && cships[c].hits+cships[c].shld>mh && (cships[c].own&1))
+		if (cw->cships[c].type>-1 && cw->cships[c].hits+cw->cships[c].shld>mh && (cw->cships[c].own&1))
 		{
-			mh = cships[c].hits+cships[c].shld;
+			mh = cw->cships[c].hits+cw->cships[c].shld;
 			b = c;
 		}
 	}
@@ -2265,17 +2688,17 @@ int32 combat_use_gong(int32 t)
 	if (b==-1)
 		return 1;
 #ifndef DEMO_VERSION
-	Play_SoundFX(WAV_GONG, t);
+	combat_sound(cw, WAV_GONG, t);
 #endif
 
 	// mark ship for extreme death
-	cships[b].bong_start = t;
-	cships[b].bong_end = t + 200;
+	cw->cships[b].bong_start = t;
+	cw->cships[b].bong_end = t + 200;
 
 	return 0;
 }
 
-void combat_help_screen()
+void combat_help_screen(t_combatworld *cw)
 {
 	int32 end;
 	int32 c, mc;
@@ -2388,16 +2811,49 @@ void combat_help_screen()
 		must_quit = 0;
 }
 
-void combat_SoundFX(int id, int srcx, int volume, int rate)
+void combat_SoundFX(t_combatworld *cw, int id, int srcx, int volume, int rate)
 {
 	int pan;
 
-	pan = (((srcx - camera.x)>>8) * camera.z)>>11;
+	if (cw->headless)
+		return;
+
+	pan = (((srcx - cw->camera.x)>>8) * cw->camera.z)>>11;
 
 	if (pan < -10000)
 		pan = -10000;
 	if (pan > 10000)
 		pan = 10000;
 
-	Play_SoundFX(id, 0, volume, rate, pan);
+	combat_sound(cw, id, 0, -1, volume, rate, pan);
+}
+
+// play a sound of the battle, unless it's headless. on the battle
+// thread it waits for combat_publish(), the interface plays it.
+void combat_sound(t_combatworld *cw, int32 id, int32 t, int32 ch, int32 volume, int32 rate, int32 pan)
+{
+	t_combatsound snd;
+
+	if (cw->headless)
+		return;
+
+	snd.id = id;
+	snd.t = t;
+	snd.ch = ch;
+	snd.volume = volume;
+	snd.rate = rate;
+	snd.pan = pan;
+
+	if (!cw->queuesound)
+		combat_playsound(&snd);
+	else if (cw->numsounds < COMBAT_SOUNDS)	// or it's dropped, like one cut off
+		cw->sounds[cw->numsounds++] = snd;
+}
+
+void combat_playsound(t_combatsound *snd)
+{
+	if (snd->ch < 0)
+		Play_SoundFX(snd->id, snd->t, snd->volume, snd->rate, snd->pan);
+	else
+		Play_Sound(snd->id, snd->ch, 1, snd->volume, snd->rate, snd->pan);
 }
@@ -14,8 +14,26 @@ enum combat_tactics
 	tac_flee,
 };
 
+// player commands, recorded for replays (see t_combatevent)
+enum combat_events
+{
+	cev_frame=0,		// ship = repeats, par = ticks run, display drawn, zoom step
+	cev_select,			// par[0] = time
+	cev_target,			// par[0] = target, par[1] = time
+	cev_waypoint,		// par[0],par[1] = waypoint, par[2] = new order
+	cev_formation,	// par[0] = angle, par[1] = distance to target
+	cev_cloak,
+	cev_gong,
+	cev_retreat,		// par[0] = on/off, par[1] = time
+	cev_klakar,			// par[0] = no klakar fleet to come
+};
+
+#define COMBAT_REPLAY_VERSION 1
+
+#ifndef MAX_COMBAT_SHIPS
 #define MAX_COMBAT_SHIPS 32
-#define MAX_COMBAT_PROJECTILES 256
+#endif
+#define MAX_COMBAT_PROJECTILES 256	// starting pool sizes, they grow as needed
 #define MAX_COMBAT_BEAMS 256
 #define MAX_COMBAT_EXPLOS 256
 
@@ -24,8 +42,15 @@ enum combat_tactics
 #else
 #define COMBAT_FRAMERATE 17
 #endif
+#define COMBAT_DISPLAYRATE 100	// the interface draws up to this, in between ticks
+
+#define COMBAT_INTERFACE_COLOR (11+cw->simulated)
+
+#define COMBAT_SOUNDS 32		// sounds the battle thread may have waiting for the interface
 
-#define COMBAT_INTERFACE_COLOR (11+simulated)
+// broadphase grid, the battlefield wraps onto 16x16 cells of 256 pixels
+#define COMBAT_GRID_SHIFT 8
+#define COMBAT_GRID_SIZE 16
 
 // ----------------
 //     TYPEDEFS
@@ -186,11 +211,9 @@ typedef struct _t_explosion
 {
 	t_ik_spritepak *spr;
 
-	int32 x, y, a;
-	int32 vx, vy, va;
+	int32 x, y, a, va;	// explosions don't drift, a spins by va per tick
 	int32 str, end;
 	int32 size, zoom;
-	int32 spin, fade;
 	int32 anim;
 	int32 cam;
 } t_explosion;
@@ -205,6 +228,137 @@ typedef struct _t_combatcamera
 	int32 drag_trg;
 } t_combatcamera;
 
+// slots for projectiles, beams or explosions. free slots are chained in
+// next[], used ones are listed in live[] in the order they were handed out.
+// entries die by clearing their wep/spr and are freed by combat_sweep().
+typedef struct _t_combatpool
+{
+	void *items;
+	int32 itemsize;
+	int32 size;			// slots allocated
+	int32 num;			// entries in live[]
+	int32 *live;
+	int32 *next;
+	int32 free;			// first free slot, -1 if none
+} t_combatpool;
+
+// a sound the battle makes, for Play_SoundFX() or, with ch set, looped
+// on that channel by Play_Sound() as the music is
+typedef struct _t_combatsound
+{
+	int32 id;
+	int32 t;
+	int32 ch;
+	int32 volume, rate, pan;
+} t_combatsound;
+
+// everything one battle needs, so that several can run side by side
+typedef struct _t_combatworld
+{
+	t_combatcamera	camera;
+	t_ship					cships[MAX_COMBAT_SHIPS];
+	t_wepbeam				*cbeams;	// items of the pools below
+	t_wepproj				*cprojs;
+	t_explosion			*cexplo;
+	t_combatpool		beams, projs, explos;
+
+	int32 numships;
+	int32 playership;
+	int32 sortship[MAX_COMBAT_SHIPS];
+
+	int32 t_move, t_disp, g_pause;
+
+	int32 nebula;
+	int32 retreat;
+	int32 rett;				// retreat time
+	int32 klaktime;
+	int32 klakavail;
+	int32 gongavail;
+
+	int32 simulated;
+	int32 headless;
+	int32 queuesound;	// on the battle thread, sounds wait in sounds[] to be published
+	t_combatsound sounds[COMBAT_SOUNDS];
+	int32 numsounds;
+	t_rng rng;				// replays exactly from the same seed
+
+	// sides, filled in before combat_start()
+	int32 pships[MAX_COMBAT_SHIPS];	// allied ships, take the first slots of cships
+	int32 num_pships;
+	int32 eships[MAX_COMBAT_SHIPS];
+	int32 num_eships;
+	int32 erace;
+	int32 eflt;				// enemy fleet number (tanru formations)
+	int32 esystem;		// enemy fleet's star system (space hulk state)
+
+	int32 *wepdmg;		// if set, damage landed per side and shipweapons[] entry
+
+	// ships bucketed by position, rebuilt each tick once they have moved
+	int32 grid_head[COMBAT_GRID_SIZE*COMBAT_GRID_SIZE];
+	int32 grid_next[MAX_COMBAT_SHIPS];
+	int32 grid_x[MAX_COMBAT_SHIPS];	// pixel position and radius of each
+	int32 grid_y[MAX_COMBAT_SHIPS];	// gridded ship, packed for the
+	int32 grid_r[MAX_COMBAT_SHIPS];	// projectile hit tests
+	int32 grid_size;	// largest ship radius in the grid
+	int32 grid_off;		// query everything instead (for benchmarking)
+} t_combatworld;
+
+typedef struct _t_combatresult
+{
+	int32 winner;		// 0 = allied, 1 = enemy, -1 = undecided at tick limit
+	int32 ticks;
+	int32 kill;			// tick the losing side was gone at
+	int32 type[MAX_COMBAT_SHIPS];		// last shiptype seen in each slot (-1 = never used)
+	int32 own[MAX_COMBAT_SHIPS];
+	int32 fate[MAX_COMBAT_SHIPS];		// 0 = survived, 1 = escaped, 2 = destroyed
+	int32 hits[MAX_COMBAT_SHIPS];		// hull left at end of battle
+	int32 maxhits[MAX_COMBAT_SHIPS];
+	int32 sysdmg[MAX_COMBAT_SHIPS];	// damaged systems
+	int32 syslost[MAX_COMBAT_SHIPS];	// destroyed systems
+	int32 *wepdmg;	// optional, damage is added to [side*num_shipweapons + weapon]
+} t_combatresult;
+
+// one entry of a replay. the time some commands carry is the interface
+// timer, which the ai takes as the current tick.
+typedef struct _t_combatevent
+{
+	int32 tick;		// t_move it happened on
+	int32 type;
+	int32 ship;
+	int32 par[3];
+} t_combatevent;
+
+// replay file header, followed by num_shiptypes t_shiptypes (the player's
+// ships change during a game) and then the events up to the end of battle
+typedef struct _t_combatreplay
+{
+	char magic[4];
+	int32 version;
+	char moddir[256];
+	uint32 seed;
+	int32 simulated;
+	int32 nebula;
+	int32 klakavail;
+	int32 gongavail;
+	int32 smoketrails;
+	int32 lensflares;
+	int32 pships[MAX_COMBAT_SHIPS];
+	int32 num_pships;
+	int32 eships[MAX_COMBAT_SHIPS];
+	int32 num_eships;
+	int32 erace;
+	int32 eflt;
+	int32 esystem;
+	int32 num_shiptypes;
+} t_combatreplay;
+
+enum combat_fates
+{
+	fate_survived=0,
+	fate_escaped,
+	fate_destroyed,
+};
+
 
 enum hull_keyids
 {
@@ -388,25 +542,10 @@ extern int						num_races;
 extern int						enemies[16];
 extern int						num_enemies;
 
-extern t_combatcamera		camera;
-extern t_ship						cships[MAX_COMBAT_SHIPS];
-extern t_wepbeam					cbeams[MAX_COMBAT_BEAMS];
-extern t_wepproj					cprojs[MAX_COMBAT_PROJECTILES];
-extern t_explosion				cexplo[MAX_COMBAT_EXPLOS];
-
-extern int32 numships;
-extern int32 playership;
-extern int32 sortship[MAX_COMBAT_SHIPS];
-
-extern int32 t_move, t_disp, g_pause;
-
-extern int32 nebula;
-extern int32 retreat;
-extern int32 klaktime;
-extern int32 klakavail;
-extern int32 gongavail;
+extern t_combatworld		combat_world;
 
-extern int32 simulated;
+extern char						combat_replayfile[256];	// set by -replay
+extern int32					combat_replayevery;
 
 #ifdef DEBUG_COMBAT
 extern char combatdebug[64];
@@ -425,30 +564,72 @@ void sort_shiptype_systems(int32 num);
 // combat.cpp
 
 int32 combat(int32 flt, int32 sim);
-void select_ship(int32 s, int32 t);
-void combat_updateshipstats(int32 s, int32 t);
-void combat_findstuff2do(int32 s, int32 t);
-void combat_help_screen();
-void combat_SoundFX(int id, int srcx = camera.x, int volume = -1, int rate = -1);
+int32 combat_headless(t_combatworld *cw, int32 maxticks, uint32 seed, t_combatresult *res);
+void combat_start(t_combatworld *cw, uint32 seed);
+void combat_movement(t_combatworld *cw, int32 t);
+void select_ship(t_combatworld *cw, int32 s, int32 t);
+void combat_updateshipstats(t_combatworld *cw, int32 s, int32 t);
+void combat_findstuff2do(t_combatworld *cw, int32 s, int32 t);
+void combat_help_screen(t_combatworld *cw);
+void combat_SoundFX(t_combatworld *cw, int id, int srcx, int volume = -1, int rate = -1);
+void combat_sound(t_combatworld *cw, int32 id, int32 t = 0, int32 ch = -1, int32 volume = -1, int32 rate = -1, int32 pan = 0);
+void combat_playsound(t_combatsound *snd);
+void combat_freeworld(t_combatworld *cw);
+int32 combat_pooladd(t_combatpool *pool);
+void combat_buildgrid(t_combatworld *cw);
+int32 combat_gridquery(t_combatworld *cw, int32 x, int32 y, int32 r, int32 *list);
+void combat_result(t_combatworld *cw, t_combatresult *res);
+void combat_applyevent(t_combatworld *cw, t_combatevent *ev);
+void combat_checkescapes(t_combatworld *cw, int32 t);
+void combat_headless_update(t_combatworld *cw, int32 t);
 
 // combat_sim.cpp
 
 void combat_sim();
-void combat_sim_end();
+void combat_sim_end(t_combatworld *cw);
+int32 combat_sim_headless(t_combatworld *cw, int32 pship, int32 *wing, int32 nwing, int32 r, int32 flt, int32 maxticks, uint32 seed, t_combatresult *res);
+void combat_sim_headless_init();
+
+// combat_batch.cpp
+
+int32 combat_batch(int32 battles, int32 threads, int32 maxticks, uint32 seed, FILE *out, int32 json);
+int32 combat_benchmark(int32 ships, int32 ticks, int32 r, uint32 seed);
+int32 combat_hitbench(int32 ships, int32 ticks, int32 reps, int32 r, uint32 seed);
+
+// combat_replay.cpp
+
+void combat_recstart(t_combatworld *cw, uint32 seed);
+void combat_reccommand(t_combatworld *cw, t_combatevent *ev);
+void combat_recframe(t_combatworld *cw, int32 ticks, int32 disp, int32 zoom);
+void combat_recend();
+int32 combat_replaymod(const char *fname);
+int32 combat_replay(const char *fname, int32 every, t_combatresult *res);
+
+// combat_thread.cpp
+
+void combat_threadstart(t_combatworld *cw);
+void combat_threadstop();
+void combat_threadhold(int32 hold);
+void combat_threadspeed(int32 pause, int32 zoom);
+void combat_command(int32 type, int32 s, int32 p0=0, int32 p1=0, int32 p2=0);
+t_combatworld *combat_snapshot(int32 *frac);
+void combat_release();
+void combat_playsounds();
+void combat_interpolate(t_combatworld *cw, int32 f);
 
 // combat_display.cpp
 
-void combat_autocamera(int32 t);
-void combat_display(int32 t);
+void combat_autocamera(t_combatworld *cw, int32 t);
+void combat_display(t_combatworld *cw, int32 t);
 
 // combat_weapons.cpp
 
-int32 combat_findtarget(t_ship *ship, int32 hdp);
-void combat_fire(t_ship *src, int32 hdp, t_ship *trg, int32 start);
-int32 combat_addbeam(t_shipweapon *wep, t_ship *src, int32 hdp, t_ship *trg, int32 start, int32 stg = -1);
-int32 combat_addproj(t_ship *src, int32 hdp, t_ship *trg, int32 start);
-void combat_launchstages(int32 p, int32 num, int32 start);
-int32 combat_addexplo(int32 x, int32 y, t_ik_spritepak *spr, int32 spin, int32 size, int32 zoom, int32 start, int32 end, int32 anim=-1, int32 cam=1);
-void combat_damageship(int32 s, int32 src, int32 dmg, int32 t, t_shipweapon *wep, int32 deb=0);
+int32 combat_findtarget(t_combatworld *cw, t_ship *ship, int32 hdp);
+void combat_fire(t_combatworld *cw, t_ship *src, int32 hdp, t_ship *trg, int32 start);
+int32 combat_addbeam(t_combatworld *cw, t_shipweapon *wep, t_ship *src, int32 hdp, t_ship *trg, int32 start, int32 stg = -1);
+int32 combat_addproj(t_combatworld *cw, t_ship *src, int32 hdp, t_ship *trg, int32 start);
+void combat_launchstages(t_combatworld *cw, int32 p, int32 num, int32 start);
+int32 combat_addexplo(t_combatworld *cw, int32 x, int32 y, t_ik_spritepak *spr, int32 spin, int32 size, int32 zoom, int32 start, int32 end, int32 anim=-1, int32 cam=1);
+void combat_damageship(t_combatworld *cw, int32 s, int32 src, int32 dmg, int32 t, t_shipweapon *wep, int32 deb=0);
 void combat_gethardpoint(t_ship *ship, int32 hdp, int32 *rx, int32 *ry);
-void combat_killship(int32 s, int32 t, int32 quiet=0);
+void combat_killship(t_combatworld *cw, int32 s, int32 t, int32 quiet=0);
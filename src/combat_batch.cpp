@@ -0,0 +1,666 @@
+// ----------------
+//     INCLUDES
+// ----------------
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <SDL.h>
+
+#include "typedefs.h"
+#include "rng.h"
+#include "is_fileio.h"
+
+#include "iface_globals.h"
+#include "gfx.h"
+#include "combat.h"
+#include "starmap.h"
+
+// ----------------
+//     TYPEDEFS
+// ----------------
+
+// one player ship against one fleet composition
+typedef struct _t_batchmatch
+{
+	int32 pship;
+	int32 race;
+	int32 fleet;
+
+	int32 won, lost, drawn;
+	float64 killticks;	// summed over decided battles
+	float64 *wepdmg;		// [side*num_shipweapons + weapon], summed
+} t_batchmatch;
+
+// one tick's ships and projectiles, recorded for combat_hitbench()
+typedef struct _t_hitframe
+{
+	int32 t;
+	t_ship ships[MAX_COMBAT_SHIPS];
+	int32 x[MAX_COMBAT_SHIPS];	// packed by combat_buildgrid()
+	int32 y[MAX_COMBAT_SHIPS];
+	int32 r[MAX_COMBAT_SHIPS];
+	t_wepproj *projs;
+	int32 num;
+} t_hitframe;
+
+// ----------------
+// GLOBAL VARIABLES
+// ----------------
+
+t_batchmatch	*bt_match;
+int32					bt_nummatch;
+int32					bt_battles;
+int32					bt_maxticks;
+uint32				bt_seed;
+
+int32					bt_nextjob;		// next battle to hand out, guarded by bt_lock
+SDL_mutex			*bt_lock;
+
+// ----------------
+// LOCAL PROTOTYPES
+// ----------------
+
+int32 combat_batch_matchups();
+void combat_batch_free();
+int combat_batch_thread(void *data);
+int32 combat_batch_difficulty(int32 c, int32 dif, float64 *win, float64 *loss, float64 *kill);
+void combat_batch_csv(FILE *out);
+void combat_batch_json(FILE *out);
+int32 combat_hitrecord(t_combatworld *cw, t_hitframe *f);
+int32 combat_hitsqrt(t_hitframe *f, int32 *hit);
+int32 combat_hitpacked(t_hitframe *f, int32 *hit);
+
+// ----------------
+// GLOBAL FUNCTIONS
+// ----------------
+
+// run battles seeded battles for every simulator ship against every fleet
+// in the races' fleet tables, spread over threads worker threads, and write
+// the statistics to out as csv (or json). battle j of the whole run uses
+// seed+j, so any one of them can be replayed with -simulate.
+int32 combat_batch(int32 battles, int32 threads, int32 maxticks, uint32 seed, FILE *out, int32 json)
+{
+	SDL_Thread *th[64];
+	int32 c;
+	time_t t0;
+
+	bt_battles = battles;
+	bt_maxticks = maxticks;
+	bt_seed = seed;
+	bt_nextjob = 0;
+
+	bt_lock = SDL_CreateMutex();
+	if (!bt_lock)
+	{
+		fprintf(stderr, "unable to create mutex: %s\n", SDL_GetError());
+		return 0;
+	}
+
+	if (!combat_batch_matchups())
+	{
+		combat_batch_free();
+		SDL_DestroyMutex(bt_lock);
+		return 0;
+	}
+
+	combat_sim_headless_init();
+
+	threads = MAX(1, MIN(threads, 64));
+	t0 = time(NULL);
+	fprintf(stderr, "running %d battles on %d threads...\n", bt_nummatch*bt_battles, threads);
+
+	for (c = 0; c < threads; c++)
+	{
+		th[c] = SDL_CreateThread(combat_batch_thread, NULL);
+		if (!th[c])
+		{
+			fprintf(stderr, "unable to create thread: %s\n", SDL_GetError());
+			threads = c;
+		}
+	}
+
+	// if some threads failed to start the rest still take all the jobs
+	for (c = 0; c < threads; c++)
+	{
+		SDL_WaitThread(th[c], NULL);
+	}
+
+	SDL_DestroyMutex(bt_lock);
+
+	if (threads > 0)
+	{
+		fprintf(stderr, "done in %d seconds\n", (int)(time(NULL)-t0));
+		if (json)
+			combat_batch_json(out);
+		else
+			combat_batch_csv(out);
+	}
+
+	combat_batch_free();
+
+	return threads > 0;
+}
+
+// time the combat engine on one big battle, ships split evenly between the
+// simulator ships and race r's fleet ships, with and without the broadphase
+// grid. larger battles need a build with a raised MAX_COMBAT_SHIPS.
+int32 combat_benchmark(int32 ships, int32 ticks, int32 r, uint32 seed)
+{
+	t_combatworld *cw;
+	t_combatresult res[2];
+	t_racefleet *rf;
+	clock_t t0;
+	float64 secs;
+	int32 c, g;
+
+	if (ships < 2 || ships > MAX_COMBAT_SHIPS || races[r].fleet == -1)
+	{
+		fprintf(stderr, "need 2 to %d ships and a race with a fleet\n", MAX_COMBAT_SHIPS);
+		return 0;
+	}
+
+	cw = (t_combatworld*)calloc(1, sizeof(t_combatworld));
+	if (!cw)
+	{
+		fprintf(stderr, "out of memory\n");
+		return 0;
+	}
+
+	combat_sim_headless_init();
+	rf = &racefleets[races[r].fleet];
+
+	for (g = 0; g < 2; g++)
+	{
+		cw->num_pships = ships/2;
+		for (c = 0; c < cw->num_pships; c++)
+			cw->pships[c] = 1 + c%3;
+		cw->num_eships = ships - cw->num_pships;
+		for (c = 0; c < cw->num_eships; c++)
+			cw->eships[c] = rf->stype[c%3];
+		cw->erace = r;
+		cw->eflt = 0;
+		cw->esystem = 0;
+		cw->grid_off = g;
+
+		res[g].wepdmg = NULL;
+		t0 = clock();
+		combat_headless(cw, ticks, seed, &res[g]);
+		secs = (float64)(clock()-t0) / CLOCKS_PER_SEC;
+
+		printf("%d ships, %s: %d ticks in %.2f s, %.1f ticks/sec\n", ships, g ? "full scan" : "grid",
+					 res[g].ticks, secs, secs > 0 ? res[g].ticks / secs : 0);
+	}
+	cw->grid_off = 0;
+
+	c = (res[0].winner == res[1].winner && res[0].ticks == res[1].ticks &&
+			 !memcmp(res[0].hits, res[1].hits, sizeof(res[0].hits)));
+	if (!c)
+		printf("grid and full scan battles differ!\n");
+
+	combat_freeworld(cw);
+	free(cw);
+
+	return c;
+}
+
+// time the projectile hit test on its own, the sqrt of each distance with
+// the radius looked up through shiptypes[] and hulls[] (as it used to be)
+// against squared distances to the packed grid_x/y/r. both run over the
+// same ships and projectiles, recorded every 10th tick of a benchmark
+// battle, and must pick the same ship for every projectile.
+int32 combat_hitbench(int32 ships, int32 ticks, int32 reps, int32 r, uint32 seed)
+{
+	t_combatworld *cw;
+	t_racefleet *rf;
+	t_hitframe *fr;
+	int32 *hit[2];
+	int32 numfr, maxfr, maxproj;
+	int32 c, f, k, n, bad;
+	clock_t t0;
+	float64 secs[2];
+
+	if (ships < 2 || ships > MAX_COMBAT_SHIPS || races[r].fleet == -1)
+	{
+		fprintf(stderr, "need 2 to %d ships and a race with a fleet\n", MAX_COMBAT_SHIPS);
+		return 0;
+	}
+
+	maxfr = ticks/10 + 1;
+	cw = (t_combatworld*)calloc(1, sizeof(t_combatworld));
+	fr = (t_hitframe*)calloc(maxfr, sizeof(t_hitframe));
+	if (!cw || !fr)
+	{
+		fprintf(stderr, "out of memory\n");
+		free(cw); free(fr);
+		return 0;
+	}
+
+	combat_sim_headless_init();
+	rf = &racefleets[races[r].fleet];
+
+	cw->num_pships = ships/2;
+	for (c = 0; c < cw->num_pships; c++)
+		cw->pships[c] = 1 + c%3;
+	cw->num_eships = ships - cw->num_pships;
+	for (c = 0; c < cw->num_eships; c++)
+		cw->eships[c] = rf->stype[c%3];
+	cw->erace = r;
+	cw->simulated = 1;
+	cw->headless = 1;
+	combat_start(cw, seed);
+
+	// same steps as combat_headless(), but it plays on once a side is gone
+	numfr = 0; maxproj = 0; n = 0;
+	for (cw->t_move = 1; cw->t_move <= ticks; cw->t_move++)
+	{
+		combat_checkescapes(cw, cw->t_move);
+		combat_movement(cw, cw->t_move);
+		combat_headless_update(cw, cw->t_move);
+		if (cw->t_move % 10)
+			continue;
+
+		if (!combat_hitrecord(cw, &fr[numfr]))
+		{
+			fprintf(stderr, "out of memory\n");
+			break;
+		}
+		maxproj = MAX(maxproj, fr[numfr].num);
+		n += fr[numfr].num;
+		numfr++;
+	}
+	cw->headless = 0;
+
+	hit[0] = (int32*)malloc(MAX(maxproj,1)*sizeof(int32));
+	hit[1] = (int32*)malloc(MAX(maxproj,1)*sizeof(int32));
+	bad = 0;
+	if (hit[0] && hit[1])
+	{
+		for (f = 0; f < numfr; f++)
+		{
+			combat_hitsqrt(&fr[f], hit[0]);
+			combat_hitpacked(&fr[f], hit[1]);
+			for (c = 0; c < fr[f].num; c++)
+				bad += (hit[0][c] != hit[1][c]);
+		}
+
+		for (k = 0; k < 2; k++)
+		{
+			t0 = clock();
+			for (c = 0; c < reps; c++)
+			for (f = 0; f < numfr; f++)
+			{
+				if (k)
+					combat_hitpacked(&fr[f], hit[1]);
+				else
+					combat_hitsqrt(&fr[f], hit[0]);
+			}
+			secs[k] = (float64)(clock()-t0) / CLOCKS_PER_SEC;
+		}
+
+		printf("%d ships, %d ticks recorded, %d projectiles x %d\n", ships, numfr, n, reps);
+		printf("sqrt: %.3f s, packed: %.3f s\n", secs[0], secs[1]);
+		if (bad)
+			printf("sqrt and packed hit tests differ for %d projectiles!\n", bad);
+	}
+	else
+	{
+		fprintf(stderr, "out of memory\n");
+		bad = 1;
+	}
+
+	free(hit[0]); free(hit[1]);
+	for (f = 0; f < numfr; f++)
+		free(fr[f].projs);
+	free(fr);
+	combat_freeworld(cw);
+	free(cw);
+
+	return !bad;
+}
+
+// ----------------
+// LOCAL FUNCTIONS
+// ----------------
+
+// list every simulator ship against every fleet of every race
+int32 combat_batch_matchups()
+{
+	int32 p, r, f;
+	int32 n;
+
+	n = 0;
+	for (r = race_none+1; r < num_races; r++)
+	if (races[r].fleet > -1)
+		n += racefleets[races[r].fleet].num_fleets * 3;
+
+	bt_nummatch = 0;
+	bt_match = (t_batchmatch*)calloc(MAX(n,1), sizeof(t_batchmatch));
+	if (!bt_match)
+	{
+		fprintf(stderr, "out of memory\n");
+		return 0;
+	}
+
+	for (p = 0; p < 3; p++)
+	for (r = race_none+1; r < num_races; r++)
+	if (races[r].fleet > -1)
+	for (f = 0; f < racefleets[races[r].fleet].num_fleets; f++)
+	{
+		bt_match[bt_nummatch].pship = p;
+		bt_match[bt_nummatch].race = r;
+		bt_match[bt_nummatch].fleet = f;
+		bt_match[bt_nummatch].wepdmg = (float64*)calloc(2*num_shipweapons, sizeof(float64));
+		if (!bt_match[bt_nummatch].wepdmg)
+		{
+			fprintf(stderr, "out of memory\n");
+			return 0;
+		}
+		bt_nummatch++;
+	}
+
+	return bt_nummatch;
+}
+
+void combat_batch_free()
+{
+	int32 c;
+
+	for (c = 0; c < bt_nummatch; c++)
+		free(bt_match[c].wepdmg);
+	free(bt_match);
+	bt_match = NULL;
+	bt_nummatch = 0;
+}
+
+// worker thread, takes battles off the shared counter until there are none
+// left. each thread has its own world so only the tallies need the lock.
+int combat_batch_thread(void *data)
+{
+	t_combatworld *cw;
+	t_combatresult res;
+	t_batchmatch *m;
+	int32 *wepdmg;
+	int32 j, c;
+
+	cw = (t_combatworld*)calloc(1, sizeof(t_combatworld));
+	wepdmg = (int32*)malloc(2*num_shipweapons*sizeof(int32));
+	if (!cw || !wepdmg)
+	{
+		fprintf(stderr, "out of memory\n");
+		free(cw); free(wepdmg);
+		return 1;
+	}
+
+	while (1)
+	{
+		SDL_mutexP(bt_lock);
+		j = bt_nextjob++;
+		SDL_mutexV(bt_lock);
+		if (j >= bt_nummatch*bt_battles)
+			break;
+
+		m = &bt_match[j / bt_battles];
+		memset(wepdmg, 0, 2*num_shipweapons*sizeof(int32));
+		res.wepdmg = wepdmg;
+		combat_sim_headless(cw, m->pship, NULL, 0, m->race, m->fleet, bt_maxticks, bt_seed+j, &res);
+
+		SDL_mutexP(bt_lock);
+		if (res.winner == 0)
+		{	m->won++; m->killticks += res.kill; }
+		else if (res.winner == 1)
+		{	m->lost++; m->killticks += res.kill; }
+		else
+			m->drawn++;
+		for (c = 0; c < 2*num_shipweapons; c++)
+			m->wepdmg[c] += wepdmg[c];
+		SDL_mutexV(bt_lock);
+	}
+
+	free(wepdmg);
+	combat_freeworld(cw);
+	free(cw);
+
+	return 0;
+}
+
+// results for bt_match[c]'s ship and race on difficulty dif, weighting
+// each fleet by how often the starmap picks it (c must hold fleet 0).
+// returns 0 if no battle was decided, leaving kill unset.
+int32 combat_batch_difficulty(int32 c, int32 dif, float64 *win, float64 *loss, float64 *kill)
+{
+	t_racefleet *rf;
+	t_batchmatch *m;
+	int32 k, f;
+	float64 n;
+
+	rf = &racefleets[races[bt_match[c].race].fleet];
+	*win = *loss = 0;
+	*kill = n = 0;
+	for (k = 0; k < 10; k++)
+	{
+		f = rf->diff[dif][k];
+		if (f < 0 || f >= rf->num_fleets)
+			continue;
+		m = &bt_match[c+f];
+		*win += (float64)m->won / bt_battles / 10;
+		*loss += (float64)m->lost / bt_battles / 10;
+		if (m->won + m->lost > 0)
+		{
+			*kill += m->killticks / (m->won+m->lost);
+			n++;
+		}
+	}
+	if (n == 0)
+		return 0;
+	*kill = *kill / n / COMBAT_FRAMERATE;
+	return 1;
+}
+
+// one row per matchup, then one per ship, race and difficulty weighted by
+// how often the starmap picks each fleet. times are in seconds, weapon
+// damage is per battle and lists the allied side's weapons first.
+void combat_batch_csv(FILE *out)
+{
+	t_batchmatch *m;
+	t_racefleet *rf;
+	int32 c, d, k, w;
+	float64 win, loss, kill;
+
+	fprintf(out, "ship,race,fleet,difficulty,composition,battles,win_rate,loss_rate,draw_rate,mean_time_to_kill,weapon_damage\n");
+
+	for (c = 0; c < bt_nummatch; c++)
+	{
+		m = &bt_match[c];
+		rf = &racefleets[races[m->race].fleet];
+		fprintf(out, "%s,%s,%d,,%d/%d/%d,%d,%.4f,%.4f,%.4f,",
+						shiptypes[m->pship+1].name, races[m->race].name, m->fleet,
+						rf->fleets[m->fleet][0], rf->fleets[m->fleet][1], rf->fleets[m->fleet][2],
+						bt_battles, (float64)m->won/bt_battles, (float64)m->lost/bt_battles, (float64)m->drawn/bt_battles);
+		if (m->won + m->lost > 0)
+			fprintf(out, "%.2f,", m->killticks/(m->won+m->lost)/COMBAT_FRAMERATE);
+		else
+			fprintf(out, ",");
+
+		d = 0;
+		for (w = 0; w < 2*num_shipweapons; w++)
+		if (m->wepdmg[w] > 0)
+		{
+			fprintf(out, "%s%s:%s:%.1f", d ? ";" : "", w < num_shipweapons ? "allied" : "enemy",
+							shipweapons[w%num_shipweapons].name, m->wepdmg[w]/bt_battles);
+			d = 1;
+		}
+		fprintf(out, "\n");
+	}
+
+	// matchups are grouped by ship and race, starting with fleet 0
+	for (c = 0; c < bt_nummatch; c++)
+	if (bt_match[c].fleet == 0)
+	for (d = 0; d < 3; d++)
+	{
+		k = combat_batch_difficulty(c, d, &win, &loss, &kill);
+		fprintf(out, "%s,%s,,%d,,%d,%.4f,%.4f,%.4f,",
+						shiptypes[bt_match[c].pship+1].name, races[bt_match[c].race].name, d,
+						bt_battles, win, loss, 1-win-loss);
+		if (k)
+			fprintf(out, "%.2f,\n", kill);
+		else
+			fprintf(out, ",\n");
+	}
+}
+
+void combat_batch_json(FILE *out)
+{
+	t_batchmatch *m;
+	t_racefleet *rf;
+	int32 c, d, k, w;
+	float64 win, loss, kill;
+
+	fprintf(out, "{\n\t\"seed\": %u,\n\t\"battles\": %d,\n\t\"maxticks\": %d,\n\t\"framerate\": %d,\n\t\"matchups\": [\n",
+					bt_seed, bt_battles, bt_maxticks, COMBAT_FRAMERATE);
+
+	for (c = 0; c < bt_nummatch; c++)
+	{
+		m = &bt_match[c];
+		rf = &racefleets[races[m->race].fleet];
+		fprintf(out, "\t\t{ \"ship\": \"%s\", \"race\": \"%s\", \"fleet\": %d, \"composition\": [%d, %d, %d],\n",
+						shiptypes[m->pship+1].name, races[m->race].name, m->fleet,
+						rf->fleets[m->fleet][0], rf->fleets[m->fleet][1], rf->fleets[m->fleet][2]);
+		fprintf(out, "\t\t  \"first_seed\": %u, \"won\": %d, \"lost\": %d, \"drawn\": %d, \"win_rate\": %.4f, ",
+						bt_seed + c*bt_battles, m->won, m->lost, m->drawn, (float64)m->won/bt_battles);
+		if (m->won + m->lost > 0)
+			fprintf(out, "\"mean_time_to_kill\": %.2f,\n", m->killticks/(m->won+m->lost)/COMBAT_FRAMERATE);
+		else
+			fprintf(out, "\"mean_time_to_kill\": null,\n");
+
+		fprintf(out, "\t\t  \"weapon_damage\": [");
+		d = 0;
+		for (w = 0; w < 2*num_shipweapons; w++)
+		if (m->wepdmg[w] > 0)
+		{
+			fprintf(out, "%s\n\t\t\t{ \"side\": \"%s\", \"weapon\": \"%s\", \"damage\": %.1f }", d ? "," : "",
+							w < num_shipweapons ? "allied" : "enemy", shipweapons[w%num_shipweapons].name, m->wepdmg[w]/bt_battles);
+			d = 1;
+		}
+		fprintf(out, " ] }%s\n", c < bt_nummatch-1 ? "," : "");
+	}
+
+	fprintf(out, "\t],\n\t\"difficulties\": [\n");
+	k = 0;
+	for (c = 0; c < bt_nummatch; c++)
+	if (bt_match[c].fleet == 0)
+	for (d = 0; d < 3; d++)
+	{
+		fprintf(out, "%s\t\t{ \"ship\": \"%s\", \"race\": \"%s\", \"difficulty\": %d, ", k ? ",\n" : "",
+						shiptypes[bt_match[c].pship+1].name, races[bt_match[c].race].name, d);
+		if (combat_batch_difficulty(c, d, &win, &loss, &kill))
+			fprintf(out, "\"win_rate\": %.4f, \"loss_rate\": %.4f, \"mean_time_to_kill\": %.2f }", win, loss, kill);
+		else
+			fprintf(out, "\"win_rate\": %.4f, \"loss_rate\": %.4f, \"mean_time_to_kill\": null }", win, loss);
+		k = 1;
+	}
+	fprintf(out, "\n\t]\n}\n");
+}
+
+// copy the live ships and projectiles, with the projectiles' sources
+// pointing into the copy. returns 0 if out of memory.
+int32 combat_hitrecord(t_combatworld *cw, t_hitframe *f)
+{
+	int32 c, p;
+
+	combat_buildgrid(cw);
+
+	f->t = cw->t_move;
+	memcpy(f->ships, cw->cships, sizeof(f->ships));
+	memcpy(f->x, cw->grid_x, sizeof(f->x));
+	memcpy(f->y, cw->grid_y, sizeof(f->y));
+	memcpy(f->r, cw->grid_r, sizeof(f->r));
+
+	f->num = 0;
+	f->projs = (t_wepproj*)malloc(MAX(cw->projs.num,1)*sizeof(t_wepproj));
+	if (!f->projs)
+		return 0;
+
+	for (c = 0; c < cw->projs.num; c++)
+	if (cw->cprojs[p = cw->projs.live[c]].wep)
+	{
+		f->projs[f->num] = cw->cprojs[p];
+		f->projs[f->num].src = &f->ships[cw->cprojs[p].src - cw->cships];
+		f->projs[f->num].dst = NULL;
+		f->num++;
+	}
+
+	return 1;
+}
+
+// the first ship each projectile hits, or -1. returns the number that hit.
+int32 combat_hitsqrt(t_hitframe *f, int32 *hit)
+{
+	t_wepproj *pr;
+	int32 c, p, a, n;
+
+	n = 0;
+	for (c = 0; c < f->num; c++)
+	{
+		pr = &f->projs[c];
+		hit[c] = -1;
+		for (p = 0; p < MAX_COMBAT_SHIPS; p++)
+		if (f->ships[p].type>-1 && (f->ships[p].own&1)!=(pr->src->own&1))
+		{
+			a = hulls[shiptypes[f->ships[p].type].hull].size>>1;
+			if (pr->wep->flags & wpfDisperse)
+			{
+				a += (2 + ((pr->wep->size-4) * (f->t - pr->str)) / (pr->end - pr->str))>>1;
+			}
+			if (pr->wep->flags & (wpfImplode | wpfNoclip))
+			{
+				a = -100;
+			}
+			if (get_distance( (f->ships[p].x>>10)-(pr->x>>10), (f->ships[p].y>>10)-(pr->y>>10) ) < a)
+			{
+				hit[c] = p;
+				n++;
+				break;
+			}
+		}
+	}
+
+	return n;
+}
+
+// the same, as combat_movement() does it now
+int32 combat_hitpacked(t_hitframe *f, int32 *hit)
+{
+	t_wepproj *pr;
+	int32 c, p, a, n;
+	int32 rd, dx, dy;
+
+	n = 0;
+	for (c = 0; c < f->num; c++)
+	{
+		pr = &f->projs[c];
+		hit[c] = -1;
+		if (pr->wep->flags & (wpfImplode | wpfNoclip))
+			continue;
+		rd = 0;
+		if ((pr->wep->flags & wpfDisperse) && pr->end > pr->str)
+			rd = (2 + ((pr->wep->size-4) * (f->t - pr->str)) / (pr->end - pr->str))>>1;
+
+		for (p = 0; p < MAX_COMBAT_SHIPS; p++)
+		if (f->ships[p].type>-1 && (f->ships[p].own&1)!=(pr->src->own&1))
+		{
+			a = f->r[p] + rd;
+			dx = f->x[p] - (pr->x>>10);
+			dy = f->y[p] - (pr->y>>10);
+			if (a > 0 && dx*dx + dy*dy < a*a)
+			{
+				hit[c] = p;
+				n++;
+				break;
+			}
+		}
+	}
+
+	return n;
+}
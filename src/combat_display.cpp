@@ -9,6 +9,7 @@
 #include <math.h>
 
 #include "typedefs.h"
+#include "rng.h"
 #include "iface_globals.h"
 #include "is_fileio.h"
 #include "gfx.h"
@@ -23,35 +24,35 @@
 // GLOBAL FUNCTIONS
 // ----------------
 
-void combat_autocamera(int32 t)
+void combat_autocamera(t_combatworld *cw, int32 t)
 {
 	int32 minx, maxx, miny, maxy;
 	int32 x,y,z;
 	int32 s;
-	int32 c;
+	int32 c, q;
 
 	minx=(30000)<<10; maxx=(-30000)<<10;
 	miny=(30000)<<10; maxy=(-30000)<<10;
 
 	for (c = 0; c < MAX_COMBAT_SHIPS; c++)
-	if (cships[c].type>-1 && cships[c].flee < 2)
+	if (cw->cships[c].type>-1 && cw->cships[c].flee < 2)
 	{
-		s = hulls[shiptypes[cships[c].type].hull].size << 9;
-		minx = MIN(minx, cships[c].x - s);
-		maxx = MAX(maxx, cships[c].x + s);
-		miny = MIN(miny, cships[c].y - s);
-		maxy = MAX(maxy, cships[c].y + s);
+		s = hulls[shiptypes[cw->cships[c].type].hull].size << 9;
+		minx = MIN(minx, cw->cships[c].x - s);
+		maxx = MAX(maxx, cw->cships[c].x + s);
+		miny = MIN(miny, cw->cships[c].y - s);
+		maxy = MAX(maxy, cw->cships[c].y + s);
 	}
-	for (c = 0; c < MAX_COMBAT_EXPLOS; c++)
-	if (cexplo[c].spr)
+	for (q = 0; q < cw->explos.num; q++)
+	if (cw->cexplo[c = cw->explos.live[q]].spr)
 	{
-		if (cexplo[c].cam)
+		if (cw->cexplo[c].cam)
 		{
-			s = cexplo[c].size << 9;
-			minx = MIN(minx, cexplo[c].x - s);
-			maxx = MAX(maxx, cexplo[c].x + s);
-			miny = MIN(miny, cexplo[c].y - s);
-			maxy = MAX(maxy, cexplo[c].y + s);
+			s = cw->cexplo[c].size << 9;
+			minx = MIN(minx, cw->cexplo[c].x - s);
+			maxx = MAX(maxx, cw->cexplo[c].x + s);
+			miny = MIN(miny, cw->cexplo[c].y - s);
+			maxy = MAX(maxy, cw->cexplo[c].y + s);
 		}
 	}
 
@@ -62,13 +63,13 @@ void combat_autocamera(int32 t)
 		c = MAX(maxx-minx, maxy-miny)>>10;
 		z = (256<<12)/c;
 
-		camera.x = (camera.x*15 + x)>>4;
-		camera.y = (camera.y*15 + y)>>4;
-		camera.z = (camera.z*15 + z)>>4;
+		cw->camera.x = (cw->camera.x*15 + x)>>4;
+		cw->camera.y = (cw->camera.y*15 + y)>>4;
+		cw->camera.z = (cw->camera.z*15 + z)>>4;
 	}
 }
 
-void combat_displayships()
+void combat_displayships(t_combatworld *cw)
 {
 	int32 s, t;
 	int32 bx, by, h;
@@ -85,29 +86,29 @@ void combat_displayships()
 
 	// check for klakar button
 
-	klak = klakavail;
+	klak = cw->klakavail;
 	for (s = 0; s < MAX_COMBAT_SHIPS; s++)
 	{
-		if (shiptypes[cships[s].type].race == 2)
+		if (shiptypes[cw->cships[s].type].race == 2)
 			klak = 2;
 	}
-	if (cships[playership].hits<=0)
+	if (cw->cships[cw->playership].hits<=0)
 		klak = 0;
 
 	// player ship selection
 
 	bx = 0; by = 0; h = 288;
 
-	s = camera.ship_sel;
+	s = cw->camera.ship_sel;
 	if (s==-1)
-	{	select_ship(0, t); s = 0; }
+	{	select_ship(cw, 0, t); s = 0; }
 
-	ty = cships[s].type;
+	ty = cw->cships[s].type;
 	if (ty == -1)
-	{ select_ship(0, t); s = 0; ty = player.ships[0]; }
+	{ select_ship(cw, 0, t); s = 0; ty = player.ships[0]; }
 
-	if (s == 0 && cships[s].type == -1)
-	{	camera.ship_sel = -1; camera.ship_trg = -1; }
+	if (s == 0 && cw->cships[s].type == -1)
+	{	cw->camera.ship_sel = -1; cw->camera.ship_trg = -1; }
 
 	if (ty>-1)
 		sprintf(top, "%s", shiptypes[ty].name);
@@ -120,22 +121,22 @@ void combat_displayships()
 	{
 		hull = &hulls[shiptypes[ty].hull];
 		ik_dsprite(screen, bx+16, by+40, hulls[shiptypes[ty].hull].silu, 2+(COMBAT_INTERFACE_COLOR<<8));
-		hp = MAX(0,cships[s].hits) * 100 / hulls[shiptypes[ty].hull].hits;
+		hp = MAX(0,cw->cships[s].hits) * 100 / hulls[shiptypes[ty].hull].hits;
 		ik_drawmeter(screen, bx+12, by+40, bx+15, by+166, 0, hp, COMBAT_INTERFACE_COLOR, 28);
-		if (cships[s].shld_type>-1)
+		if (cw->cships[s].shld_type>-1)
 		{
-			hp = (cships[s].shld * 100) / shipsystems[cships[s].shld_type].par[0];
+			hp = (cw->cships[s].shld * 100) / shipsystems[cw->cships[s].shld_type].par[0];
 			ik_drawmeter(screen, bx+144, by+40, bx+147, by+166, 0, hp, COMBAT_INTERFACE_COLOR, 92);
 		}
 		for (hp = 0; hp < hull->numh; hp++)
 		{
 			l = 0;
 			if (hull->hardpts[hp].type == hdpWeapon && shipsystems[shiptypes[ty].system[hp]].item>-1)
-				l=(cships[s].syshits[hp]>0);
+				l=(cw->cships[s].syshits[hp]>0);
 			if (hull->hardpts[hp].type == hdpEngine && shiptypes[ty].engine>-1)
-				l=3*(cships[s].syshits[shiptypes[ty].sys_eng]>0);
+				l=3*(cw->cships[s].syshits[shiptypes[ty].sys_eng]>0);
 			if (hull->hardpts[hp].type == hdpThruster && shiptypes[ty].thrust>-1)
-				l=2*(cships[s].syshits[shiptypes[ty].sys_thru]>0);
+				l=2*(cw->cships[s].syshits[shiptypes[ty].sys_thru]>0);
 
 			ik_dsprite(screen, bx + 8 + hull->hardpts[hp].x*2, by + 32 + hull->hardpts[hp].y*2,
 									spr_IFsystem->spr[hull->hardpts[hp].type * 4 + 1], 2+(l<<8));
@@ -148,11 +149,11 @@ void combat_displayships()
 		{
 			if (shipsystems[shiptypes[ty].system[sy]].item>-1)
 			{
-				if (cships[s].syshits[sy]==10)
+				if (cw->cships[s].syshits[sy]==10)
 					l = 4;
-				else if (cships[s].syshits[sy]>=5)
+				else if (cw->cships[s].syshits[sy]>=5)
 					l = 3;
-				else if (cships[s].syshits[sy]>0)
+				else if (cw->cships[s].syshits[sy]>0)
 					l = 1;
 				else
 					l = 0;
@@ -172,10 +173,10 @@ void combat_displayships()
 	for (y = 0; y < player.num_ships; y++)
 	{
 		l = 0;
-		if (cships[y].hits <= 0)
+		if (cw->cships[y].hits <= 0)
 			l = 1+(24<<8);
 		ik_drsprite(screen, bx+y*16+24, by+32, 0, 16, hulls[shiptypes[player.ships[y]].hull].sprite, l);
-		if (y == camera.ship_sel)
+		if (y == cw->camera.ship_sel)
 		{
 			l = (get_ik_timer(1)&31)>23;
 			ik_drsprite(screen, bx+y*16+24, by+32, 0, 16+l*2, spr_IFtarget->spr[8], 5+((8+l*7)<<8));
@@ -184,9 +185,9 @@ void combat_displayships()
 
 	// cloak button
 
-	if (cships[playership].clo_type>0 && cships[playership].hits>0)
+	if (cw->cships[cw->playership].clo_type>0 && cw->cships[cw->playership].hits>0)
 	{
-		if (!cships[playership].cloaked)
+		if (!cw->cships[cw->playership].cloaked)
 			interface_drawbutton(screen, bx, 288, 80, COMBAT_INTERFACE_COLOR, textstring[STR_COMBAT_CLOAK]);
 		else
 			interface_drawbutton(screen, bx, 288, 80, COMBAT_INTERFACE_COLOR, textstring[STR_COMBAT_UNCLOAK]);
@@ -196,9 +197,9 @@ void combat_displayships()
 
 	// gong button
 
-	if (gongavail == 2)	// available
+	if (cw->gongavail == 2)	// available
 		interface_drawbutton(screen, bx+80, 288, 80, COMBAT_INTERFACE_COLOR, textstring[STR_COMBAT_GONG]);
-	else if (gongavail == 1)	// used
+	else if (cw->gongavail == 1)	// used
 		interface_drawbutton(screen, bx+80, 288, 80, 1, textstring[STR_COMBAT_GONG]);
 	else	// none
 		interface_drawbutton(screen, bx+80, 288, 80, 0, "");
@@ -207,16 +208,16 @@ void combat_displayships()
 
 	f=0;
 	for (s=0;s<MAX_COMBAT_SHIPS;s++)
-	if (cships[s].hits>0 && cships[s].type>-1)
+	if (cw->cships[s].hits>0 && cw->cships[s].type>-1)
 	{
-		if ((cships[s].own&1)==0)
+		if ((cw->cships[s].own&1)==0)
 			f |= 1;
 		else
 			f |= 2;
 	}
-	if (cships[playership].hits > 0 && f > 1)
+	if (cw->cships[cw->playership].hits > 0 && f > 1)
 	{
-		if (!retreat)
+		if (!cw->retreat)
 			interface_drawbutton(screen, bx, 304, 80, COMBAT_INTERFACE_COLOR, textstring[STR_COMBAT_RETREAT]);
 		else
 			interface_drawbutton(screen, bx, 304, 80, 1, textstring[STR_COMBAT_RETREAT]);
@@ -245,11 +246,11 @@ void combat_displayships()
 
 	bx = 0; by = 320; h = 160;
 
-	s = camera.ship_trg;
+	s = cw->camera.ship_trg;
 	if (s==-1)
 		ty = -1;
 	else
-		ty = cships[s].type;
+		ty = cw->cships[s].type;
 
 	if (ty>-1)
 		sprintf(top, "%s", shiptypes[ty].name);
@@ -262,27 +263,27 @@ void combat_displayships()
 	{
 		hull = &hulls[shiptypes[ty].hull];
 		ik_dsprite(screen, bx+16, by+24, hulls[shiptypes[ty].hull].silu, 2+(COMBAT_INTERFACE_COLOR<<8));
-		if (cships[s].active > 1 || shiptypes[ty].race != race_unknown)
+		if (cw->cships[s].active > 1 || shiptypes[ty].race != race_unknown)
 		{
-			hp = MAX(0,cships[s].hits) * 100 / hulls[shiptypes[ty].hull].hits;
-			if (cships[s].active == 1 && cships[s].hits == 1)
+			hp = MAX(0,cw->cships[s].hits) * 100 / hulls[shiptypes[ty].hull].hits;
+			if (cw->cships[s].active == 1 && cw->cships[s].hits == 1)
 					hp = 100;
 
 			ik_drawmeter(screen, bx+12, by+24, bx+15, by+152, 0, hp, COMBAT_INTERFACE_COLOR, 28);
-			if (cships[s].shld_type>-1)
+			if (cw->cships[s].shld_type>-1)
 			{
-				hp = (cships[s].shld * 100) / shipsystems[cships[s].shld_type].par[0];
+				hp = (cw->cships[s].shld * 100) / shipsystems[cw->cships[s].shld_type].par[0];
 				ik_drawmeter(screen, bx+144, by+24, bx+147, by+152, 0, hp, COMBAT_INTERFACE_COLOR, 92);
 			}
 			for (hp = 0; hp < hull->numh; hp++)
 			{
 				l = 0;
 				if (hull->hardpts[hp].type == hdpWeapon)
-					l=(cships[s].syshits[hp]>0);
+					l=(cw->cships[s].syshits[hp]>0);
 				if (hull->hardpts[hp].type == hdpEngine)
-					l=3*(cships[s].syshits[shiptypes[ty].sys_eng]>0);
+					l=3*(cw->cships[s].syshits[shiptypes[ty].sys_eng]>0);
 				if (hull->hardpts[hp].type == hdpThruster)
-					l=2*(cships[s].syshits[shiptypes[ty].sys_thru]>0);
+					l=2*(cw->cships[s].syshits[shiptypes[ty].sys_thru]>0);
 				ik_dsprite(screen, bx + 8 + hull->hardpts[hp].x*2, by + 16 + hull->hardpts[hp].y*2,
 										spr_IFsystem->spr[hull->hardpts[hp].type * 4 + 1], 2+(l<<8));
 			}
@@ -292,9 +293,11 @@ void combat_displayships()
 
 }
 
-void combat_display(int32 t)
+// draw the battle. the camera, fleeing ships and expiring effects are
+// left to combat_headless_update(), which must have run for this tick.
+void combat_display(t_combatworld *cw, int32 t)
 {
-	int32 c;
+	int32 c, q;
 	int32 s;
 	int32 p;
 	int32 tx, ty;
@@ -308,8 +311,6 @@ void combat_display(int32 t)
 	int32 bab;
 	uint8	*draw, *src;
 
-	combat_autocamera(t);
-
 	bab = 0;
 	for (c = 0; c < player.num_items; c++)
 		if (itemtypes[player.items[c]].flag & device_torc)
@@ -321,12 +322,13 @@ void combat_display(int32 t)
 
 	// nebula background
 
-	if (nebula)
+	if (cw->nebula)
 	{
 
-		s = (4096<<12) / (camera.z+1) + (1<<13);
-		ty = sy = ((-camera.y<<1)-232*s)&0xffffff;
-		sx = ((camera.x<<1)-232*s)&0xffffff;
+		s = (4096<<12) / (cw->camera.z+1) + (1<<13);
+		ty = sy = ((-cw->camera.y<<1)-232*s)&0xffffff;
+		sx = ((cw->camera.x<<1)-232*s)&0xffffff;
+		ik_dirty(screen, 168, 8, 632, 476);
 		for (y = 8; y < 476; y++)
 		{
 			src=combatbg2->data+(combatbg2->pitch*(ty>>16));
@@ -349,31 +351,26 @@ void combat_display(int32 t)
 	}
 
 	// grid
-//x = camera.x + ((((ik_mouse_x - 400)<<12)/camera.z)<<10);
-	c = 3 + 63*simulated;
+//x = cw->camera.x + ((((ik_mouse_x - 400)<<12)/cw->camera.z)<<10);
+	c = 3 + 63*cw->simulated;
 
-	sy = (camera.y>>10) + ((-232<<12)/camera.z);
+	sy = (cw->camera.y>>10) + ((-232<<12)/cw->camera.z);
 	sy = (sy/250)*250 - 250;
-	ty = (camera.y>>10) + ((232<<12)/camera.z) + 250;
+	ty = (cw->camera.y>>10) + ((232<<12)/cw->camera.z) + 250;
 	for (; sy < ty; sy += 250)
 	{
-		y = cy - (((sy - (camera.y>>10)) * camera.z) >> 12);
+		y = cy - (((sy - (cw->camera.y>>10)) * cw->camera.z) >> 12);
 		if (y > cy - 232 && y < cy + 232)
 		{
-			draw = ik_image_pointer(screen, cx - 232, y);
-			for (x = 0; x < 464; x++)
-			{
-				*draw=gfx_addbuffer[(*draw) + (c<<8)];
-				draw++;
-			}
+			gfx_maprow(ik_image_pointer(screen, cx - 232, y), 464, gfx_addbuffer + (c<<8));
 		}
 	}
-	sx = (camera.x>>10) + ((-232<<12)/camera.z);
+	sx = (cw->camera.x>>10) + ((-232<<12)/cw->camera.z);
 	sx = (sx/250)*250 - 250;
-	tx = (camera.x>>10) + ((232<<12)/camera.z) + 250;
+	tx = (cw->camera.x>>10) + ((232<<12)/cw->camera.z) + 250;
 	for (; sx < tx; sx += 250)
 	{
-		x = cx + (((sx - (camera.x>>10)) * camera.z) >> 12);
+		x = cx + (((sx - (cw->camera.x>>10)) * cw->camera.z) >> 12);
 		if (x > cx - 232 && x < cx + 232)
 		{
 			draw = ik_image_pointer(screen, x, cy - 232);
@@ -386,40 +383,40 @@ void combat_display(int32 t)
 	}
 
 	// display list insertion
-	numships = 0;
+	cw->numships = 0;
 	for (c = 0; c < MAX_COMBAT_SHIPS; c++)
-	if ((cships[c].cloaked==0 || (t-cships[c].cloaktime<50 && cships[c].cloaktime>0)) || (cships[c].own==0 || bab))
-	if (cships[c].type > -1)
+	if ((cw->cships[c].cloaked==0 || (t-cw->cships[c].cloaktime<50 && cw->cships[c].cloaktime>0)) || (cw->cships[c].own==0 || bab))
+	if (cw->cships[c].type > -1)
 	{
-		sortship[numships] = c;
-		numships++;
+		cw->sortship[cw->numships] = c;
+		cw->numships++;
 	}
 	// sort display list
-	for (c = 0; c < numships; c++)
+	for (c = 0; c < cw->numships; c++)
 	{
 		s = c;
-		while (s > 0 && hulls[shiptypes[cships[sortship[s]].type].hull].size > hulls[shiptypes[cships[sortship[s-1]].type].hull].size)
+		while (s > 0 && hulls[shiptypes[cw->cships[cw->sortship[s]].type].hull].size > hulls[shiptypes[cw->cships[cw->sortship[s-1]].type].hull].size)
 		{
-			p = sortship[s-1];
-			sortship[s-1] = sortship[s];
-			sortship[s] = p;
+			p = cw->sortship[s-1];
+			cw->sortship[s-1] = cw->sortship[s];
+			cw->sortship[s] = p;
 			s--;
 		}
 	}
 
-	for (c = 0; c < numships; c++)
+	for (c = 0; c < cw->numships; c++)
 	{
-		s = sortship[c];
-		cships[s].ds_x = cx + ((((cships[s].x - camera.x)>>8) * camera.z) >> 14);
-		cships[s].ds_y = cy - ((((cships[s].y - camera.y)>>8) * camera.z) >> 14);
-		cships[s].ds_s = 	(hulls[shiptypes[cships[s].type].hull].size * camera.z) >> 12;
-		if (cships[s].own != 2 || t > klaktime+75)
+		s = cw->sortship[c];
+		cw->cships[s].ds_x = cx + ((((cw->cships[s].x - cw->camera.x)>>8) * cw->camera.z) >> 14);
+		cw->cships[s].ds_y = cy - ((((cw->cships[s].y - cw->camera.y)>>8) * cw->camera.z) >> 14);
+		cw->cships[s].ds_s = 	(hulls[shiptypes[cw->cships[s].type].hull].size * cw->camera.z) >> 12;
+		if (cw->cships[s].own != 2 || t > cw->klaktime+75)
 		{
-			if (simulated)
+			if (cw->simulated)
 			{
-				if (s == playership)
+				if (s == cw->playership)
 					l = 90;
-				else if (cships[s].own == 0)
+				else if (cw->cships[s].own == 0)
 					l = 74;
 				else
 					l = 26;
@@ -427,27 +424,27 @@ void combat_display(int32 t)
 			else
 				l = 15;
 
-			if (cships[s].cloaked)
+			if (cw->cships[s].cloaked)
 			{
-				if (t - cships[s].cloaktime < 50 && cships[s].cloaktime > 0)
-					l = 15 - (t-cships[s].cloaktime)*11/50;
+				if (t - cw->cships[s].cloaktime < 50 && cw->cships[s].cloaktime > 0)
+					l = 15 - (t-cw->cships[s].cloaktime)*11/50;
 				else
-					l = 4 + 4*(cships[s].own&1);
+					l = 4 + 4*(cw->cships[s].own&1);
 			}
-			else if (cships[s].clo_type && cships[s].cloaktime > 0)	// has uncloaked
+			else if (cw->cships[s].clo_type && cw->cships[s].cloaktime > 0)	// has uncloaked
 			{
-				if (t - cships[s].cloaktime < 50 && cships[s].cloaktime > 0)
-					l = 4 + (t-cships[s].cloaktime)*11/50;
+				if (t - cw->cships[s].cloaktime < 50 && cw->cships[s].cloaktime > 0)
+					l = 4 + (t-cw->cships[s].cloaktime)*11/50;
 				else
 					l = 15;
 			}
 
-			if (cships[s].teltime>0 && t < cships[s].teltime+32)	// zorg fold effect
+			if (cw->cships[s].teltime>0 && t < cw->cships[s].teltime+32)	// zorg fold effect
 			{
-				p = (t - cships[s].teltime);
+				p = (t - cw->cships[s].teltime);
 
-				x = cx + ((((cships[s].x + cships[s].tel_x - camera.x)>>8) * camera.z) >> 14);
-				y = cy - ((((cships[s].y + cships[s].tel_y - camera.y)>>8) * camera.z) >> 14);
+				x = cx + ((((cw->cships[s].x + cw->cships[s].tel_x - cw->camera.x)>>8) * cw->camera.z) >> 14);
+				y = cy - ((((cw->cships[s].y + cw->cships[s].tel_y - cw->camera.y)>>8) * cw->camera.z) >> 14);
 
 				if (p < 16)
 					l = p;
@@ -455,26 +452,26 @@ void combat_display(int32 t)
 					l = 31-p;
 
 				ik_dspriteline(screen,
-											cships[s].ds_x,
-											cships[s].ds_y,
+											cw->cships[s].ds_x,
+											cw->cships[s].ds_y,
 											x,
 											y,
-											(20 * camera.z) >> 12,
+											(20 * cw->camera.z) >> 12,
 											(-t*13)&31, 18,
 											spr_weapons->spr[1+(rand()&1)], 5 + (l << 8));
 
 				ik_drsprite(screen,
-										(cships[s].ds_x*(32-p)+x*p)>>5,
-										(cships[s].ds_y*(32-p)+y*p)>>5,
+										(cw->cships[s].ds_x*(32-p)+x*p)>>5,
+										(cw->cships[s].ds_y*(32-p)+y*p)>>5,
 										rand()&1023,
-										(64 * camera.z) >> 12,
+										(64 * cw->camera.z) >> 12,
 										spr_shockwave->spr[4], 4);
 				if (rand()&1)
 				ik_drsprite(screen,
-										(cships[s].ds_x*(32-p)+x*p)>>5,
-										(cships[s].ds_y*(32-p)+y*p)>>5,
+										(cw->cships[s].ds_x*(32-p)+x*p)>>5,
+										(cw->cships[s].ds_y*(32-p)+y*p)>>5,
 										rand()&1023,
-										(64 * camera.z) >> 12,
+										(64 * cw->camera.z) >> 12,
 										spr_shockwave->spr[4], 4);
 
 				if (p < 16)
@@ -482,81 +479,81 @@ void combat_display(int32 t)
 				else
 				{
 					l = p-16;
-					cships[s].ds_x = x;
-					cships[s].ds_y = y;
+					cw->cships[s].ds_x = x;
+					cw->cships[s].ds_y = y;
 				}
 			}
 
 
 			if (l == 15)
 				ik_drsprite(screen,
-										cships[s].ds_x,
-										cships[s].ds_y,
-										cships[s].a,
-										cships[s].ds_s,
-										hulls[shiptypes[cships[s].type].hull].sprite, 0);
+										cw->cships[s].ds_x,
+										cw->cships[s].ds_y,
+										cw->cships[s].a,
+										cw->cships[s].ds_s,
+										hulls[shiptypes[cw->cships[s].type].hull].sprite, 0);
 			else
 				ik_drsprite(screen,
-										cships[s].ds_x,
-										cships[s].ds_y,
-										cships[s].a,
-										cships[s].ds_s,
-										hulls[shiptypes[cships[s].type].hull].sprite, 5+(l<<8));
+										cw->cships[s].ds_x,
+										cw->cships[s].ds_y,
+										cw->cships[s].a,
+										cw->cships[s].ds_s,
+										hulls[shiptypes[cw->cships[s].type].hull].sprite, 5+(l<<8));
 		}
-		if (cships[s].own == 2)
+		if (cw->cships[s].own == 2)
 		{
-			if (t - klaktime < 75)
+			if (t - cw->klaktime < 75)
 			{
-				l = (t-klaktime)*15/75;
+				l = (t-cw->klaktime)*15/75;
 				ik_drsprite(screen,
-										cships[s].ds_x,
-										cships[s].ds_y,
-										cships[s].a,
-										((t-klaktime)*camera.z)>>12,
+										cw->cships[s].ds_x,
+										cw->cships[s].ds_y,
+										cw->cships[s].a,
+										((t-cw->klaktime)*cw->camera.z)>>12,
 										spr_shockwave->spr[4], 5+(l<<8));
 			}
-			else if (t - klaktime < 100)
+			else if (t - cw->klaktime < 100)
 			{
-				l = ((klaktime+100-t)*15) / 25;
+				l = ((cw->klaktime+100-t)*15) / 25;
 				ik_drsprite(screen,
-										cships[s].ds_x,
-										cships[s].ds_y,
-										cships[s].a,
-										(256*camera.z)>>12,
+										cw->cships[s].ds_x,
+										cw->cships[s].ds_y,
+										cw->cships[s].a,
+										(256*cw->camera.z)>>12,
 										spr_shockwave->spr[4], 5+(l<<8));
 			}
 		}
-		if (cships[s].shld_type > -1 && cships[s].shld>0 && t < cships[s].shld_time+32)
+		if (cw->cships[s].shld_type > -1 && cw->cships[s].shld>0 && t < cw->cships[s].shld_time+32)
 		{
-			p = shipsystems[cships[s].shld_type].par[0];
-			l = 15; //(cships[s].shld * 15) / p;
-			l = (l * (cships[s].shld_time+32-t))>>5;
+			p = shipsystems[cw->cships[s].shld_type].par[0];
+			l = 15; //(cw->cships[s].shld * 15) / p;
+			l = (l * (cw->cships[s].shld_time+32-t))>>5;
 			p = (p-1)/10; if (p>4) p=4;
 			ik_drsprite(screen,
-									cships[s].ds_x,
-									cships[s].ds_y,
+									cw->cships[s].ds_x,
+									cw->cships[s].ds_y,
 									rand()%1024,
-									cships[s].ds_s,
+									cw->cships[s].ds_s,
 									spr_shield->spr[p], 5+(l<<8));
 		}
 
 		// draw markers so you can see them from far
 		// triangles
-		if (cships[s].own==0)
+		if (cw->cships[s].own==0)
 			p = 72;
-		else if (cships[s].own==1)
+		else if (cw->cships[s].own==1)
 			p = 24;
 		else
 			p = 56;
-		if (cships[s].ds_s > 10)
-			p -= (cships[s].ds_s-10);
-		if (cships[s].ds_s < 18 && cships[s].escaped==0)
-		{
-			sz = cships[s].ds_s/2+2;
-			sx = cships[s].ds_x;
-			sy = cships[s].ds_y;
-			tx = sin1k[cships[s].a];
-			ty = cos1k[cships[s].a];
+		if (cw->cships[s].ds_s > 10)
+			p -= (cw->cships[s].ds_s-10);
+		if (cw->cships[s].ds_s < 18 && cw->cships[s].escaped==0)
+		{
+			sz = cw->cships[s].ds_s/2+2;
+			sx = cw->cships[s].ds_x;
+			sy = cw->cships[s].ds_y;
+			tx = sin1k[cw->cships[s].a];
+			ty = cos1k[cw->cships[s].a];
 			ik_drawline(screen,
 									sx - ((tx*sz*2+ty*sz*3)>>17), sy + ((ty*sz*2-tx*sz*3)>>17),
 									sx + ((tx*sz*4)>>17), sy - ((ty*sz*4)>>17),
@@ -570,100 +567,84 @@ void combat_display(int32 t)
 									sx - ((tx*sz*2-ty*sz*3)>>17), sy + ((ty*sz*2+tx*sz*3)>>17),
 									p, 0, 255, 1);
 		}
-//		ik_print(screen, font_6x8, cships[s].ds_x, cships[s].ds_y, 0, "%s", racename[shiptypes[cships[s].type].race]);
+//		ik_print(screen, font_6x8, cw->cships[s].ds_x, cw->cships[s].ds_y, 0, "%s", racename[shiptypes[cw->cships[s].type].race]);
 	}
 
-	for (c = 0; c < MAX_COMBAT_SHIPS; c++)
-		if (cships[c].type > -1 && cships[c].own == 1 && cships[c].flee == 2)
-		{
-			if (cships[c].ds_x+cships[c].ds_s < cx-240 ||
-					cships[c].ds_x-cships[c].ds_s > cx+240 ||
-					cships[c].ds_y+cships[c].ds_s < cy-240 ||
-					cships[c].ds_y-cships[c].ds_s > cy+240 ||
-					(cships[c].cloaked && t > cships[c].cloaktime+50))
-			{
-				combat_killship(c, t, 1);
-			}
-		}
-
-	for (c = 0; c < MAX_COMBAT_BEAMS; c++)
-	if (cbeams[c].wep)
+	for (q = 0; q < cw->beams.num; q++)
+	if (cw->cbeams[c = cw->beams.live[q]].wep)
 	{
-		if (cbeams[c].stg > -1)	// staged from projectile
+		if (cw->cbeams[c].stg > -1)	// staged from projectile
 		{
-			if (!cprojs[cbeams[c].stg].wep)
-			{
-				cbeams[c].wep = NULL;
+			if (!cw->cprojs[cw->cbeams[c].stg].wep)
 				continue;
-			}
-			sx = cprojs[cbeams[c].stg].x;
-			sy = cprojs[cbeams[c].stg].y;
+			sx = cw->cprojs[cw->cbeams[c].stg].x;
+			sy = cw->cprojs[cw->cbeams[c].stg].y;
 		}
 		else
 		{
-			combat_gethardpoint(cbeams[c].src, cbeams[c].stp, &sx, &sy);
+			combat_gethardpoint(cw->cbeams[c].src, cw->cbeams[c].stp, &sx, &sy);
 		}
-		if (cbeams[c].dst)
+		if (cw->cbeams[c].dst)
 		{
-			combat_gethardpoint(cbeams[c].dst, cbeams[c].dsp, &tx, &ty);
-			if (cbeams[c].wep->flags & wpfWiggle)
+			combat_gethardpoint(cw->cbeams[c].dst, cw->cbeams[c].dsp, &tx, &ty);
+			if (cw->cbeams[c].wep->flags & wpfWiggle)
 			{
-				l = (t-cbeams[c].str)*(cbeams[c].stp*5+30) + (cbeams[c].stp*160);
-				tx = tx + ((sin1k[l&1023]*hulls[shiptypes[cbeams[c].dst->type].hull].size)>>8);
-				ty = ty + ((cos1k[l&1023]*hulls[shiptypes[cbeams[c].dst->type].hull].size)>>8);
+				l = (t-cw->cbeams[c].str)*(cw->cbeams[c].stp*5+30) + (cw->cbeams[c].stp*160);
+				tx = tx + ((sin1k[l&1023]*hulls[shiptypes[cw->cbeams[c].dst->type].hull].size)>>8);
+				ty = ty + ((cos1k[l&1023]*hulls[shiptypes[cw->cbeams[c].dst->type].hull].size)>>8);
 			}
 		}
 		else
 		{
-			tx = sx + ((sin1k[cbeams[c].ang] * cbeams[c].len)>>6);
-			ty = sy + ((cos1k[cbeams[c].ang] * cbeams[c].len)>>6);
+			tx = sx + ((sin1k[cw->cbeams[c].ang] * cw->cbeams[c].len)>>6);
+			ty = sy + ((cos1k[cw->cbeams[c].ang] * cw->cbeams[c].len)>>6);
 		}
 
-		if (t+t < cbeams[c].str + cbeams[c].end)
+		if (t+t < cw->cbeams[c].str + cw->cbeams[c].end)
 		{
-			//l = ((t - cbeams[c].str)*24) / (cbeams[c].end - cbeams[c].str) + 3;
+			//l = ((t - cw->cbeams[c].str)*24) / (cw->cbeams[c].end - cw->cbeams[c].str) + 3;
 			l = 15;
 		}
 		else
 		{
-			l = ((cbeams[c].end - t)*24) / (cbeams[c].end - cbeams[c].str) + 3;
+			l = ((cw->cbeams[c].end - t)*24) / (cw->cbeams[c].end - cw->cbeams[c].str) + 3;
 		}
 		if (l < 2) l = 2;
 		if (l > 15) l = 15;
 		ik_dspriteline(screen,
-									cx + ((((sx - camera.x)>>8) * camera.z) >> 14),
-									cy - ((((sy - camera.y)>>8) * camera.z) >> 14),
-									cx + ((((tx - camera.x)>>8) * camera.z) >> 14),
-									cy - ((((ty - camera.y)>>8) * camera.z) >> 14),
-									(cbeams[c].wep->size * camera.z) >> 12,
+									cx + ((((sx - cw->camera.x)>>8) * cw->camera.z) >> 14),
+									cy - ((((sy - cw->camera.y)>>8) * cw->camera.z) >> 14),
+									cx + ((((tx - cw->camera.x)>>8) * cw->camera.z) >> 14),
+									cy - ((((ty - cw->camera.y)>>8) * cw->camera.z) >> 14),
+									(cw->cbeams[c].wep->size * cw->camera.z) >> 12,
 									(-t*13)&31, 18,
-									cbeams[c].wep->sprite, 5 + (l << 8));
+									cw->cbeams[c].wep->sprite, 5 + (l << 8));
 	}
 
-	for (c = 0; c < MAX_COMBAT_PROJECTILES; c++)
-	if (cprojs[c].wep)
+	for (q = 0; q < cw->projs.num; q++)
+	if (cw->cprojs[c = cw->projs.live[q]].wep)
 	{
 		l = 15;
-		p = cprojs[c].wep->flags;
+		p = cw->cprojs[c].wep->flags;
 		if (p & wpfDisperse)
 		{
-			sz = 4 + ((cprojs[c].wep->size-4) * (t - cprojs[c].str)) / (cprojs[c].end - cprojs[c].str);
-			l = 15 - (14 * (t - cprojs[c].str)) / (cprojs[c].end - cprojs[c].str);
-			if (cprojs[c].hits < cprojs[c].wep->damage)
+			sz = 4 + ((cw->cprojs[c].wep->size-4) * (t - cw->cprojs[c].str)) / (cw->cprojs[c].end - cw->cprojs[c].str);
+			l = 15 - (14 * (t - cw->cprojs[c].str)) / (cw->cprojs[c].end - cw->cprojs[c].str);
+			if (cw->cprojs[c].hits < cw->cprojs[c].wep->damage)
 			{	// fade as its hits go away
-				l = 1 + ((l-1)*cprojs[c].hits)/cprojs[c].wep->damage;
+				l = 1 + ((l-1)*cw->cprojs[c].hits)/cw->cprojs[c].wep->damage;
 			}
 		}
 		else if (p & wpfImplode)
 		{
-			if (t - cprojs[c].str < 32)
-				sz = (cprojs[c].wep->size * (t-cprojs[c].str)) >> 5;
+			if (t - cw->cprojs[c].str < 32)
+				sz = (cw->cprojs[c].wep->size * (t-cw->cprojs[c].str)) >> 5;
 			else
-				sz = cprojs[c].wep->size;
+				sz = cw->cprojs[c].wep->size;
 			if (sz < 1) sz = 1;
 		}
 		else
-		{	sz = cprojs[c].wep->size; }
+		{	sz = cw->cprojs[c].wep->size; }
 
 
 		if (p & wpfTrans)
@@ -672,176 +653,174 @@ void combat_display(int32 t)
 			a = 0;
 
 		ik_drsprite(screen,
-								cx + ((((cprojs[c].x - camera.x)>>8) * camera.z) >> 14),
-								cy - ((((cprojs[c].y - camera.y)>>8) * camera.z) >> 14),
-								cprojs[c].a,
-								(sz * camera.z) >> 12,
-								cprojs[c].wep->sprite, a);
+								cx + ((((cw->cprojs[c].x - cw->camera.x)>>8) * cw->camera.z) >> 14),
+								cy - ((((cw->cprojs[c].y - cw->camera.y)>>8) * cw->camera.z) >> 14),
+								cw->cprojs[c].a,
+								(sz * cw->camera.z) >> 12,
+								cw->cprojs[c].wep->sprite, a);
 		if (p & wpfImplode)
 			ik_drsprite(screen,
-									cx + ((((cprojs[c].x - camera.x)>>8) * camera.z) >> 14),
-									cy - ((((cprojs[c].y - camera.y)>>8) * camera.z) >> 14),
-									1023-cprojs[c].a,
-									(sz * camera.z) >> 12,
+									cx + ((((cw->cprojs[c].x - cw->camera.x)>>8) * cw->camera.z) >> 14),
+									cy - ((((cw->cprojs[c].y - cw->camera.y)>>8) * cw->camera.z) >> 14),
+									1023-cw->cprojs[c].a,
+									(sz * cw->camera.z) >> 12,
 									spr_shockwave->spr[4], a);
 
-//		if (t > cprojs[c].end)
-//			cprojs[c].wep = NULL;
+//		if (t > cw->cprojs[c].end)
+//			cw->cprojs[c].wep = NULL;
 	}
 
 	// check for fiery furies (gong)
 	for (c = 0; c < MAX_COMBAT_SHIPS; c++)
-	if (cships[c].bong_start > 0 && t > cships[c].bong_start+50 && t < cships[c].bong_end && cships[c].hits > 0 && cships[c].type > -1)
+	if (cw->cships[c].bong_start > 0 && t > cw->cships[c].bong_start+50 && t < cw->cships[c].bong_end && cw->cships[c].hits > 0 && cw->cships[c].type > -1)
 	{
 		for (l = 0; l < 5; l++)
 		{
-			p = (t-cships[c].bong_start-50);
+			p = (t-cw->cships[c].bong_start-50);
 			p = ((p+50)*(p+50)-2500) >> 6;
 			a = (205*l + p) & 1023;
-			sz = 2000*(cships[c].bong_end-t)/(cships[c].bong_end-cships[c].bong_start-50);
-			sx = cships[c].x + ((sin1k[a]*sz)>>6);
-			sy = cships[c].y + ((cos1k[a]*sz)>>6);
+			sz = 2000*(cw->cships[c].bong_end-t)/(cw->cships[c].bong_end-cw->cships[c].bong_start-50);
+			sx = cw->cships[c].x + ((sin1k[a]*sz)>>6);
+			sy = cw->cships[c].y + ((cos1k[a]*sz)>>6);
 			ik_drsprite(screen,
-									cx + ((((sx - camera.x)>>8) * camera.z) >> 14),
-									cy - ((((sy - camera.y)>>8) * camera.z) >> 14),
+									cx + ((((sx - cw->camera.x)>>8) * cw->camera.z) >> 14),
+									cy - ((((sy - cw->camera.y)>>8) * cw->camera.z) >> 14),
 									((t<<5)&1023),
-									(32 * camera.z) >> 12,
+									(32 * cw->camera.z) >> 12,
 									spr_weapons->spr[12], 4);
 		}
 	}
 
-	for (c = 0; c < MAX_COMBAT_EXPLOS; c++)
-	if (cexplo[c].spr)
+	for (q = 0; q < cw->explos.num; q++)
+	if (cw->cexplo[c = cw->explos.live[q]].spr)
 	{
-		if (!cexplo[c].zoom)
+		if (!cw->cexplo[c].zoom)
 		{
 			l = 15;
-			sz = cexplo[c].size;
+			sz = cw->cexplo[c].size;
 		}
 		else
 		{
-			l = 15 - (t - cexplo[c].str)*15/(cexplo[c].end-cexplo[c].str);
+			l = 15 - (t - cw->cexplo[c].str)*15/(cw->cexplo[c].end-cw->cexplo[c].str);
 			if (l<0) l=0;
-			if (cexplo[c].zoom == 1)
-				sz = (cexplo[c].size * (t - cexplo[c].str))/(cexplo[c].end-cexplo[c].str);
+			if (cw->cexplo[c].zoom == 1)
+				sz = (cw->cexplo[c].size * (t - cw->cexplo[c].str))/(cw->cexplo[c].end-cw->cexplo[c].str);
 			else
-				sz = cexplo[c].size;
+				sz = cw->cexplo[c].size;
 		}
-		a = (cexplo[c].a + (t - cexplo[c].str) * cexplo[c].va) & 1023;
-		if (cexplo[c].anim==-1)
+		a = (cw->cexplo[c].a + (t - cw->cexplo[c].str) * cw->cexplo[c].va) & 1023;
+		if (cw->cexplo[c].anim==-1)
 		{
-			p = (t - cexplo[c].str)*cexplo[c].spr->num/(cexplo[c].end-cexplo[c].str);
-			if (p >= cexplo[c].spr->num)
-				p = cexplo[c].spr->num - 1;
+			p = (t - cw->cexplo[c].str)*cw->cexplo[c].spr->num/(cw->cexplo[c].end-cw->cexplo[c].str);
+			if (p >= cw->cexplo[c].spr->num)
+				p = cw->cexplo[c].spr->num - 1;
 		}
-		else p = cexplo[c].anim;
+		else p = cw->cexplo[c].anim;
 
 		ik_drsprite(screen,
-								cx + ((((cexplo[c].x - camera.x)>>8) * camera.z) >> 14),
-								cy - ((((cexplo[c].y - camera.y)>>8) * camera.z) >> 14),
+								cx + ((((cw->cexplo[c].x - cw->camera.x)>>8) * cw->camera.z) >> 14),
+								cy - ((((cw->cexplo[c].y - cw->camera.y)>>8) * cw->camera.z) >> 14),
 								a,
-								(sz * camera.z) >> 12,
-								cexplo[c].spr->spr[p],
+								(sz * cw->camera.z) >> 12,
+								cw->cexplo[c].spr->spr[p],
 								5+(l<<8));
-		if (t > cexplo[c].end)
-			cexplo[c].spr = NULL;
 	}
 
-	if (camera.ship_sel > -1)
+	if (cw->camera.ship_sel > -1)
 	{
 		t = get_ik_timer(1);
 
-		s = camera.ship_sel;
-		if (t >= camera.time_sel + 40)
+		s = cw->camera.ship_sel;
+		if (t >= cw->camera.time_sel + 40)
 		{
 			l = 6;
-			p = MAX(cships[s].ds_s, 16);
-			a = cships[s].a;
+			p = MAX(cw->cships[s].ds_s, 16);
+			a = cw->cships[s].a;
 		}
 		else
 		{
-			l = 15 - ((t - camera.time_sel) >> 2);
-			p = cships[s].ds_s + ((cships[s].ds_s * (camera.time_sel + 40 - t))>>5);
-			a = (cships[s].a + (camera.time_sel + 40 - t)*16) & 1023;
+			l = 15 - ((t - cw->camera.time_sel) >> 2);
+			p = cw->cships[s].ds_s + ((cw->cships[s].ds_s * (cw->camera.time_sel + 40 - t))>>5);
+			a = (cw->cships[s].a + (cw->camera.time_sel + 40 - t)*16) & 1023;
 		}
 		ik_drsprite(screen,
-								cships[s].ds_x,
-								cships[s].ds_y,
+								cw->cships[s].ds_x,
+								cw->cships[s].ds_y,
 								a,
 								p,
 								spr_IFtarget->spr[8], 5+(l<<8));
-		if (t < camera.time_sel + 32)
+		if (t < cw->camera.time_sel + 32)
 		{
-			l = 15 - ((t - camera.time_sel) >> 1);
+			l = 15 - ((t - cw->camera.time_sel) >> 1);
 			ik_drsprite(screen,
-									cships[s].ds_x,
-									cships[s].ds_y,
+									cw->cships[s].ds_x,
+									cw->cships[s].ds_y,
 									a,
-									(cships[s].ds_s * (t - camera.time_sel))>>3,
+									(cw->cships[s].ds_s * (t - cw->camera.time_sel))>>3,
 									spr_IFtarget->spr[8], 5+(l<<8));
 		}
 
 		fr = 2;
-		s = cships[camera.ship_sel].target;
+		s = cw->cships[cw->camera.ship_sel].target;
 		if (s > -1)
 		{
-			camera.ship_trg = s;
-			if ((cships[camera.ship_sel].own&1) == (cships[s].own&1))
+			cw->camera.ship_trg = s;
+			if ((cw->cships[cw->camera.ship_sel].own&1) == (cw->cships[s].own&1))
 				fr = 1;
-			else if (cships[s].active==2)
+			else if (cw->cships[s].active==2)
 				fr = 0;
 			else
 				fr = 2;
 
-			if (cships[camera.ship_sel].cloaked && shiptypes[cships[s].type].race==race_unknown)
+			if (cw->cships[cw->camera.ship_sel].cloaked && shiptypes[cw->cships[s].type].race==race_unknown)
 				fr = 2;
 
-			if (t >= camera.time_trg + 40)
+			if (t >= cw->camera.time_trg + 40)
 			{
 				l = 6;
-				p = cships[s].ds_s;
-				a = cships[s].a;
+				p = cw->cships[s].ds_s;
+				a = cw->cships[s].a;
 			}
 			else
 			{
-				l = 15 - ((t - camera.time_trg) >> 2);
-				p = cships[s].ds_s + ((cships[s].ds_s * (camera.time_trg + 40 - t))>>5);
-				a = (cships[s].a + (camera.time_trg + 40 - t)*16) & 1023;
+				l = 15 - ((t - cw->camera.time_trg) >> 2);
+				p = cw->cships[s].ds_s + ((cw->cships[s].ds_s * (cw->camera.time_trg + 40 - t))>>5);
+				a = (cw->cships[s].a + (cw->camera.time_trg + 40 - t)*16) & 1023;
 			}
 
 			if (fr==2)	// "board"
-				ik_print(screen, font_6x8, cships[s].ds_x-15, cships[s].ds_y-cships[s].ds_s/2-12, 4, "BOARD");
+				ik_print(screen, font_6x8, cw->cships[s].ds_x-15, cw->cships[s].ds_y-cw->cships[s].ds_s/2-12, 4, "BOARD");
 
 			ik_drsprite(screen,
-									cships[s].ds_x,
-									cships[s].ds_y,
+									cw->cships[s].ds_x,
+									cw->cships[s].ds_y,
 									a,
-									MAX(cships[s].ds_s, 16),
+									MAX(cw->cships[s].ds_s, 16),
 									spr_IFtarget->spr[6+fr], 5+(l<<8));
-			if (t < camera.time_trg + 32)
+			if (t < cw->camera.time_trg + 32)
 			{
-				l = 15 - ((t - camera.time_trg) >> 1);
+				l = 15 - ((t - cw->camera.time_trg) >> 1);
 				ik_drsprite(screen,
-										cships[s].ds_x,
-										cships[s].ds_y,
+										cw->cships[s].ds_x,
+										cw->cships[s].ds_y,
 										a,
-										(cships[s].ds_s * (t - camera.time_trg))>>3,
+										(cw->cships[s].ds_s * (t - cw->camera.time_trg))>>3,
 										spr_IFtarget->spr[6+fr], 5+(l<<8));
 			}
 		}
-		if (!camera.drag_trg)
+		if (!cw->camera.drag_trg)
 		{
 			l = 4 + 3*((t & 31)>24);
-			p = cships[camera.ship_sel].dist;
+			p = cw->cships[cw->camera.ship_sel].dist;
 			if (s > -1)
 			{
-				x = cships[s].ds_x - ((((sin1k[cships[camera.ship_sel].angle] * p)>>16) * camera.z)>>12);
-				y = cships[s].ds_y + ((((cos1k[cships[camera.ship_sel].angle] * p)>>16) * camera.z)>>12);
+				x = cw->cships[s].ds_x - ((((sin1k[cw->cships[cw->camera.ship_sel].angle] * p)>>16) * cw->camera.z)>>12);
+				y = cw->cships[s].ds_y + ((((cos1k[cw->cships[cw->camera.ship_sel].angle] * p)>>16) * cw->camera.z)>>12);
 			}
 			else
 			{
-				x = cx + ((((cships[camera.ship_sel].wp_x - camera.x)>>8) * camera.z) >> 14);
-				y = cy - ((((cships[camera.ship_sel].wp_y - camera.y)>>8) * camera.z) >> 14);
+				x = cx + ((((cw->cships[cw->camera.ship_sel].wp_x - cw->camera.x)>>8) * cw->camera.z) >> 14);
+				y = cy - ((((cw->cships[cw->camera.ship_sel].wp_y - cw->camera.y)>>8) * cw->camera.z) >> 14);
 			}
 		}
 		else
@@ -851,36 +830,36 @@ void combat_display(int32 t)
 			y = ik_mouse_y;
 		}
 		if (s > -1)
-			a = get_distance(cships[s].ds_x-x, y-cships[s].ds_y);
-		if (s > -1 && a > (cships[s].ds_s>>1) )
+			a = get_distance(cw->cships[s].ds_x-x, y-cw->cships[s].ds_y);
+		if (s > -1 && a > (cw->cships[s].ds_s>>1) )
 		{
-			if (cships[camera.ship_sel].tac==0)
+			if (cw->cships[cw->camera.ship_sel].tac==0)
 			{
-				a = get_direction(x-cships[camera.ship_sel].ds_x, cships[camera.ship_sel].ds_y-y);
+				a = get_direction(x-cw->cships[cw->camera.ship_sel].ds_x, cw->cships[cw->camera.ship_sel].ds_y-y);
 				ik_dspriteline(screen,
-											cships[camera.ship_sel].ds_x,
-											cships[camera.ship_sel].ds_y,
+											cw->cships[cw->camera.ship_sel].ds_x,
+											cw->cships[cw->camera.ship_sel].ds_y,
 											x - (sin1k[a]>>13),
 											y + (cos1k[a]>>13),
 											8, (t&15), 16, spr_IFtarget->spr[fr*2], 5+(l<<8));
-				a = get_direction(cships[s].ds_x-x, y-cships[s].ds_y);
-				if ((cships[s].own&1) != (cships[camera.ship_sel].own&1))
+				a = get_direction(cw->cships[s].ds_x-x, y-cw->cships[s].ds_y);
+				if ((cw->cships[s].own&1) != (cw->cships[cw->camera.ship_sel].own&1))
 				{
 					ik_dspriteline(screen,
 												x + (sin1k[a]>>13),
 												y - (cos1k[a]>>13),
-												cships[s].ds_x,
-												cships[s].ds_y,
+												cw->cships[s].ds_x,
+												cw->cships[s].ds_y,
 												8, (t&15), 16, spr_IFtarget->spr[fr*2], 5+(l<<8));
 				}
 			}
 			else
 			{
 				ik_dspriteline(screen,
-											cships[camera.ship_sel].ds_x,
-											cships[camera.ship_sel].ds_y,
-											cships[s].ds_x,
-											cships[s].ds_y,
+											cw->cships[cw->camera.ship_sel].ds_x,
+											cw->cships[cw->camera.ship_sel].ds_y,
+											cw->cships[s].ds_x,
+											cw->cships[s].ds_y,
 											8, (t&15), 16, spr_IFtarget->spr[fr*2], 5+(l<<8));
 			}
 			ik_drsprite(screen,
@@ -894,8 +873,8 @@ void combat_display(int32 t)
 		{
 			if (s > -1)
 			{
-				x = cships[s].ds_x;
-				y = cships[s].ds_y;
+				x = cw->cships[s].ds_x;
+				y = cw->cships[s].ds_y;
 			}
 			else
 			ik_drsprite(screen,
@@ -906,8 +885,8 @@ void combat_display(int32 t)
 									spr_IFtarget->spr[fr+6], 5+(l<<8));
 
 			ik_dspriteline(screen,
-										cships[camera.ship_sel].ds_x,
-										cships[camera.ship_sel].ds_y,
+										cw->cships[cw->camera.ship_sel].ds_x,
+										cw->cships[cw->camera.ship_sel].ds_y,
 										x,
 										y,
 										8, (t&15), 16, spr_IFtarget->spr[fr*2], 5+(l<<8));
@@ -919,7 +898,7 @@ void combat_display(int32 t)
 											 0, COMBAT_INTERFACE_COLOR, textstring[STR_COMBAT_TITLE]);
 	// draw selected ships
 
-	combat_displayships();
+	combat_displayships(cw);
 
 
 	// pause button
@@ -927,15 +906,15 @@ void combat_display(int32 t)
 	ik_dsprite(screen, 186, 456, spr_IFbutton->spr[5], 2+(COMBAT_INTERFACE_COLOR<<8));
 	ik_dsprite(screen, 202, 456, spr_IFbutton->spr[6], 2+(COMBAT_INTERFACE_COLOR<<8));
 
-	ik_dsprite(screen, 177, 456, spr_IFbutton->spr[7+(g_pause!=1)], 2+(COMBAT_INTERFACE_COLOR<<8));
-	ik_dsprite(screen, 190, 456, spr_IFbutton->spr[9+(g_pause!=0)], 2+(COMBAT_INTERFACE_COLOR<<8));
-	ik_dsprite(screen, 199, 456, spr_IFbutton->spr[17+(g_pause!=-1)], 2+(COMBAT_INTERFACE_COLOR<<8));
+	ik_dsprite(screen, 177, 456, spr_IFbutton->spr[7+(cw->g_pause!=1)], 2+(COMBAT_INTERFACE_COLOR<<8));
+	ik_dsprite(screen, 190, 456, spr_IFbutton->spr[9+(cw->g_pause!=0)], 2+(COMBAT_INTERFACE_COLOR<<8));
+	ik_dsprite(screen, 199, 456, spr_IFbutton->spr[17+(cw->g_pause!=-1)], 2+(COMBAT_INTERFACE_COLOR<<8));
 
 	// race portraits
 	for (x = 1; x < player.num_ships; x++)
 	if (!(shiptypes[player.ships[x]].flag & 8))
 	{
-		if (cships[x].hits > 0)
+		if (cw->cships[x].hits > 0)
 			ik_dsprite(screen, 176+(x-1)*68, 24, spr_SMraces->spr[shiptypes[player.ships[x]].race], 0);
 		else
 			ik_drsprite(screen, 176+(x-1)*68+32, 24+32, 0, 64, spr_SMraces->spr[shiptypes[player.ships[x]].race], 1+(24<<8));
@@ -945,19 +924,19 @@ void combat_display(int32 t)
 	y = 0;
 	for (x = 0; x < MAX_COMBAT_SHIPS; x++)
 	{
-		if (cships[x].own==2 && cships[x].type>-1) // klakar
+		if (cw->cships[x].own==2 && cw->cships[x].type>-1) // klakar
 		{
-			if (cships[x].hits > 0)
-				ik_dsprite(screen, 176+(player.num_ships-1)*68, 24, spr_SMraces->spr[shiptypes[cships[x].type].race], 0);
+			if (cw->cships[x].hits > 0)
+				ik_dsprite(screen, 176+(player.num_ships-1)*68, 24, spr_SMraces->spr[shiptypes[cw->cships[x].type].race], 0);
 			else
-				ik_drsprite(screen, 176+(player.num_ships-1)*68+32, 24+32, 0, 64, spr_SMraces->spr[shiptypes[cships[x].type].race], 1+(24<<8));
+				ik_drsprite(screen, 176+(player.num_ships-1)*68+32, 24+32, 0, 64, spr_SMraces->spr[shiptypes[cw->cships[x].type].race], 1+(24<<8));
 			ik_dsprite(screen, 176+(player.num_ships-1)*68, 24, spr_IFborder->spr[18], 2+(3<<8));
 		}
-		else if (cships[x].own==1 && y==0)	// enemy
+		else if (cw->cships[x].own==1 && y==0)	// enemy
 		{
-			if (cships[x].type>-1 && shiptypes[cships[x].type].race < race_unknown)
+			if (cw->cships[x].type>-1 && shiptypes[cw->cships[x].type].race < race_unknown)
 			{
-				ik_dsprite(screen, 560, 24, spr_SMraces->spr[shiptypes[cships[x].type].race], 0);
+				ik_dsprite(screen, 560, 24, spr_SMraces->spr[shiptypes[cw->cships[x].type].race], 0);
 				ik_dsprite(screen,560, 24, spr_IFborder->spr[18], 2+(1<<8));
 				y = 1;
 			}
@@ -7,12 +7,14 @@
 #include <string.h>
 
 #include "typedefs.h"
+#include "rng.h"
 #include "iface_globals.h"
 #include "is_fileio.h"
 #include "gfx.h"
 #include "snd.h"
 #include "starmap.h"
 #include "combat.h"
+#include "gamedata.h"
 
 // ----------------
 //     CONSTANTS
@@ -33,6 +35,7 @@ const char *hull_keywords[hlkMax] =
 	"FTRB",
 	"END",
 };
+t_inikeys hull_keys = { hull_keywords, hlkMax };
 
 const char *shiptype_keywords[shkMax] =
 {
@@ -48,6 +51,7 @@ const char *shiptype_keywords[shkMax] =
 	"WEAP",
 	"END",
 };
+t_inikeys shiptype_keys = { shiptype_keywords, shkMax };
 
 const char *shipweapon_keywords[wpkMax] =
 {
@@ -66,6 +70,7 @@ const char *shipweapon_keywords[wpkMax] =
 	"RANG",
 	"END",
 };
+t_inikeys shipweapon_keys = { shipweapon_keywords, wpkMax };
 
 const char *shipweapon_flagwords[wpfMax] =
 {
@@ -95,6 +100,7 @@ const char *shipsystem_keywords[sykMax] =
 	"PAR4",
 	"END",
 };
+t_inikeys shipsystem_keys = { shipsystem_keywords, sykMax };
 
 const char *race_keywords[rckMax] =
 {
@@ -104,6 +110,7 @@ const char *race_keywords[rckMax] =
 	"TXT2",
 	"END",
 };
+t_inikeys race_keys = { race_keywords, rckMax };
 
 // ----------------
 // GLOBAL VARIABLES
@@ -163,8 +170,11 @@ void combat_deinitsprites();
 
 void combat_init()
 {
-	initraces();
 	combat_initsprites();
+	if (gamedata_usecache && gamedata_load())
+		return;
+
+	initraces();
 	combat_initshipweapons();
 	combat_initshipsystems();
 	combat_inithulls();
@@ -173,6 +183,7 @@ void combat_init()
 
 void combat_deinit()
 {
+	combat_freeworld(&combat_world);
 	combat_deinitshiptypes();
 	combat_deinithulls();
 	combat_deinitshipweapons();
@@ -186,44 +197,38 @@ void combat_deinit()
 
 void combat_inithulls()
 {
-	FILE* ini;
-	char s1[64], s2[256];
-	char end;
+	t_inifile *ini;
+	char *s1, *s2;
+	int32 ln;
 	int num;
 	int flag;
-	int n, com;
+	int com;
 
 	char ts1[64];
 	int tv1, tv2, tv3, tv4, tv5;
 
-	ini = myopen("gamedata/hulls.ini", "rb");
+	ini = ini_open("gamedata/hulls.ini", 1);
 	if (!ini)
 		return;
 
-	end = 0; num = 0;
-	while (!end)
+	num = 0;
+	for (ln = 0; ln < ini->num; ln++)
 	{
-		end = read_line(ini, s1, s2);
+		s1 = ini->line[ln].key;
 		if (!strcmp(s1, hull_keywords[hlkBegin]))
 			num++;
 	}
-	fclose(ini);
 
 	hulls = (t_hull*)calloc(num, sizeof(t_hull));
 	if (!hulls)
-		return;
+	{ ini_close(ini); return; }
 	num_hulls = num;
 
-	ini = myopen("gamedata/hulls.ini", "rb");
-
-	end = 0; num = 0; flag = 0;
-	while (!end)
+	num = 0; flag = 0;
+	for (ln = 0; ln < ini->num; ln++)
 	{
-		end = read_line(ini, s1, s2);
-		com = -1;
-		for (n = 0; n < hlkMax; n++)
-			if (!strcmp(s1, hull_keywords[n]))
-				com = n;
+		s1 = ini->line[ln].key; s2 = ini->line[ln].par;
+		com = ini_keyword(&hull_keys, &ini->line[ln]);
 
 		if (flag == 0)
 		{
@@ -286,7 +291,7 @@ void combat_inithulls()
 		}
 
 	}
-	fclose(ini);
+	ini_close(ini);
 }
 
 void combat_deinithulls()
@@ -297,22 +302,22 @@ void combat_deinithulls()
 
 void combat_initshiptypes()
 {
-	FILE* ini;
-	char s1[64], s2[256];
-	char end;
+	t_inifile *ini;
+	char *s1, *s2;
+	int32 ln;
 	int num;
 	int flag;
 	int n, com;
 
-	ini = myopen("gamedata/ships.ini", "rb");
+	ini = ini_open("gamedata/ships.ini", 1);
 	if (!ini)
 		return;
 
-	end = 0; num = 0;
+	num = 0;
 	flag = 0; num_enemies = 0;
-	while (!end)
+	for (ln = 0; ln < ini->num; ln++)
 	{
-		end = read_line(ini, s1, s2);
+		s1 = ini->line[ln].key; s2 = ini->line[ln].par;
 		if (!strcmp(s1, shiptype_keywords[shkBegin]))
 			num++;
 		if (!strcmp(s1, "ENEMIES"))
@@ -334,23 +339,17 @@ void combat_initshiptypes()
 		}
 
 	}
-	fclose(ini);
 
 	shiptypes = (t_shiptype*)calloc(num, sizeof(t_shiptype));
 	if (!shiptypes)
-		return;
+	{ ini_close(ini); return; }
 	num_shiptypes = num;
 
-	ini = myopen("gamedata/ships.ini", "rb");
-
-	end = 0; num = 0; flag = 0;
-	while (!end)
+	num = 0; flag = 0;
+	for (ln = 0; ln < ini->num; ln++)
 	{
-		end = read_line(ini, s1, s2);
-		com = -1;
-		for (n = 0; n < shkMax; n++)
-			if (!strcmp(s1, shiptype_keywords[n]))
-				com = n;
+		s1 = ini->line[ln].key; s2 = ini->line[ln].par;
+		com = ini_keyword(&shiptype_keys, &ini->line[ln]);
 
 		if (flag == 0)
 		{
@@ -433,7 +432,7 @@ void combat_initshiptypes()
 		}
 
 	}
-	fclose(ini);
+	ini_close(ini);
 }
 
 void combat_deinitshiptypes()
@@ -444,9 +443,9 @@ void combat_deinitshiptypes()
 
 void combat_initshipweapons()
 {
-	FILE* ini;
-	char s1[64], s2[256];
-	char end;
+	t_inifile *ini;
+	char *s1, *s2;
+	int32 ln;
 	int num;
 	int flag;
 	int n, com;
@@ -455,34 +454,28 @@ void combat_initshipweapons()
 	char ts[4][64];
 	int tv1, tv2;
 
-	ini = myopen("gamedata/weapons.ini", "rb");
+	ini = ini_open("gamedata/weapons.ini", 1);
 	if (!ini)
 		return;
 
-	end = 0; num = 0;
-	while (!end)
+	num = 0;
+	for (ln = 0; ln < ini->num; ln++)
 	{
-		end = read_line(ini, s1, s2);
+		s1 = ini->line[ln].key;
 		if (!strcmp(s1, shipweapon_keywords[wpkBegin]))
 			num++;
 	}
-	fclose(ini);
 
 	shipweapons = (t_shipweapon*)calloc(num, sizeof(t_shipweapon));
 	if (!shipweapons)
-		return;
+	{ ini_close(ini); return; }
 	num_shipweapons = num;
 
-	ini = myopen("gamedata/weapons.ini", "rb");
-
-	end = 0; num = 0; flag = 0;
-	while (!end)
+	num = 0; flag = 0;
+	for (ln = 0; ln < ini->num; ln++)
 	{
-		end = read_line(ini, s1, s2);
-		com = -1;
-		for (n = 0; n < wpkMax; n++)
-			if (!strcmp(s1, shipweapon_keywords[n]))
-				com = n;
+		s1 = ini->line[ln].key; s2 = ini->line[ln].par;
+		com = ini_keyword(&shipweapon_keys, &ini->line[ln]);
 
 		if (flag == 0)
 		{
@@ -573,7 +566,7 @@ void combat_initshipweapons()
 		}
 
 	}
-	fclose(ini);
+	ini_close(ini);
 }
 
 void combat_deinitshipweapons()
@@ -584,9 +577,9 @@ void combat_deinitshipweapons()
 
 void combat_initshipsystems()
 {
-	FILE* ini;
-	char s1[64], s2[256];
-	char end;
+	t_inifile *ini;
+	char *s1, *s2;
+	int32 ln;
 	int num;
 	int flag;
 	int n = 0;
@@ -596,15 +589,15 @@ void combat_initshipsystems()
 	char systype[16][32];
 	int32 num_systypes;
 
-	ini = myopen("gamedata/systems.ini", "rb");
+	ini = ini_open("gamedata/systems.ini", 1);
 	if (!ini)
 		return;
 
-	end = 0; num = 0;
+	num = 0;
 	flag = 0; num_systypes = 0;
-	while (!end)
+	for (ln = 0; ln < ini->num; ln++)
 	{
-		end = read_line(ini, s1, s2);
+		s1 = ini->line[ln].key; s2 = ini->line[ln].par;
 		if (!strcmp(s1, shipsystem_keywords[sykBegin]))
 			num++;
 		if (!strcmp(s1, "SYSTEMTYPES"))
@@ -619,23 +612,17 @@ void combat_initshipsystems()
 		}
 
 	}
-	fclose(ini);
 
 	shipsystems = (t_shipsystem*)calloc(num, sizeof(t_shipsystem));
 	if (!shipsystems)
-		return;
+	{ ini_close(ini); return; }
 	num_shipsystems = num;
 
-	ini = myopen("gamedata/systems.ini", "rb");
-
-	end = 0; num = 0; flag = 0;
-	while (!end)
+	num = 0; flag = 0;
+	for (ln = 0; ln < ini->num; ln++)
 	{
-		end = read_line(ini, s1, s2);
-		com = -1;
-		for (n = 0; n < sykMax; n++)
-			if (!strcmp(s1, shipsystem_keywords[n]))
-				com = n;
+		s1 = ini->line[ln].key; s2 = ini->line[ln].par;
+		com = ini_keyword(&shipsystem_keys, &ini->line[ln]);
 
 		if (flag == 0)
 		{
@@ -686,7 +673,7 @@ void combat_initshipsystems()
 		}
 
 	}
-	fclose(ini);
+	ini_close(ini);
 }
 
 void combat_deinitshipsystems()
@@ -837,25 +824,22 @@ void combat_deinitsprites()
 
 void initraces(void)
 {
-	FILE* ini;
-	char s1[64], s2[256];
-	char end;
+	t_inifile *ini;
+	char *s2;
+	int32 ln;
 	int num;
 	int flag;
-	int n, com;
+	int com;
 
-	ini = myopen("gamedata/races.ini", "rb");
+	ini = ini_open("gamedata/races.ini", 1);
 	if (!ini)
 		return;
 
-	end = 0; num = 0; flag = 0;
-	while (!end)
+	num = 0; flag = 0;
+	for (ln = 0; ln < ini->num; ln++)
 	{
-		end = read_line(ini, s1, s2);
-		com = -1;
-		for (n = 0; n < rckMax; n++)
-			if (!strcmp(s1, race_keywords[n]))
-				com = n;
+		s2 = ini->line[ln].par;
+		com = ini_keyword(&race_keys, &ini->line[ln]);
 
 		if (flag == 0)
 		{
@@ -888,7 +872,7 @@ void initraces(void)
 
 	}
 	num_races = num;
-	fclose(ini);
+	ini_close(ini);
 }
 
 void sort_shiptype_systems(int32 num)
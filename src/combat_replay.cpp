@@ -0,0 +1,306 @@
+// ----------------
+//     INCLUDES
+// ----------------
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "typedefs.h"
+#include "rng.h"
+#include "is_fileio.h"
+#include "iface_globals.h"
+#include "gfx.h"
+#include "snd.h"
+
+#include "combat.h"
+
+// ----------------
+//		CONSTANTS
+// ----------------
+
+#define COMBAT_REPLAY_FILE "lastcombat.rpl"
+
+// ----------------
+// GLOBAL VARIABLES
+// ----------------
+
+char					combat_replayfile[256];
+int32					combat_replayevery;
+
+FILE					*rp_out;		// recording of the battle on screen
+t_combatevent	rp_frame;		// run of identical frames not written yet
+
+// ----------------
+// LOCAL PROTOTYPES
+// ----------------
+
+void combat_recwrite(t_combatevent *ev);
+
+// ----------------
+// GLOBAL FUNCTIONS
+// ----------------
+
+// start recording the battle combat() is about to fight. the file is
+// rewritten every battle and flushed as it goes, so it survives a crash.
+void combat_recstart(t_combatworld *cw, uint32 seed)
+{
+	t_combatreplay hdr;
+	int32 s;
+
+	rp_frame.ship = 0;
+	rp_out = fopen(COMBAT_REPLAY_FILE, "wb");
+	if (!rp_out)
+	{
+		fprintf(stderr, "unable to record %s\n", COMBAT_REPLAY_FILE);
+		return;
+	}
+
+	memset(&hdr, 0, sizeof(t_combatreplay));
+	memcpy(hdr.magic, "SRPL", 4);
+	hdr.version = COMBAT_REPLAY_VERSION;
+	strcpy(hdr.moddir, moddir);
+	hdr.seed = seed;
+	hdr.simulated = cw->simulated;
+	hdr.nebula = cw->nebula;
+	hdr.klakavail = cw->klakavail;
+	hdr.gongavail = cw->gongavail;
+	hdr.smoketrails = settings.opt_smoketrails;
+	hdr.lensflares = settings.opt_lensflares;
+	hdr.num_pships = cw->num_pships;
+	for (s = 0; s < cw->num_pships; s++)
+		hdr.pships[s] = cw->pships[s];
+	hdr.num_eships = cw->num_eships;
+	for (s = 0; s < cw->num_eships; s++)
+		hdr.eships[s] = cw->eships[s];
+	hdr.erace = cw->erace;
+	hdr.eflt = cw->eflt;
+	hdr.esystem = cw->esystem;
+	hdr.num_shiptypes = num_shiptypes;
+
+	fwrite(&hdr, sizeof(t_combatreplay), 1, rp_out);
+	fwrite(shiptypes, sizeof(t_shiptype), num_shiptypes, rp_out);
+	fflush(rp_out);
+}
+
+// record a player command and carry it out, on the tick it's applied
+void combat_reccommand(t_combatworld *cw, t_combatevent *ev)
+{
+	ev->tick = cw->t_move;
+
+	if (rp_out)
+	{
+		combat_recwrite(&rp_frame);
+		combat_recwrite(ev);
+		fflush(rp_out);
+	}
+
+	combat_applyevent(cw, ev);
+}
+
+// record a frame of combat(): escapes checked, zoom keys, ticks run and
+// whether the display state was updated. the sim thread records one per
+// tick and most are the same, so they are kept as runs, at most a second
+// long so little is lost in a crash.
+void combat_recframe(t_combatworld *cw, int32 ticks, int32 disp, int32 zoom)
+{
+	if (!rp_out)
+		return;
+
+	if (rp_frame.ship > 0 && rp_frame.par[0] == ticks && rp_frame.par[1] == disp && rp_frame.par[2] == zoom)
+	{
+		rp_frame.ship++;
+	}
+	else
+	{
+		combat_recwrite(&rp_frame);
+		rp_frame.tick = cw->t_move - ticks;
+		rp_frame.type = cev_frame;
+		rp_frame.ship = 1;
+		rp_frame.par[0] = ticks;
+		rp_frame.par[1] = disp;
+		rp_frame.par[2] = zoom;
+	}
+
+	if (rp_frame.ship == COMBAT_FRAMERATE)
+	{
+		combat_recwrite(&rp_frame);
+		fflush(rp_out);
+	}
+}
+
+void combat_recend()
+{
+	if (!rp_out)
+		return;
+
+	combat_recwrite(&rp_frame);
+	fclose(rp_out);
+	rp_out = NULL;
+}
+
+// point moddir at the mod a replay was recorded with,
+// before the game data is loaded
+int32 combat_replaymod(const char *fname)
+{
+	FILE *in;
+	t_combatreplay hdr;
+	int32 ok;
+
+	in = fopen(fname, "rb");
+	if (!in)
+	{
+		fprintf(stderr, "unable to open %s\n", fname);
+		return 0;
+	}
+
+	ok = (fread(&hdr, sizeof(t_combatreplay), 1, in) == 1 && !memcmp(hdr.magic, "SRPL", 4) && hdr.version == COMBAT_REPLAY_VERSION);
+	fclose(in);
+	if (!ok)
+	{
+		fprintf(stderr, "%s is not a combat replay\n", fname);
+		return 0;
+	}
+
+	strcpy(moddir, hdr.moddir);
+	return 1;
+}
+
+// fight a recorded battle again, as fast as it will go. every > 0 draws
+// a frame each time that many ticks have passed, 0 runs with no display
+// or sound. res gets the outcome, like combat_headless().
+int32 combat_replay(const char *fname, int32 every, t_combatresult *res)
+{
+	FILE *in;
+	t_combatreplay hdr;
+	t_combatevent ev;
+	t_combatworld *cw = &combat_world;
+	int32 s, n, r;
+	int32 drawn, sync;
+	int8 smoketrails, lensflares;
+
+	in = fopen(fname, "rb");
+	if (!in)
+	{
+		fprintf(stderr, "unable to open %s\n", fname);
+		return 0;
+	}
+
+	if (fread(&hdr, sizeof(t_combatreplay), 1, in) != 1 || memcmp(hdr.magic, "SRPL", 4) || hdr.version != COMBAT_REPLAY_VERSION)
+	{
+		fprintf(stderr, "%s is not a combat replay\n", fname);
+		fclose(in);
+		return 0;
+	}
+	if (hdr.num_shiptypes != num_shiptypes ||
+			fread(shiptypes, sizeof(t_shiptype), num_shiptypes, in) != (size_t)num_shiptypes)
+	{
+		fprintf(stderr, "%s was recorded with different game data\n", fname);
+		fclose(in);
+		return 0;
+	}
+
+	cw->simulated = hdr.simulated;
+	cw->headless = (every < 1);
+	cw->num_pships = hdr.num_pships;
+	for (s = 0; s < hdr.num_pships; s++)
+		cw->pships[s] = hdr.pships[s];
+	cw->num_eships = hdr.num_eships;
+	for (s = 0; s < hdr.num_eships; s++)
+		cw->eships[s] = hdr.eships[s];
+	cw->erace = hdr.erace;
+	cw->eflt = hdr.eflt;
+	cw->esystem = hdr.esystem;
+
+	// effects draw on the battle's rng, so these must be as recorded
+	smoketrails = settings.opt_smoketrails;
+	lensflares = settings.opt_lensflares;
+	settings.opt_smoketrails = hdr.smoketrails;
+	settings.opt_lensflares = hdr.lensflares;
+
+	combat_start(cw, hdr.seed);
+	cw->wepdmg = res->wepdmg;
+	cw->nebula = hdr.nebula;
+	cw->klakavail = hdr.klakavail;
+	cw->gongavail = hdr.gongavail;
+	cw->t_move = 0; cw->t_disp = 0; cw->g_pause = 0; cw->rett = 0;
+
+	for (s = 0; s < MAX_COMBAT_SHIPS; s++)
+		res->type[s] = cw->cships[s].type;
+
+	drawn = -every; sync = 1;
+	while (!must_quit && fread(&ev, sizeof(t_combatevent), 1, in) == 1)
+	{
+		if (ev.tick != cw->t_move && sync)
+		{
+			fprintf(stderr, "replay out of step at tick %d (recorded %d)\n", cw->t_move, ev.tick);
+			sync = 0;
+		}
+
+		if (ev.type != cev_frame)
+		{
+			combat_applyevent(cw, &ev);
+			continue;
+		}
+
+		// same steps as a frame of combat()
+		for (n = 0; n < ev.ship && !must_quit; n++)
+		{
+			combat_checkescapes(cw, cw->t_move);
+			cw->camera.z += ev.par[2];
+
+			for (r = 0; r < ev.par[0]; r++)
+			{
+				cw->t_move++;
+				combat_movement(cw, cw->t_move);
+				for (s = 0; s < MAX_COMBAT_SHIPS; s++)
+					if (cw->cships[s].type > -1)
+						res->type[s] = cw->cships[s].type;
+			}
+
+			if (!ev.par[1])
+				continue;
+
+			cw->t_disp = cw->t_move;
+			combat_headless_update(cw, cw->t_disp);
+			if (every > 0 && cw->t_move >= drawn + every)
+			{
+				drawn = cw->t_move;
+				ik_eventhandler();
+				prep_screen();
+				ik_drawbox(screen, 0, 0, 640, 480, 0);
+				combat_display(cw, cw->t_disp);
+				ik_blit();
+			}
+		}
+	}
+	fclose(in);
+
+	settings.opt_smoketrails = smoketrails;
+	settings.opt_lensflares = lensflares;
+
+	combat_result(cw, res);
+	res->kill = 0;
+
+	if (!cw->headless)
+		Stop_All_Sounds();
+	cw->headless = 0;
+	cw->wepdmg = NULL;
+
+	return 1;
+}
+
+// ----------------
+// LOCAL FUNCTIONS
+// ----------------
+
+// write ev if it holds anything, pending frames are emptied
+void combat_recwrite(t_combatevent *ev)
+{
+	if (ev->type == cev_frame && ev->ship == 0)
+		return;
+
+	fwrite(ev, sizeof(t_combatevent), 1, rp_out);
+	if (ev->type == cev_frame)
+		ev->ship = 0;
+}
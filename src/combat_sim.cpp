@@ -2,6 +2,8 @@
 //     INCLUDES
 // ----------------
 
+#include <stdexcept>
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -9,6 +11,7 @@
 #include <math.h>
 
 #include "typedefs.h"
+#include "rng.h"
 #include "is_fileio.h"
 
 #include "textstr.h"
@@ -110,6 +113,52 @@ void combat_sim()
 	}
 }
 
+// headless simulator battle for balance testing, no setup screen.
+// pship is the player ship (0-2, as on the setup screen), wing lists up to
+// two wingman shiptypes and the enemy is fleet flt from race r's fleet table
+// (the race must have one).
+// only cw is written, call combat_sim_headless_init() once beforehand.
+int32 combat_sim_headless(t_combatworld *cw, int32 pship, int32 *wing, int32 nwing, int32 r, int32 flt, int32 maxticks, uint32 seed, t_combatresult *res)
+{
+	int32 c;
+	int32 s;
+	int32 n;
+	t_racefleet *rf;
+
+	cw->num_pships = 1;
+	cw->pships[0] = pship + 1;
+	for (c = 0; c < nwing && cw->num_pships < 3; c++)
+		cw->pships[cw->num_pships++] = wing[c];
+
+	cw->erace = r;
+	cw->eflt = 0;
+	cw->esystem = 0;
+	cw->num_eships = 0;
+	if (races[r].fleet < 0)
+		throw std::runtime_error("race has no fleet to simulate");
+	rf = &racefleets[races[r].fleet];
+	if (r == race_drone)
+	{
+		for (s = 0; s < 3; s++)
+			cw->eships[cw->num_eships++] = rf->stype[0];
+	}
+	if (flt >= 0 && flt < rf->num_fleets)
+	{
+		cw->num_eships = 0;
+		for (s = 2; s >= 0; s--)
+			for (n = 0; n < rf->fleets[flt][s] && cw->num_eships < 16; n++)
+				cw->eships[cw->num_eships++] = rf->stype[s];
+	}
+
+	return combat_headless(cw, maxticks, seed, res);
+}
+
+// reset ship hulls and damage as the simulator screen does
+void combat_sim_headless_init()
+{
+	cs_player_init();
+}
+
 void cs_insertship(int32 st)
 {
 	int32 x;
@@ -0,0 +1,409 @@
+// ----------------
+//     INCLUDES
+// ----------------
+
+#include <stdexcept>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <SDL.h>
+
+#include "typedefs.h"
+#include "rng.h"
+#include "is_fileio.h"
+#include "iface_globals.h"
+#include "gfx.h"
+#include "snd.h"
+
+#include "combat.h"
+
+// ----------------
+//		CONSTANTS
+// ----------------
+
+#define COMBAT_QUEUE 64				// player commands waiting for the next tick
+#define COMBAT_CATCHUP 250		// ms behind before the sim gives up catching up
+
+// ----------------
+// GLOBAL VARIABLES
+// ----------------
+
+SDL_Thread		*ct_thread;
+SDL_mutex			*ct_lock;			// guards everything below
+SDL_mutex			*ct_busy;			// held by the sim thread while it steps the battle
+
+int32					ct_run;
+int32					ct_speed;			// g_pause of the interface
+int32					ct_zoom;			// zoom keys held, -1..1
+
+t_combatevent	ct_queue[COMBAT_QUEUE];
+int32					ct_numqueue;
+
+t_combatsound	ct_sounds[COMBAT_SOUNDS];	// published with the snapshots, for the interface to play
+int32					ct_numsounds;
+t_combatworld	*ct_world;
+
+t_combatworld	ct_snap[2];		// the interface draws one while the other is written
+int32					ct_front;			// last one published
+int32					ct_reading;		// the one being drawn, -1 if none
+uint32				ct_time;			// when the front one was published
+
+// ----------------
+// LOCAL PROTOTYPES
+// ----------------
+
+int combat_thread(void *data);
+void combat_threadtick(t_combatworld *cw, int32 zoom);
+int32 combat_publish(t_combatworld *cw);
+void combat_copyworld(t_combatworld *dst, t_combatworld *src);
+void combat_poolcopy(t_combatpool *dst, t_combatpool *src);
+t_ship *combat_rebase(t_combatworld *dst, t_combatworld *src, t_ship *s);
+
+// ----------------
+// GLOBAL FUNCTIONS
+// ----------------
+
+// step the battle in cw at COMBAT_FRAMERATE on a thread of its own, so
+// slow frames don't slow the battle down. until combat_threadstop() the
+// interface only reads snapshots and hands over commands.
+void combat_threadstart(t_combatworld *cw)
+{
+	ct_lock = SDL_CreateMutex();
+	ct_busy = SDL_CreateMutex();
+	if (!ct_lock || !ct_busy)
+		throw std::runtime_error("unable to create combat mutex");
+
+	ct_run = 1;
+	ct_speed = cw->g_pause;
+	ct_zoom = 0;
+	ct_numqueue = 0;
+	ct_numsounds = 0;
+
+	// the mixer is the interface's, the battle only says what to play
+	ct_world = cw;
+	cw->queuesound = 1;
+	cw->numsounds = 0;
+
+	combat_copyworld(&ct_snap[0], cw);
+	ct_front = 0;
+	ct_reading = -1;
+	ct_time = SDL_GetTicks();
+
+	ct_thread = SDL_CreateThread(combat_thread, cw);
+	if (!ct_thread)
+		throw std::runtime_error("unable to create combat thread");
+}
+
+void combat_threadstop()
+{
+	SDL_mutexP(ct_lock);
+	ct_run = 0;
+	SDL_mutexV(ct_lock);
+
+	SDL_WaitThread(ct_thread, NULL);
+	ct_thread = NULL;
+	ct_world->queuesound = 0;
+	ct_world->numsounds = 0;
+
+	SDL_DestroyMutex(ct_busy);
+	SDL_DestroyMutex(ct_lock);
+
+	combat_freeworld(&ct_snap[0]);
+	combat_freeworld(&ct_snap[1]);
+}
+
+// stop the battle while a popup is up. the sim thread finishes its tick
+// first, so it makes no sound or other call behind the popup's back.
+void combat_threadhold(int32 hold)
+{
+	if (hold)
+		SDL_mutexP(ct_busy);
+	else
+		SDL_mutexV(ct_busy);
+}
+
+void combat_threadspeed(int32 pause, int32 zoom)
+{
+	SDL_mutexP(ct_lock);
+	ct_speed = pause;
+	ct_zoom = zoom;
+	SDL_mutexV(ct_lock);
+}
+
+// queue a player command, the sim thread records and carries it out on
+// its next tick. if the queue is full it is dropped, like a missed click.
+void combat_command(int32 type, int32 s, int32 p0, int32 p1, int32 p2)
+{
+	t_combatevent *ev;
+
+	SDL_mutexP(ct_lock);
+	if (ct_numqueue < COMBAT_QUEUE)
+	{
+		ev = &ct_queue[ct_numqueue++];
+		ev->tick = 0;
+		ev->type = type;
+		ev->ship = s;
+		ev->par[0] = p0;
+		ev->par[1] = p1;
+		ev->par[2] = p2;
+	}
+	SDL_mutexV(ct_lock);
+}
+
+// the latest snapshot of the battle, for the interface to read and draw
+// until combat_release(). frac is how far into the next tick the battle
+// is by now, in 256ths, for combat_interpolate().
+t_combatworld *combat_snapshot(int32 *frac)
+{
+	t_combatworld *cw;
+	int32 f;
+
+	SDL_mutexP(ct_lock);
+	ct_reading = ct_front;
+	cw = &ct_snap[ct_reading];
+	f = 0;
+	if (ct_speed < 1)
+	{
+		f = MIN((int32)(SDL_GetTicks() - ct_time) * 256 / (1000/COMBAT_FRAMERATE), 256);
+		if (ct_speed == -1)
+			f *= 3;
+	}
+	SDL_mutexV(ct_lock);
+
+	*frac = f;
+	return cw;
+}
+
+void combat_release()
+{
+	SDL_mutexP(ct_lock);
+	ct_reading = -1;
+	SDL_mutexV(ct_lock);
+}
+
+// play the sounds published since the last call, on the interface's
+// thread like all the others
+void combat_playsounds()
+{
+	t_combatsound sounds[COMBAT_SOUNDS];
+	int32 c, num;
+
+	SDL_mutexP(ct_lock);
+	num = ct_numsounds;
+	memcpy(sounds, ct_sounds, num * sizeof(t_combatsound));
+	ct_numsounds = 0;
+	SDL_mutexV(ct_lock);
+
+	for (c = 0; c < num; c++)
+		combat_playsound(&sounds[c]);
+}
+
+// move ships and projectiles f/256 of a tick along, -f puts them back.
+// the division truncates towards zero, so the two cancel out exactly.
+void combat_interpolate(t_combatworld *cw, int32 f)
+{
+	int32 c, q;
+
+	if (!f)
+		return;
+
+	for (c = 0; c < MAX_COMBAT_SHIPS; c++)
+	if (cw->cships[c].type > -1)
+	{
+		cw->cships[c].x += cw->cships[c].vx * f / 256;
+		cw->cships[c].y += cw->cships[c].vy * f / 256;
+		cw->cships[c].a = (cw->cships[c].a + cw->cships[c].va * f / 256) & 1023;
+	}
+
+	for (q = 0; q < cw->projs.num; q++)
+	if (cw->cprojs[c = cw->projs.live[q]].wep)
+	{
+		cw->cprojs[c].x += cw->cprojs[c].vx * f / 256;
+		cw->cprojs[c].y += cw->cprojs[c].vy * f / 256;
+	}
+}
+
+// ----------------
+// LOCAL FUNCTIONS
+// ----------------
+
+int combat_thread(void *data)
+{
+	t_combatworld *cw = (t_combatworld*)data;
+	t_combatevent queue[COMBAT_QUEUE];
+	int32 num, speed, zoom, run;
+	int32 c, n, stale;
+	uint32 next, now;
+
+	next = SDL_GetTicks();
+	stale = 0;
+	for (;;)
+	{
+		SDL_mutexP(ct_busy);
+
+		SDL_mutexP(ct_lock);
+		run = ct_run;
+		speed = ct_speed;
+		zoom = ct_zoom;
+		num = ct_numqueue;
+		memcpy(queue, ct_queue, num * sizeof(t_combatevent));
+		ct_numqueue = 0;
+		SDL_mutexV(ct_lock);
+
+		if (!run)
+		{
+			SDL_mutexV(ct_busy);
+			break;
+		}
+
+		for (c = 0; c < num; c++)
+			combat_reccommand(cw, &queue[c]);
+
+		// after a pause, popup or long stall start afresh instead of racing to catch up
+		now = SDL_GetTicks();
+		if (speed == 1 || (int32)(now - next) > COMBAT_CATCHUP)
+			next = now;
+
+		n = 0;
+		while (speed < 1 && (int32)(now - next) >= 0)
+		{
+			for (c = 0; c < 1 + 2*(speed == -1); c++)
+				combat_threadtick(cw, c ? 0 : zoom);
+			next += 1000/COMBAT_FRAMERATE;
+			n++;
+		}
+
+		if (n || num)
+			stale = 1;
+		if (stale)
+			stale = !combat_publish(cw);
+
+		SDL_mutexV(ct_busy);
+		SDL_Delay(1);
+	}
+
+	return 0;
+}
+
+// a tick of the battle and the steps a frame of combat() took around it,
+// recorded as such so replays play it back the same way
+void combat_threadtick(t_combatworld *cw, int32 zoom)
+{
+	combat_checkescapes(cw, cw->t_move);
+
+	if (zoom > 0 && cw->camera.z < 256)
+		zoom = 1;
+	else if (zoom < 0 && cw->camera.z > 4)
+		zoom = -1;
+	else
+		zoom = 0;
+	cw->camera.z += zoom;
+
+	cw->t_move++;
+	combat_movement(cw, cw->t_move);
+	if (cw->t_move==cw->klaktime+1 && cw->klaktime>0)
+		combat_sound(cw, WAV_HYPERDRIVE, get_ik_timer(1));
+
+	cw->t_disp = cw->t_move;
+	combat_headless_update(cw, cw->t_disp);
+	combat_recframe(cw, 1, 1, zoom);
+}
+
+// copy the battle into the snapshot not being drawn, and hand over the
+// sounds it made since. returns 0 if the interface still has both, the
+// next tick tries again.
+int32 combat_publish(t_combatworld *cw)
+{
+	int32 b, c;
+
+	SDL_mutexP(ct_lock);
+	b = 1 - ct_front;
+	if (b == ct_reading)
+		b = -1;
+	SDL_mutexV(ct_lock);
+
+	if (b == -1)
+		return 0;
+
+	combat_copyworld(&ct_snap[b], cw);
+
+	SDL_mutexP(ct_lock);
+	ct_front = b;
+	ct_time = SDL_GetTicks();
+	for (c = 0; c < cw->numsounds && ct_numsounds < COMBAT_SOUNDS; c++)
+		ct_sounds[ct_numsounds++] = cw->sounds[c];
+	SDL_mutexV(ct_lock);
+	cw->numsounds = 0;
+
+	return 1;
+}
+
+// snapshots keep pools of their own, which grow with the battle's
+void combat_copyworld(t_combatworld *dst, t_combatworld *src)
+{
+	t_combatpool projs, beams, explos;
+	int32 c, q;
+
+	projs = dst->projs;
+	beams = dst->beams;
+	explos = dst->explos;
+	memcpy(dst, src, sizeof(t_combatworld));
+	dst->projs = projs;
+	dst->beams = beams;
+	dst->explos = explos;
+
+	combat_poolcopy(&dst->projs, &src->projs);
+	combat_poolcopy(&dst->beams, &src->beams);
+	combat_poolcopy(&dst->explos, &src->explos);
+	dst->cprojs = (t_wepproj*)dst->projs.items;
+	dst->cbeams = (t_wepbeam*)dst->beams.items;
+	dst->cexplo = (t_explosion*)dst->explos.items;
+
+	for (q = 0; q < dst->projs.num; q++)
+	{
+		c = dst->projs.live[q];
+		dst->cprojs[c].src = combat_rebase(dst, src, dst->cprojs[c].src);
+		dst->cprojs[c].dst = combat_rebase(dst, src, dst->cprojs[c].dst);
+	}
+	for (q = 0; q < dst->beams.num; q++)
+	{
+		c = dst->beams.live[q];
+		dst->cbeams[c].src = combat_rebase(dst, src, dst->cbeams[c].src);
+		dst->cbeams[c].dst = combat_rebase(dst, src, dst->cbeams[c].dst);
+	}
+}
+
+void combat_poolcopy(t_combatpool *dst, t_combatpool *src)
+{
+	void *items;
+	int32 *live, *next;
+
+	if (dst->size < src->size)
+	{
+		items = realloc(dst->items, src->size * src->itemsize);
+		if (items) dst->items = items;
+		live = (int32*)realloc(dst->live, src->size * sizeof(int32));
+		if (live) dst->live = live;
+		next = (int32*)realloc(dst->next, src->size * sizeof(int32));
+		if (next) dst->next = next;
+		if (!items || !live || !next)
+			throw std::runtime_error("out of memory");
+		dst->size = src->size;
+	}
+
+	memcpy(dst->items, src->items, src->size * src->itemsize);
+	memcpy(dst->live, src->live, src->num * sizeof(int32));
+	memcpy(dst->next, src->next, src->size * sizeof(int32));
+	dst->itemsize = src->itemsize;
+	dst->num = src->num;
+	dst->free = src->free;
+}
+
+// the ship of dst that s points at in src
+t_ship *combat_rebase(t_combatworld *dst, t_combatworld *src, t_ship *s)
+{
+	if (!s)
+		return NULL;
+	return dst->cships + (s - src->cships);
+}
@@ -9,6 +9,7 @@
 #include <math.h>
 
 #include "typedefs.h"
+#include "rng.h"
 #include "iface_globals.h"
 #include "is_fileio.h"
 #include "gfx.h"
@@ -42,12 +43,14 @@ void combat_gethardpoint(t_ship *ship, int32 hdp, int32 *rx, int32 *ry)
 				(32-hull->hardpts[hdp].x) * sin1k[ship->a] ) * hull->size) >> 12);
 }
 
-int32 combat_findtarget(t_ship *ship, int32 hdp)
+int32 combat_findtarget(t_combatworld *cw, t_ship *ship, int32 hdp)
 {
 	int32 e;
 	int32 s;
 	int32 a1, a2, a3;
 	int32 md, d;
+	int32 n, c;
+	int32 list[MAX_COMBAT_SHIPS];
 	t_shipweapon *wep;
 
 	s = shiptypes[ship->type].system[hdp];
@@ -60,15 +63,16 @@ int32 combat_findtarget(t_ship *ship, int32 hdp)
 	md = wep->range;
 	e = -1;
 
-	for (s = 0; s < MAX_COMBAT_SHIPS; s++)
-	if (&cships[s] != ship && cships[s].type>-1 && (cships[s].own&1) != (ship->own&1) &&
-			cships[s].hits>0 && cships[s].active==2 && cships[s].cloaked==0)
+	n = combat_gridquery(cw, ship->x>>10, ship->y>>10, wep->range+1, list);
+	for (c = 0; c < n; c++)
+	if (&cw->cships[s=list[c]] != ship && cw->cships[s].type>-1 && (cw->cships[s].own&1) != (ship->own&1) &&
+			cw->cships[s].hits>0 && cw->cships[s].active==2 && cw->cships[s].cloaked==0)
 	{
-		a1 = get_direction( (cships[s].x>>10)-(ship->x>>10), (cships[s].y>>10)-(ship->y>>10) );
-		d = get_distance( (cships[s].x>>10)-(ship->x>>10), (cships[s].y>>10)-(ship->y>>10) );
-		a2 = (ship->a + hulls[shiptypes[ship->type].hull].hardpts[hdp].a) & 1023;
+		d = get_distance( (cw->cships[s].x>>10)-(ship->x>>10), (cw->cships[s].y>>10)-(ship->y>>10) );
 		if (d < md || (s == ship->target && d < wep->range))
 		{
+			a1 = get_direction( (cw->cships[s].x>>10)-(ship->x>>10), (cw->cships[s].y>>10)-(ship->y>>10) );
+			a2 = (ship->a + hulls[shiptypes[ship->type].hull].hardpts[hdp].a) & 1023;
 			a3 = a1 - a2;
 			while (a3 > 512) a3-=1024;
 			while (a3 <-512) a3+=1024;
@@ -86,7 +90,7 @@ int32 combat_findtarget(t_ship *ship, int32 hdp)
 	return e;
 }
 
-void combat_fire(t_ship *src, int32 hdp, t_ship *trg, int32 start)
+void combat_fire(t_combatworld *cw, t_ship *src, int32 hdp, t_ship *trg, int32 start)
 {
 	t_shipweapon *wep;
 	int s = shiptypes[src->type].system[hdp];
@@ -99,17 +103,16 @@ void combat_fire(t_ship *src, int32 hdp, t_ship *trg, int32 start)
 
 	if (wep->type == 0)
 	{
-		combat_addbeam(wep, src, hdp, trg, start);
+		combat_addbeam(cw, wep, src, hdp, trg, start);
 	}
 	else
 	{
-		combat_addproj(src, hdp, trg, start);
+		combat_addproj(cw, src, hdp, trg, start);
 	}
 }
 
-int32 combat_addbeam(t_shipweapon *wep, t_ship *src, int32 hdp, t_ship *trg, int32 start, int32 stg)
+int32 combat_addbeam(t_combatworld *cw, t_shipweapon *wep, t_ship *src, int32 hdp, t_ship *trg, int32 start, int32 stg)
 {
-	int32 c;
 	int32 b;
 	int32 cpu;
 	int32 hit;
@@ -128,43 +131,38 @@ int32 combat_addbeam(t_shipweapon *wep, t_ship *src, int32 hdp, t_ship *trg, int
 	else
 		hit = 100;
 
-	b = -1;
-	for (c = 0; c < MAX_COMBAT_BEAMS; c++)
-	if (!cbeams[c].wep)
-	{ b = c; break; }
-
-	if (b==-1)
-		return -1;
+	b = combat_pooladd(&cw->beams);
+	cw->cbeams = (t_wepbeam*)cw->beams.items;
 
-	cbeams[b].wep = wep;
-	cbeams[b].stg = stg;
+	cw->cbeams[b].wep = wep;
+	cw->cbeams[b].stg = stg;
 
-	cbeams[b].src = src;
-	cbeams[b].stp = hdp;
-	if (rand()%100 < hit)
+	cw->cbeams[b].src = src;
+	cw->cbeams[b].stp = hdp;
+	if (rng_rand(&cw->rng)%100 < hit)
 	{
-		cbeams[b].dst = trg;
-		cbeams[b].dsp = -1;
+		cw->cbeams[b].dst = trg;
+		cw->cbeams[b].dsp = -1;
 	}
 	else
 	{
-		cbeams[b].dst = NULL;
-		cbeams[b].ang = get_direction( trg->x - src->x, trg->y - src->y );
-		cbeams[b].len = wep->range;
+		cw->cbeams[b].dst = NULL;
+		cw->cbeams[b].ang = get_direction( trg->x - src->x, trg->y - src->y );
+		cw->cbeams[b].len = wep->range;
 	}
-	cbeams[b].str = start;
-	cbeams[b].dmt = start + wep->speed * 2;
-	cbeams[b].end = start + wep->speed * 5;
+	cw->cbeams[b].str = start;
+	cw->cbeams[b].dmt = start + wep->speed * 2;
+	cw->cbeams[b].end = start + wep->speed * 5;
 
 	if (stg == -1)
 	{
 		if (src->syshits[hdp]<5) // damaged
-			src->wepfire[hdp] = start + wep->rate * (3 + 2*(src->cpu_type<3)) * (1+rand()%3);
+			src->wepfire[hdp] = start + wep->rate * (3 + 2*(src->cpu_type<3)) * (1+rng_rand(&cw->rng)%3);
 		else
 			src->wepfire[hdp] = start + wep->rate * (3 + 2*(src->cpu_type<3));
 	}
 
-	combat_SoundFX(wep->sound1, src->x);
+	combat_SoundFX(cw, wep->sound1, src->x);
 	return b;
 }
 
@@ -191,7 +189,7 @@ int32 calc_leadangle(int32 tx, int32 ty, int32 vtx, int32 vty,
 	return a;
 }
 
-int32 combat_addproj(t_ship *src, int32 hdp, t_ship *trg, int32 start)
+int32 combat_addproj(t_combatworld *cw, t_ship *src, int32 hdp, t_ship *trg, int32 start)
 {
 	int32 c;
 	int32 b;
@@ -212,13 +210,8 @@ int32 combat_addproj(t_ship *src, int32 hdp, t_ship *trg, int32 start)
 	wep = &shipweapons[shipsystems[s].par[0]];
 //	t_shipweapon *wep = &shipweapons[shiptypes[src->type].weapon[hdp]];
 
-	b = -1;
-	for (c = 0; c < MAX_COMBAT_PROJECTILES; c++)
-	if (!cprojs[c].wep)
-	{ b = c; break; }
-
-	if (b==-1)
-		return -1;
+	b = combat_pooladd(&cw->projs);
+	cw->cprojs = (t_wepproj*)cw->projs.items;
 
 	cpu = src->cpu_type;
 	combat_gethardpoint(src, hdp, &sx, &sy);
@@ -278,81 +271,80 @@ int32 combat_addproj(t_ship *src, int32 hdp, t_ship *trg, int32 start)
 	}
 
 	if (wep->flags && wpfImplode)
-		a = (1024 + a + rand()%30 - 15) & 1023;
+		a = (1024 + a + rng_rand(&cw->rng)%30 - 15) & 1023;
 
 //	t_hull* hull = &hulls[shiptypes[src->type].hull];
 //	a = (src->a + hull->hardpts[hdp].a + 1024) & 1023;
 
-	cprojs[b].x = sx;
-	cprojs[b].y = sy;
-	cprojs[b].vx = src->vx + ((sin1k[a] * wep->speed / COMBAT_FRAMERATE) >> 6);
-	cprojs[b].vy = src->vy + ((cos1k[a] * wep->speed / COMBAT_FRAMERATE) >> 6);
-	cprojs[b].a = get_direction ( cprojs[b].vx, cprojs[b].vy );
+	cw->cprojs[b].x = sx;
+	cw->cprojs[b].y = sy;
+	cw->cprojs[b].vx = src->vx + ((sin1k[a] * wep->speed / COMBAT_FRAMERATE) >> 6);
+	cw->cprojs[b].vy = src->vy + ((cos1k[a] * wep->speed / COMBAT_FRAMERATE) >> 6);
+	cw->cprojs[b].a = get_direction ( cw->cprojs[b].vx, cw->cprojs[b].vy );
 
-	cprojs[b].wep = wep;
-	cprojs[b].src = src;
-	cprojs[b].dst = trg;
-	cprojs[b].str = start;
+	cw->cprojs[b].wep = wep;
+	cw->cprojs[b].src = src;
+	cw->cprojs[b].dst = trg;
+	cw->cprojs[b].str = start;
 
 	if (wep->flags & wpfSpin)
-		cprojs[b].va = 20;
+		cw->cprojs[b].va = 20;
 	else
-		cprojs[b].va = 0;
+		cw->cprojs[b].va = 0;
 
 	if (wep->flags & wpfNova)
 	{
-		combat_addexplo(cprojs[b].x + cprojs[b].vx * 4,
-										cprojs[b].y + cprojs[b].vy * 4,
+		combat_addexplo(cw, cw->cprojs[b].x + cw->cprojs[b].vx * 4,
+										cw->cprojs[b].y + cw->cprojs[b].vy * 4,
 										spr_shockwave, 1, 64, 0, start, start+6, 4);
 	}
 
 	if (wep->flags & wpfHoming)
 	{
-		cprojs[b].end = start + COMBAT_FRAMERATE * (wep->range * 3/2) / wep->speed;
+		cw->cprojs[b].end = start + COMBAT_FRAMERATE * (wep->range * 3/2) / wep->speed;
 
-		if (cprojs[b].dst->ecm_type > -1 && cprojs[b].dst->syshits[cprojs[b].dst->sys_ecm]>0)
+		if (cw->cprojs[b].dst->ecm_type > -1 && cw->cprojs[b].dst->syshits[cw->cprojs[b].dst->sys_ecm]>0)
 		{	// ecm
-			a = shipsystems[cprojs[b].dst->ecm_type].par[0] * 10;
-			if (rand()%30 < a)
+			a = shipsystems[cw->cprojs[b].dst->ecm_type].par[0] * 10;
+			if (rng_rand(&cw->rng)%30 < a)
 			{
 				//Play_SoundFX(WAV_SYSFIXED);
-				cprojs[b].dst = NULL;
-				cprojs[b].va = (rand()%4) + 1;
-				if (rand()&1) cprojs[b].va = -cprojs[b].va;
+				cw->cprojs[b].dst = NULL;
+				cw->cprojs[b].va = (rng_rand(&cw->rng)%4) + 1;
+				if (rng_rand(&cw->rng)&1) cw->cprojs[b].va = -cw->cprojs[b].va;
 			}
 		}
 	}
 	else
 	{
-		cprojs[b].end = start + COMBAT_FRAMERATE * wep->range / wep->speed;
+		cw->cprojs[b].end = start + COMBAT_FRAMERATE * wep->range / wep->speed;
 		if (wep->flags & wpfSplit)
 		{
-			cprojs[b].end = start + eta - (COMBAT_FRAMERATE * 100) / wep->speed;
-			if (cprojs[b].end < start + 10)
-				cprojs[b].end = start + 10;
+			cw->cprojs[b].end = start + eta - (COMBAT_FRAMERATE * 100) / wep->speed;
+			if (cw->cprojs[b].end < start + 10)
+				cw->cprojs[b].end = start + 10;
 		}
 	}
 
 	if (wep->flags & wpfImplode)
-		cprojs[b].end = start + COMBAT_FRAMERATE * (wep->range * 3/2) / wep->speed;
+		cw->cprojs[b].end = start + COMBAT_FRAMERATE * (wep->range * 3/2) / wep->speed;
 
 	if (wep->flags & wpfDisperse)
-		cprojs[b].hits = wep->damage;
+		cw->cprojs[b].hits = wep->damage;
 	else
-		cprojs[b].hits = 1;
+		cw->cprojs[b].hits = 1;
 
 	if (src->syshits[hdp]<5) // damaged
-		src->wepfire[hdp] = start + wep->rate * (3 + 2*(src->cpu_type<3)) * (1+rand()%3);
+		src->wepfire[hdp] = start + wep->rate * (3 + 2*(src->cpu_type<3)) * (1+rng_rand(&cw->rng)%3);
 	else
 		src->wepfire[hdp] = start + wep->rate * (3 + 2*(src->cpu_type<3));
 
-	combat_SoundFX(wep->sound1, cprojs[b].x);
+	combat_SoundFX(cw, wep->sound1, cw->cprojs[b].x);
 	return b;
 }
 
-void combat_launchstages(int32 p, int32 num, int32 start)
+void combat_launchstages(t_combatworld *cw, int32 p, int32 num, int32 start)
 {
-	int32 c;
 	int32 b;
 	int32 a;
 	int32 f;
@@ -361,99 +353,94 @@ void combat_launchstages(int32 p, int32 num, int32 start)
 	int32 n;
 	t_ship *trg;
 
-	t_shipweapon *wep = &shipweapons[cprojs[p].wep->stage];
-	if (cprojs[p].wep->flags & wpfHoming)
+	t_shipweapon *wep = &shipweapons[cw->cprojs[p].wep->stage];
+	if (cw->cprojs[p].wep->flags & wpfHoming)
 	{
-		if (cprojs[p].dst)
+		if (cw->cprojs[p].dst)
 		{
-			trg = cprojs[p].dst;
+			trg = cw->cprojs[p].dst;
 		}
 		else
 			return;
 	}
 	else
-		trg = cprojs[p].dst;
+		trg = cw->cprojs[p].dst;
 
-	combat_SoundFX(wep->sound1, cprojs[p].x);
+	combat_SoundFX(cw, wep->sound1, cw->cprojs[p].x);
 	for (n = 0; n < num; n++)
 	{
-		b = -1;
-		for (c = 0; c < MAX_COMBAT_PROJECTILES; c++)
-		if (!cprojs[c].wep)
-		{ b = c; break; }
-
-		if (b==-1)
-			break;
+		b = combat_pooladd(&cw->projs);
+		cw->cprojs = (t_wepproj*)cw->projs.items;
 
-		sx = cprojs[p].x;
-		sy = cprojs[p].y;
+		sx = cw->cprojs[p].x;
+		sy = cw->cprojs[p].y;
 		combat_gethardpoint(trg, -1, &tx, &ty);
 
 		f = 0;
-		if (cprojs[p].wep->item != -1)
-			if (shipsystems[itemtypes[cprojs[p].wep->item].index].par[2])
-				f = shipsystems[itemtypes[cprojs[p].wep->item].index].par[2];
+		if (cw->cprojs[p].wep->item != -1)
+			if (shipsystems[itemtypes[cw->cprojs[p].wep->item].index].par[2])
+				f = shipsystems[itemtypes[cw->cprojs[p].wep->item].index].par[2];
 
 		if (f & 1)
-			a = rand()&1023;
+			a = rng_rand(&cw->rng)&1023;
 		else
 		{
-			if (cprojs[p].wep->flags & wpfHoming)
+			if (cw->cprojs[p].wep->flags & wpfHoming)
 				a = get_direction( (tx>>10)-(sx>>10), (ty>>10)-(sy>>10) );
 			else
-				a = cprojs[p].a;
+				a = cw->cprojs[p].a;
 			if (num>1)
 				a = (a + 768 + (512 * n) / (num-1)) & 1023;
 		}
 
-		cprojs[b].x = sx;
-		cprojs[b].y = sy;
+		cw->cprojs[b].x = sx;
+		cw->cprojs[b].y = sy;
 		if (f & 2)
 		{
-			cprojs[b].vx = ((sin1k[a] * wep->speed / COMBAT_FRAMERATE) >> 6);
-			cprojs[b].vy = ((cos1k[a] * wep->speed / COMBAT_FRAMERATE) >> 6);
+			cw->cprojs[b].vx = ((sin1k[a] * wep->speed / COMBAT_FRAMERATE) >> 6);
+			cw->cprojs[b].vy = ((cos1k[a] * wep->speed / COMBAT_FRAMERATE) >> 6);
 		}
 		else
 		{
-			cprojs[b].vx = cprojs[p].vx + ((sin1k[a] * wep->speed / COMBAT_FRAMERATE) >> 6);
-			cprojs[b].vy = cprojs[p].vy + ((cos1k[a] * wep->speed / COMBAT_FRAMERATE) >> 6);
+			cw->cprojs[b].vx = cw->cprojs[p].vx + ((sin1k[a] * wep->speed / COMBAT_FRAMERATE) >> 6);
+			cw->cprojs[b].vy = cw->cprojs[p].vy + ((cos1k[a] * wep->speed / COMBAT_FRAMERATE) >> 6);
 		}
-		cprojs[b].a = get_direction(cprojs[b].vx, cprojs[b].vy);
+		cw->cprojs[b].a = get_direction(cw->cprojs[b].vx, cw->cprojs[b].vy);
 
-		cprojs[b].wep = wep;
-		cprojs[b].src = cprojs[p].src;
-		cprojs[b].dst = trg;
-		cprojs[b].str = start;
+		cw->cprojs[b].wep = wep;
+		cw->cprojs[b].src = cw->cprojs[p].src;
+		cw->cprojs[b].dst = trg;
+		cw->cprojs[b].str = start;
 		if (wep->flags & wpfHoming)
 		{
-			cprojs[b].end = start + COMBAT_FRAMERATE * (wep->range * 3/2) / wep->speed;
-			if (cprojs[b].dst->ecm_type > -1 && cprojs[b].dst->syshits[cprojs[b].dst->sys_ecm]>0)
+			cw->cprojs[b].end = start + COMBAT_FRAMERATE * (wep->range * 3/2) / wep->speed;
+			if (cw->cprojs[b].dst->ecm_type > -1 && cw->cprojs[b].dst->syshits[cw->cprojs[b].dst->sys_ecm]>0)
 			{	// ecm
-				a = shipsystems[cprojs[b].dst->ecm_type].par[0] * 10;
-				if (rand()%30 < a)
+				a = shipsystems[cw->cprojs[b].dst->ecm_type].par[0] * 10;
+				if (rng_rand(&cw->rng)%30 < a)
 				{
-					Play_SoundFX(WAV_SYSFIXED, get_ik_timer(1));
-					cprojs[b].dst = NULL;
-					cprojs[b].va = (rand()%5 + 4)*((rand()&1)*2-1);
+					combat_sound(cw, WAV_SYSFIXED, get_ik_timer(1));
+					cw->cprojs[b].dst = NULL;
+					cw->cprojs[b].va = (rng_rand(&cw->rng)%5 + 4)*((rng_rand(&cw->rng)&1)*2-1);
 				}
 			}
 		}
 		else
-			cprojs[b].end = start + COMBAT_FRAMERATE * wep->range / wep->speed;
+			cw->cprojs[b].end = start + COMBAT_FRAMERATE * wep->range / wep->speed;
 
 		if (wep->flags & wpfSpin)
-			cprojs[b].va = 20;
+			cw->cprojs[b].va = 20;
 		else
-			cprojs[b].va = 0;
+			cw->cprojs[b].va = 0;
 
 		if (wep->flags & wpfDisperse)
-			cprojs[b].hits = wep->damage;
+			cw->cprojs[b].hits = wep->damage;
 		else
-			cprojs[b].hits = 0;
+			cw->cprojs[b].hits = 0;
 	}
 }
 
-void combat_damageship(int32 s, int32 src, int32 dmg, int32 t, t_shipweapon *wep, int32 deb)
+void combat_damageship(t_combatworld *cw, int32 s, int32 src, int32 dmg, int32 t, t_shipweapon *wep, int32 deb)
 {
 	int32 sys = -1;
 	int32 d1;
@@ -462,189 +449,188 @@ void combat_damageship(int32 s, int32 src, int32 dmg, int32 t, t_shipweapon *wep
 	if (s == -1)
 		return;
 
-	if (cships[s].type == -1)	// now this would suck
+	if (cw->cships[s].type == -1)	// now this would suck
 		return;
 
-	if (t > cships[s].damage_time + 10)
+	if (t > cw->cships[s].damage_time + 10)
 	{
-		if (cships[s].shld_type>-1 && cships[s].shld>0)
+		if (cw->cships[s].shld_type>-1 && cw->cships[s].shld>0)
 		{
-			combat_SoundFX(WAV_SHIELD, cships[s].x);
+			combat_SoundFX(cw, WAV_SHIELD, cw->cships[s].x);
 		}
 		else
 		{
 			if (wep->type==0) // beam
-				combat_SoundFX(WAV_EXPLO1, cships[s].x);
+				combat_SoundFX(cw, WAV_EXPLO1, cw->cships[s].x);
 			else
-				combat_SoundFX(wep->sound2, cships[s].x);
+				combat_SoundFX(cw, wep->sound2, cw->cships[s].x);
 		}
-		cships[s].damage_time = t;
+		cw->cships[s].damage_time = t;
 	}
 
-	if (cships[s].hits <= 0 || cships[s].active<2)
+	if (cw->cships[s].hits <= 0 || cw->cships[s].active<2)
 		return;
 
+	if (cw->wepdmg && !deb)
+		cw->wepdmg[(1-(cw->cships[s].own&1))*num_shipweapons + (wep-shipweapons)] += dmg;
+
 	if (!deb)
 	{
-		if (cships[s].shld_type>-1 && cships[s].shld>0)
+		if (cw->cships[s].shld_type>-1 && cw->cships[s].shld>0)
 		{
-			if ( (rand()%10)==0)
-				sys = cships[s].sys_shld;
+			if ( (rng_rand(&cw->rng)%10)==0)
+				sys = cw->cships[s].sys_shld;
 			else
 			{
-				d1 = MIN(dmg, cships[s].shld);
+				d1 = MIN(dmg, cw->cships[s].shld);
 				dmg = dmg - d1;
-				cships[s].shld -= d1;
-				cships[s].shld_time = t;
-				if (cships[s].shld <= 0) cships[s].shld = 0;
+				cw->cships[s].shld -= d1;
+				cw->cships[s].shld_time = t;
+				if (cw->cships[s].shld <= 0) cw->cships[s].shld = 0;
 			}
 		}
 
 		if (dmg>0)
 		{
-			if ( (rand()%10)<5 )
+			if ( (rng_rand(&cw->rng)%10)<5 )
 			{
-				sys = rand()%shiptypes[cships[s].type].num_systems;
-				if (cships[s].syshits[sys]<=0 || shipsystems[shiptypes[cships[s].type].system[sys]].item==-1)
+				sys = rng_rand(&cw->rng)%shiptypes[cw->cships[s].type].num_systems;
+				if (cw->cships[s].syshits[sys]<=0 || shipsystems[shiptypes[cw->cships[s].type].system[sys]].item==-1)
 					sys = -1;
 			}
 
 			if (sys==-1)
-				cships[s].hits -= dmg;	// hull hit
+				cw->cships[s].hits -= dmg;	// hull hit
 			else
 			{
-				d1 = cships[s].syshits[sys];
-				cships[s].syshits[sys] = MAX (0, cships[s].syshits[sys]-dmg);
-				if (cships[s].syshits[sys]>0)
+				d1 = cw->cships[s].syshits[sys];
+				cw->cships[s].syshits[sys] = MAX (0, cw->cships[s].syshits[sys]-dmg);
+				if (cw->cships[s].syshits[sys]>0)
 				{
-					if (cships[s].syshits[sys]/5 != d1/5)	// green->yellow, yellow->red
-						combat_SoundFX(WAV_SYSHIT1+(rand()&1), cships[s].x);
+					if (cw->cships[s].syshits[sys]/5 != d1/5)	// green->yellow, yellow->red
+						combat_SoundFX(cw, WAV_SYSHIT1+(rng_rand(&cw->rng)&1), cw->cships[s].x);
 				}
 				else	// red->grey
-					combat_SoundFX(WAV_SYSDAMAGE, cships[s].x);
+					combat_SoundFX(cw, WAV_SYSDAMAGE, cw->cships[s].x);
 			}	// system damage
 		}
 	}
 	else
 	{
-		cships[s].hits -= dmg;
+		cw->cships[s].hits -= dmg;
 	}
 
-	combat_updateshipstats(s, t);
+	combat_updateshipstats(cw, s, t);
 
-	if (cships[s].hits <= 0) // burn
+	if (cw->cships[s].hits <= 0) // burn
 	{
-		cships[s].va = rand()%cships[s].turn+1;
-		if (rand()&1)
-			cships[s].va = -cships[s].va;
-		if (shiptypes[cships[s].type].race == race_unknown)	// stop space hulk
-			cships[s].vx = cships[s].vy = 0;
+		cw->cships[s].va = rng_rand(&cw->rng)%cw->cships[s].turn+1;
+		if (rng_rand(&cw->rng)&1)
+			cw->cships[s].va = -cw->cships[s].va;
+		if (shiptypes[cw->cships[s].type].race == race_unknown)	// stop space hulk
+			cw->cships[s].vx = cw->cships[s].vy = 0;
 
 		// reset other ships' targets
 		for (c = 0; c < MAX_COMBAT_SHIPS; c++)
-		if (cships[c].type > -1 && cships[c].hits > 0)
+		if (cw->cships[c].type > -1 && cw->cships[c].hits > 0)
 		{
-			if (cships[c].target == s)
+			if (cw->cships[c].target == s)
 			{
-				cships[c].target = -1;
-				combat_findstuff2do(c,t);
+				cw->cships[c].target = -1;
+				combat_findstuff2do(cw, c,t);
 			}
 		}
 	}
 }
 
-void combat_killship(int32 s, int32 t, int32 quiet)
+void combat_killship(t_combatworld *cw, int32 s, int32 t, int32 quiet)
 {
 	int32 c;
+	int32 n;
 	int32 sz;
 	int32 shu=0;
 
 	if (s == -1)
 		return;
-	if (cships[s].type == -1)
+	if (cw->cships[s].type == -1)
 		return;
 
-	if (shiptypes[cships[s].type].flag & 256)
+	if (shiptypes[cw->cships[s].type].flag & 256)
 		shu = 1;
 
 	if (!quiet)
-		cships[s].hits = -666;
-	sz = hulls[shiptypes[cships[s].type].hull].size * 2;
+		cw->cships[s].hits = -666;
+	sz = hulls[shiptypes[cw->cships[s].type].hull].size * 2;
 
-	if (camera.ship_sel == s)
-		camera.ship_sel = -1;
+	if (cw->camera.ship_sel == s)
+		cw->camera.ship_sel = -1;
 
 	for (c = 0; c < MAX_COMBAT_SHIPS; c++)
-	if (cships[c].type > -1)
+	if (cw->cships[c].type > -1)
 	{
-		if (cships[c].target == s)
+		if (cw->cships[c].target == s)
 		{
-			cships[c].target = -1;
-			combat_findstuff2do(c,t);
+			cw->cships[c].target = -1;
+			combat_findstuff2do(cw, c,t);
 		}
 	}
 
-	for (c = 0; c < MAX_COMBAT_PROJECTILES; c++)
-	if (cprojs[c].wep != NULL)
+	for (n = 0; n < cw->projs.num; n++)
+	if (cw->cprojs[c = cw->projs.live[n]].wep != NULL)
 	{
-		if (cprojs[c].wep->flags & wpfHoming)
-			if (cprojs[c].dst == &cships[s])
-				cprojs[c].dst = NULL;
+		if (cw->cprojs[c].wep->flags & wpfHoming)
+			if (cw->cprojs[c].dst == &cw->cships[s])
+				cw->cprojs[c].dst = NULL;
 	}
 
-	for (c = 0; c < MAX_COMBAT_BEAMS; c++)
-	if (cbeams[c].wep != NULL)
+	for (n = 0; n < cw->beams.num; n++)
+	if (cw->cbeams[c = cw->beams.live[n]].wep != NULL)
 	{
-		if (cbeams[c].dst == &cships[s])
-			cbeams[c].wep = NULL;
-		if (cbeams[c].src == &cships[s])
-			cbeams[c].wep = NULL;
+		if (cw->cbeams[c].dst == &cw->cships[s])
+			cw->cbeams[c].wep = NULL;
+		if (cw->cbeams[c].src == &cw->cships[s])
+			cw->cbeams[c].wep = NULL;
 	}
 
 
 	if (shu)
 	{
-		cships[s].active = 1;
-		cships[s].hits = 1;
+		cw->cships[s].active = 1;
+		cw->cships[s].hits = 1;
 	}
 	else
 	{
-		cships[s].active = 0;
+		cw->cships[s].active = 0;
 		if (!quiet)
 		{
-			combat_SoundFX(WAV_EXPLO2, cships[s].x);
-			combat_addexplo(cships[s].x, cships[s].y, spr_shockwave,
+			combat_SoundFX(cw, WAV_EXPLO2, cw->cships[s].x);
+			combat_addexplo(cw, cw->cships[s].x, cw->cships[s].y, spr_shockwave,
 									5, sz*4, 1, t, t+sz/2, 0);
-			combat_addexplo(cships[s].x, cships[s].y, spr_explode1,
+			combat_addexplo(cw, cw->cships[s].x, cw->cships[s].y, spr_explode1,
 									5, sz, 0, t, t+sz/4);
 		}
-		cships[s].type = -1;
+		cw->cships[s].type = -1;
 	}
 }
 
-int32 combat_addexplo(int32 x, int32 y, t_ik_spritepak *spr, int32 spin, int32 size, int32 zoom, int32 start, int32 end, int32 anim, int32 cam)
+int32 combat_addexplo(t_combatworld *cw, int32 x, int32 y, t_ik_spritepak *spr, int32 spin, int32 size, int32 zoom, int32 start, int32 end, int32 anim, int32 cam)
 {
-	int b, c;
-
-	b = -1;
-	for (c = 0; c < MAX_COMBAT_EXPLOS; c++)
-	if (!cexplo[c].spr)
-	{ b = c; break; }
-
-	if (b == -1)
-		return -1;
-
-	cexplo[b].x = x;
-	cexplo[b].y = y;
-	cexplo[c].a = rand()%1024,
-	cexplo[b].spr = spr;
-	cexplo[b].str = start;
-	cexplo[b].end = end;
-	cexplo[b].size = size;
-	cexplo[b].zoom = zoom;
-	cexplo[b].va = spin;
-	cexplo[b].anim = anim;
-	cexplo[b].cam = cam;
+	int b;
+
+	b = combat_pooladd(&cw->explos);
+	cw->cexplo = (t_explosion*)cw->explos.items;
+
+	cw->cexplo[b].x = x;
+	cw->cexplo[b].y = y;
+	cw->cexplo[b].a = rng_rand(&cw->rng)%1024,
+	cw->cexplo[b].spr = spr;
+	cw->cexplo[b].str = start;
+	cw->cexplo[b].end = end;
+	cw->cexplo[b].size = size;
+	cw->cexplo[b].zoom = zoom;
+	cw->cexplo[b].va = spin;
+	cw->cexplo[b].anim = anim;
+	cw->cexplo[b].cam = cam;
 
 	return b;
 }
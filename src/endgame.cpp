@@ -9,6 +9,7 @@
 #include <math.h>
 
 #include "typedefs.h"
+#include "rng.h"
 #include "is_fileio.h"
 
 #include "textstr.h"
@@ -437,21 +438,21 @@ void checkhiscore(int32 score)
 
 void endgame_init()
 {
-	FILE* ini;
-	char s1[64], s2[256];
-	char end;
+	t_inifile *ini;
+	char *s1, *s2;
+	int32 ln;
 	int num;
 	int flag;
 	int tv1;
 
-	ini = myopen("gamedata/jobs.ini", "rb");
+	ini = ini_open("gamedata/jobs.ini", 1);
 	if (!ini)
 		return;
 
-	end = 0; num = 0; flag = 0;
-	while (!end)
+	num = 0; flag = 0;
+	for (ln = 0; ln < ini->num; ln++)
 	{
-		end = read_line(ini, s1, s2);
+		s1 = ini->line[ln].key; s2 = ini->line[ln].par;
 		if (!strcmp(s1, "JOBS"))
 			flag=1;
 		else if (!strcmp(s1, "END"))
@@ -459,18 +460,16 @@ void endgame_init()
 		else if (flag)
 			num++;
 	}
-	fclose(ini);
 
 	jobs = (t_job*)calloc(num, sizeof(t_job));
 	if (!jobs)
-		return;
+	{ ini_close(ini); return; }
 	num_jobs = num;
 
-	ini = myopen("gamedata/jobs.ini", "rb");
-	end = 0; flag = 0;
-	while (!end)
+	flag = 0;
+	for (ln = 0; ln < ini->num; ln++)
 	{
-		end = read_line(ini, s1, s2);
+		s1 = ini->line[ln].key; s2 = ini->line[ln].par;
 		if (!strcmp(s1, "JOBS"))
 		{	flag = 1; num = 0; }
 		else if (!strcmp(s1, "END"))
@@ -486,7 +485,7 @@ void endgame_init()
 			}
 		}
 	}
-	fclose(ini);
+	ini_close(ini);
 
 	load_scores();
 }
@@ -131,6 +131,7 @@ void ik_print(t_ik_image *img, t_ik_font *fnt, int32 x, int32 y, uint8 co, const
 	if (!fnt->data)
 		return;
 
+	ik_dirty(img, x, y, x+(int32)strlen(dlin)*fnt->w, y+fnt->h);
   while (*dl)
 	{
   	ik_drawfont(img, fnt, x, y, co, (*dl++));
@@ -151,6 +152,7 @@ void ik_printbig(t_ik_image *img, t_ik_font *fnt, int32 x, int32 y, uint8 co, co
 	if (!fnt->data)
 		return;
 
+	ik_dirty(img, x, y, x+(int32)strlen(dlin)*(fnt->w<<1), y+(fnt->h<<1));
   while (*dl)
 	{
   	ik_drawfontbig(img, fnt, x, y, co, (*dl++));
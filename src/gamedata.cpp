@@ -0,0 +1,396 @@
+// ----------------
+//     INCLUDES
+// ----------------
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "typedefs.h"
+#include "rng.h"
+#include "iface_globals.h"
+#include "is_fileio.h"
+#include "gfx.h"
+#include "cards.h"
+#include "combat.h"
+#include "starmap.h"
+#include "gamedata.h"
+#include "vfs.h"
+
+// ----------------
+//     TYPEDEFS
+// ----------------
+
+typedef struct
+{
+	char magic[8];
+	int32 version;
+	uint32 layout;		// sizes of the tables, a struct that changes shows here
+	uint32 sum;				// fnv-1a of everything after the header
+	int32 size;				// of the whole file
+} t_gdheader;
+
+// an .ini the tables came from, as it was
+typedef struct
+{
+	int32 inmod;		// VFS_MOD and VFS_PACKED bits
+	int32 size;
+	int32 time;
+} t_gdstamp;
+
+// a table the loaders fill, fixed or a malloc'd array of *num items
+typedef struct
+{
+	void *data;
+	void **array;
+	int *num;
+	int32 size;
+} t_gdtable;
+
+// a sprite pointer in an array, kept as a frame of pak in the cache
+typedef struct
+{
+	void **array;
+	int *num;
+	int32 size;
+	int32 offset;
+	t_ik_spritepak **pak;
+} t_gdsprite;
+
+// ----------------
+//     CONSTANTS
+// ----------------
+
+const char gd_magic[8] = "SAISDAT";
+
+// strings.ini is no table here, but item sounds depend on it
+const char *gd_sources[] =
+{
+	"gamedata/races.ini",
+	"gamedata/weapons.ini",
+	"gamedata/systems.ini",
+	"gamedata/hulls.ini",
+	"gamedata/ships.ini",
+	"gamedata/planets.ini",
+	"gamedata/items.ini",
+	"gamedata/fleets.ini",
+	"gamedata/cards.ini",
+	"gamedata/strings.ini",
+};
+#define GD_SOURCES ((int32)(sizeof(gd_sources)/sizeof(gd_sources[0])))
+
+t_gdtable gd_tables[] =
+{
+	{ races, NULL, NULL, sizeof(races) },
+	{ &num_races, NULL, NULL, sizeof(num_races) },
+	{ enemies, NULL, NULL, sizeof(enemies) },
+	{ &num_enemies, NULL, NULL, sizeof(num_enemies) },
+	{ NULL, (void**)&shipweapons, &num_shipweapons, sizeof(t_shipweapon) },
+	{ NULL, (void**)&shipsystems, &num_shipsystems, sizeof(t_shipsystem) },
+	{ NULL, (void**)&hulls, &num_hulls, sizeof(t_hull) },
+	{ NULL, (void**)&shiptypes, &num_shiptypes, sizeof(t_shiptype) },
+	{ NULL, (void**)&platypes, &num_platypes, sizeof(t_planettype) },
+	{ NULL, (void**)&startypes, &num_startypes, sizeof(t_startype) },
+	{ star_env, NULL, NULL, sizeof(star_env) },
+	{ plgfx_type, NULL, NULL, sizeof(plgfx_type) },
+	{ &num_plgfx, NULL, NULL, sizeof(num_plgfx) },
+	{ planetnames, NULL, NULL, sizeof(planetnames) },
+	{ planetnametype, NULL, NULL, sizeof(planetnametype) },
+	{ &num_planetnames, NULL, NULL, sizeof(num_planetnames) },
+	{ starnames, NULL, NULL, sizeof(starnames) },
+	{ starnametype, NULL, NULL, sizeof(starnametype) },
+	{ &num_starnames, NULL, NULL, sizeof(num_starnames) },
+	{ holenames, NULL, NULL, sizeof(holenames) },
+	{ &num_holenames, NULL, NULL, sizeof(num_holenames) },
+	{ NULL, (void**)&itemtypes, &num_itemtypes, sizeof(t_itemtype) },
+	{ racefleets, NULL, NULL, sizeof(racefleets) },
+	{ &num_racefleets, NULL, NULL, sizeof(num_racefleets) },
+	{ NULL, (void**)&ecards, &num_ecards, sizeof(t_eventcard) },
+};
+#define GD_TABLES ((int32)(sizeof(gd_tables)/sizeof(gd_tables[0])))
+
+t_gdsprite gd_sprites[] =
+{
+	{ (void**)&hulls, &num_hulls, sizeof(t_hull), offsetof(t_hull, sprite), &spr_ships },
+	{ (void**)&hulls, &num_hulls, sizeof(t_hull), offsetof(t_hull, silu), &spr_shipsilu },
+	{ (void**)&shipweapons, &num_shipweapons, sizeof(t_shipweapon), offsetof(t_shipweapon, sprite), &spr_weapons },
+};
+#define GD_SPRITES ((int32)(sizeof(gd_sprites)/sizeof(gd_sprites[0])))
+
+// ----------------
+// GLOBAL VARIABLES
+// ----------------
+
+int32 gamedata_usecache;
+int32 gamedata_cached;
+
+// ----------------
+// LOCAL PROTOTYPES
+// ----------------
+
+void gd_filename(char *fname);
+void gd_stamp(const char *fname, t_gdstamp *st);
+uint32 gd_layout();
+uint32 gd_sum(uint8 *data, int32 size);
+int32 gd_put(uint8 *buf, int32 pos, const void *src, int32 size);
+int32 gd_read(uint8 *map, int32 size, int32 apply);
+
+// ----------------
+// GLOBAL FUNCTIONS
+// ----------------
+
+// fill the tables the .ini loaders would from the mod's cache, if it's
+// there, whole and no older than the .ini files. the combat sprites have
+// to be loaded, the cache only knows frame numbers.
+int32 gamedata_load()
+{
+	t_gdheader *hdr;
+	char fname[256];
+	uint8 *map;
+	int32 size, ok;
+
+	gamedata_cached = 0;
+	gd_filename(fname);
+	map = map_file(fname, &size);
+	if (!map)
+		return 0;
+
+	hdr = (t_gdheader*)map;
+	ok = size >= (int32)sizeof(t_gdheader)
+		&& !memcmp(hdr->magic, gd_magic, sizeof(gd_magic))
+		&& hdr->version == GAMEDATA_VERSION
+		&& hdr->layout == gd_layout()
+		&& hdr->size == size
+		&& hdr->sum == gd_sum(map + sizeof(t_gdheader), size - sizeof(t_gdheader));
+
+	// check it all before touching a table, then fill them
+	if (ok)
+		ok = gd_read(map, size, 0);
+	if (ok)
+		ok = gd_read(map, size, 1);
+
+	unmap_file(map, size);
+	gamedata_cached = ok;
+	return ok;
+}
+
+// write what the .ini loaders just filled the tables with to the cache
+void gamedata_save()
+{
+	t_gdheader hdr;
+	t_gdstamp st;
+	t_ik_spritepak *pak;
+	char fname[256];
+	FILE *fil;
+	uint8 *buf, *item;
+	int32 size, pos, pass;
+	int32 n, c, f;
+
+	buf = NULL; size = 0;
+	for (pass = 0; pass < 2; pass++)
+	{
+		pos = sizeof(t_gdheader);
+		for (n = 0; n < GD_SOURCES; n++)
+		{
+			gd_stamp(gd_sources[n], &st);
+			pos = gd_put(buf, pos, &st, sizeof(st));
+		}
+		for (n = 0; n < GD_TABLES; n++)
+		{
+			if (gd_tables[n].data)
+			{
+				pos = gd_put(buf, pos, gd_tables[n].data, gd_tables[n].size);
+				continue;
+			}
+			c = *gd_tables[n].num;
+			pos = gd_put(buf, pos, &c, sizeof(int32));
+			if (c > 0)
+				pos = gd_put(buf, pos, *gd_tables[n].array, c * gd_tables[n].size);
+		}
+		for (n = 0; n < GD_SPRITES; n++)
+		{
+			pak = *gd_sprites[n].pak;
+			for (c = 0; c < *gd_sprites[n].num; c++)
+			{
+				item = (uint8*)*gd_sprites[n].array + c * gd_sprites[n].size;
+				for (f = pak ? pak->num - 1 : -1; f >= 0; f--)
+					if (*(t_ik_sprite**)(item + gd_sprites[n].offset) == pak->spr[f])
+						break;
+				pos = gd_put(buf, pos, &f, sizeof(int32));
+			}
+		}
+
+		if (!pass)
+		{
+			size = pos;
+			buf = (uint8*)malloc(size);
+			if (!buf)
+				return;
+		}
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, gd_magic, sizeof(gd_magic));
+	hdr.version = GAMEDATA_VERSION;
+	hdr.layout = gd_layout();
+	hdr.size = size;
+	hdr.sum = gd_sum(buf + sizeof(t_gdheader), size - sizeof(t_gdheader));
+	memcpy(buf, &hdr, sizeof(hdr));
+
+	gd_filename(fname);
+	fil = fopen(fname, "wb");
+	if (!fil || fwrite(buf, 1, size, fil) != (size_t)size)
+		fprintf(stderr, "Unable to write gamedata cache '%s'\n", fname);
+	if (fil)
+		fclose(fil);
+	free(buf);
+}
+
+// ----------------
+// LOCAL FUNCTIONS
+// ----------------
+
+// one cache for each mod, next to its own files
+void gd_filename(char *fname)
+{
+	sprintf(fname, "%sgamedata.bin", moddir);
+}
+
+// where myopen() would find fname, and its size and time there
+void gd_stamp(const char *fname, t_gdstamp *st)
+{
+	struct stat s;
+	char realfname[256];
+	int32 f;
+
+	memset(st, 0, sizeof(t_gdstamp));
+	f = vfs_find(fname, VFS_TOP);
+	if (f >= 0 && (st->inmod = vfs_stat(f, &st->size, &st->time)) >= 0)
+		return;
+
+	sprintf(realfname, "%s%s", moddir, fname);
+	st->inmod = 1;
+	if (stat(realfname, &s))
+	{
+		st->inmod = 0;
+		if (stat(fname, &s))
+		{ st->size = -1; return; }
+	}
+	st->size = (int32)s.st_size;
+	st->time = (int32)s.st_mtime;
+}
+
+uint32 gd_layout()
+{
+	uint32 h;
+	int32 n;
+
+	h = 2166136261u;
+	for (n = 0; n < GD_TABLES; n++)
+		h = (h ^ gd_tables[n].size) * 16777619u;
+	for (n = 0; n < GD_SPRITES; n++)
+		h = (h ^ gd_sprites[n].offset) * 16777619u;
+	return h;
+}
+
+uint32 gd_sum(uint8 *data, int32 size)
+{
+	uint32 h = 2166136261u;
+	int32 n;
+
+	for (n = 0; n < size; n++)
+		h = (h ^ data[n]) * 16777619u;
+	return h;
+}
+
+// copy size bytes to buf at pos, or only count them if there's no buf yet
+int32 gd_put(uint8 *buf, int32 pos, const void *src, int32 size)
+{
+	if (buf)
+		memcpy(buf + pos, src, size);
+	return pos + size;
+}
+
+// walk the cache in map. without apply only check that the .ini files
+// haven't changed and that everything is where it should be, with it
+// fill the tables.
+int32 gd_read(uint8 *map, int32 size, int32 apply)
+{
+	t_gdstamp st;
+	t_ik_spritepak *pak;
+	uint8 *item;
+	void *array;
+	int32 nums[GD_TABLES];
+	int32 pos, n, c, f, num;
+
+	pos = sizeof(t_gdheader);
+	if (pos + GD_SOURCES * (int32)sizeof(t_gdstamp) > size)
+		return 0;
+	for (n = 0; n < GD_SOURCES; n++)
+	{
+		gd_stamp(gd_sources[n], &st);
+		if (memcmp(&st, map + pos, sizeof(st)))
+			return 0;
+		pos += sizeof(st);
+	}
+
+	for (n = 0; n < GD_TABLES; n++)
+	{
+		if (gd_tables[n].data)
+		{
+			if (pos + gd_tables[n].size > size)
+				return 0;
+			if (apply)
+				memcpy(gd_tables[n].data, map + pos, gd_tables[n].size);
+			pos += gd_tables[n].size;
+			continue;
+		}
+
+		if (pos + (int32)sizeof(int32) > size)
+			return 0;
+		memcpy(&num, map + pos, sizeof(int32));
+		pos += sizeof(int32);
+		if (num < 0 || num > (size - pos) / gd_tables[n].size)
+			return 0;
+		nums[n] = num;
+		if (apply)
+		{
+			// the deinit functions free() these, so they can't stay in the map
+			array = calloc(num ? num : 1, gd_tables[n].size);
+			if (!array)
+				return 0;
+			memcpy(array, map + pos, num * gd_tables[n].size);
+			*gd_tables[n].array = array;
+			*gd_tables[n].num = num;
+		}
+		pos += num * gd_tables[n].size;
+	}
+
+	for (n = 0; n < GD_SPRITES; n++)
+	{
+		pak = *gd_sprites[n].pak;
+		if (!pak)
+			return 0;
+		num = 0;
+		for (c = 0; c < GD_TABLES; c++)
+			if (gd_tables[c].array == gd_sprites[n].array)
+				num = nums[c];
+		if (pos + num * (int32)sizeof(int32) > size)
+			return 0;
+		for (c = 0; c < num; c++, pos += sizeof(int32))
+		{
+			memcpy(&f, map + pos, sizeof(int32));
+			if (f >= pak->num)
+				return 0;
+			if (!apply)
+				continue;
+			item = (uint8*)*gd_sprites[n].array + c * gd_sprites[n].size;
+			*(t_ik_sprite**)(item + gd_sprites[n].offset) = (f >= 0) ? pak->spr[f] : NULL;
+		}
+	}
+
+	return pos == size;
+}
@@ -0,0 +1,19 @@
+// ----------------
+//    CONSTANTS
+// ----------------
+
+#define GAMEDATA_VERSION 1		// bump when a loader or a table changes
+
+// ----------------
+// GLOBAL VARIABLES
+// ----------------
+
+extern int32	gamedata_usecache;	// set by main_init(), the simulators always parse
+extern int32	gamedata_cached;		// the tables came from the cache, skip the .ini files
+
+// ----------------
+//    PROTOTYPES
+// ----------------
+
+int32 gamedata_load();
+void gamedata_save();
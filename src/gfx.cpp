@@ -5,6 +5,7 @@
 #include <string.h>
 #include <malloc.h>
 #include <math.h>
+#include <SDL.h>
 
 #include "typedefs.h"
 #include "iface_globals.h"
@@ -14,9 +15,30 @@
 
 //#define THICK_MAGNIFIER
 
+#define DIM_LEVELS 8		// halfbritescreen()s that can be nested
+
+// the most of the screen the cursor or magnifier covers
+#define UNDER_W 384
+#define UNDER_H 192
+
+// colormap.dat is three 64k tables after this header. it is rebuilt when
+// the version or the palettes it was made from don't match.
+#define COLORMAP_VERSION 1
+#define COLORMAP_THREADS 4		// the tables are worked out in this many row blocks
+
+typedef struct
+{
+	char magic[4];	// "ICMP"
+	int32 version;
+	uint32 palhash;
+} t_colormaphdr;
+
 // GLOBALS
 
 t_ik_image *magni;
+uint8 gfx_under[UNDER_W*UNDER_H];		// screen under the cursor or magnifier
+int32 gfx_underx, gfx_undery, gfx_underw, gfx_underh;
+int32 gfx_magcol[UNDER_W];		// column of gfx_under each magnifier column shows
 t_ik_image *screen;
 t_ik_image screenbuf;
 int gfx_width, gfx_height, gfx_fullscreen, gfx_switch;
@@ -32,8 +54,16 @@ unsigned char *gfx_transbuffer;
 unsigned char *gfx_lightbuffer;
 unsigned char *gfx_addbuffer;
 
-t_ik_image *dims[8];
+// halfbritescreen() keeps the screen under each popup in dim_arena. the
+// first level is kept whole, later ones only keep the rows that differ
+// from the level below darkened, which is all but what the popup drew.
 int num_dims;
+int32 dim_light[DIM_LEVELS];	// lightbuffer row each level was darkened with
+int32 dim_start[DIM_LEVELS];	// where each level's rows start in dim_arena
+int32 *dim_row;			// offset of each level's rows in dim_arena, -1 if not kept
+uint8 *dim_arena;
+int32 dim_size, dim_used;
+uint8 *dim_tmp;			// a row, for comparing against
 
 uint8 globalpal[768];
 uint8 currentpal[768];
@@ -41,6 +71,33 @@ uint8 currentpal[768];
 int32 sin1k[1024];
 int32 cos1k[1024];
 
+int gfx_libmath;	// get_direction() through atan2 instead of the tables
+
+// direction units are 512/3.14159 per radian, like the original atan2 code
+float64 dir_atan[257];		// atan(i/256) in direction units
+float64 dir_sin[514];			// unit vector at the start of each direction
+float64 dir_cos[514];
+float64 dir_right;				// pi/2 in direction units
+
+// get_rgb_color() looks in a 32x32x32 grid of cells of 8x8x8 colours.
+// each cell lists the palette entries that can be nearest to a colour
+// in it. list_rgb_cells() works them all out, get_rgb_color() only reads
+// them and scans the palette for a cell that isn't listed.
+uint8 pal_cellpal[768];			// palette the cells were listed for
+int32 pal_cellstart[32768];	// where each cell's list is in pal_cands
+uint16 pal_cellnum[32768];	// length of each list, 0 if not listed yet
+uint8 *pal_cands;
+int32 pal_numcands, pal_maxcands;
+
+uint8 *cm_pal;							// palette calc_color_tables() blends
+
+int32 list_rgb_cell(int32 cell);
+uint32 colormap_hash(uint8 *pal);
+int32 colormap_load(uint8 *pal);
+int colormap_rows(void *data);
+int32 dim_keeprow(int32 d, int32 y);
+void dim_getrow(int32 d, int32 y, uint8 *dst);
+
 // PUTPIXEL/GETPIXEL
 
 void ik_setclip(int32 left, int32 top, int32 right, int32 bottom)
@@ -53,11 +110,13 @@ void ik_setclip(int32 left, int32 top, int32 right, int32 bottom)
 
 void ik_putpixel(t_ik_image *img, int32 x, int32 y, uint32 c)
 {
+	ik_dirty(img, x, y, x+1, y+1);
 	img->data[y*img->pitch+x]=c;
 }
 
 void ik_putpixel_add(t_ik_image *img, int32 x, int32 y, uint32 c)
 {
+	ik_dirty(img, x, y, x+1, y+1);
 	img->data[y*img->pitch+x]=gfx_addbuffer[img->data[y*img->pitch+x]+(c<<8)];
 }
 
@@ -81,6 +140,8 @@ void ik_drawline(t_ik_image *img, int32 xb, int32 yb, int32 xe, int32 ye, int32
 
   if (dx==0 && dy==0) return;
 
+	ik_dirty(img, MIN(xb,xe), MIN(yb,ye), MAX(xb,xe)+1, MAX(yb,ye)+1);
+
 	x1=abs(dx); y1=abs(dy);
   if (x1>y1)
   {
@@ -162,6 +223,8 @@ void ik_drawbox(t_ik_image *img, int32 xb, int32 yb, int32 xe, int32 ye, int32 c
 	if (xe < xb) { w = xe; xe = xb; xb = w; }
 	if (ye < yb) { w = ye; ye = yb; yb = w; }
 
+	ik_dirty(img, MAX(xb, c_minx), MAX(yb, c_miny), MIN(xe+1, c_maxx), MIN(ye+1, c_maxy));
+
 	y = MAX(yb, c_miny);
 	p = img->data + y*img->pitch + MAX(xb, c_minx);
 	w = MIN(xe+1, c_maxx) - MAX(xb, c_minx);
@@ -185,6 +248,8 @@ void ik_copybox(t_ik_image *src, t_ik_image *dst, int32 xb, int32 yb, int32 xe,
 {
 	int32 y;
 
+	ik_dirty(dst, xd, yd, xd+xe-xb, yd+ye-yb);
+
 	for (y=0;y<ye-yb;y++)
 		memcpy(ik_image_pointer(dst,xd,y+yd),ik_image_pointer(src,xb,y+yb),xe-xb);
 }
@@ -207,7 +272,39 @@ void ik_drawmeter(t_ik_image *img, int32 xb, int32 yb, int32 xe, int32 ye, int32
 
 // FIND RGB COLOR
 
+// nearest palette entry, the first one on a tie
 int32 get_rgb_color(int32 r, int32 g, int32 b)
+{
+	int32 c,e,ee,x,n,r1,g1,b1;
+	int32 cell;
+	uint8 *p, *cand;
+
+	if (r < 0 || r > 255 || g < 0 || g > 255 || b < 0 || b > 255)
+		return get_rgb_color_scan(r, g, b);
+
+	cell = ((r>>3)<<10) + ((g>>3)<<5) + (b>>3);
+	if (!pal_cellnum[cell])
+		return get_rgb_color_scan(r, g, b);
+
+	cand = pal_cands + pal_cellstart[cell];
+	n = pal_cellnum[cell];
+	c=0;ee=200000;
+	for (x=0;x<n;x++)
+	{
+		p=currentpal+cand[x]*3;
+		r1=r-p[0];
+		g1=g-p[1];
+		b1=b-p[2];
+		e=r1*r1+g1*g1+b1*b1;
+		if (e<ee)
+		{ c=cand[x]; ee=e; }
+	}
+
+	return c;
+}
+
+// the same, trying every palette entry
+int32 get_rgb_color_scan(int32 r, int32 g, int32 b)
 {
 	int32 c,e,ee,x,r1,g1,b1;
 	int32 c0;
@@ -227,35 +324,197 @@ int32 get_rgb_color(int32 r, int32 g, int32 b)
 	return c;
 }
 
+// forget the cells if the palette has changed since they were listed.
+// whoever changes currentpal calls this (or list_rgb_cells()) before the
+// next get_rgb_color().
+void check_rgb_cells()
+{
+	if (memcmp(pal_cellpal, currentpal, 768))
+	{
+		memcpy(pal_cellpal, currentpal, 768);
+		memset(pal_cellnum, 0, sizeof(pal_cellnum));
+		pal_numcands = 0;
+	}
+}
+
+// list every cell up front, so get_rgb_color() only reads and can run on
+// several threads at once. returns 0 if there was no memory.
+int32 list_rgb_cells()
+{
+	int32 cell;
+
+	check_rgb_cells();
+	for (cell = 0; cell < 32768; cell++)
+		if (!pal_cellnum[cell] && !list_rgb_cell(cell))
+			return 0;
+
+	return 1;
+}
+
+// list the palette entries that may be nearest to some colour in cell.
+// one entry is at most far away from all of the cell; entries that are
+// further than that from all of it can't be nearest to any of it.
+// returns 0 if there was no memory.
+int32 list_rgb_cell(int32 cell)
+{
+	int32 lo[3], near[256];
+	int32 x, k, d, e, ee, dn, df;
+	uint8 *cands;
+
+	lo[0] = (cell>>10)<<3;
+	lo[1] = ((cell>>5)&31)<<3;
+	lo[2] = (cell&31)<<3;
+
+	if (pal_numcands + 256 > pal_maxcands)
+	{
+		cands = (uint8*)realloc(pal_cands, pal_maxcands + 16384);
+		if (!cands)
+			return 0;
+		pal_cands = cands;
+		pal_maxcands += 16384;
+	}
+
+	ee = 200000;
+	for (x = 0; x < 256; x++)
+	{
+		dn = 0; df = 0;
+		for (k = 0; k < 3; k++)
+		{
+			d = currentpal[x*3+k] - lo[k];
+			if (d < 0)
+			{	dn += d*d; df += (d-7)*(d-7); }
+			else if (d > 7)
+			{	dn += (d-7)*(d-7); df += d*d; }
+			else
+				df += MAX(d, 7-d)*MAX(d, 7-d);
+		}
+		near[x] = dn;
+		if (df < ee)
+			ee = df;
+	}
+
+	e = pal_numcands;
+	for (x = 0; x < 256; x++)
+		if (near[x] <= ee)
+			pal_cands[pal_numcands++] = x;
+
+	pal_cellstart[cell] = e;
+	pal_cellnum[cell] = pal_numcands - e;
+	return 1;
+}
+
 // CALCULATE COLOR TABLES
 
 void calc_color_tables(uint8 *pal)
 {
-	int32 x,y;
+	SDL_Thread *th[COLORMAP_THREADS];
+	int32 blocks[COLORMAP_THREADS];
+	int32 c, threads;
+	t_colormaphdr hdr;
 	FILE *colormap;
 
-	gfx_addbuffer=(unsigned char*)malloc(65536);
-	gfx_transbuffer=(unsigned char*)malloc(65536);
-	gfx_lightbuffer=(unsigned char*)malloc(65536);
+	check_rgb_cells();
+
+	// padded for the 4 byte reads of gfx_fxrow()
+	gfx_addbuffer=(unsigned char*)calloc(65536+4, 1);
+	gfx_transbuffer=(unsigned char*)calloc(65536+4, 1);
+	gfx_lightbuffer=(unsigned char*)calloc(65536+4, 1);
 
 	if (gfx_transbuffer==NULL || gfx_lightbuffer==NULL || gfx_addbuffer==NULL)
 		return;  // fail
 
-	colormap=myopen("graphics/colormap.dat", "rb");
-	if (colormap)
-	{
-		size_t read_count;
-		read_count = fread(gfx_transbuffer, 1, 65536, colormap);
-		if(read_count != 65536) { throw std::runtime_error("short read"); }
-		read_count = fread(gfx_lightbuffer, 1, 65536, colormap);
-		if(read_count != 65536) { throw std::runtime_error("short read"); }
-		read_count = fread(gfx_addbuffer,   1, 65536, colormap);
-		if(read_count != 65536) { throw std::runtime_error("short read"); }
-		fclose(colormap);
+	if (colormap_load(pal))
+		return;
+
+	// with every cell listed the row blocks share get_rgb_color() safely,
+	// otherwise they run one after another
+	cm_pal = pal;
+	threads = 0;
+	if (list_rgb_cells())
+		for (c = 0; c < COLORMAP_THREADS; c++)
+		{
+			blocks[c] = c;
+			th[c] = SDL_CreateThread(colormap_rows, &blocks[c]);
+			if (!th[c])
+				break;
+			threads++;
+		}
+
+	for (c = threads; c < COLORMAP_THREADS; c++)
+	{
+		blocks[c] = c;
+		colormap_rows(&blocks[c]);
+	}
+	for (c = 0; c < threads; c++)
+		SDL_WaitThread(th[c], NULL);
+
+	colormap=myopen("graphics/colormap.dat","wb");
+	if (!colormap)
+	{
+		fprintf(stderr, "unable to write graphics/colormap.dat\n");
 		return;
 	}
 
-	for (y=0;y<256;y++)
+	memcpy(hdr.magic, "ICMP", 4);
+	hdr.version = COLORMAP_VERSION;
+	hdr.palhash = colormap_hash(pal);
+	fwrite(&hdr, sizeof(t_colormaphdr), 1, colormap);
+	fwrite(gfx_transbuffer, 1, 65536, colormap);
+	fwrite(gfx_lightbuffer, 1, 65536, colormap);
+	fwrite(gfx_addbuffer, 1, 65536, colormap);
+
+	fclose(colormap);
+}
+
+// fnv-1a of the palette the tables blend and the one they pick from
+uint32 colormap_hash(uint8 *pal)
+{
+	uint32 h;
+	int32 x;
+
+	h = 2166136261u;
+	for (x = 0; x < 768; x++)
+		h = (h ^ pal[x]) * 16777619u;
+	for (x = 0; x < 768; x++)
+		h = (h ^ currentpal[x]) * 16777619u;
+
+	return h;
+}
+
+// read the tables from colormap.dat, if it was made for these palettes
+int32 colormap_load(uint8 *pal)
+{
+	t_colormaphdr hdr;
+	FILE *colormap;
+	int32 ok;
+
+	colormap=myopen("graphics/colormap.dat", "rb");
+	if (!colormap)
+		return 0;
+
+	ok = (fread(&hdr, sizeof(t_colormaphdr), 1, colormap) == 1 &&
+				!memcmp(hdr.magic, "ICMP", 4) && hdr.version == COLORMAP_VERSION &&
+				hdr.palhash == colormap_hash(pal) &&
+				fread(gfx_transbuffer, 1, 65536, colormap) == 65536 &&
+				fread(gfx_lightbuffer, 1, 65536, colormap) == 65536 &&
+				fread(gfx_addbuffer,   1, 65536, colormap) == 65536);
+	fclose(colormap);
+
+	if (!ok)
+		fprintf(stderr, "graphics/colormap.dat is out of date, rebuilding\n");
+	return ok;
+}
+
+// work out one block of rows of the three tables
+int colormap_rows(void *data)
+{
+	int32 x, y, yb, ye;
+	uint8 *pal = cm_pal;
+
+	yb = *(int32*)data * (256/COLORMAP_THREADS);
+	ye = yb + 256/COLORMAP_THREADS;
+
+	for (y=yb;y<ye;y++)
 		for (x=0;x<256;x++)
 		{
 			gfx_transbuffer[y*256+x]=get_rgb_color( ((int32)pal[y*3]+pal[x*3])>>1,
@@ -269,13 +528,7 @@ void calc_color_tables(uint8 *pal)
 																						MIN((int32)pal[y*3+2]+pal[x*3+2],255) );
 		}
 
-	colormap=myopen("graphics/colormap.dat","wb");
-
-	fwrite(gfx_transbuffer, 1, 65536, colormap);
-	fwrite(gfx_lightbuffer, 1, 65536, colormap);
-	fwrite(gfx_addbuffer, 1, 65536, colormap);
-
-	fclose(colormap);
+	return 0;
 }
 
 void del_color_tables()
@@ -444,7 +697,7 @@ t_ik_image *ik_load_tga(const char *fname, uint8 *pal)
 	int p;
 	uint8 hdr[18];
 
-	fil = fopen(fname, "rb");
+	fil = myopen(fname, "rb");
 	if (!fil) return NULL;
 
 	if(fread(hdr, 1, 18, fil) != 18)
@@ -564,7 +817,21 @@ void ik_save_tga(const char *fname, t_ik_image *img, uint8 *pal)
 
 }
 
-int get_direction(int32 dx, int32 dy)
+void gfx_initdirection()
+{
+	int32 c;
+
+	for (c = 0; c < 257; c++)
+		dir_atan[c] = atan(c/256.0)*512/3.14159;
+	for (c = 0; c < 514; c++)
+	{
+		dir_sin[c] = sin(c*3.14159/512);
+		dir_cos[c] = cos(c*3.14159/512);
+	}
+	dir_right = atan2(1.0, 0.0)*512/3.14159;
+}
+
+int get_direction_libm(int32 dx, int32 dy)
 {
 	int32 a;
 
@@ -577,6 +844,68 @@ int get_direction(int32 dx, int32 dy)
 	return a;
 }
 
+// same result as get_direction_libm(). the angle is estimated from the
+// octant and the atan table, then stepped until it sits between the two
+// boundaries around x,y, tested exactly with cross products.
+int get_direction(int32 dx, int32 dy)
+{
+	float64 x, y, e;
+	int32 a;
+
+	if (gfx_libmath)
+		return get_direction_libm(dx, dy);
+
+	if (dx==0 && dy==0)
+		return 0;
+
+	// atan2 truncates towards zero, so left is a mirror of right
+	x = ABS((float64)dx);
+	y = dy;
+
+	if (x <= y)
+		e = dir_atan[(int32)(x*256/y)];
+	else if (y >= 0)
+		e = dir_right - dir_atan[(int32)(y*256/x)];
+	else if (x > -y)
+		e = dir_right + dir_atan[(int32)(-y*256/x)];
+	else
+		e = 2*dir_right - dir_atan[(int32)(-x*256/y)];
+
+	a = (int32)e;
+	while (a < 512 && x*dir_cos[a+1] - y*dir_sin[a+1] >= 0)
+		a++;
+	while (a > 0 && x*dir_cos[a] - y*dir_sin[a] < 0)
+		a--;
+
+	if (dx < 0)
+		a = -a;
+	a = (a + 1024) & 1023;
+
+	return a;
+}
+
+// compare get_direction() against atan2 for every dx,dy within range,
+// returns the number of mismatches
+int32 gfx_checkdirection(int32 range)
+{
+	int32 dx, dy;
+	int32 bad;
+
+	bad = 0;
+	for (dy = -range; dy <= range; dy++)
+	for (dx = -range; dx <= range; dx++)
+	if (get_direction(dx, dy) != get_direction_libm(dx, dy))
+	{
+		if (bad < 10)
+			fprintf(stderr, "get_direction(%d, %d) = %d, atan2 gives %d\n",
+							dx, dy, get_direction(dx, dy), get_direction_libm(dx, dy));
+		bad++;
+	}
+
+	return bad;
+}
+
+// sqrt is correctly rounded and beats an integer square root here
 int get_distance(int32 dx, int32 dy)
 {
 	int32 r;
@@ -591,19 +920,31 @@ int get_distance(int32 dx, int32 dy)
 
 void halfbritescreen()
 {
-	int32 x, y;
+	int32 y;
 	int32 l;
-	uint8 *po;
 
-	if (num_dims >= 8)
+	if (num_dims >= DIM_LEVELS)
 		return;
 
 	prep_screen();
-	dims[num_dims] = new_image(screen->w, screen->h);
-	if (!dims[num_dims])
-	{	free_screen(); return; }
+	if (!dim_row)
+	{
+		dim_row = (int32*)malloc(DIM_LEVELS * screen->h * sizeof(int32));
+		dim_tmp = (uint8*)malloc(screen->w);
+		dim_size = screen->w * screen->h * 2;
+		dim_arena = (uint8*)malloc(dim_size);
+		if (!dim_row || !dim_tmp || !dim_arena)
+		{
+			free(dim_row); free(dim_tmp); free(dim_arena);
+			dim_row = NULL; dim_tmp = NULL; dim_arena = NULL;
+			free_screen(); return;
+		}
+	}
 
-	ik_copybox(screen, dims[num_dims], 0, 0, screen->w, screen->h, 0, 0);
+	dim_start[num_dims] = dim_used;
+	for (y = 0; y < screen->h; y++)
+		if (!dim_keeprow(num_dims, y))
+		{	dim_used = dim_start[num_dims]; free_screen(); return; }
 	num_dims++;
 
 	if (num_dims > 1)
@@ -612,49 +953,94 @@ void halfbritescreen()
 		l = 11;
 
 	l<<=8;
+	dim_light[num_dims-1] = l;
 
+	ik_dirty(screen, 0, 0, screen->w, screen->h);
 	for (y = 0; y < screen->h; y++)
-	{
-		po = screen->data + screen->pitch*y;
-		for (x = screen->w; x; x--)
-		{
-			*po = gfx_lightbuffer[l+*po];
-			po++;
-		}
-	}
+		gfx_maprow(ik_image_pointer(screen, 0, y), screen->w, gfx_lightbuffer + l);
 	free_screen();
 }
 
 void reshalfbritescreen()
 {
+	int32 y;
+
 	if (num_dims <= 0)
 		return;
 
 	prep_screen();
 
 	num_dims--;
-	ik_copybox(dims[num_dims], screen, 0, 0, screen->w, screen->h, 0, 0);
-	del_image(dims[num_dims]);
-	dims[num_dims]=NULL;
+	ik_dirty(screen, 0, 0, screen->w, screen->h);
+	for (y = 0; y < screen->h; y++)
+		dim_getrow(num_dims, y, ik_image_pointer(screen, 0, y));
+	dim_used = dim_start[num_dims];
 
 	free_screen();
 }
 
+// straight back to the first level, the ones on top of it don't matter
 void resallhalfbritescreens()
 {
+	int32 y;
+
 	if (num_dims <= 0)
 		return;
 
 	prep_screen();
 
-	while (num_dims)
+	ik_dirty(screen, 0, 0, screen->w, screen->h);
+	for (y = 0; y < screen->h; y++)
+		dim_getrow(0, y, ik_image_pointer(screen, 0, y));
+	num_dims = 0;
+	dim_used = 0;
+
+	free_screen();
+}
+
+// keep row y of the screen as level d has it, if it isn't level d-1's
+// darkened. 0 if the arena is full and can't grow.
+int32 dim_keeprow(int32 d, int32 y)
+{
+	uint8 *p, *row = ik_image_pointer(screen, 0, y);
+
+	if (d > 0)
+	{
+		dim_getrow(d-1, y, dim_tmp);
+		gfx_maprow(dim_tmp, screen->w, gfx_lightbuffer + dim_light[d-1]);
+		if (!memcmp(dim_tmp, row, screen->w))
+		{
+			dim_row[d*screen->h + y] = -1;
+			return 1;
+		}
+	}
+
+	if (dim_used + screen->w > dim_size)
 	{
-		num_dims--;
-		ik_copybox(dims[num_dims], screen, 0, 0, screen->w, screen->h, 0, 0);
-		del_image(dims[num_dims]);
-		dims[num_dims]=NULL;
+		p = (uint8*)realloc(dim_arena, dim_size * 2);
+		if (!p)
+			return 0;
+		dim_arena = p;
+		dim_size *= 2;
 	}
-	free_screen();
+
+	memcpy(dim_arena + dim_used, row, screen->w);
+	dim_row[d*screen->h + y] = dim_used;
+	dim_used += screen->w;
+	return 1;
+}
+
+// row y of the screen as it was at level d
+void dim_getrow(int32 d, int32 y, uint8 *dst)
+{
+	if (dim_row[d*screen->h + y] > -1)
+	{
+		memcpy(dst, dim_arena + dim_row[d*screen->h + y], screen->w);
+		return;
+	}
+
+	dim_getrow(d-1, y, dst);
+	gfx_maprow(dst, screen->w, gfx_lightbuffer + dim_light[d-1]);
 }
 
 extern t_ik_spritepak *spr_IFbutton;
@@ -664,6 +1050,47 @@ void ik_draw_mousecursor()
 	ik_dsprite(screen, ik_mouse_x, ik_mouse_y, spr_IFbutton->spr[2], 0);
 }
 
+// keep w x h of the screen at x, y (0 off the edges) for gfx_restoreunder()
+void gfx_saveunder(int32 x, int32 y, int32 w, int32 h)
+{
+	int32 y1, xb, xe;
+	uint8 *p;
+
+	w = MIN(w, UNDER_W); h = MIN(h, UNDER_H);
+	gfx_underx = x; gfx_undery = y;
+	gfx_underw = w; gfx_underh = h;
+
+	xb = MAX(-x, 0); xe = MIN(screen->w - x, w);
+	for (y1 = 0; y1 < h; y1++)
+	{
+		p = gfx_under + y1*w;
+		if (y+y1 < 0 || y+y1 >= screen->h || xb >= xe)
+		{
+			memset(p, 0, w);
+			continue;
+		}
+		memset(p, 0, xb);
+		memcpy(p+xb, ik_image_pointer(screen, x+xb, y+y1), xe-xb);
+		memset(p+xe, 0, w-xe);
+	}
+}
+
+// put back what gfx_saveunder() kept, inside the clip rect
+void gfx_restoreunder()
+{
+	int32 y, xb, xe, yb, ye;
+
+	xb = MAX(gfx_underx, c_minx); xe = MIN(gfx_underx+gfx_underw, c_maxx);
+	yb = MAX(gfx_undery, c_miny); ye = MIN(gfx_undery+gfx_underh, c_maxy);
+	if (xb >= xe || yb >= ye)
+		return;
+
+	ik_dirty(screen, xb, yb, xe, ye);
+	for (y = yb; y < ye; y++)
+		memcpy(ik_image_pointer(screen, xb, y),
+					 gfx_under + (y-gfx_undery)*gfx_underw + (xb-gfx_underx), xe-xb);
+}
+
 extern t_ik_spritepak *spr_SMraces;
 
 void gfx_blarg()
@@ -678,6 +1105,10 @@ void gfx_initmagnifier()
 	int p;
 #endif
 
+	// the magnifier shows the middle half of what's under it at 2x
+	for (x = 0; x < UNDER_W; x++)
+		gfx_magcol[x] = UNDER_W/4 + x/2;
+
 	magni = new_image(128, 128);
 	for (y = 0; y < 128; y++)
 		for (x = 0; x < 128; x++)
@@ -730,57 +1161,36 @@ void gfx_deinitmagnifier()
 	del_image(magni);
 }
 
+// magnify the middle of the 384x192 around the mouse over all of it,
+// straight from what gfx_saveunder() kept of it. black shows as 16.
 void gfx_magnify()
 {
-	t_ik_sprite *mag;
-	int  y;	// x
-	unsigned char *p;
-	//unsigned char *m;
-
-//	mag = get_sprite(screen, ik_mouse_x-64, ik_mouse_y-64, 128, 128);
-	mag = get_sprite(screen, ik_mouse_x-96, ik_mouse_y-48, 192, 96);
-	p = mag->data;
-	y = mag->h * mag->w;
-	while (y--)
-	{
-		if (!*p)
-			*p = 16;
-		p++;
-	}
-/*
-	p = mag->data;
-	m = magni->data;
-	for (y = 0; y < mag->h; y++)
-		for (x = 0; x < mag->w; x++)
-		{
-			//if (y == 0 || x == 0 || y == mag->h-1 || x == mag->w-1)
-			//	*p = 178;
-			//else
+	int32 x, y, xb, xe, yb, ye;
+	uint8 *src, *dst;
+	uint8 c;
+
+	xb = MAX(gfx_underx, c_minx) - gfx_underx; xe = MIN(gfx_underx+UNDER_W, c_maxx) - gfx_underx;
+	yb = MAX(gfx_undery, c_miny) - gfx_undery; ye = MIN(gfx_undery+UNDER_H, c_maxy) - gfx_undery;
 
-			if (*m == 1)
+	if (xb < xe && yb < ye)
+	{
+		ik_dirty(screen, gfx_underx+xb, gfx_undery+yb, gfx_underx+xe, gfx_undery+ye);
+		for (y = yb; y < ye; y++)
+		{
+			dst = ik_image_pointer(screen, gfx_underx+xb, gfx_undery+y);
+			if (y > yb && (y&1))		// second of the two rows from this one
 			{
-				if (!*p)
-					*p = 16;
+				memcpy(dst, dst - screen->pitch, xe-xb);
+				continue;
 			}
-			else if (*m == 2)
+			src = gfx_under + (UNDER_H/4 + y/2)*UNDER_W;
+			for (x = xb; x < xe; x++)
 			{
-				*p = 178;
+				c = src[gfx_magcol[x]];
+				dst[x-xb] = c ? c : 16;
 			}
-			else
-				*p = *m;
-
-			p++; m++;
 		}
+	}
 
-	ik_drsprite(screen, ik_mouse_x+1, ik_mouse_y+1, 0, 256, mag, 0);
-	*/
-	ik_drsprite(screen, ik_mouse_x+1, ik_mouse_y+1, 0, 384, mag, 0);
-	interface_thinborder(screen, ik_mouse_x-192, ik_mouse_y-96, ik_mouse_x+192, ik_mouse_y+96, 11, -1);
-	/*
-	ik_drawline(screen, ik_mouse_x-192, ik_mouse_y-96, ik_mouse_x+191, ik_mouse_y-96, 178, 0, 255, 0);
-	ik_drawline(screen, ik_mouse_x-192, ik_mouse_y+95, ik_mouse_x+191, ik_mouse_y+95, 178, 0, 255, 0);
-	ik_drawline(screen, ik_mouse_x-192, ik_mouse_y-96, ik_mouse_x-192, ik_mouse_y+95, 178, 0, 255, 0);
-	ik_drawline(screen, ik_mouse_x+191, ik_mouse_y-96, ik_mouse_x+191, ik_mouse_y+95, 178, 0, 255, 0);
-	*/
-	free_sprite(mag);
+	interface_thinborder(screen, gfx_underx, gfx_undery, gfx_underx+UNDER_W, gfx_undery+UNDER_H, 11, -1);
 }
@@ -22,11 +22,14 @@ typedef struct {
 	int32 w,h;    // size
 	uint32 co;     // average color
 	uint8 *data;	// linear bitmap
+	int32 *runs;	// opaque runs of each row, or NULL (see sprite_buildruns)
 } t_ik_sprite;
 
 typedef struct {
 	int32 num;
 	t_ik_sprite **spr;
+	uint8 *map;		// the .spr file its frames point into, or NULL
+	int32 mapsize;
 } t_ik_spritepak;
 
 typedef struct {
@@ -50,6 +53,7 @@ extern unsigned char *gfx_addbuffer;
 
 extern int32 sin1k[1024];
 extern int32 cos1k[1024];
+extern int gfx_libmath;
 
 // resizing (also initialization)
 extern int gfx_window_width, gfx_window_height;
@@ -68,6 +72,7 @@ void ik_setclip(int32 left, int32 top, int32 right, int32 bottom);
 void ik_putpixel(t_ik_image *img, int32 x, int32 y, uint32 c);
 int32 ik_getpixel(t_ik_image *img, int32 x, int32 y);
 uint8 *ik_image_pointer(t_ik_image *img, int32 x, int32 y);
+void ik_dirty(t_ik_image *img, int32 xb, int32 yb, int32 xe, int32 ye);
 void ik_drawline(t_ik_image *img, int32 xb, int32 yb, int32 xe, int32 ye, int32 c1, int32 c2=0, uint8 mask=255, uint8 fx=0);
 void ik_drawbox(t_ik_image *img, int32 xb, int32 yb, int32 xe, int32 ye, int32 c);
 void ik_copybox(t_ik_image *src, t_ik_image *dst, int32 xb, int32 yb, int32 xe, int32 ye, int32 xd, int32 yd);
@@ -75,6 +80,8 @@ void ik_drawmeter(t_ik_image *img, int32 xb, int32 yb, int32 xe, int32 ye, int32
 void ik_draw_mousecursor();
 void gfx_blarg();
 void gfx_magnify();
+void gfx_saveunder(int32 x, int32 y, int32 w, int32 h);
+void gfx_restoreunder();
 
 // screen blits & other management
 void prep_screen(); // call before drawing stuff to *screen
@@ -90,16 +97,34 @@ void update_palette();  // blit palette entries to hardware
 void set_palette_entry(int n, int r, int g, int b);
 int get_palette_entry(int n);
 int32 get_rgb_color(int32 r, int32 g, int32 b);
+int32 get_rgb_color_scan(int32 r, int32 g, int32 b);
+void check_rgb_cells();
+int32 list_rgb_cells();
 void calc_color_tables(uint8 *pal);
 void del_color_tables();
 
 // misc
+void gfx_initdirection();
 int get_direction(int32 dx, int32 dy);
+int get_direction_libm(int32 dx, int32 dy);
 int get_distance(int32 dx, int32 dy);
+int32 gfx_checkdirection(int32 range);
 
 void gfx_initmagnifier();
 void gfx_deinitmagnifier();
 
+// ------------------------
+//       GFX_BLIT.CPP
+// ------------------------
+
+// row kernels for the blitters, vectorized where the cpu allows
+extern int32 gfx_blitcpu;
+void gfx_initblit();
+void gfx_maskrow(uint8 *dst, uint8 *src, int32 n, int32 co);
+void gfx_fxrow(uint8 *dst, uint8 *src, int32 n, int32 fx);
+void gfx_maprow(uint8 *dst, int32 n, uint8 *map);
+int32 gfx_blitbench(t_ik_spritepak **paks, int32 num, int32 reps);
+
 // ------------------------
 //         FONT.CPP
 // ------------------------
@@ -123,6 +148,7 @@ void							free_sprite(t_ik_sprite *spr);
 
 t_ik_sprite *			get_sprite(t_ik_image *img, int32 x, int32 y, int32 w, int32 h);
 int32							calc_sprite_color(t_ik_sprite *spr);
+int32							sprite_buildruns(t_ik_sprite *spr);
 
 t_ik_spritepak *	new_spritepak(int32 num);
 void							free_spritepak(t_ik_spritepak *pak);
@@ -131,6 +157,11 @@ t_ik_spritepak *	load_sprites(const char *fname);
 void							save_sprites(const char *fname, t_ik_spritepak *pak);
 
 
+// rotated sprite cache, in bytes (0 turns it off) and calls served
+extern int32 gfx_rotcache_budget;
+extern uint32 gfx_rotcache_hits;
+extern uint32 gfx_rotcache_misses;
+
 // sprite drawing
 void ik_dsprite(t_ik_image *img, int32 x, int32 y, t_ik_sprite *spr, int32 flags=0);
 void ik_drsprite(t_ik_image *img, int32 x, int32 y, int32 r, int32 s, t_ik_sprite *spr, int32 flags=0);
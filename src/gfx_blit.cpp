@@ -0,0 +1,296 @@
+// ----------------
+//     INCLUDES
+// ----------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "typedefs.h"
+#include "gfx.h"
+
+// vector kernels are built for any x86 gcc and picked at run time, the
+// plain loops below them are the reference and do whatever is left over
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define BLIT_X86
+#include <immintrin.h>
+#endif
+
+// ----------------
+// GLOBAL VARIABLES
+// ----------------
+
+int32 gfx_blitcpu;		// row kernels in use, see gfx_initblit()
+
+// ----------------
+// LOCAL PROTOTYPES
+// ----------------
+
+#ifdef BLIT_X86
+int32 maskrow_sse2(uint8 *dst, uint8 *src, int32 n, int32 co);
+int32 maskrow_avx2(uint8 *dst, uint8 *src, int32 n, int32 co);
+int32 fxrow_avx2(uint8 *dst, uint8 *src, int32 n, int32 fx);
+int32 maprow_avx2(uint8 *dst, int32 n, uint8 *map);
+#endif
+
+// ----------------
+// GLOBAL FUNCTIONS
+// ----------------
+
+// pick the best row kernels this cpu runs, 0 plain C, 1 sse2, 2 avx2
+void gfx_initblit()
+{
+	gfx_blitcpu = 0;
+#ifdef BLIT_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2"))
+		gfx_blitcpu = 1;
+	if (__builtin_cpu_supports("avx2"))
+		gfx_blitcpu = 2;
+#endif
+}
+
+// copy the n pixels of src that aren't 0 to dst. with co set, colours
+// 1..15 go to the co'th ramp, as ik_dsprite() draws them.
+void gfx_maskrow(uint8 *dst, uint8 *src, int32 n, int32 co)
+{
+	int32 d = 0;
+
+#ifdef BLIT_X86
+	if (gfx_blitcpu >= 2)
+		d = maskrow_avx2(dst, src, n, co);
+	else if (gfx_blitcpu >= 1)
+		d = maskrow_sse2(dst, src, n, co);
+#endif
+
+	for (; d < n; d++)
+	{
+		if (!src[d])
+			continue;
+		if (co && src[d] < 16)
+			dst[d] = src[d] + co*16;
+		else
+			dst[d] = src[d];
+	}
+}
+
+// blend the n pixels of src that aren't 0 onto dst through the colour
+// tables, fx as in ik_drsprite(): 1 light (level in fx>>8), 2 trans, 4 add
+void gfx_fxrow(uint8 *dst, uint8 *src, int32 n, int32 fx)
+{
+	int32 d = 0;
+	int32 c;
+
+#ifdef BLIT_X86
+	if (gfx_blitcpu >= 2)
+		d = fxrow_avx2(dst, src, n, fx);
+#endif
+
+	for (; d < n; d++)
+	{
+		c = src[d];
+		if (!c)
+			continue;
+		if (fx&1)  c=gfx_lightbuffer[(c<<8)+(fx>>8)];
+		if (fx&2)  c=gfx_transbuffer[(c<<8)+dst[d]];
+		if (fx&4)  c=gfx_addbuffer[(c<<8)+dst[d]];
+		dst[d] = c;
+	}
+}
+
+// run n pixels of dst through a row of one of the colour tables
+void gfx_maprow(uint8 *dst, int32 n, uint8 *map)
+{
+	int32 d = 0;
+
+#ifdef BLIT_X86
+	if (gfx_blitcpu >= 2)
+		d = maprow_avx2(dst, n, map);
+#endif
+
+	for (; d < n; d++)
+		dst[d] = map[dst[d]];
+}
+
+// time sprite drawing with each set of kernels the cpu has, over the
+// frames of paks. returns the number that drew differently from plain C.
+int32 gfx_blitbench(t_ik_spritepak **paks, int32 num, int32 reps)
+{
+	t_ik_image *img;
+	t_ik_sprite *spr;
+	int32 cpu, best, bad;
+	int32 p, s, r, x, y, l, n;
+	uint32 sum, ref;
+	clock_t t0;
+
+	img = new_image(640, 480);
+	if (!img)
+	{
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+	ik_setclip(0, 0, 640, 480);
+
+	best = gfx_blitcpu;
+	bad = 0; ref = 0;
+	for (cpu = 0; cpu <= best; cpu++)
+	{
+		gfx_blitcpu = cpu;
+		for (n = 0; n < 640*480; n++)
+			img->data[n] = (uint8)(n*7 + n/640);
+
+		t0 = clock();
+		for (r = 0; r < reps; r++)
+		for (p = 0; p < num; p++)
+		for (s = 0; s < paks[p]->num; s++)
+		{
+			spr = paks[p]->spr[s];
+			x = (s*97 + r*13) % 640 - 32;
+			y = (s*61 + p*89 + r*7) % 480 - 32;
+			ik_dsprite(img, x, y, spr, 0);
+			ik_dsprite(img, x+24, y, spr, 2+((s&15)<<8));
+			ik_drsprite(img, x, y+24, (s*40)&1023, 32, spr, 1+(10<<8));
+			ik_drsprite(img, x+24, y+24, (s*40)&1023, 32, spr, 2);
+			ik_drsprite(img, x+48, y+24, (s*40)&1023, 32, spr, 4);
+			if (!(s&15))
+				for (l = 0; l < 480; l++)
+					gfx_maprow(img->data + l*640, 640, gfx_lightbuffer + (15<<8));
+		}
+		t0 = clock() - t0;
+
+		sum = 0;
+		for (n = 0; n < 640*480; n++)
+			sum = sum*31 + img->data[n];
+		if (!cpu)
+			ref = sum;
+		else if (sum != ref)
+			bad++;
+
+		printf("%s %.1f ms %s\n", cpu == 2 ? "avx2" : cpu == 1 ? "sse2" : "c",
+					 (float64)t0 * 1000 / CLOCKS_PER_SEC, sum == ref ? "ok" : "DIFFERS");
+	}
+	gfx_blitcpu = best;
+
+	del_image(img);
+	return bad;
+}
+
+// ----------------
+// LOCAL FUNCTIONS
+// ----------------
+
+#ifdef BLIT_X86
+
+__attribute__((target("sse2")))
+int32 maskrow_sse2(uint8 *dst, uint8 *src, int32 n, int32 co)
+{
+	__m128i s, d, z, lo;
+	__m128i zero = _mm_setzero_si128();
+	__m128i high = _mm_set1_epi8((char)0xf0);
+	__m128i ramp = _mm_set1_epi8((char)(co*16));
+	int32 x;
+
+	for (x = 0; x + 16 <= n; x += 16)
+	{
+		s = _mm_loadu_si128((__m128i*)(src + x));
+		d = _mm_loadu_si128((__m128i*)(dst + x));
+		z = _mm_cmpeq_epi8(s, zero);
+		if (co)
+		{
+			lo = _mm_cmpeq_epi8(_mm_and_si128(s, high), zero);
+			s = _mm_add_epi8(s, _mm_and_si128(lo, ramp));
+		}
+		_mm_storeu_si128((__m128i*)(dst + x), _mm_or_si128(_mm_and_si128(z, d), _mm_andnot_si128(z, s)));
+	}
+
+	return x;
+}
+
+__attribute__((target("avx2")))
+int32 maskrow_avx2(uint8 *dst, uint8 *src, int32 n, int32 co)
+{
+	__m256i s, d, z, lo;
+	__m256i zero = _mm256_setzero_si256();
+	__m256i high = _mm256_set1_epi8((char)0xf0);
+	__m256i ramp = _mm256_set1_epi8((char)(co*16));
+	int32 x;
+
+	for (x = 0; x + 32 <= n; x += 32)
+	{
+		s = _mm256_loadu_si256((__m256i*)(src + x));
+		d = _mm256_loadu_si256((__m256i*)(dst + x));
+		z = _mm256_cmpeq_epi8(s, zero);
+		if (co)
+		{
+			lo = _mm256_cmpeq_epi8(_mm256_and_si256(s, high), zero);
+			s = _mm256_add_epi8(s, _mm256_and_si256(lo, ramp));
+		}
+		_mm256_storeu_si256((__m256i*)(dst + x), _mm256_blendv_epi8(s, d, z));
+	}
+
+	return x;
+}
+
+// eight pixels at a time, widened to 32 bits for the table gathers. a
+// gather reads 4 bytes, so the tables are allocated 4 bytes long.
+__attribute__((target("avx2")))
+int32 fxrow_avx2(uint8 *dst, uint8 *src, int32 n, int32 fx)
+{
+	__m256i c, d, z;
+	__m256i zero = _mm256_setzero_si256();
+	__m256i byte = _mm256_set1_epi32(255);
+	__m256i level = _mm256_set1_epi32(fx>>8);
+	__m256i pack = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+																	0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	__m256i lanes = _mm256_setr_epi32(0, 4, 1, 1, 1, 1, 1, 1);
+	int32 x;
+
+	for (x = 0; x + 8 <= n; x += 8)
+	{
+		c = _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i*)(src + x)));
+		d = _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i*)(dst + x)));
+		z = _mm256_cmpeq_epi32(c, zero);
+		if (_mm256_movemask_epi8(z) == -1)
+			continue;
+
+		if (fx&1)
+			c = _mm256_and_si256(_mm256_i32gather_epi32((const int*)gfx_lightbuffer,
+															_mm256_add_epi32(_mm256_slli_epi32(c, 8), level), 1), byte);
+		if (fx&2)
+			c = _mm256_and_si256(_mm256_i32gather_epi32((const int*)gfx_transbuffer,
+															_mm256_or_si256(_mm256_slli_epi32(c, 8), d), 1), byte);
+		if (fx&4)
+			c = _mm256_and_si256(_mm256_i32gather_epi32((const int*)gfx_addbuffer,
+															_mm256_or_si256(_mm256_slli_epi32(c, 8), d), 1), byte);
+
+		c = _mm256_blendv_epi8(c, d, z);
+		c = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(c, pack), lanes);
+		_mm_storel_epi64((__m128i*)(dst + x), _mm256_castsi256_si128(c));
+	}
+
+	return x;
+}
+
+__attribute__((target("avx2")))
+int32 maprow_avx2(uint8 *dst, int32 n, uint8 *map)
+{
+	__m256i c;
+	__m256i byte = _mm256_set1_epi32(255);
+	__m256i pack = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+																	0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	__m256i lanes = _mm256_setr_epi32(0, 4, 1, 1, 1, 1, 1, 1);
+	int32 x;
+
+	for (x = 0; x + 8 <= n; x += 8)
+	{
+		c = _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i*)(dst + x)));
+		c = _mm256_and_si256(_mm256_i32gather_epi32((const int*)map, c, 1), byte);
+		c = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(c, pack), lanes);
+		_mm_storel_epi64((__m128i*)(dst + x), _mm256_castsi256_si128(c));
+	}
+
+	return x;
+}
+
+#endif
@@ -2,30 +2,59 @@
 //     INCLUDES
 // ----------------
 
+#include <stdexcept>
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdarg.h>
+#include <time.h>
+#ifdef WINDOWS
+#include <io.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #include "typedefs.h"
+#include "rng.h"
 #include "gfx.h"
 #include "is_fileio.h"
 #include "combat.h"
 #include "starmap.h"
+#include "vfs.h"
 
 FILE *logfile;
 int last_logdate;
 
 char moddir[256];
 
+// ----------------
+// LOCAL PROTOTYPES
+// ----------------
+
+int32 ini_cut(t_inifile *ini, int32 split, int32 *c, char **text);
+uint32 ini_hash(const char *s);
+void ini_findhash(t_inikeys *keys);
+
 // ----------------
 // GLOBAL FUNCTIONS
 // ----------------
 
+// open fname from the mod if it has one, or else the game's. reads of
+// the files vfs_setmod() indexed go straight to the right one.
 FILE *myopen(const char *fname, const char *flags)
 {
 	FILE *fil;
 	char realfname[256];
+	int32 f;
+
+	f = vfs_find(fname, VFS_TOP);
+	if (f >= 0 && flags[0] == 'r')
+		return vfs_open(f, flags);
 
 	sprintf(realfname, "%s%s", moddir, fname);
 	fil = fopen(realfname, flags);
@@ -125,6 +154,218 @@ int read_line1(FILE *in, char *out1)
 	return end-1;
 }
 
+// the whole of fname, private to us and writable, which leaves the file
+// alone. windows reads it into memory instead.
+uint8 *map_file(const char *fname, int32 *size)
+{
+	uint8 *map;
+#ifdef WINDOWS
+	FILE *fil;
+
+	fil = fopen(fname, "rb");
+	if (!fil)
+		return NULL;
+	fseek(fil, 0, SEEK_END);
+	*size = ftell(fil);
+	fseek(fil, 0, SEEK_SET);
+	map = NULL;
+	if (*size > 0)
+		map = (uint8*)malloc(*size);
+	if (map && fread(map, 1, *size, fil) != (size_t)*size)
+	{	free(map); map = NULL; }
+	fclose(fil);
+#else
+	struct stat st;
+	int fd;
+
+	fd = open(fname, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	map = NULL;
+	if (!fstat(fd, &st) && st.st_size > 0)
+	{
+		*size = (int32)st.st_size;
+		map = (uint8*)mmap(NULL, *size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+		if (map == (uint8*)MAP_FAILED)
+			map = NULL;
+	}
+	close(fd);
+#endif
+
+	return map;
+}
+
+void unmap_file(uint8 *map, int32 size)
+{
+#ifdef WINDOWS
+	free(map);
+#else
+	munmap(map, size);
+#endif
+}
+
+// map fname, from the mod first like myopen(), and cut it into the lines
+// read_line() would read from it, or read_line1() if split is 0. the
+// strings are cut in place, so the file is only read the once.
+t_inifile *ini_open(const char *fname, int32 split)
+{
+	t_inifile *ini;
+	char realfname[256];
+	char *text;
+	int32 c, n, f;
+
+	ini = (t_inifile*)malloc(sizeof(t_inifile));
+	if (!ini)
+		return NULL;
+
+	f = vfs_find(fname, VFS_TOP);
+	if (f >= 0)
+		ini->map = vfs_map(f, &ini->mapsize);
+	else
+	{
+		sprintf(realfname, "%s%s", moddir, fname);
+		ini->map = map_file(realfname, &ini->mapsize);
+		if (!ini->map)
+			ini->map = map_file(fname, &ini->mapsize);
+	}
+	if (!ini->map)
+	{ free(ini); return NULL; }
+
+	// every line ends in a control character but the last, so that's
+	// enough of them. the last is copied out to give it an end.
+	n = 1;
+	for (c = 0; c < ini->mapsize; c++)
+		n += ((int8)ini->map[c] < 32);
+	ini->line = (t_iniline*)malloc(n * sizeof(t_iniline));
+	ini->tail = (char*)malloc(ini->mapsize + 2);
+	if (!ini->line || !ini->tail)
+	{
+		free(ini->line); free(ini->tail);
+		unmap_file(ini->map, ini->mapsize);
+		free(ini);
+		return NULL;
+	}
+
+	ini->num = 0;
+	c = 0; text = ini->tail;
+	while (ini_cut(ini, split, &c, &text))
+		;
+
+	return ini;
+}
+
+void ini_close(t_inifile *ini)
+{
+	if (!ini)
+		return;
+	free(ini->line);
+	free(ini->tail);
+	unmap_file(ini->map, ini->mapsize);
+	free(ini);
+}
+
+// which of keys line starts with, -1 if none. the same as comparing it
+// with each of them, but one compare does.
+int32 ini_keyword(t_inikeys *keys, t_iniline *line)
+{
+	int32 n;
+
+	if (!keys->mul)
+		ini_findhash(keys);
+
+	n = keys->slot[(line->hash * keys->mul) >> (32 - keys->bits)];
+	if (n < 0 || strcmp(line->key, keys->words[n]))
+		return -1;
+	return n;
+}
+
+// time the two passes the loaders make over each of the game's .ini
+// files, with read_line() and with ini_open(). returns the number of
+// files the two read differently.
+int32 ini_bench(int32 reps)
+{
+	const char *files[] = {
+		"gamedata/hulls.ini", "gamedata/ships.ini", "gamedata/weapons.ini",
+		"gamedata/systems.ini", "gamedata/races.ini", "gamedata/cards.ini",
+		"gamedata/planets.ini", "gamedata/items.ini", "gamedata/fleets.ini",
+		"gamedata/names.ini", "gamedata/jobs.ini", "gamedata/strings.ini" };
+	FILE *fil;
+	t_inifile *ini;
+	char s1[1024], s2[1024];
+	int32 f, r, p, l, end, split, bad, diff;
+	uint32 sum1, sum2;
+	clock_t t0, t1, t2;
+
+	bad = 0;
+	for (f = 0; f < (int32)(sizeof(files)/sizeof(files[0])); f++)
+	{
+		split = strcmp(files[f], "gamedata/names.ini") != 0;
+
+		// the old way, and a check of the lines against the new
+		diff = 0;
+		ini = ini_open(files[f], split);
+		fil = myopen(files[f], "rb");
+		if (!ini || !fil)
+		{
+			printf("%s: not found\n", files[f]);
+			if (fil) fclose(fil);
+			ini_close(ini);
+			continue;
+		}
+		end = 0; l = 0;
+		while (!end)
+		{
+			if (split)
+				end = read_line(fil, s1, s2);
+			else
+			{ end = read_line1(fil, s1); s2[0] = 0; }
+			if (l >= ini->num || strcmp(s1, ini->line[l].key) || strcmp(s2, ini->line[l].par))
+				diff = 1;
+			l++;
+		}
+		if (l != ini->num)
+			diff = 1;
+		fclose(fil);
+		ini_close(ini);
+		bad += diff;
+
+		sum1 = sum2 = 0;
+		t0 = clock();
+		for (r = 0; r < reps; r++)
+		for (p = 0; p < 2; p++)
+		{
+			fil = myopen(files[f], "rb");
+			end = 0;
+			while (!end)
+			{
+				if (split)
+					end = read_line(fil, s1, s2);
+				else
+					end = read_line1(fil, s1);
+				sum1 += s1[0];
+			}
+			fclose(fil);
+		}
+		t1 = clock();
+		for (r = 0; r < reps; r++)
+		{
+			ini = ini_open(files[f], split);
+			for (p = 0; p < 2; p++)
+			for (l = 0; l < ini->num; l++)
+				sum2 += ini->line[l].key[0];
+			ini_close(ini);
+		}
+		t2 = clock();
+
+		printf("%s: read_line %.3f ms, ini_open %.3f ms %s\n", files[f],
+					 (float64)(t1-t0) * 1000 / CLOCKS_PER_SEC / reps,
+					 (float64)(t2-t1) * 1000 / CLOCKS_PER_SEC / reps,
+					 (diff || sum1 != sum2) ? "DIFFERS" : "ok");
+	}
+
+	return bad;
+}
+
 void ik_start_log()
 {
 	int n;
@@ -184,3 +425,123 @@ void ik_print_log(const char *ln, ...)
 
 	fprintf(logfile, "%s", dl);
 }
+
+// ----------------
+// LOCAL FUNCTIONS
+// ----------------
+
+// cut the line at *c into the next of ini's lines, as read_line() reads
+// it. where char is signed, bytes from 128 up end lines as control chars do.
+// returns 0 at the end of the file, which still makes a last line.
+int32 ini_cut(t_inifile *ini, int32 split, int32 *c, char **text)
+{
+	char *m = (char*)ini->map;
+	int32 size = ini->mapsize;
+	int32 i = *c;
+	int32 k, p, ke, pe;
+	t_iniline *line;
+
+	line = &ini->line[ini->num++];
+
+	while (i < size && m[i] <= 32)
+		i++;
+	k = i;
+	if (split)
+		while (i < size && m[i] > 32)
+			i++;
+	else
+		while (i < size && m[i] >= 32)
+			i++;
+	ke = i;
+	p = pe = i;
+	if (split && i < size && m[i] == 32)
+	{
+		while (i < size && m[i] == 32)
+			i++;
+		p = i;
+		if (i < size && m[i] > 32)
+			while (i < size && m[i] >= 32)
+				i++;
+		pe = i;
+	}
+
+	if (i < size)
+	{
+		m[ke] = 0;
+		m[pe] = 0;
+		line->key = m + k;
+		line->par = (pe > p) ? m + p : m + ke;
+		line->hash = ini_hash(line->key);
+		*c = i + 1;
+		return 1;
+	}
+
+	// the end of the file ended this one
+	line->key = *text;
+	memcpy(*text, m + k, ke - k);
+	(*text)[ke - k] = 0;
+	line->par = *text + ke - k + 1;
+	memcpy(line->par, m + p, pe - p);
+	line->par[pe - p] = 0;
+	line->hash = ini_hash(line->key);
+	*c = i;
+	return 0;
+}
+
+// fnv-1a
+uint32 ini_hash(const char *s)
+{
+	uint32 h = 2166136261u;
+
+	while (*s)
+		h = (h ^ (uint8)*s++) * 16777619u;
+	return h;
+}
+
+// look for a multiplier that puts each of the words in a slot of its own.
+// a word twice in the table is the later one, as the strcmp loops had it.
+// tables of up to 128 words fit in slot[], the game's find one at 4 or 5
+// bits in a few tries.
+void ini_findhash(t_inikeys *keys)
+{
+	uint32 h, mul;
+	int32 n, s, t, ok;
+	char err[128];
+
+	if (keys->num > 128)
+	{
+		sprintf(err, "keyword table from %.32s has %d words, 128 fit", keys->words[0], keys->num);
+		throw std::runtime_error(err);
+	}
+
+	for (keys->bits = 4; (1 << keys->bits) < keys->num * 2; keys->bits++)
+		;
+
+	mul = 2654435761u;
+	for (t = 0; ; t++)
+	{
+		if (t == 1000)
+		{
+			if (keys->bits == 8)
+			{
+				sprintf(err, "no perfect hash for the keyword table from %.32s", keys->words[0]);
+				throw std::runtime_error(err);
+			}
+			keys->bits++; t = 0;
+		}
+		memset(keys->slot, -1, sizeof(keys->slot));
+		ok = 1;
+		for (n = 0; n < keys->num && ok; n++)
+		{
+			h = ini_hash(keys->words[n]);
+			s = (h * mul) >> (32 - keys->bits);
+			if (keys->slot[s] >= 0 && strcmp(keys->words[keys->slot[s]], keys->words[n]))
+				ok = 0;
+			keys->slot[s] = n;
+		}
+		if (ok)
+			break;
+		mul += 2 * 0x9e3779b9u;
+	}
+	keys->mul = mul;
+}
@@ -1,6 +1,40 @@
+// a line of an .ini file, as read_line() splits it
+typedef struct
+{
+	char *key;
+	char *par;
+	uint32 hash;	// of key, see ini_keyword()
+} t_iniline;
+
+// a whole .ini file, mapped and cut up into lines in one pass
+typedef struct
+{
+	int32 num;
+	t_iniline *line;
+	uint8 *map;
+	int32 mapsize;
+	char *tail;		// the last line, which the file doesn't end for us
+} t_inifile;
+
+// a keyword table and the perfect hash ini_keyword() finds for it
+typedef struct
+{
+	const char **words;
+	int32 num;
+	uint32 mul;		// 0 until the first lookup
+	int32 bits;
+	int8 slot[256];
+} t_inikeys;
+
 FILE *myopen(const char *fname, const char *flags);
 int read_line(FILE *in, char *out1, char *out2);
 int read_line1(FILE *in, char *out1);
+uint8 *map_file(const char *fname, int32 *size);
+void unmap_file(uint8 *map, int32 size);
+t_inifile *ini_open(const char *fname, int32 split);
+void ini_close(t_inifile *ini);
+int32 ini_keyword(t_inikeys *keys, t_iniline *line);
+int32 ini_bench(int32 reps);
 void ik_start_log();
 void ik_print_log(const char *ln, ...);
 
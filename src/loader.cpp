@@ -0,0 +1,276 @@
+// ----------------
+//     INCLUDES
+// ----------------
+
+#include <stdexcept>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <SDL.h>
+
+#include "typedefs.h"
+#include "loader.h"
+
+// ----------------
+//		CONSTANTS
+// ----------------
+
+#define LOADER_THREADS 3		// besides the main thread, which helps while it waits
+
+// ----------------
+// GLOBAL VARIABLES
+// ----------------
+
+t_loadtask		ld_tasks[LOADER_TASKS];
+int32					ld_num;
+
+SDL_Thread		*ld_thread[LOADER_THREADS];
+SDL_mutex			*ld_lock;			// guards the tasks' states and everything below
+SDL_cond			*ld_done;			// a task finished
+uint32				ld_time;			// SDL_GetTicks() at loader_start()
+uint32				ld_first;			// when the first loader_wait() returned
+char					ld_error[256];	// what a task threw, if one did
+
+// ----------------
+// LOCAL PROTOTYPES
+// ----------------
+
+int loader_thread(void *data);
+int32 loader_next(uint32 tasks);
+void loader_run(int32 t, int32 thread);
+void loader_join();
+void loader_log();
+
+// ----------------
+// GLOBAL FUNCTIONS
+// ----------------
+
+// add a task that runs func after the tasks in deps, returns its number
+// for the deps of later ones
+int32 loader_add(const char *name, void (*func)(), uint32 deps)
+{
+	t_loadtask *t;
+
+	if (ld_num == LOADER_TASKS)
+		throw std::runtime_error("too many load tasks");
+
+	t = &ld_tasks[ld_num];
+	t->name = name;
+	t->func = func;
+	t->deps = deps;
+	t->state = 0;
+	t->thread = -1;
+	t->start = t->end = 0;
+
+	return ld_num++;
+}
+
+// start running the tasks added so far. without threads the main
+// thread runs them all in loader_wait().
+void loader_start()
+{
+	int32 n;
+
+	ld_lock = SDL_CreateMutex();
+	ld_done = SDL_CreateCond();
+	if (!ld_lock || !ld_done)
+		throw std::runtime_error("unable to create loader mutex");
+
+	ld_time = SDL_GetTicks();
+	ld_first = 0;
+	ld_error[0] = 0;
+
+	for (n = 0; n < LOADER_THREADS; n++)
+		ld_thread[n] = SDL_CreateThread(loader_thread, (void*)(size_t)n);
+}
+
+// return once the tasks in the tasks bits are done, running those that
+// are ready in the meantime. others are left to the threads, so a long
+// one doesn't hold up the wait. what a task threw is thrown again here.
+void loader_wait(uint32 tasks)
+{
+	int32 n, t, left;
+
+	SDL_mutexP(ld_lock);
+	for (;;)
+	{
+		if (ld_error[0])
+			break;
+
+		left = 0;
+		for (n = 0; n < ld_num; n++)
+			if ((tasks & (1 << n)) && ld_tasks[n].state < 2)
+				left = 1;
+		if (!left)
+			break;
+
+		t = loader_next(tasks);
+		if (t >= 0)
+			loader_run(t, -1);
+		else
+			SDL_CondWait(ld_done, ld_lock);
+	}
+	if (!ld_first)
+		ld_first = SDL_GetTicks() - ld_time;
+	SDL_mutexV(ld_lock);
+
+	if (ld_error[0])
+	{
+		loader_join();
+		throw std::runtime_error(ld_error);
+	}
+}
+
+// the rest of the tasks, then the threads. logs what took how long.
+void loader_finish()
+{
+	if (!ld_lock)
+		return;
+
+	loader_wait(ld_num < 32 ? (1u << ld_num) - 1 : ~0u);
+	loader_join();
+	loader_log();
+	ld_num = 0;
+}
+
+// ----------------
+// LOCAL FUNCTIONS
+// ----------------
+
+int loader_thread(void *data)
+{
+	int32 thread = (int32)(size_t)data;
+	int32 n, t, waiting;
+
+	SDL_mutexP(ld_lock);
+	for (;;)
+	{
+		if (ld_error[0])
+			break;
+
+		t = loader_next(~0u);
+		if (t >= 0)
+		{
+			loader_run(t, thread);
+			continue;
+		}
+
+		waiting = 0;
+		for (n = 0; n < ld_num; n++)
+			if (!ld_tasks[n].state)
+				waiting = 1;
+		if (!waiting)
+			break;
+		SDL_CondWait(ld_done, ld_lock);
+	}
+	SDL_mutexV(ld_lock);
+
+	return 0;
+}
+
+// the first waiting one of tasks whose deps are done, -1 if none.
+// ld_lock held.
+int32 loader_next(uint32 tasks)
+{
+	int32 n, d;
+
+	for (n = 0; n < ld_num; n++)
+	{
+		if (ld_tasks[n].state || !(tasks & (1 << n)))
+			continue;
+		for (d = 0; d < ld_num; d++)
+			if ((ld_tasks[n].deps & (1 << d)) && ld_tasks[d].state < 2)
+				break;
+		if (d == ld_num)
+			return n;
+	}
+
+	return -1;
+}
+
+// run task t with ld_lock let go of in the meantime
+void loader_run(int32 t, int32 thread)
+{
+	t_loadtask *task = &ld_tasks[t];
+
+	task->state = 1;
+	task->thread = thread;
+	task->start = SDL_GetTicks() - ld_time;
+	SDL_mutexV(ld_lock);
+
+	try
+	{
+		task->func();
+	}
+	catch (std::exception &e)
+	{
+		SDL_mutexP(ld_lock);
+		if (!ld_error[0])
+			sprintf(ld_error, "%.32s: %.200s", task->name, e.what());
+		SDL_mutexV(ld_lock);
+	}
+
+	SDL_mutexP(ld_lock);
+	task->end = SDL_GetTicks() - ld_time;
+	task->state = 2;
+	SDL_CondBroadcast(ld_done);
+}
+
+void loader_join()
+{
+	int32 n;
+
+	if (!ld_lock)
+		return;
+
+	SDL_mutexP(ld_lock);
+	SDL_CondBroadcast(ld_done);
+	SDL_mutexV(ld_lock);
+
+	for (n = 0; n < LOADER_THREADS; n++)
+		if (ld_thread[n])
+		{
+			SDL_WaitThread(ld_thread[n], NULL);
+			ld_thread[n] = NULL;
+		}
+
+	SDL_DestroyCond(ld_done);
+	SDL_DestroyMutex(ld_lock);
+	ld_done = NULL;
+	ld_lock = NULL;
+}
+
+// each task's times, then the chain of tasks that held up the last one
+void loader_log()
+{
+	char path[256], where[24];
+	int32 n, t, d, last;
+
+	last = 0;
+	for (n = 0; n < ld_num; n++)
+	{
+		if (ld_tasks[n].thread < 0)
+			strcpy(where, "main");
+		else
+			sprintf(where, "thread %d", ld_tasks[n].thread + 1);
+		printf("load: %-12s %5u ms, %5u to %5u on %s\n", ld_tasks[n].name,
+					 ld_tasks[n].end - ld_tasks[n].start, ld_tasks[n].start, ld_tasks[n].end, where);
+		if (ld_tasks[n].end > ld_tasks[last].end)
+			last = n;
+	}
+
+	path[0] = 0;
+	for (t = last; t >= 0; t = d)
+	{
+		if (path[0])
+			strncat(path, " < ", sizeof(path) - strlen(path) - 1);
+		strncat(path, ld_tasks[t].name, sizeof(path) - strlen(path) - 1);
+
+		d = -1;
+		for (n = 0; n < ld_num; n++)
+			if ((ld_tasks[t].deps & (1 << n)) && (d < 0 || ld_tasks[n].end > ld_tasks[d].end))
+				d = n;
+	}
+	printf("load: first wait done at %u ms, all at %u ms: %s\n", ld_first, ld_tasks[last].end, path);
+}
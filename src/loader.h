@@ -0,0 +1,37 @@
+// ----------------
+//    CONSTANTS
+// ----------------
+
+#define LOADER_TASKS 32
+
+// ----------------
+//     TYPEDEFS
+// ----------------
+
+// a step of loading the game, run on whichever loader thread is free
+// once the tasks in deps are done
+typedef struct
+{
+	const char *name;
+	void (*func)();
+	uint32 deps;				// bits of the task numbers it waits for
+	int32 state;				// 0 waiting, 1 running, 2 done
+	int32 thread;				// that ran it, -1 the main thread
+	uint32 start, end;	// ms after loader_start()
+} t_loadtask;
+
+// ----------------
+// GLOBAL VARIABLES
+// ----------------
+
+extern t_loadtask	ld_tasks[LOADER_TASKS];
+extern int32			ld_num;
+
+// ----------------
+//    PROTOTYPES
+// ----------------
+
+int32 loader_add(const char *name, void (*func)(), uint32 deps);
+void loader_start();
+void loader_wait(uint32 tasks);
+void loader_finish();
@@ -21,6 +21,7 @@
 #endif
 
 #include "typedefs.h"
+#include "rng.h"
 #include "is_fileio.h"
 
 #include "textstr.h"
@@ -33,6 +34,9 @@
 #include "cards.h"
 #include "startgame.h"
 #include "endgame.h"
+#include "gamedata.h"
+#include "loader.h"
+#include "vfs.h"
 #include "sais_version.h"
 
 #define MAIN_INTERFACE_COLOR 0
@@ -67,12 +71,20 @@ t_ik_spritepak *spr_titles;
 int32 main_menu();
 
 void main_init();
+void main_loadcolors();
+void main_loadtitles();
+void main_savecache();
 void main_deinit();
 void splash_screen();
 void credits_screen();
 int32 intro_screen();
 int modconfig_main();
 
+void sim_init();
+void sim_deinit();
+void sim_printresult(t_combatresult *res);
+int replay_run();
+
 // ----------------
 // GLOBAL FUNCTIONS
 // ----------------
@@ -90,7 +102,12 @@ int my_main()
 #ifndef DEMO_VERSION
 	settings.opt_mousemode = 0;
 	ik_hidecursor();
-	if (!modconfig_main())
+	if (combat_replayfile[0])	// replays bring their own mod
+	{
+		if (!combat_replaymod(combat_replayfile))
+			must_quit = 1;
+	}
+	else if (!modconfig_main())
 		must_quit = 1;
 #endif
 
@@ -98,11 +115,19 @@ int my_main()
 	movrecord = 1;
 #endif
 
-	if (!must_quit)
+	if (!must_quit && combat_replayfile[0])
+	{
+		main_init();
+		loader_finish();
+		replay_run();
+		main_deinit();
+	}
+	else if (!must_quit)
 	{
 		main_init();
 
 		splash_screen();
+		loader_finish();
 
 		while (!must_quit && main_menu()>0);
 
@@ -514,13 +539,405 @@ int32 main_menu()
 // LOCAL FUNCTIONS
 // ----------------
 
+// headless combat simulator for balance testing
+//   -simulate <ship> <race> <fleet> [maxticks] [seed] [mod]
+// ship is the player ship (0-2), fleet an index into the race's fleet table
+int sim_main(int argc, char *argv[])
+{
+	t_combatresult res;
+	int32 pship, race, flt, maxticks;
+	uint32 seed;
+
+	if (argc < 3)
+	{
+		fprintf(stderr, "usage: -simulate <ship> <race> <fleet> [maxticks] [seed] [mod]\n");
+		return 1;
+	}
+
+	pship = atoi(argv[0]);
+	race = atoi(argv[1]);
+	flt = atoi(argv[2]);
+	maxticks = 10*60*COMBAT_FRAMERATE;	// ten minutes of game time
+	if (argc > 3)
+		maxticks = atoi(argv[3]);
+	seed = (uint32)time(NULL);
+	if (argc > 4)
+		seed = (uint32)strtoul(argv[4], NULL, 0);
+
+	moddir[0] = 0;
+	if (argc > 5)
+		sprintf(moddir, "mods/%s/", argv[5]);
+
+	sim_init();
+
+	if (pship < 0 || pship > 2 || race <= race_none || race >= num_races)
+	{
+		fprintf(stderr, "invalid ship or race\n");
+		sim_deinit();
+		return 1;
+	}
+
+	// drones without a valid fleet meet the simulator screen's three
+	if (races[race].fleet < 0 ||
+			(race != race_drone && (flt < 0 || flt >= racefleets[races[race].fleet].num_fleets)))
+	{
+		fprintf(stderr, "race %d has no fleet %d\n", race, flt);
+		fprintf(stderr, "usage: -simulate <ship> <race> <fleet> [maxticks] [seed] [mod]\n");
+		sim_deinit();
+		return 1;
+	}
+
+	combat_sim_headless_init();
+	res.wepdmg = NULL;
+	combat_sim_headless(&combat_world, pship, NULL, 0, race, flt, maxticks, seed, &res);
+
+	printf("seed %u\n", seed);
+	sim_printresult(&res);
+
+	sim_deinit();
+
+	return 0;
+}
+
+// batch balance runs, every simulator ship against every racial fleet
+//   -batch <battles> <outfile> [threads] [maxticks] [seed] [mod]
+// writes json if outfile ends in .json, csv otherwise
+int batch_main(int argc, char *argv[])
+{
+	FILE *out;
+	int32 battles, threads, maxticks;
+	int32 json, ok;
+	uint32 seed;
+	char *ext;
+
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: -batch <battles> <outfile> [threads] [maxticks] [seed] [mod]\n");
+		return 1;
+	}
+
+	battles = atoi(argv[0]);
+	threads = 4;
+	if (argc > 2)
+		threads = atoi(argv[2]);
+	maxticks = 10*60*COMBAT_FRAMERATE;
+	if (argc > 3)
+		maxticks = atoi(argv[3]);
+	seed = (uint32)time(NULL);
+	if (argc > 4)
+		seed = (uint32)strtoul(argv[4], NULL, 0);
+
+	moddir[0] = 0;
+	if (argc > 5)
+		sprintf(moddir, "mods/%s/", argv[5]);
+
+	if (battles < 1)
+	{
+		fprintf(stderr, "invalid number of battles\n");
+		return 1;
+	}
+
+	ext = strrchr(argv[1], '.');
+	json = (ext && !strcmp(ext, ".json"));
+
+	out = fopen(argv[1], "w");
+	if (!out)
+	{
+		fprintf(stderr, "unable to open %s\n", argv[1]);
+		return 1;
+	}
+
+	sim_init();
+	fprintf(stderr, "seed %u\n", seed);
+	ok = combat_batch(battles, threads, maxticks, seed, out, json);
+	sim_deinit();
+
+	fclose(out);
+
+	return !ok;
+}
+
+// re-run a battle recorded by combat(), without display or sound
+//   -replay <file> 0
+// see replay_run() for replays that are drawn
+int replay_main()
+{
+	int ok;
+
+	if (!combat_replaymod(combat_replayfile))
+		return 1;
+
+	sim_init();
+	ok = replay_run();
+	sim_deinit();
+
+	return !ok;
+}
+
+// combat engine speed test
+//   -benchmark <ships> [ticks] [race] [seed]
+int bench_main(int argc, char *argv[])
+{
+	int32 ships, ticks, race;
+	int32 ok;
+	uint32 seed;
+
+	if (argc < 1)
+	{
+		fprintf(stderr, "usage: -benchmark <ships> [ticks] [race] [seed]\n");
+		return 1;
+	}
+
+	ships = atoi(argv[0]);
+	ticks = 30*COMBAT_FRAMERATE;
+	if (argc > 1)
+		ticks = atoi(argv[1]);
+	race = -1;
+	if (argc > 2)
+		race = atoi(argv[2]);
+	seed = 1;
+	if (argc > 3)
+		seed = (uint32)strtoul(argv[3], NULL, 0);
+
+	sim_init();
+
+	if (race == -1)	// first race with a fleet
+		for (race = race_none+1; race < num_races-1 && races[race].fleet == -1; race++);
+
+	if (race <= race_none || race >= num_races)
+	{
+		fprintf(stderr, "invalid race\n");
+		sim_deinit();
+		return 1;
+	}
+
+	ok = combat_benchmark(ships, ticks, race, seed);
+	sim_deinit();
+
+	return !ok;
+}
+
+// projectile hit test speed test, old against packed
+//   -hitbench <ships> [ticks] [reps] [race] [seed]
+int hitbench_main(int argc, char *argv[])
+{
+	int32 ships, ticks, reps, race;
+	int32 ok;
+	uint32 seed;
+
+	if (argc < 1)
+	{
+		fprintf(stderr, "usage: -hitbench <ships> [ticks] [reps] [race] [seed]\n");
+		return 1;
+	}
+
+	ships = atoi(argv[0]);
+	ticks = 30*COMBAT_FRAMERATE;
+	if (argc > 1)
+		ticks = atoi(argv[1]);
+	reps = 100;
+	if (argc > 2)
+		reps = atoi(argv[2]);
+	race = -1;
+	if (argc > 3)
+		race = atoi(argv[3]);
+	seed = 1;
+	if (argc > 4)
+		seed = (uint32)strtoul(argv[4], NULL, 0);
+
+	sim_init();
+
+	if (race == -1)	// first race with a fleet
+		for (race = race_none+1; race < num_races-1 && races[race].fleet == -1; race++);
+
+	if (race <= race_none || race >= num_races)
+	{
+		fprintf(stderr, "invalid race\n");
+		sim_deinit();
+		return 1;
+	}
+
+	ok = combat_hitbench(ships, ticks, MAX(reps,1), race, seed);
+	sim_deinit();
+
+	return !ok;
+}
+
+// get_direction() against atan2 over the combat range, with timings
+//   -checkdirection [range]
+int dircheck_main(int argc, char *argv[])
+{
+	int32 range, dx, dy;
+	int32 bad;
+	uint32 sum;
+	clock_t t0, t1, t2;
+
+	range = 2048;
+	if (argc > 0)
+		range = atoi(argv[0]);
+
+	gfx_initdirection();
+	bad = gfx_checkdirection(range);
+	printf("%d mismatches for dx,dy within %d\n", bad, range);
+
+	// fixed point deltas, the sums double as a check on those
+	sum = 0;
+	t0 = clock();
+	for (dy = -range; dy <= range; dy++)
+	for (dx = -range; dx <= range; dx += 7)
+		sum += get_direction_libm(dx*1024, dy);
+	t1 = clock();
+	for (dy = -range; dy <= range; dy++)
+	for (dx = -range; dx <= range; dx += 7)
+		sum -= get_direction(dx*1024, dy);
+	t2 = clock();
+	printf("atan2 %.3fs, tables %.3fs\n",
+				 (float64)(t1-t0) / CLOCKS_PER_SEC, (float64)(t2-t1) / CLOCKS_PER_SEC);
+
+	return bad > 0 || sum != 0;
+}
+
+// sprite blitter speed test over the combat sprites, for each set of
+// row kernels the cpu has
+//   -blitbench [reps]
+int blitbench_main(int argc, char *argv[])
+{
+	t_ik_spritepak *paks[5];
+	int32 reps, bad;
+
+	reps = 20;
+	if (argc > 0)
+		reps = atoi(argv[0]);
+
+	sim_init();
+	calc_color_tables(globalpal);
+
+	paks[0] = spr_ships;
+	paks[1] = spr_weapons;
+	paks[2] = spr_explode1;
+	paks[3] = spr_shockwave;
+	paks[4] = spr_shield;
+	bad = gfx_blitbench(paks, 5, reps);
+
+	del_color_tables();
+	sim_deinit();
+
+	return bad > 0;
+}
+
+// gamedata .ini reading, read_line() against ini_open()
+//   -inibench [reps]
+int inibench_main(int argc, char *argv[])
+{
+	int32 reps;
+
+	reps = 50;
+	if (argc > 0)
+		reps = atoi(argv[0]);
+
+	return ini_bench(reps > 0 ? reps : 50) > 0;
+}
+
+// pack the game's graphics, sounds and gamedata, or a mod's, into one file
+//   -pack <outfile> [mod]
+int pack_main(int argc, char *argv[])
+{
+	int32 num;
+
+	if (argc < 1)
+	{
+		fprintf(stderr, "usage: -pack <outfile> [mod]\n");
+		return 1;
+	}
+
+	moddir[0] = 0;
+	if (argc > 1)
+		sprintf(moddir, "mods/%s/", argv[1]);
+
+	vfs_setmod();
+	num = vfs_pack(argv[0]);
+	vfs_deinit();
+
+	return num < 0;
+}
+
+// play back combat_replayfile, drawing every combat_replayevery ticks
+int replay_run()
+{
+	t_combatresult res;
+
+	res.wepdmg = NULL;
+	if (!combat_replay(combat_replayfile, combat_replayevery, &res))
+		return 0;
+
+	sim_printresult(&res);
+	return 1;
+}
+
+void sim_printresult(t_combatresult *res)
+{
+	int32 c;
+
+	printf("winner %d\nticks %d\n", res->winner, res->ticks);
+	for (c = 0; c < MAX_COMBAT_SHIPS; c++)
+	if (res->type[c] > -1)
+	{
+		printf("ship %d %s own %d fate %d hull %d/%d systems damaged %d lost %d\n",
+					 c, shiptypes[res->type[c]].name, res->own[c], res->fate[c],
+					 res->hits[c], res->maxhits[c], res->sysdmg[c], res->syslost[c]);
+	}
+}
+
+// load only the game data the combat engine needs, no video or audio
+void sim_init()
+{
+	int x;
+	FILE *fil;
+
+	must_quit=0;
+
+	vfs_setmod();
+	fil = myopen("graphics/palette.dat", "rb");
+	if(fread(globalpal, 1, 768, fil) != 768)
+		{ throw std::runtime_error("short read"); }
+	fclose(fil);
+	memcpy(currentpal, globalpal, 768);
+	check_rgb_cells();
+
+	for (x=0;x<1024;x++)
+	{
+		sin1k[x] = (int32)(sin(x*3.14159/512)*65536);
+		cos1k[x] = (int32)(cos(x*3.14159/512)*65536);
+	}
+	gfx_initdirection();
+	gfx_initblit();
+
+	textstrings_init();
+	combat_init();
+	starmap_init();
+
+	srand( (unsigned)time( NULL ) );
+	rng_seed(&sm_rng, (uint32)time(NULL));
+}
+
+void sim_deinit()
+{
+	starmap_deinit();
+	combat_deinit();
+	textstrings_deinit();
+	vfs_deinit();
+}
+
 void main_init()
 {
 	int x;
 	FILE *fil;
+	int32 tcombat, tsfx, tiface, tstr, tstar, tcolor, tmag, ttitle, tcards;
 	must_quit=0;
 	wants_screenshot=0;
 
+	// the mod is chosen by now, index its files before anything is loaded
+	vfs_setmod();
 	fil = myopen("graphics/palette.dat", "rb");
 	if(fread(globalpal, 1, 768, fil) != 768)
 		{ throw std::runtime_error("short read"); }
@@ -532,30 +949,46 @@ void main_init()
 		sin1k[x] = (int32)(sin(x*3.14159/512)*65536);
 		cos1k[x] = (int32)(cos(x*3.14159/512)*65536);
 	}
+	gfx_initdirection();
+	gfx_initblit();
+
+	// sprite colours and the colour tables all look up get_rgb_color() at
+	// once on the loader threads, which only reads a grid that's listed
+	if (!list_rgb_cells())
+		throw std::runtime_error("out of memory");
 
 //	if (strlen(moddir))	// loading a mod, check for new frames
 //	{
 //		loggy = fopen("modlog.txt", "wt");
 //	}
 
-	calc_color_tables(globalpal);
-
-	textstrings_init();
-	load_all_sfx();
-	combat_init();
-	starmap_init();
-	interface_init();
-	cards_init();
-	endgame_init();
-	gfx_initmagnifier();
+	// the rest loads on the loader threads, each part once the ones it
+	// needs are in. long ones first, so they start first.
+	gamedata_usecache = 1;
+	tcombat = loader_add("combat", combat_init, 0);
+	tsfx = loader_add("splash sfx", load_splash_sfx, 0);
+	loader_add("sfx", load_all_sfx, 1 << tsfx);
+	tiface = loader_add("interface", interface_init, 0);
+	tstr = loader_add("strings", textstrings_init, 0);
+	tstar = loader_add("starmap", starmap_init, (1 << tcombat) | (1 << tstr));
+	tcolor = loader_add("colours", main_loadcolors, 0);
+	tmag = loader_add("magnifier", gfx_initmagnifier, 0);
+	ttitle = loader_add("titles", main_loadtitles, 0);
+	loader_add("endgame", endgame_init, 0);
+	tcards = loader_add("cards", cards_init, (1 << tcombat) | (1 << tstar));
+	loader_add("cache", main_savecache, 1 << tcards);
+	loader_start();
 
 	srand( (unsigned)time( NULL ) );
+	rng_seed(&sm_rng, (uint32)time(NULL));
 
 	//s_volume = 85;
 	got_hiscore = -2;
 	loadconfig();
 
-	spr_titles = load_sprites("graphics/titles.spr");
+	// the splash screen and the mouse cursor only need these, the rest
+	// goes on loading behind the splash until loader_finish()
+	loader_wait((1 << tcolor) | (1 << tsfx) | (1 << tiface) | (1 << tmag) | (1 << ttitle));
 
 //	if (strlen(moddir))	// loading a mod, check for new frames
 //	{
@@ -575,6 +1008,23 @@ void main_init()
 
 }
 
+void main_loadcolors()
+{
+	calc_color_tables(globalpal);
+}
+
+void main_loadtitles()
+{
+	spr_titles = load_sprites("graphics/titles.spr");
+}
+
+// once all the tables are in, if they didn't come from the cache
+void main_savecache()
+{
+	if (!gamedata_cached)
+		gamedata_save();
+}
+
 void main_deinit()
 {
 	gfx_deinitmagnifier();
@@ -589,6 +1039,7 @@ void main_deinit()
 	free_spritepak(spr_titles);
 
 	del_color_tables();
+	vfs_deinit();
 }
 
 int32 intro_screen()
@@ -882,6 +1333,7 @@ int32 intro_screen()
 				break;
 
 				case 1:
+				ik_dirty(screen, 16, 112, 624, 320);
 				for (y = 112; y < 320; y++)
 				{
 					dr = ik_image_pointer(screen, 16, y);
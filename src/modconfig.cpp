@@ -9,13 +9,11 @@
 #include <stdlib.h>
 
 #ifdef WINDOWS
-#include <io.h>
 #include <malloc.h>
-#else
-#include <dirent.h>
 #endif
 
 #include "is_fileio.h"
+#include "vfs.h"
 #include "iface_globals.h"
 #include "gfx.h"
 #include "interface.h"
@@ -39,59 +37,22 @@ void modconfig_init()
 	int x;
 	int y;
 	char tmps[256];
+	char names[MAX_MODDIRS][32];
 	FILE *fil;
 
 	moddir[0] = 0;
+	vfs_setmod();
 
 	// allocate memory for mod names
 	moddirs = (t_moddir*)calloc(MAX_MODDIRS, sizeof(t_moddir));
-	n_moddirs = 0;
-
-#ifdef WINDOWS
-	int handle;
-	_finddata_t find;
 
 	// read mod names
-	handle = _findfirst("mods/*.*", &find);
-	if (handle != -1)
+	n_moddirs = vfs_mods(names, MAX_MODDIRS);
+	for (x = 0; x < n_moddirs; x++)
 	{
-		x = handle;
-		while (x != -1)
-		{
-			if (n_moddirs < MAX_MODDIRS)
-			if (find.attrib & _A_SUBDIR)
-			{
-				if (strcmp(find.name, ".") && strcmp(find.name, ".."))
-				{
-					sprintf(moddirs[n_moddirs].dir, "mods/%s/", find.name);
-					sprintf(moddirs[n_moddirs].name, "%s", find.name);
-					n_moddirs++;
-				}
-			}
-			x = _findnext(handle, &find);
-		}
-		_findclose(handle);
+		sprintf(moddirs[x].dir, "mods/%s/", names[x]);
+		sprintf(moddirs[x].name, "%s", names[x]);
 	}
-#else
-	DIR *find;
-	find = opendir("mods");
-	if (NULL != find) {
-		struct dirent *de;
-
-		while (NULL != (de = readdir(find))) {
-			if (n_moddirs < MAX_MODDIRS)
-			if(de->d_type == DT_DIR) {
-				if (strcmp(de->d_name, ".") && strcmp(de->d_name, ".."))
-				{
-					sprintf(moddirs[n_moddirs].dir, "mods/%s/", de->d_name);
-					sprintf(moddirs[n_moddirs].name, "%s", de->d_name);
-					n_moddirs++;
-				}
-			}
-		}
-		closedir(find);
-	}
-#endif
 
 	if (n_moddirs > 1)
 	{
@@ -116,6 +77,7 @@ void modconfig_init()
 		{ throw std::runtime_error("short read"); }
 	fclose(fil);
 	memcpy(currentpal, globalpal, 768);
+	check_rgb_cells();
 
 	Load_WAV("sounds/beep_wait.wav",0);
 	s_volume = 100;
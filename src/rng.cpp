@@ -0,0 +1,61 @@
+// ----------------
+//     INCLUDES
+// ----------------
+
+#include "typedefs.h"
+#include "rng.h"
+
+// ----------------
+// LOCAL FUNCTIONS
+// ----------------
+
+static uint32 rng_rotl(uint32 x, int k)
+{
+	return (x << k) | (x >> (32 - k));
+}
+
+// splitmix32, spreads a seed over the whole state
+static uint32 rng_splitmix(uint32 *x)
+{
+	uint32 z;
+
+	z = (*x += 0x9e3779b9);
+	z = (z ^ (z >> 16)) * 0x85ebca6b;
+	z = (z ^ (z >> 13)) * 0xc2b2ae35;
+	return z ^ (z >> 16);
+}
+
+// ----------------
+// GLOBAL FUNCTIONS
+// ----------------
+
+void rng_seed(t_rng *rng, uint32 seed)
+{
+	int c;
+
+	for (c = 0; c < 4; c++)
+		rng->s[c] = rng_splitmix(&seed);
+}
+
+uint32 rng_next(t_rng *rng)
+{
+	uint32 r, t;
+	uint32 *s = rng->s;
+
+	r = rng_rotl(s[1] * 5, 7) * 9;
+	t = s[1] << 9;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = rng_rotl(s[3], 11);
+
+	return r;
+}
+
+int32 rng_rand(t_rng *rng)
+{
+	return (int32)(rng_next(rng) >> 1);
+}
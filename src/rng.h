@@ -0,0 +1,17 @@
+// ----------------
+//     TYPEDEFS
+// ----------------
+
+// xoshiro128** generator state, one per battle or galaxy
+typedef struct _t_rng
+{
+	uint32 s[4];
+} t_rng;
+
+// ----------------
+//    PROTOTYPES
+// ----------------
+
+void rng_seed(t_rng *rng, uint32 seed);
+uint32 rng_next(t_rng *rng);
+int32 rng_rand(t_rng *rng);		// 0..0x7fffffff, replaces rand()
@@ -3,10 +3,16 @@
 
 #include <cassert>
 #include <cmath>
+#include <cstdio>
 #include <cstring>
 #include <new>
 #include <sstream>
 #include <stdexcept>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "scaledvideo.hpp"
 
@@ -31,13 +37,103 @@ ScaledVideo::ScaledVideo(
 	m_virtual_resolution(virtual_resolution),
 	m_true_resolution(true_resolution) {
 
-	m_virtual_dirty.x = -1;
-	m_virtual_dirty.y = 0;
-	m_virtual_dirty.w = 0;
-	m_virtual_dirty.h = 0;
+	m_virtual_dirty = m_virtual_resolution;
+
+	// A new scaler has a new true surface, so it all needs painting
+	m_dirty[0] = m_virtual_resolution;
+	m_num_dirty = 1;
+	m_last_dirty = 0;
+
+	m_num_helpers = 0;
+	m_helper_start = 0;
+	m_helper_done = 0;
+	m_band_lock = 0;
+	m_helpers_quit = false;
+}
+
+ScaledVideo::~ScaledVideo() {
+	m_helpers_quit = true;
+	for(int i = 0; i < m_num_helpers; ++i) {
+		SDL_SemPost(m_helper_start);
+	}
+	for(int i = 0; i < m_num_helpers; ++i) {
+		SDL_WaitThread(m_helpers[i], 0);
+	}
+	if(m_helper_start) { SDL_DestroySemaphore(m_helper_start); }
+	if(m_helper_done) { SDL_DestroySemaphore(m_helper_done); }
+	if(m_band_lock) { SDL_DestroyMutex(m_band_lock); }
+}
+
+void ScaledVideo::scaleRows(int, int) {
+	throw std::logic_error("scaler has no scaleRows()");
+}
+
+// Set by benchmark_scaled_video() to time the scalers on one thread
+static bool s_single_threaded = false;
+
+void ScaledVideo::parallelRows(int first, int last, long pixels) {
+	// Below this, waking the helpers costs more than they save
+	if(s_single_threaded || pixels < 256 * 1024
+		|| last - first < SCALER_BANDS) {
+
+		scaleRows(first, last);
+		return;
+	}
+
+	if(!m_band_lock) {
+		m_helper_start = SDL_CreateSemaphore(0);
+		m_helper_done = SDL_CreateSemaphore(0);
+		m_band_lock = SDL_CreateMutex();
+		if(m_helper_start && m_helper_done && m_band_lock) {
+			for(int i = 0; i < SCALER_THREADS; ++i) {
+				m_helpers[i] = SDL_CreateThread(helperThread, this);
+				if(!m_helpers[i]) { break; }
+				++m_num_helpers;
+			}
+		}
+	}
+	if(!m_num_helpers) {
+		scaleRows(first, last);
+		return;
+	}
+
+	m_band_first = first;
+	m_band_last = last;
+	m_band_next = 0;
+	for(int i = 0; i < m_num_helpers; ++i) {
+		SDL_SemPost(m_helper_start);
+	}
+	runBands();
+	for(int i = 0; i < m_num_helpers; ++i) {
+		SDL_SemWait(m_helper_done);
+	}
+}
+
+// Take bands until there are none left; any thread may get any band
+void ScaledVideo::runBands() {
+	int rows = m_band_last - m_band_first;
+
+	for(;;) {
+		SDL_mutexP(m_band_lock);
+		int band = m_band_next++;
+		SDL_mutexV(m_band_lock);
+		if(band >= SCALER_BANDS) { break; }
+
+		scaleRows(m_band_first + (rows * band) / SCALER_BANDS,
+			m_band_first + (rows * (band + 1)) / SCALER_BANDS);
+	}
 }
 
-ScaledVideo::~ScaledVideo() {}
+int ScaledVideo::helperThread(void* data) {
+	ScaledVideo* video = (ScaledVideo*) data;
+
+	for(;;) {
+		SDL_SemWait(video->m_helper_start);
+		if(video->m_helpers_quit) { return 0; }
+		video->runBands();
+		SDL_SemPost(video->m_helper_done);
+	}
+}
 
 void ScaledVideo::clipPoint(Sint16 raw_x, Sint16 raw_y,
 	Sint16* clip_x, Sint16* clip_y) {
@@ -53,49 +149,118 @@ void ScaledVideo::clipPoint(Sint16 raw_x, Sint16 raw_y,
 SDL_Rect ScaledVideo::clipRect(const SDL_Rect& rect) {
 	SDL_Rect out;
 
-	clipPoint(rect.x, rect.y, &out.x, &out.y);
+	// w and h are unsigned, so work in wider signed ints; an empty
+	// result has zero w and h
+	Sint32 x1 = rect.x < 0 ? 0 : rect.x;
+	Sint32 y1 = rect.y < 0 ? 0 : rect.y;
+	Sint32 x2 = rect.x + rect.w;
+	Sint32 y2 = rect.y + rect.h;
+	if(x2 > m_virtual_resolution.w) { x2 = m_virtual_resolution.w; }
+	if(y2 > m_virtual_resolution.h) { y2 = m_virtual_resolution.h; }
 
-	// w and h are unsigned, cannot be < 0
-	if(rect.x + rect.w > m_virtual_resolution.w) {
-		out.w = m_virtual_resolution.w - out.x;
-	} else {
-		out.w = (rect.x + rect.w) - out.x;
-	}
+	out.x = x1;
+	out.y = y1;
+	out.w = x2 > x1 ? x2 - x1 : 0;
+	out.h = y2 > y1 ? y2 - y1 : 0;
 
-	if(rect.y + rect.h > m_virtual_resolution.h) {
-		out.h = m_virtual_resolution.h - out.y;
-	} else {
-		out.h = (rect.y + rect.h) - out.y;
-	}
+	return out;
+}
 
+static bool rect_contains(const SDL_Rect& outer, const SDL_Rect& inner) {
+	return inner.x >= outer.x && inner.y >= outer.y
+		&& inner.x + inner.w <= outer.x + outer.w
+		&& inner.y + inner.h <= outer.y + outer.h;
+}
+
+static SDL_Rect rect_union(const SDL_Rect& a, const SDL_Rect& b) {
+	SDL_Rect out;
+	Sint32 x2 = a.x + a.w > b.x + b.w ? a.x + a.w : b.x + b.w;
+	Sint32 y2 = a.y + a.h > b.y + b.h ? a.y + a.h : b.y + b.h;
+
+	out.x = a.x < b.x ? a.x : b.x;
+	out.y = a.y < b.y ? a.y : b.y;
+	out.w = x2 - out.x;
+	out.h = y2 - out.y;
 	return out;
 }
 
+static Sint32 rect_area(const SDL_Rect& rect) {
+	return (Sint32) rect.w * rect.h;
+}
+
 void ScaledVideo::dirtyRect(const SDL_Rect& rect) {
 	SDL_Rect clipped = clipRect(rect);
+	if(clipped.w == 0 || clipped.h == 0) { return; }
+
+	// Runs of small draws (pixels of a line, glyphs of a string) mostly
+	// land in the rectangle the last one went to
+	if(m_last_dirty >= 0
+		&& rect_contains(m_dirty[m_last_dirty], clipped)) { return; }
+	for(int i = 0; i < m_num_dirty; ++i) {
+		if(rect_contains(m_dirty[i], clipped)) {
+			m_last_dirty = i;
+			return;
+		}
+	}
 
-	if(m_virtual_dirty.x < 0) {
-		// No existing dirty region
-		m_virtual_dirty = clipped;
-		return;
+	/* Merge into the rectangle that grows least doing so, if that adds no
+	 * more clean area than the new one covers. Otherwise keep it separate,
+	 * unless the list is full. */
+	int best = -1;
+	Sint32 best_waste = 0;
+	for(int i = 0; i < m_num_dirty; ++i) {
+		Sint32 waste = rect_area(rect_union(m_dirty[i], clipped))
+			- rect_area(m_dirty[i]) - rect_area(clipped);
+		if(best < 0 || waste < best_waste) {
+			best = i;
+			best_waste = waste;
+		}
 	}
 
-	Sint32 r_x2 =    rect.x +    rect.w;
-	Sint32 r_y2 =    rect.y +    rect.h;
-	Sint32 c_x2 = clipped.x + clipped.w;
-	Sint32 c_y2 = clipped.y + clipped.h;
-	if(clipped.x < m_virtual_dirty.x) { m_virtual_dirty.x = clipped.x; }
-	if(clipped.y < m_virtual_dirty.y) { m_virtual_dirty.y = clipped.y; }
-	if(c_x2 > r_x2) { m_virtual_dirty.w = c_x2 - m_virtual_dirty.x; }
-	if(c_y2 > r_y2) { m_virtual_dirty.h = c_y2 - m_virtual_dirty.y; }
+	if(best >= 0 && (best_waste <= rect_area(clipped)
+		|| m_num_dirty == MAX_DIRTY_RECTS)) {
+
+		m_dirty[best] = rect_union(m_dirty[best], clipped);
+		m_last_dirty = best;
+
+		// Drop any others it has swallowed
+		for(int i = 0; i < m_num_dirty; ) {
+			if(i != best && rect_contains(m_dirty[best], m_dirty[i])) {
+				m_dirty[i] = m_dirty[--m_num_dirty];
+				if(best == m_num_dirty) { best = i; }
+				m_last_dirty = best;
+			} else {
+				++i;
+			}
+		}
+	} else {
+		m_dirty[m_num_dirty] = clipped;
+		m_last_dirty = m_num_dirty++;
+	}
 }
 
 void ScaledVideo::update(bool to_screen) {
 	// Nothing to do?
-	if(m_virtual_dirty.x < 0) { return; }
+	if(m_num_dirty == 0) { return; }
+
+	// Do the actual scaling, a rectangle at a time
+	SDL_Rect true_dirty[MAX_DIRTY_RECTS];
+	for(int i = 0; i < m_num_dirty; ++i) {
+		Sint16 x2, y2;
 
-	// Do the actual scaling
-	updateScale();
+		m_virtual_dirty = m_dirty[i];
+		updateScale();
+
+		mapVirtualToTrue(
+			m_virtual_dirty.x, m_virtual_dirty.y,
+			&true_dirty[i].x, &true_dirty[i].y);
+		mapVirtualToTrue(
+			m_virtual_dirty.x + m_virtual_dirty.w,
+			m_virtual_dirty.y + m_virtual_dirty.h,
+			&x2, &y2);
+		true_dirty[i].w = x2 - true_dirty[i].x;
+		true_dirty[i].h = y2 - true_dirty[i].y;
+	}
 
 	// If the target is palettized, copy the palette too
 	if(m_true_surface->format->BitsPerPixel == 8) {
@@ -106,24 +271,12 @@ void ScaledVideo::update(bool to_screen) {
 
 	// Render to the screen, if requested
 	if(to_screen) {
-		SDL_Rect true_dirty;
-		Sint16 x2, y2;
-
-		mapVirtualToTrue(
-			m_virtual_dirty.x, m_virtual_dirty.y,
-			&true_dirty.x, &true_dirty.y);
-		mapVirtualToTrue(
-			m_virtual_dirty.x + m_virtual_dirty.w,
-			m_virtual_dirty.y + m_virtual_dirty.h,
-			&x2, &y2);
-		true_dirty.w = x2 - true_dirty.x;
-		true_dirty.h = y2 - true_dirty.y;
-
-		SDL_UpdateRects(m_true_surface, 1, &true_dirty);
+		SDL_UpdateRects(m_true_surface, m_num_dirty, true_dirty);
 	}
 
 	// Mark that we have no dirt left
-	m_virtual_dirty.x = -1;
+	m_num_dirty = 0;
+	m_last_dirty = -1;
 }
 
 // No scaling, just translate.
@@ -176,6 +329,47 @@ public:
 	}
 };
 
+/* Write each of w pixels of src scale times over into dst. Pixel formats
+ * are copied whole, as P; 24-bit goes through the byte version. */
+template<typename P>
+static void replicate_pixels(P* dst, const P* src, int w, unsigned int scale) {
+	if(scale == 2) {
+		for(int i = 0; i < w; ++i) {
+			dst[0] = dst[1] = src[i];
+			dst += 2;
+		}
+		return;
+	}
+	for(int i = 0; i < w; ++i) {
+		for(unsigned int xdup = scale; xdup; --xdup) {
+			*dst++ = src[i];
+		}
+	}
+}
+
+#ifdef __SSE2__
+// The common 2x cases sixteen bytes at a time; the rest goes to the above
+static int replicate_2x_8(Uint8* dst, const Uint8* src, int w) {
+	int i;
+	for(i = 0; i + 16 <= w; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*) (src + i));
+		_mm_storeu_si128((__m128i*) (dst + 2*i), _mm_unpacklo_epi8(v, v));
+		_mm_storeu_si128((__m128i*) (dst + 2*i + 16), _mm_unpackhi_epi8(v, v));
+	}
+	return i;
+}
+
+static int replicate_2x_32(Uint32* dst, const Uint32* src, int w) {
+	int i;
+	for(i = 0; i + 4 <= w; i += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i*) (src + i));
+		_mm_storeu_si128((__m128i*) (dst + 2*i), _mm_unpacklo_epi32(v, v));
+		_mm_storeu_si128((__m128i*) (dst + 2*i + 4), _mm_unpackhi_epi32(v, v));
+	}
+	return i;
+}
+#endif
+
 // Integer software scaler
 class ScaledVideoInteger : public ScaledVideo {
 	SDL_Rect m_offset;
@@ -215,11 +409,9 @@ public:
 		return oss.str();
 	}
 
-	/* This is not wonderously efficient; it makes no attempt at batch or
-	 * parallel processing, so iterates over every single output pixel.
-	 * Demands that the pixel formats match (enforced by factory).
-	 * TODO Benchmark, see if Arbitrary approach is always faster; if so,
-	 * improve or ditch this. */
+	/* Each virtual line is widened once, then copied down for the rest of
+	 * its true lines. Lines are done in bands across the helper threads.
+	 * Demands that the pixel formats match (enforced by factory). */
 	virtual void updateScale() {
 		Sint16 x = m_virtual_dirty.x;
 		Sint16 y = m_virtual_dirty.y;
@@ -230,39 +422,74 @@ public:
 		assert(x >= 0); assert (y >= 0);
 		assert(x + w <= m_virtual_resolution.w);
 		assert(y + h <= m_virtual_resolution.h);
+		assert(m_virtual_surface->format->BytesPerPixel
+			== m_true_surface->format->BytesPerPixel);
+		// (we demanded same format from SDL, remember)
 
-		// Copy and upscale data
 		SDL_LockSurface(m_virtual_surface);
 		SDL_LockSurface(m_true_surface);
+		parallelRows(y, y + h, (long) w * h * m_scale * m_scale);
+		SDL_UnlockSurface(m_true_surface);
+		SDL_UnlockSurface(m_virtual_surface);
+	}
+
+	// Rows are virtual lines here
+	virtual void scaleRows(int first, int last) {
+		Sint16 x = m_virtual_dirty.x;
+		Uint16 w = m_virtual_dirty.w;
 		Uint8 bypp = m_virtual_surface->format->BytesPerPixel;
-		assert(bypp == m_true_surface->format->BytesPerPixel);
-		// (we demanded same format from SDL, remember)
-		char* srcline = (char*) m_virtual_surface->pixels
-			+ (y * m_virtual_surface->pitch);
-		char* dstline = (char*) m_true_surface->pixels
-			+ (((y*m_scale)+m_offset.y) * m_true_surface->pitch);
-		for(Uint16 lines = h; lines; --lines) {
-			for(unsigned int ydup = m_scale; ydup; --ydup) {
-				char* srcpix = srcline + (x * bypp);
-				char* dstpix = dstline +
-					(((x*m_scale)+m_offset.x) * bypp);
-
-				for(Uint16 cols = w; cols; --cols) {
-					// TODO memcpy m_scale*bypp at once?
-					for(unsigned int xdup = m_scale; xdup;
-						--xdup) {
-
-						memcpy(dstpix, srcpix, bypp);
-						dstpix += bypp;
+		size_t truebytes = (size_t) w * m_scale * bypp;
+
+		for(int y = first; y < last; ++y) {
+			char* srcpix = (char*) m_virtual_surface->pixels
+				+ (y * m_virtual_surface->pitch) + (x * bypp);
+			char* dstpix = (char*) m_true_surface->pixels
+				+ (((y*m_scale)+m_offset.y) * m_true_surface->pitch)
+				+ (((x*m_scale)+m_offset.x) * bypp);
+
+			int done = 0;
+			switch(bypp) {
+			case 1:
+#ifdef __SSE2__
+				if(m_scale == 2) {
+					done = replicate_2x_8((Uint8*) dstpix,
+						(Uint8*) srcpix, w);
+				}
+#endif
+				replicate_pixels((Uint8*) dstpix + done*m_scale,
+					(Uint8*) srcpix + done, w - done, m_scale);
+				break;
+			case 2:
+				replicate_pixels((Uint16*) dstpix,
+					(Uint16*) srcpix, w, m_scale);
+				break;
+			case 4:
+#ifdef __SSE2__
+				if(m_scale == 2) {
+					done = replicate_2x_32((Uint32*) dstpix,
+						(Uint32*) srcpix, w);
+				}
+#endif
+				replicate_pixels((Uint32*) dstpix + done*m_scale,
+					(Uint32*) srcpix + done, w - done, m_scale);
+				break;
+			default:
+				for(Uint16 cols = 0; cols < w; ++cols) {
+					for(unsigned int xdup = 0; xdup < m_scale;
+						++xdup) {
+
+						memcpy(dstpix + (cols*m_scale + xdup)*bypp,
+							srcpix + cols*bypp, bypp);
 					}
-					srcpix += bypp;
 				}
-				dstline += m_true_surface->pitch;
+				break;
+			}
+
+			for(unsigned int ydup = 1; ydup < m_scale; ++ydup) {
+				memcpy(dstpix + ydup * m_true_surface->pitch,
+					dstpix, truebytes);
 			}
-			srcline += m_virtual_surface->pitch;
 		}
-		SDL_UnlockSurface(m_true_surface);
-		SDL_UnlockSurface(m_virtual_surface);
 	}
 
 	virtual void mapVirtualToTrue(Sint16 virtual_x, Sint16 virtual_y,
@@ -289,6 +516,14 @@ protected:
 	// and h to record the effective width and height of our true area.
 	SDL_Rect m_offset;
 
+	/* Virtual column and line of each true one, from the left and top of
+	 * the true area; the same sums as mapTrueToVirtualInternal(). */
+	std::vector<Uint16> m_column_map;
+	std::vector<Uint16> m_line_map;
+
+	// The true area updateScale() is redrawing
+	Sint16 m_truex1, m_truex2;
+
 	/* This gets called A LOT. Avoid floating point.
 	 * (This is also why it has a protected, nonvirtual version.) */
 	void mapTrueToVirtualInternal(Sint16 true_x, Sint16 true_y,
@@ -302,6 +537,24 @@ protected:
 				/ m_offset.h;
 	}
 
+	// Work out the true bounding rectangle, and run scaleRows() over it
+	void scaleDirty() {
+		Sint16 truey1, truey2;
+		mapVirtualToTrue(m_virtual_dirty.x, m_virtual_dirty.y,
+			&m_truex1, &truey1);
+		mapVirtualToTrue(
+			m_virtual_dirty.x + m_virtual_dirty.w,
+			m_virtual_dirty.y + m_virtual_dirty.h,
+			&m_truex2, &truey2);
+
+		SDL_LockSurface(m_virtual_surface);
+		SDL_LockSurface(m_true_surface);
+		parallelRows(truey1, truey2,
+			(long) (m_truex2 - m_truex1) * (truey2 - truey1));
+		SDL_UnlockSurface(m_true_surface);
+		SDL_UnlockSurface(m_virtual_surface);
+	}
+
 public:
 	ScaledVideoArbitrary(
 		SDL_Surface* virtual_surface,
@@ -338,6 +591,15 @@ public:
 		m_offset.x = (m_true_resolution.w - m_offset.w) / 2;
 		m_offset.y = (m_true_resolution.h - m_offset.h) / 2;
 		assert(m_offset.x == 0 || m_offset.y == 0);
+
+		m_column_map.resize(m_offset.w + 1);
+		for(int tx = 0; tx <= m_offset.w; ++tx) {
+			m_column_map[tx] = (tx * m_virtual_resolution.w) / m_offset.w;
+		}
+		m_line_map.resize(m_offset.h + 1);
+		for(int ty = 0; ty <= m_offset.h; ++ty) {
+			m_line_map[ty] = (ty * m_virtual_resolution.h) / m_offset.h;
+		}
 	}
 
 	virtual std::string describe() {
@@ -349,39 +611,52 @@ public:
 	}
 
 	virtual void updateScale() {
-		Sint16 x = m_virtual_dirty.x;
-		Sint16 y = m_virtual_dirty.y;
-		Uint16 w = m_virtual_dirty.w;
-		Uint16 h = m_virtual_dirty.h;
-
-		// Work out the true bounding rectangle
-		Sint16 truex1, truex2, truey1, truey2;
-		mapVirtualToTrue(x,   y,   &truex1, &truey1);
-		mapVirtualToTrue(x+w, y+h, &truex2, &truey2);
+		assert(m_virtual_surface->format->BytesPerPixel
+			== m_true_surface->format->BytesPerPixel);
+		scaleDirty();
+	}
 
-		// For each display pixel in the area, source a virtual pixel
-		Sint16 virtx, virty;
-		SDL_LockSurface(m_virtual_surface);
-		SDL_LockSurface(m_true_surface);
+	/* Rows are true lines here. A line sourced from the same virtual line
+	 * as the one above it is a copy of that one. */
+	virtual void scaleRows(int first, int last) {
 		Uint8 bypp = m_virtual_surface->format->BytesPerPixel;
-		assert(bypp == m_true_surface->format->BytesPerPixel);
-		char* dstline = (char*) m_true_surface->pixels
-			+ (truey1*m_true_surface->pitch);
-		for(Sint16 ty = truey1; ty < truey2; ++ty) {
-			char* dstpix = dstline + (truex1 * bypp);
-			for(Sint16 tx = truex1; tx < truex2; ++tx) {
-				mapTrueToVirtualInternal(tx,ty, &virtx,&virty);
-				char* srcpix = (char*) m_virtual_surface->pixels
-					+ (virty * m_virtual_surface->pitch)
-					+ (virtx * bypp);
-				memcpy(dstpix, srcpix, bypp);
-
-				dstpix += bypp;
+		const Uint16* columns = &m_column_map[m_truex1 - m_offset.x];
+		int w = m_truex2 - m_truex1;
+
+		for(int ty = first; ty < last; ++ty) {
+			int vy = m_line_map[ty - m_offset.y];
+			char* dstpix = (char*) m_true_surface->pixels
+				+ (ty * m_true_surface->pitch) + (m_truex1 * bypp);
+
+			if(ty > first && vy == m_line_map[ty - 1 - m_offset.y]) {
+				memcpy(dstpix, dstpix - m_true_surface->pitch,
+					(size_t) w * bypp);
+				continue;
+			}
+
+			char* srcline = (char*) m_virtual_surface->pixels
+				+ (vy * m_virtual_surface->pitch);
+			switch(bypp) {
+			case 1:
+				for(int i = 0; i < w; ++i) {
+					((Uint8*) dstpix)[i] =
+						((Uint8*) srcline)[columns[i]];
+				}
+				break;
+			case 4:
+				for(int i = 0; i < w; ++i) {
+					((Uint32*) dstpix)[i] =
+						((Uint32*) srcline)[columns[i]];
+				}
+				break;
+			default:
+				for(int i = 0; i < w; ++i) {
+					memcpy(dstpix + i*bypp,
+						srcline + columns[i]*bypp, bypp);
+				}
+				break;
 			}
-			dstline += m_true_surface->pitch;
 		}
-		SDL_UnlockSurface(m_true_surface);
-		SDL_UnlockSurface(m_virtual_surface);
 	}
 
 	virtual void mapVirtualToTrue(Sint16 virtual_x, Sint16 virtual_y,
@@ -408,6 +683,8 @@ public:
  * This is the almost-ultimate fallback: handles any scaling, any 32-bit RGB out
  * format. */
 class ScaledVideoArbitraryConvertingPaletted : public ScaledVideoArbitrary {
+	// The virtual palette in the true format
+	Uint32 m_colors[256];
 public:
 	ScaledVideoArbitraryConvertingPaletted(
 		SDL_Surface* virtual_surface,
@@ -431,52 +708,40 @@ public:
 	}
 
 	virtual void updateScale() {
-		Sint16 x = m_virtual_dirty.x;
-		Sint16 y = m_virtual_dirty.y;
-		Uint16 w = m_virtual_dirty.w;
-		Uint16 h = m_virtual_dirty.h;
-
-		// Work out the true bounding rectangle
-		Sint16 truex1, truex2, truey1, truey2;
-		mapVirtualToTrue(x,   y,   &truex1, &truey1);
-		mapVirtualToTrue(x+w, y+h, &truex2, &truey2);
-
 		// Transform the palette into target format
 		SDL_Palette* palette = m_virtual_surface->format->palette;
 		assert(palette->ncolors <= 256);
-		Uint32 colors[256];
 		for(int c = 0; c < palette->ncolors; ++c) {
-			colors[c] = SDL_MapRGB(m_true_surface->format,
+			m_colors[c] = SDL_MapRGB(m_true_surface->format,
 				palette->colors[c].r,
 				palette->colors[c].g,
 				palette->colors[c].b);
 		}
 
-		// For each display pixel in the area, source a virtual pixel
-		Sint16 virtx, virty;
-		SDL_LockSurface(m_virtual_surface);
-		SDL_LockSurface(m_true_surface);
-		Uint8 virtual_bypp = m_virtual_surface->format->BytesPerPixel;
-		Uint8 true_bypp    =    m_true_surface->format->BytesPerPixel;
-		char* dstline = (char*) m_true_surface->pixels
-			+ (truey1*m_true_surface->pitch);
-		for(Sint16 ty = truey1; ty < truey2; ++ty) {
-			char* dstpix = dstline + (truex1 * true_bypp);
-			for(Sint16 tx = truex1; tx < truex2; ++tx) {
-				mapTrueToVirtualInternal(tx,ty, &virtx,&virty);
-				unsigned char* srcpix = (unsigned char*)
-					m_virtual_surface->pixels
-					+ (virty * m_virtual_surface->pitch)
-					+ (virtx * virtual_bypp);
-
-				*((Uint32*) dstpix) = colors[*srcpix];
-
-				dstpix += true_bypp;
+		scaleDirty();
+	}
+
+	virtual void scaleRows(int first, int last) {
+		const Uint16* columns = &m_column_map[m_truex1 - m_offset.x];
+		int w = m_truex2 - m_truex1;
+
+		for(int ty = first; ty < last; ++ty) {
+			int vy = m_line_map[ty - m_offset.y];
+			Uint32* dstpix = (Uint32*) ((char*) m_true_surface->pixels
+				+ (ty * m_true_surface->pitch)) + m_truex1;
+
+			if(ty > first && vy == m_line_map[ty - 1 - m_offset.y]) {
+				memcpy(dstpix, (char*) dstpix - m_true_surface->pitch,
+					(size_t) w * 4);
+				continue;
+			}
+
+			Uint8* srcline = (Uint8*) m_virtual_surface->pixels
+				+ (vy * m_virtual_surface->pitch);
+			for(int i = 0; i < w; ++i) {
+				dstpix[i] = m_colors[srcline[columns[i]]];
 			}
-			dstline += m_true_surface->pitch;
 		}
-		SDL_UnlockSurface(m_true_surface);
-		SDL_UnlockSurface(m_virtual_surface);
 	}
 };
 
@@ -584,3 +849,115 @@ ScaledVideo* get_scaled_video(
 		}
 	}
 }
+
+// Benchmark //////////////////////////////////////////////////////////////////
+
+/* Full-frame updates of one scaler into a surface of its own, in ms/frame. */
+template<class Scaler>
+static double time_scaler(SDL_Surface* virtual_surface, int true_w,
+	int true_h, int true_bpp, int frames) {
+
+	SDL_Surface* true_surface = SDL_CreateRGBSurface(SDL_SWSURFACE,
+		true_w, true_h, true_bpp, 0, 0, 0, 0);
+	if(!true_surface) {
+		throw std::runtime_error(SDL_GetError());
+	}
+
+	SDL_Rect virtual_resolution;
+	virtual_resolution.x = virtual_resolution.y = 0;
+	virtual_resolution.w = virtual_surface->w;
+	virtual_resolution.h = virtual_surface->h;
+	SDL_Rect true_resolution;
+	true_resolution.x = true_resolution.y = 0;
+	true_resolution.w = true_w;
+	true_resolution.h = true_h;
+
+	Scaler* scaler = new Scaler(virtual_surface, true_surface,
+		virtual_resolution, true_resolution);
+	// One untimed frame, so the helper threads are already running
+	scaler->update(false);
+
+	Uint32 start = SDL_GetTicks();
+	for(int frame = 0; frame < frames; ++frame) {
+		scaler->dirtyRect(virtual_resolution);
+		scaler->update(false);
+	}
+	double ms = (double) (SDL_GetTicks() - start) / frames;
+
+	delete scaler;
+	SDL_FreeSurface(true_surface);
+	return ms;
+}
+
+template<class Scaler>
+static void report_scaler(const char* name, SDL_Surface* virtual_surface,
+	int true_w, int true_h, int true_bpp, int frames) {
+
+	s_single_threaded = true;
+	double serial = time_scaler<Scaler>(virtual_surface,
+		true_w, true_h, true_bpp, frames);
+	s_single_threaded = false;
+	double pooled = time_scaler<Scaler>(virtual_surface,
+		true_w, true_h, true_bpp, frames);
+
+	printf("%4dx%-4d %2dbpp  %-10s %7.2f ms/frame, %7.2f threaded\n",
+		true_w, true_h, true_bpp, name, serial, pooled);
+}
+
+bool benchmark_scaled_video(int frames) {
+	static const int resolutions[][2] = {
+		{ 1280, 960 }, { 1920, 1080 }, { 2560, 1440 }, { 3840, 2160 } };
+
+	SDL_Surface* virtual_surface = SDL_CreateRGBSurface(SDL_SWSURFACE,
+		640, 480, 8, 0, 0, 0, 0);
+	if(!virtual_surface) {
+		fprintf(stderr, "can't make a virtual surface: %s\n",
+			SDL_GetError());
+		return false;
+	}
+
+	// Something other than flat colour, and a full palette to expand
+	SDL_Color colors[256];
+	for(int c = 0; c < 256; ++c) {
+		colors[c].r = c;
+		colors[c].g = 255 - c;
+		colors[c].b = c * 3;
+		colors[c].unused = 0;
+	}
+	SDL_SetColors(virtual_surface, colors, 0, 256);
+	SDL_LockSurface(virtual_surface);
+	for(int y = 0; y < virtual_surface->h; ++y) {
+		Uint8* row = (Uint8*) virtual_surface->pixels
+			+ y * virtual_surface->pitch;
+		for(int x = 0; x < virtual_surface->w; ++x) {
+			row[x] = (Uint8) (x * 7 + y * 3);
+		}
+	}
+	SDL_UnlockSurface(virtual_surface);
+
+	try {
+		for(size_t r = 0;
+			r < sizeof(resolutions) / sizeof(resolutions[0]); ++r) {
+
+			int w = resolutions[r][0], h = resolutions[r][1];
+			SDL_Rect virtual_resolution = { 0, 0, 640, 480 };
+			SDL_Rect true_resolution = { 0, 0, (Uint16) w, (Uint16) h };
+			double upscale;
+			if(scale_needed(virtual_resolution, true_resolution, &upscale)) {
+				report_scaler<ScaledVideoInteger>("integer",
+					virtual_surface, w, h, 8, frames);
+			}
+			report_scaler<ScaledVideoArbitrary>("arbitrary",
+				virtual_surface, w, h, 8, frames);
+			report_scaler<ScaledVideoArbitraryConvertingPaletted>(
+				"converting", virtual_surface, w, h, 32, frames);
+		}
+	} catch(std::exception& e) {
+		fprintf(stderr, "scaler benchmark failed: %s\n", e.what());
+		SDL_FreeSurface(virtual_surface);
+		return false;
+	}
+
+	SDL_FreeSurface(virtual_surface);
+	return true;
+}
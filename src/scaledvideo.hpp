@@ -15,18 +15,44 @@
   * which is tuned to the scaling function needed. */
 class ScaledVideo {
 protected:
+	enum { MAX_DIRTY_RECTS = 16 };
+	// Row bands big updates are split into, and helper threads for them
+	enum { SCALER_BANDS = 16, SCALER_THREADS = 3 };
+
 	SDL_Surface* m_virtual_surface;
 	SDL_Surface* m_true_surface;
 	SDL_Rect m_virtual_resolution;
 	SDL_Rect m_true_resolution;
+	// The rectangle updateScale() is to redraw
 	SDL_Rect m_virtual_dirty;
+	// Everything dirty since the last update(), possibly overlapping
+	SDL_Rect m_dirty[MAX_DIRTY_RECTS];
+	int m_num_dirty;
+	int m_last_dirty;
 
 	// Utility to clip virtual point and rectangle
 	void clipPoint(Sint16 raw_x, Sint16 raw_y,
 		Sint16* clip_x, Sint16* clip_y);
 	SDL_Rect clipRect(const SDL_Rect& rect);
-	// Implement this to do the scaling
+	// Implement this to do the scaling, of m_virtual_dirty only
 	virtual void updateScale() = 0;
+
+	/* Call scaleRows() over first..last-1 in bands, spread over the helper
+	 * threads if pixels (the output size) makes that worth it. Rows are
+	 * whatever the subclass's scaleRows() takes them to be. */
+	void parallelRows(int first, int last, long pixels);
+	virtual void scaleRows(int first, int last);
+
+	// Helper threads, started on first use
+	SDL_Thread* m_helpers[SCALER_THREADS];
+	int m_num_helpers;
+	SDL_sem* m_helper_start;
+	SDL_sem* m_helper_done;
+	SDL_mutex* m_band_lock;
+	bool m_helpers_quit;
+	int m_band_first, m_band_last, m_band_next;
+	void runBands();
+	static int helperThread(void* data);
 public:
 	/** This is only of use to subclasses. Use the factory function.
 	  * If you try to use this plain, you won't get any video output. */
@@ -41,7 +67,9 @@ public:
 	virtual std::string describe() = 0;
 
 	/** Register a (virtual) region as changed and in need of a repaint.
-	  * Automatically clips offscreen rectangles. */
+	  * Automatically clips offscreen rectangles. Regions are kept as a
+	  * short list of rectangles, merged where that costs little, so
+	  * changes far apart don't repaint everything between them. */
 	void dirtyRect(const SDL_Rect& rect);
 
 	/** Redraw everything dirty to the true surface.
@@ -72,4 +100,9 @@ ScaledVideo* get_scaled_video(
 	int true_bpp = 0,
 	Uint32 flags = SDL_SWSURFACE | SDL_ANYFORMAT);
 
+/** Time every scaler that applies from a 640x480 8bpp surface to some
+  * common native resolutions, in 8 and 32bpp, and print ms per frame.
+  * Needs no video mode. Returns false if surfaces couldn't be made. */
+bool benchmark_scaled_video(int frames);
+
 #endif
@@ -161,6 +161,7 @@ void eventhandler()
 			if (ActiveApp)
 			{
 				gfx_redraw = 1;
+				g_scaled_video->dirtyRect(g_virtual_resolution);
 			}
 			break;
 
@@ -173,6 +174,7 @@ void eventhandler()
 				/* fallthrough */
 			case SDL_VIDEOEXPOSE:
 				ActiveApp = 1;
+				g_scaled_video->dirtyRect(g_virtual_resolution);
 				break;
 
 			case SDL_QUIT:
@@ -1,4 +1,6 @@
 #include <string>
+#include <string.h>
+#include <stdlib.h>
 
 #include <SDL.h>
 #include <SDL_mixer.h>
@@ -9,12 +11,23 @@
 #include "sais_version.h"
 
 int my_main();
+int sim_main(int argc, char *argv[]);
+int batch_main(int argc, char *argv[]);
+int bench_main(int argc, char *argv[]);
+int hitbench_main(int argc, char *argv[]);
+int dircheck_main(int argc, char *argv[]);
+int blitbench_main(int argc, char *argv[]);
+int inibench_main(int argc, char *argv[]);
+int pack_main(int argc, char *argv[]);
+int replay_main();
 int sound_init();
 
 extern SDL_Surface *sdlsurf;
 extern SDL_Rect g_native_resolution;
 extern SDL_Rect g_virtual_resolution;
 extern ScaledVideo* g_scaled_video;
+extern char combat_replayfile[256];
+extern int32 combat_replayevery;
 
 int main(int argc, char *argv[])
 {
@@ -29,6 +42,59 @@ int main(int argc, char *argv[])
 	fprintf(stderr, "Strange Adventures in Infinite Space - v" SAIS_VERSION_STRING "\n");
 	fprintf(stderr, "Unofficial fork by Philip Boulain et. al. (see README.md)\n");
 
+	// atan2 instead of the direction tables, to a/b simulator runs
+	if (argc > 1 && !strcmp(argv[1], "-libm"))
+	{
+		gfx_libmath = 1;
+		argc--; argv++;
+	}
+
+	// headless combat simulator, needs no video or audio
+	if (argc > 1 && !strcmp(argv[1], "-simulate"))
+		return sim_main(argc-2, argv+2);
+	if (argc > 1 && !strcmp(argv[1], "-batch"))
+		return batch_main(argc-2, argv+2);
+	if (argc > 1 && !strcmp(argv[1], "-benchmark"))
+		return bench_main(argc-2, argv+2);
+	if (argc > 1 && !strcmp(argv[1], "-hitbench"))
+		return hitbench_main(argc-2, argv+2);
+	if (argc > 1 && !strcmp(argv[1], "-checkdirection"))
+		return dircheck_main(argc-2, argv+2);
+	if (argc > 1 && !strcmp(argv[1], "-blitbench"))
+		return blitbench_main(argc-2, argv+2);
+	if (argc > 1 && !strcmp(argv[1], "-inibench"))
+		return inibench_main(argc-2, argv+2);
+	if (argc > 1 && !strcmp(argv[1], "-pack"))
+		return pack_main(argc-2, argv+2);
+
+	// time the screen scalers, needs the timer but no video mode
+	//   -scalebench [frames]
+	if (argc > 1 && !strcmp(argv[1], "-scalebench"))
+	{
+		if (SDL_Init(SDL_INIT_TIMER) < 0)
+		{
+			fprintf(stderr, "Problem initialising SDL: %s\n", SDL_GetError());
+			return 1;
+		}
+		int frames = (argc > 2) ? atoi(argv[2]) : 50;
+		bool ok = benchmark_scaled_video(frames > 0 ? frames : 50);
+		SDL_Quit();
+		return ok ? 0 : 1;
+	}
+
+	// play back a recorded battle, drawing a frame every so many ticks
+	//   -replay <file> [every]
+	// with every 0 it runs headless and only prints the outcome
+	if (argc > 2 && !strcmp(argv[1], "-replay"))
+	{
+		strncpy(combat_replayfile, argv[2], 255);
+		combat_replayevery = 1;
+		if (argc > 3)
+			combat_replayevery = atoi(argv[3]);
+		if (combat_replayevery < 1)
+			return replay_main();
+	}
+
 	if(SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER | SDL_INIT_AUDIO) < 0)
 	{
 		fprintf(stderr, "Problem initialising SDL: %s\n", SDL_GetError());
@@ -281,6 +281,7 @@ extern t_wavesound wavesnd[WAV_MAX];
 // ******** SOUND *********
 
 int Load_WAV(const char *filename, int id);
+void load_splash_sfx(void);
 void load_all_sfx(void);
 int Delete_Sound(int id);
 int Delete_All_Sounds(void);
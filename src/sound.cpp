@@ -6,6 +6,19 @@
 
 int8 s_volume;
 
+// what the splash screen plays, ahead of the rest
+void load_splash_sfx(void)
+{
+	Load_WAV("sounds/logo.wav",						WAV_LOGO);
+	Load_WAV("sounds/music/start.wav",					WAV_MUS_START);
+	Load_WAV("sounds/alien1.wav",					WAV_TITLE1);
+	Load_WAV("sounds/alien2.wav",					WAV_TITLE2);
+	Load_WAV("sounds/alien3.wav",					WAV_TITLE3);
+	Load_WAV("sounds/titzap01.wav",				WAV_TITLE4);
+	Load_WAV("sounds/titzap02.wav",				WAV_TITLE5);
+	Load_WAV("sounds/music/splash.wav",					WAV_MUS_SPLASH);
+}
+
 #ifndef DEMO_VERSION
 void load_all_sfx(void)
 {
@@ -12,20 +12,57 @@
 #include <string.h>
 #ifdef WINDOWS
 #include <malloc.h>
-#include <io.h>
-#else
-#include <sys/types.h>
-#include <dirent.h>
 #endif
 
 #include "typedefs.h"
 #include "iface_globals.h"
 #include "gfx.h"
 #include "is_fileio.h"
+#include "vfs.h"
 #include "snd.h"
 
 //		FILE *loggy;
 
+// --------------------------------------------
+//        ROTATED SPRITE CACHE (DATA)
+// --------------------------------------------
+
+// ik_drsprite() keeps sprites it has rotated and scaled, keyed by angle
+// bucket and size, up to gfx_rotcache_budget bytes. least recently used
+// ones go first.
+#define ROTCACHE_ENTRIES 2048
+#define ROTCACHE_HASH 1024			// power of two
+#define ROTCACHE_MAXSIZE 128		// bigger sprites are always drawn directly
+#define ROTCACHE_ASHIFT 2				// angles share an entry in steps of 1<<ROTCACHE_ASHIFT
+
+typedef struct _t_rotentry
+{
+	t_ik_sprite *spr;		// NULL if unused
+	int32 r, s;					// angle bucket and size drawn at
+	int32 size;					// half the side of rot
+	t_ik_sprite *rot;		// as drawn, centred, with runs
+	int32 bytes;
+	int32 prev, next;		// lru list, most recently used first
+	int32 hnext;				// next entry in the same hash slot
+} t_rotentry;
+
+t_rotentry	rc_entry[ROTCACHE_ENTRIES];
+int32				rc_hash[ROTCACHE_HASH];
+int32				rc_head, rc_tail;		// lru list
+int32				rc_free;						// unused entries, chained by next
+int32				rc_num;
+int32				rc_bytes;
+int32				rc_init;
+
+int32				gfx_rotcache_budget = 4<<20;
+uint32			gfx_rotcache_hits;
+uint32			gfx_rotcache_misses;
+
+int32 rotcache_get(t_ik_sprite *spr, int32 r, int32 s);
+void rotcache_forget(t_ik_sprite *spr);
+void drsprite_clamp(t_ik_sprite *spr, int32 dx, int32 dy, int32 cx, int32 cy, int32 y1,
+										int32 *x1, int32 *x2, int32 *xt, int32 *yt);
+
 // --------------------------------------------
 //      SPRITE CREATION AND MANAGEMENT
 // --------------------------------------------
@@ -40,6 +77,7 @@ t_ik_sprite *new_sprite(int32 w, int32 h)
 		return NULL;
 
 	spr->data=(uint8 *)malloc(w*h);
+	spr->runs=NULL;
 	spr->w=w;
 	spr->h=h;
 	spr->co=0;
@@ -100,17 +138,78 @@ t_ik_sprite *get_sprite(t_ik_image *img, int32 x, int32 y, int32 w, int32 h)
 			spr->data[y1*w+x1]=0;
 
 	calc_sprite_color(spr);
+	sprite_buildruns(spr);
 
 	return spr;
 }
 
+// list the runs of opaque pixels on each row, so the blitters can copy
+// them whole instead of testing every pixel. runs[y] is where row y's
+// list starts in runs: the number of runs, then start and length of each.
+// sprites whose data is changed after this must not have runs.
+// returns the bytes used, 0 if there was no memory or the runs are too
+// short to be worth it (runs stays NULL).
+int32 sprite_buildruns(t_ik_sprite *spr)
+{
+	int32 x, y, n, o;
+	int32 *runs;
+	uint8 *p;
+
+	free(spr->runs);
+	spr->runs = NULL;
+
+	n = spr->h; o = 0;
+	for (y = 0; y < spr->h; y++)
+	{
+		p = spr->data + y*spr->w;
+		n++;
+		for (x = 0; x < spr->w; x++)
+			if (p[x])
+			{
+				o++;
+				if (x == 0 || !p[x-1])
+					n += 2;
+			}
+	}
+	if (o < (n - spr->h*2) * 2)		// runs under 4 pixels on average
+		return 0;
+
+	runs = (int32*)malloc(n * sizeof(int32));
+	if (!runs)
+		return 0;
+
+	n = spr->h;
+	for (y = 0; y < spr->h; y++)
+	{
+		p = spr->data + y*spr->w;
+		runs[y] = n++;
+		runs[runs[y]] = 0;
+		for (x = 0; x < spr->w; x++)
+			if (p[x])
+			{
+				if (x == 0 || !p[x-1])
+				{
+					runs[runs[y]]++;
+					runs[n++] = x;
+					runs[n++] = 0;
+				}
+				runs[n-1]++;
+			}
+	}
+
+	spr->runs = runs;
+	return n * sizeof(int32);
+}
+
 // DESTROY SPRITE AND FREE MEMORY
 void free_sprite(t_ik_sprite *spr)
 {
 	if (spr)
 	{
+		rotcache_forget(spr);	// its address may come back as another sprite
 		if (spr->data)
 			free(spr->data);
+		free(spr->runs);
 		free(spr);
 	}
 }
@@ -142,134 +241,127 @@ void free_spritepak(t_ik_spritepak *pak)
 
 	for (x = 0; x < pak->num; x++)
 	{
+		// frames in the mapping go with it
+		if (pak->spr[x] && pak->spr[x]->data >= pak->map && pak->spr[x]->data <= pak->map + pak->mapsize)
+			pak->spr[x]->data = NULL;
 		free_sprite(pak->spr[x]);
 		pak->spr[x]=NULL;
 	}
 	free(pak->spr);
+	if (pak->map)
+		unmap_file(pak->map, pak->mapsize);
 	free(pak);
 }
 
 t_ik_spritepak *load_sprites(const char *fname)
 {
 	// NOTE: load_sprites loads default .SPR, and FRAMES from the mod
-#ifdef WINDOWS
-	struct _finddata_t find;
-	long fhandle;
-	int fi;
-#else
-	DIR		   *find;
-#endif
-	int fnum;
 	char spritedir[256];
 	char framename[256];
 	int rep[256];
 	int max;
 	t_ik_image *img;
-	uint8 *buffu;
 
-	FILE *fil;
+	uint8 *map;
 	t_ik_spritepak *pak;
-	int32 x,num;
+	t_ik_sprite *spr;
+	int32 x,num,o,size,f;
 	int32 w,h,c;
 
 /*
-if loading a mod, look at the folder for new frames
+if loading a mod, look in the index for new frames
 and mark them in the replacement array.
 */
 	for (x = 0; x < 256; x++)
 		rep[x] = 0;
 	max = 0;
+	sprintf(spritedir, "%s", fname);
+	sprintf(spritedir+strlen(spritedir)-4, "/%c", '\0');
 	if (strlen(moddir))
 	{
-#ifdef WINDOWS
-		sprintf(spritedir, "%s%s", moddir, fname);
-		sprintf(spritedir+strlen(spritedir)-4, "/%c", '\0');
-		sprintf(framename, "%sframe*.tga", spritedir);
-
-		fhandle = _findfirst(framename, &find);
-		if (fhandle != -1)
+		for (x = 0; x < 256; x++)
 		{
-			fi = fhandle;
-			while (fi != -1)
+			sprintf(framename, "%sframe%03d.tga", spritedir, x);
+			if (vfs_find(framename, VFS_MOD) >= 0)
 			{
-				sscanf(find.name+5, "%03d", &fnum);
-				if (fnum < 256)
-				{
-					rep[fnum] = 1;
-					if (fnum+1 > max)
-						max = fnum+1;
-				}
-				fi = _findnext(fhandle, &find);
-			}
-			_findclose(fhandle);
-		}
-#else
-		sprintf(spritedir, "%s%s", moddir, fname);
-		sprintf(spritedir+strlen(spritedir)-4, "/%c", '\0');
-
-		find = opendir(spritedir);
-		if (NULL != find) {
-			struct dirent *de;
-
-			while (NULL != (de = readdir(find))) {
-				if (!strncasecmp(de->d_name, "frame",5)
-				    and !strncasecmp(de->d_name+8, ".tga", 4)) {
-					sscanf(de->d_name+5, "%03d", &fnum);
-					if (fnum < 256) {
-						rep[fnum] = 1;
-						if (fnum+1 > max)
-							max = fnum+1;
-					}
-				}
+				rep[x] = 1;
+				max = x+1;
 			}
-			closedir(find);
 		}
-#endif
 	}
 
-	fil=fopen(fname,"rb");	// don't use myopen here
-	if (!fil)
+	// frames point straight into the file, only mod frames are copies
+	f = vfs_find(fname, VFS_BASE);		// the game's, not the mod's
+	if (f >= 0)
+		map = vfs_map(f, &size);
+	else
+		map = map_file(fname, &size);
+	if (!map)
 		return NULL;
+	if (size < 2)
+	{ unmap_file(map, size); return NULL; }
 
-	num=fgetc(fil);
-	num+=fgetc(fil)*256;
+	num = map[0] + map[1]*256;
 
 	if (num > max)
 		max = num;
 
 	pak = new_spritepak(max);
 	if (!pak)
-	{ fclose(fil); return NULL; }
+	{ unmap_file(map, size); return NULL; }
+	pak->map = map;
+	pak->mapsize = size;
 
+	o = 2;
 	for (x=0;x<max;x++)
 	{
 		// header
+		if (x < num && o + 8 > size)
+		{
+			fprintf(stderr, "Short read when loading sprite '%s'\n", fname);
+			num = x;
+		}
 		if (x < num)
 		{
-			w=fgetc(fil);
-			w+=fgetc(fil)*256;
-			h=fgetc(fil);
-			h+=fgetc(fil)*256;
-			c = fgetc(fil);
-			fgetc(fil);
-			fgetc(fil);
-			fgetc(fil);
-			buffu = (uint8*)malloc(w * h);
-			// short reads seem to be *normal* here for graphics/ifbutton.spr D:
-			memset(buffu, 0, w*h); // so zero-init any missing data
-			if(fread(buffu,1,w*h,fil) != static_cast<size_t>(w*h))
-				{ fprintf(stderr, "Short read when loading sprite '%s'\n", fname); }
+			w = map[o] + map[o+1]*256;
+			h = map[o+2] + map[o+3]*256;
+			c = map[o+4];
+			o += 8;
 
 			if (!rep[x])
 			{
 			// if not marked as rep, make new sprite
-				pak->spr[x]=new_sprite(w,h);
-				pak->spr[x]->co=c;
-				// data
-				memcpy(pak->spr[x]->data, buffu, w*h);
+				if (o + w*h <= size)
+				{
+					spr = (t_ik_sprite*)malloc(sizeof(t_ik_sprite));
+					if (spr)
+					{
+						spr->data = map + o;
+						spr->runs = NULL;
+						spr->w = w;
+						spr->h = h;
+					}
+				}
+				else
+				{
+					// short reads seem to be *normal* here for graphics/ifbutton.spr D:
+					fprintf(stderr, "Short read when loading sprite '%s'\n", fname);
+					spr = new_sprite(w,h);
+					if (spr)
+					{
+						memset(spr->data, 0, w*h); // so zero-fill any missing data
+						memcpy(spr->data, map + o, MAX(size - o, 0));
+					}
+				}
+				pak->spr[x] = spr;
+				if (spr)
+				{
+					spr->co=c;
+					sprite_buildruns(spr);
+				}
 			}
 
-			free(buffu);
+			o += w*h;
 		}
 		if (rep[x])
 		{
@@ -283,8 +375,6 @@ and mark them in the replacement array.
 		}
 	}
 
-	fclose(fil);
-
 	return pak;
 }
 
@@ -322,6 +412,42 @@ void save_sprites(const char *fname, t_ik_spritepak *pak)
 //	      SPRITE DRAWING FUNCTIONS
 // --------------------------------------------
 
+// draw the opaque runs of spr with its corner at x, y. co recolours the
+// first 16 colours like ik_dsprite(), fx are the light, trans and add
+// flags of ik_drsprite(). without runs each row is tested pixel by pixel.
+void sprite_drawruns(t_ik_image *img, int32 x, int32 y, t_ik_sprite *spr, int32 co, int32 fx)
+{
+	int32 py, yb, ye;
+	int32 x1, x2, n;
+	int32 row[3];
+	int32 *run;
+	uint8 *p1, *p2;
+
+	yb=MAX(c_miny, y); ye=MIN(c_maxy, y+spr->h);
+	row[0] = 1; row[1] = 0; row[2] = spr->w;
+
+	for (py=yb; py<ye; py++)
+	{
+		run = spr->runs ? spr->runs + spr->runs[py-y] : row;
+		for (n = *run++; n > 0; n--, run += 2)
+		{
+			x1 = MAX(x+run[0], c_minx);
+			x2 = MIN(x+run[0]+run[1], c_maxx);
+			if (x1 >= x2)
+				continue;
+
+			p1 = ik_image_pointer(img, x1, py);
+			p2 = spr->data + (py-y)*spr->w + (x1-x);
+			if (!co && !fx && spr->runs)
+				memcpy(p1, p2, x2-x1);
+			else if (!fx)
+				gfx_maskrow(p1, p2, x2-x1, co);
+			else
+				gfx_fxrow(p1, p2, x2-x1, fx);
+		}
+	}
+}
+
 // basic sprite draw.. corner align, 0-masked
 // flags:
 // 1:  center align (move up-left by half the size)
@@ -329,10 +455,7 @@ void save_sprites(const char *fname, t_ik_spritepak *pak)
 // 4:  blank
 void ik_dsprite(t_ik_image *img, int32 x, int32 y, t_ik_sprite *spr, int32 flags)
 {
-	int32 px,py;
-	int32 yb,ye,xb,xe;
 	uint8 co=0;
-  uint8 *p1, *p2;
 
 	if (flags&1) { x-=spr->w>>1; y-=spr->h>>1; }  // centered
 	if (flags&2) { co=flags>>8; }  // colored
@@ -340,36 +463,8 @@ void ik_dsprite(t_ik_image *img, int32 x, int32 y, t_ik_sprite *spr, int32 flags
 
   if (x<c_minx-spr->w || y<c_miny-spr->h || x>=c_maxx || y>=c_maxy) return;
 
-	yb=MAX(c_miny, y); ye=MIN(c_maxy, y+spr->h);
-	xb=MAX(c_minx, x); xe=MIN(c_maxx, x+spr->w);
-
-  for (py=yb; py<ye; py++)
-  {
-		px=xb;
-    p1=ik_image_pointer(img,px,py);
-    p2=spr->data+((py-y)*spr->w)+(px-x);
-		if (!co)
-			for (;px<xe;px++)
-      {
-      	if (*p2)
-					*p1=*p2;
-
-        p1++;p2++;
-      }
-		else
-  		for (;px<xe;px++)
-      {
-				if (*p2)
-				{
-      		if (*p2<16)
-    	  	  *p1=*p2+co*16;
-					else
-	        	*p1=*p2;
-				}
-
-        p1++;p2++;
-      }
-		}
+	ik_dirty(img, x, y, x+spr->w, y+spr->h);
+	sprite_drawruns(img, x, y, spr, co, 0);
 }
 
 // basic rsprite draw.. center align, rotation, scale (0-masked)
@@ -382,8 +477,8 @@ void ik_drsprite(t_ik_image *img, int32 x, int32 y, int32 r, int32 s, t_ik_sprit
   int32 x1,y1,x2;
 	int32 size;
 	int32 xt,yt,c,cx,cy;
-	int32 cutleft, cutright;
 	int32 dx,dy;
+	int32 e;
   uint8 *p1;
 
 	if (s<=2)
@@ -395,6 +490,7 @@ void ik_drsprite(t_ik_image *img, int32 x, int32 y, int32 r, int32 s, t_ik_sprit
 			{
 				if (flags)
 				{
+					ik_dirty(img, x, y, x+1, y+1);
 			    p1=ik_image_pointer(img, x, y);
 
 					if (flags&1)  c=gfx_lightbuffer[(c<<8)+(flags>>8)];
@@ -410,11 +506,25 @@ void ik_drsprite(t_ik_image *img, int32 x, int32 y, int32 r, int32 s, t_ik_sprit
 		return;
 	}
 
-	s=(s<<10)/MAX(spr->w,spr->h);
-  size=MAX(spr->w,spr->h)*s>>11;
+	size=MAX(spr->w,spr->h)*((s<<10)/MAX(spr->w,spr->h))>>11;
 
   if (x<c_minx-size || y<c_miny-size || x>=c_maxx+size || y>=c_maxy+size) return;
 
+	e = (int32)(size*1.4)+1;
+	ik_dirty(img, x-e, y-e, x+e, y+e);
+
+	// most sprites come back at the same few angles and sizes every frame
+	if (s <= ROTCACHE_MAXSIZE && gfx_rotcache_budget > 0)
+	{
+		e = rotcache_get(spr, r, s);
+		if (e > -1)
+		{
+			sprite_drawruns(img, x-rc_entry[e].size, y-rc_entry[e].size, rc_entry[e].rot, 0, flags);
+			return;
+		}
+	}
+
+	s=(s<<10)/MAX(spr->w,spr->h);
 	r &= 1023;
 	dx = cos1k[r]*1024/s;
 	dy = -sin1k[r]*1024/s;
@@ -429,43 +539,9 @@ void ik_drsprite(t_ik_image *img, int32 x, int32 y, int32 r, int32 s, t_ik_sprit
     {
       x2=x+size;if (x2>c_maxx) x2=c_maxx;
 			x1=x-size;if (x1<c_minx) x1=c_minx;
-			xt=cx+(x1-x)*dx-y1*dy;
-			yt=cy+y1*dx+(x1-x)*dy;
-
-			cutleft=0; cutright=0;
-			// Clamp X
-			if (dx>0)
-			{
-				if (xt+(x2-x1)*dx>spr->w<<16) 	cutright=MAX(cutright, (xt+(x2-x1)*dx-(spr->w<<16))/dx);
-				if (xt<0)												cutleft=MAX(cutleft, -xt/dx+1);
-			}
-			else if (dx<0)
-			{
-				if (xt+(x2-x1)*dx<0)			cutright=MAX(cutright, (xt+(x2-x1)*dx)/dx);
-				if (xt>spr->w<<16)				cutleft=MAX(cutleft, -(xt-(spr->w<<16))/dx+1);
-			}
-			else if (xt<0 || xt>=spr->w<<16)	 x2=x1;   // don't draw hline
-
-			// Clamp Y
-			if (x2>x1) {
-				if (dy>0)
-				{
-					if (yt+(x2-x1)*dy>spr->h<<16)			cutright=MAX(cutright, (yt+(x2-x1)*dy-(spr->h<<16))/dy);
-					if (yt<0)													cutleft=MAX(cutleft, -yt/dy+1);
-				}
-				else if (dy<0)
-				{
-					if (yt+(x2-x1)*dy<0)				cutright=MAX(cutright, (yt+(x2-x1)*dy)/dy);
-					if (yt>spr->h<<16)					cutleft=MAX(cutleft, -(yt-(spr->h<<16))/dy+1);
-				}
-				else if (yt<0 || yt>=spr->h<<16)	x2=x1;  // don't draw hline
-			}
-
-			// Apply clamps
-			if (cutleft)
-			{ xt+=dx*cutleft; yt+=dy*cutleft; x1+=cutleft; }
-			if (cutright)
-			{ x2-=cutright; }
+			x1-=x; x2-=x;
+			drsprite_clamp(spr, dx, dy, cx, cy, y1, &x1, &x2, &xt, &yt);
+			x1+=x; x2+=x;
 
       p1=ik_image_pointer(img, x1, y1+y);
 
@@ -499,6 +575,53 @@ void ik_drsprite(t_ik_image *img, int32 x, int32 y, int32 r, int32 s, t_ik_sprit
   }
 }
 
+// narrow row y1 of a rotated sprite, x1 to x2 (both relative to its
+// centre), to where it samples inside the sprite. xt, yt get the
+// texture position of the new x1.
+void drsprite_clamp(t_ik_sprite *spr, int32 dx, int32 dy, int32 cx, int32 cy, int32 y1,
+										int32 *x1, int32 *x2, int32 *xt, int32 *yt)
+{
+	int32 cutleft, cutright;
+
+	*xt=cx+(*x1)*dx-y1*dy;
+	*yt=cy+y1*dx+(*x1)*dy;
+
+	cutleft=0; cutright=0;
+	// Clamp X
+	if (dx>0)
+	{
+		if (*xt+(*x2-*x1)*dx>spr->w<<16) 	cutright=MAX(cutright, (*xt+(*x2-*x1)*dx-(spr->w<<16))/dx);
+		if (*xt<0)												cutleft=MAX(cutleft, -*xt/dx+1);
+	}
+	else if (dx<0)
+	{
+		if (*xt+(*x2-*x1)*dx<0)			cutright=MAX(cutright, (*xt+(*x2-*x1)*dx)/dx);
+		if (*xt>spr->w<<16)				cutleft=MAX(cutleft, -(*xt-(spr->w<<16))/dx+1);
+	}
+	else if (*xt<0 || *xt>=spr->w<<16)	 *x2=*x1;   // don't draw hline
+
+	// Clamp Y
+	if (*x2>*x1) {
+		if (dy>0)
+		{
+			if (*yt+(*x2-*x1)*dy>spr->h<<16)			cutright=MAX(cutright, (*yt+(*x2-*x1)*dy-(spr->h<<16))/dy);
+			if (*yt<0)													cutleft=MAX(cutleft, -*yt/dy+1);
+		}
+		else if (dy<0)
+		{
+			if (*yt+(*x2-*x1)*dy<0)				cutright=MAX(cutright, (*yt+(*x2-*x1)*dy)/dy);
+			if (*yt>spr->h<<16)					cutleft=MAX(cutleft, -(*yt-(spr->h<<16))/dy+1);
+		}
+		else if (*yt<0 || *yt>=spr->h<<16)	*x2=*x1;  // don't draw hline
+	}
+
+	// Apply clamps
+	if (cutleft)
+	{ *xt+=dx*cutleft; *yt+=dy*cutleft; *x1+=cutleft; }
+	if (cutright)
+	{ *x2-=cutright; }
+}
+
 // sprite line draw.. line of tiled sprites (useful for laser beams etc)
 // flags:
 // 1:  Light   (flags = 1 + lightcolor*256)
@@ -534,6 +657,8 @@ void ik_dspriteline(t_ik_image *img, int32 xb, int32 yb, int32 xe, int32 ye, int
 	if (xl0>xl1 || yl0>yl1) return;  // if clipped out
   if (xl1<c_minx || yl1<c_miny || xl0>=c_maxx || yl0>=c_maxy) return;
 
+	ik_dirty(img, xl0, yl0, xl1, yl1);
+
 	r=atan2(xe-xb, yb-ye);
 	dx=(int32)(cos(r)*65536*64/s);
 	dy=-(int32)(sin(r)*65536*64/s);
@@ -618,3 +743,183 @@ void ik_dspriteline(t_ik_image *img, int32 xb, int32 yb, int32 xe, int32 ye, int
   }
 }
 
+// --------------------------------------------
+//      ROTATED SPRITE CACHE (FUNCTIONS)
+// --------------------------------------------
+
+void rotcache_initialize()
+{
+	int32 c;
+
+	for (c = 0; c < ROTCACHE_HASH; c++)
+		rc_hash[c] = -1;
+	for (c = 0; c < ROTCACHE_ENTRIES; c++)
+	{
+		rc_entry[c].spr = NULL;
+		rc_entry[c].next = c+1;
+	}
+	rc_entry[ROTCACHE_ENTRIES-1].next = -1;
+	rc_free = 0;
+	rc_head = rc_tail = -1;
+	rc_num = 0;
+	rc_bytes = 0;
+	rc_init = 1;
+}
+
+int32 rotcache_hashslot(t_ik_sprite *spr, int32 r, int32 s)
+{
+	return (int32)(((size_t)spr >> 4) ^ (r * 31) ^ (s * 1021)) & (ROTCACHE_HASH-1);
+}
+
+void rotcache_unlink(int32 e)
+{
+	if (rc_entry[e].prev > -1)
+		rc_entry[rc_entry[e].prev].next = rc_entry[e].next;
+	else
+		rc_head = rc_entry[e].next;
+	if (rc_entry[e].next > -1)
+		rc_entry[rc_entry[e].next].prev = rc_entry[e].prev;
+	else
+		rc_tail = rc_entry[e].prev;
+}
+
+void rotcache_linkfront(int32 e)
+{
+	rc_entry[e].prev = -1;
+	rc_entry[e].next = rc_head;
+	if (rc_head > -1)
+		rc_entry[rc_head].prev = e;
+	else
+		rc_tail = e;
+	rc_head = e;
+}
+
+void rotcache_remove(int32 e)
+{
+	t_rotentry *en = &rc_entry[e];
+	int32 *h;
+
+	h = &rc_hash[rotcache_hashslot(en->spr, en->r, en->s)];
+	while (*h != e)
+		h = &rc_entry[*h].hnext;
+	*h = en->hnext;
+
+	rotcache_unlink(e);
+	// not free_sprite(), nothing is cached for the rotation itself
+	free(en->rot->data);
+	free(en->rot->runs);
+	free(en->rot);
+	en->rot = NULL;
+	en->spr = NULL;
+	rc_bytes -= en->bytes;
+	rc_num--;
+
+	en->next = rc_free;
+	rc_free = e;
+}
+
+// rotate and scale spr into a new entry, as ik_drsprite() would draw it
+int32 rotcache_add(t_ik_sprite *spr, int32 r, int32 s)
+{
+	t_rotentry *en;
+	t_ik_sprite *rot;
+	int32 e, h;
+	int32 size, bytes;
+	int32 x1, x2, y1, xt, yt, dx, dy, cx, cy;
+	uint8 *p1;
+
+	size = (int32)((MAX(spr->w,spr->h)*((s<<10)/MAX(spr->w,spr->h))>>11) * 1.4);
+	if (size < 1 || size*size*4 > gfx_rotcache_budget)
+		return -1;
+
+	rot = new_sprite(size*2, size*2);
+	if (!rot)
+		return -1;
+	if (!rot->data)
+	{
+		free(rot);
+		return -1;
+	}
+
+	// the same texture walk as ik_drsprite(), with nothing clipped
+	h = (s<<10)/MAX(spr->w,spr->h);
+	dx = cos1k[(r << ROTCACHE_ASHIFT) & 1023]*1024/h;
+	dy = -sin1k[(r << ROTCACHE_ASHIFT) & 1023]*1024/h;
+	cx=(spr->w+1)<<15;
+	cy=(spr->h+1)<<15;
+
+	memset(rot->data, 0, size*size*4);
+	for (y1 = -size; y1 < size; y1++)
+	{
+		x1 = -size; x2 = size;
+		drsprite_clamp(spr, dx, dy, cx, cy, y1, &x1, &x2, &xt, &yt);
+
+		p1 = rot->data + (y1+size)*size*2 + x1+size;
+		for (; x1 < x2; x1++)
+		{
+			*p1++ = spr->data[(yt>>16)*spr->w+(xt>>16)];
+			xt+=dx; yt+=dy;
+		}
+	}
+
+	bytes = sprite_buildruns(rot) + size*size*4;
+
+	while ((rc_free == -1 || rc_bytes + bytes > gfx_rotcache_budget) && rc_tail > -1)
+		rotcache_remove(rc_tail);
+
+	e = rc_free;
+	rc_free = rc_entry[e].next;
+	en = &rc_entry[e];
+	en->spr = spr;
+	en->r = r;
+	en->s = s;
+	en->size = size;
+	en->rot = rot;
+	en->bytes = bytes;
+	rc_bytes += bytes;
+	rc_num++;
+
+	h = rotcache_hashslot(spr, r, s);
+	en->hnext = rc_hash[h];
+	rc_hash[h] = e;
+	rotcache_linkfront(e);
+
+	return e;
+}
+
+int32 rotcache_get(t_ik_sprite *spr, int32 r, int32 s)
+{
+	int32 e;
+
+	if (!rc_init)
+		rotcache_initialize();
+
+	r = ((r + (1<<(ROTCACHE_ASHIFT-1))) >> ROTCACHE_ASHIFT) & (1023 >> ROTCACHE_ASHIFT);
+	for (e = rc_hash[rotcache_hashslot(spr, r, s)]; e > -1; e = rc_entry[e].hnext)
+		if (rc_entry[e].spr == spr && rc_entry[e].r == r && rc_entry[e].s == s)
+		{
+			gfx_rotcache_hits++;
+			if (e != rc_head)
+			{
+				rotcache_unlink(e);
+				rotcache_linkfront(e);
+			}
+			return e;
+		}
+
+	gfx_rotcache_misses++;
+	return rotcache_add(spr, r, s);
+}
+
+// drop every rotation of spr, called when it's freed
+void rotcache_forget(t_ik_sprite *spr)
+{
+	int32 e;
+
+	if (!rc_num)
+		return;
+
+	for (e = 0; e < ROTCACHE_ENTRIES; e++)
+		if (rc_entry[e].spr == spr)
+			rotcache_remove(e);
+}
@@ -9,6 +9,7 @@
 #include <math.h>
 
 #include "typedefs.h"
+#include "rng.h"
 #include "is_fileio.h"
 
 #include "textstr.h"
@@ -44,6 +45,8 @@ int32 kawangi_splode;
 int32 kawangi_incoming;
 int32 timer_warning;
 
+uint32 sm_maplayerkey;	// starmap_maplayerkey() when sm_maplayer was drawn
+
 // ----------------
 // LOCAL PROTOTYPES
 // ----------------
@@ -52,6 +55,8 @@ void help_screen();
 
 void starmap_displayship(int32 t, int32 st);
 int starmap_findstar(int32 mx, int32 my);
+uint32 starmap_maplayerkey();
+void starmap_drawmaplayer();
 
 
 void killstar(int32 c);
@@ -743,7 +748,7 @@ void starmap()
 					ik_print_log("Arrived at %s system.\n", sm_stars[player.system].starname);
 /*
 					if (!sm_stars[player.target].explored)
-						player.card = rand()%num_ecards;
+						player.card = rng_rand(&sm_rng)%num_ecards;
 					sm_stars[player.target].explored = 1;
 */
 				}
@@ -1116,9 +1121,13 @@ void starmap_display(int32 t)
 	cy = SM_MAP_Y + 244;
 	cx = SM_MAP_X + 240;
 
+	// the nebula and stars only change when a star does
+	if (!sm_maplayer || starmap_maplayerkey() != sm_maplayerkey)
+		starmap_drawmaplayer();
+
 	ik_setclip(cx-232,cy-232,cx+232,cy+232);
 
-	ik_copybox(sm_nebulagfx, screen, 8, 8, 472, 472, cx-232, cy-232);
+	ik_copybox(sm_maplayer, screen, 0, 0, 464, 464, cx-232, cy-232);
 
 	for (c = 0; c < num_holes; c++)
 #ifndef STARMAP_DEBUGINFO
@@ -1150,22 +1159,6 @@ void starmap_display(int32 t)
 		sm_stars[c].ds_x = cx + sm_stars[c].x;
 		sm_stars[c].ds_y = cy - sm_stars[c].y;
 
-		if (sm_stars[c].color > -1)
-		{
-			ik_drsprite(screen, sm_stars[c].ds_x, sm_stars[c].ds_y,
-									0, 32, spr_SMstars->spr[sm_stars[c].color], 4);
-			ik_drsprite(screen, sm_stars[c].ds_x, sm_stars[c].ds_y,
-									0, 32, spr_SMstars->spr[sm_stars[c].color], 2);
-		}
-		if ( int32(sm_stars[c].ds_x + 12 + strlen(sm_stars[c].starname)*4) < int32(cx + 232))
-			ik_print(screen, font_4x8, sm_stars[c].ds_x + 12, sm_stars[c].ds_y - 3, 0, sm_stars[c].starname);
-		else
-			ik_print(screen, font_4x8, sm_stars[c].ds_x - 12 - strlen(sm_stars[c].starname)*4, sm_stars[c].ds_y - 3, 0, sm_stars[c].starname);
-#ifdef STARMAP_DEBUGINFO
-		if (sm_stars[c].card>-1 && c != homesystem)
-			ik_print(screen, font_4x8, sm_stars[c].ds_x - 32, sm_stars[c].ds_y + 12, 0, ecards[sm_stars[c].card].name);
-#endif
-
 		if (sm_stars[c].novadate > 0)
 		{
 			nl = (5-4*sm_stars[c].novatype)*365;
@@ -1242,7 +1235,7 @@ void starmap_display(int32 t)
 				while (plgfx_type[sm_stars[c].planetgfx] != sm_stars[c].planet && !must_quit)
 				{
 					ik_eventhandler();
-					sm_stars[c].planetgfx = rand()%num_plgfx;
+					sm_stars[c].planetgfx = rng_rand(&sm_rng)%num_plgfx;
 				}
 			}
 			l = 15;
@@ -1906,6 +1899,69 @@ void starmap_display(int32 t)
 
 }
 
+// what sm_maplayer is drawn from, besides the nebula. stars only change
+// when they go nova or collapse, and then their colour does.
+uint32 starmap_maplayerkey()
+{
+	uint32 k = 2166136261u;
+	int32 c;
+
+	k = (k ^ num_stars) * 16777619u;
+	for (c = 0; c < num_stars; c++)
+	{
+		k = (k ^ sm_stars[c].color) * 16777619u;
+		k = (k ^ sm_stars[c].x) * 16777619u;
+		k = (k ^ sm_stars[c].y) * 16777619u;
+		k = (k ^ sm_stars[c].card) * 16777619u;
+	}
+
+	return k;
+}
+
+// the part of the map that is the same every frame: the nebula, the stars
+// and their names. starmap_display() copies it in and draws the rest.
+void starmap_drawmaplayer()
+{
+	int32 c, x, y;
+	int32 cl[4];
+
+	if (!sm_maplayer)
+	{
+		sm_maplayer = new_image(464, 464);
+		if (!sm_maplayer)
+			return;
+	}
+	sm_maplayerkey = starmap_maplayerkey();
+
+	cl[0] = c_minx; cl[1] = c_miny; cl[2] = c_maxx; cl[3] = c_maxy;
+	ik_setclip(0, 0, 464, 464);
+
+	ik_copybox(sm_nebulagfx, sm_maplayer, 8, 8, 472, 472, 0, 0);
+
+	for (c = 0; c < num_stars; c++)
+	if (sm_stars[c].color > -2)
+	{
+		x = 232 + sm_stars[c].x;
+		y = 232 - sm_stars[c].y;
+
+		if (sm_stars[c].color > -1)
+		{
+			ik_drsprite(sm_maplayer, x, y, 0, 32, spr_SMstars->spr[sm_stars[c].color], 4);
+			ik_drsprite(sm_maplayer, x, y, 0, 32, spr_SMstars->spr[sm_stars[c].color], 2);
+		}
+		if ( int32(x + 12 + strlen(sm_stars[c].starname)*4) < 464)
+			ik_print(sm_maplayer, font_4x8, x + 12, y - 3, 0, sm_stars[c].starname);
+		else
+			ik_print(sm_maplayer, font_4x8, x - 12 - strlen(sm_stars[c].starname)*4, y - 3, 0, sm_stars[c].starname);
+#ifdef STARMAP_DEBUGINFO
+		if (sm_stars[c].card>-1 && c != homesystem)
+			ik_print(sm_maplayer, font_4x8, x - 32, y + 12, 0, ecards[sm_stars[c].card].name);
+#endif
+	}
+
+	ik_setclip(cl[0], cl[1], cl[2], cl[3]);
+}
+
 int starmap_findstar(int32 mx, int32 my)
 {
 	int c;
@@ -349,13 +349,24 @@ extern t_ik_spritepak *spr_SMraces;
 extern uint8					*sm_nebulamap;
 extern t_ik_image			*sm_nebulagfx;
 extern t_ik_image			*sm_starfield;
+extern t_ik_image			*sm_maplayer;		// nebula, stars and their names as on the map
 
 extern int32					star_env[8][8];
 //extern char						pltype_name[10][32];
 extern int32					plgfx_type[256];
 extern int32					num_plgfx;
 
+extern char						planetnames[128][32];
+extern int32					planetnametype[128];
+extern int32					num_planetnames;
+extern char						starnames[128][32];
+extern int32					starnametype[128];
+extern int32					num_starnames;
+extern char						holenames[128][32];
+extern int32					num_holenames;
+
 extern int32					homesystem;
+extern t_rng					sm_rng;
 extern t_player				player;
 extern t_hud					hud;
 
@@ -377,7 +388,7 @@ void player_init();
 void allies_init();
 
 void starmap_init();
-void starmap_create();
+void starmap_create(uint32 seed);
 void starmap_createnebulagfx();
 
 void starmap_deinit();
@@ -9,6 +9,7 @@
 #include <math.h>
 
 #include "typedefs.h"
+#include "rng.h"
 #include "is_fileio.h"
 
 #include "textstr.h"
@@ -222,7 +223,7 @@ void starmap_exploreplanet()
 				sh = -1;
 				while (sh == -1)
 				{
-					sh = rand()%player.num_ships;
+					sh = rng_rand(&sm_rng)%player.num_ships;
 					if (shiptypes[player.ships[sh]].flag & 32)
 						sh = -1;
 				}
@@ -239,7 +240,7 @@ void starmap_exploreplanet()
 
 			if (s > 0)
 			{
-				s = rand()%s;
+				s = rng_rand(&sm_rng)%s;
 				r = 0;
 				for (n = 0; n < shiptypes[sh].num_systems; n++)
 				{
@@ -273,13 +274,13 @@ void starmap_exploreplanet()
 			}
 			if (s>-1)
 			{
-				s = rand()%player.num_items;
+				s = rng_rand(&sm_rng)%player.num_items;
 				while (itemtypes[player.items[s]].type == item_lifeform || itemtypes[player.items[s]].flag == 7)
-					s = rand()%player.num_items;
+					s = rng_rand(&sm_rng)%player.num_items;
 				n = player.items[s];
 				starmap_removeitem(s);
 				sprintf(texty, ecards[c].text, itemtypes[n].name);
-				if (rand()&1)
+				if (rng_rand(&sm_rng)&1)
 					kla_items[kla_numitems++]=n;
 			}
 			else
@@ -303,7 +304,7 @@ void starmap_exploreplanet()
 					while (s == -1 && !must_quit)
 					{
 						ik_eventhandler();
-						s = rand()%num_stars;
+						s = rng_rand(&sm_rng)%num_stars;
 						r = get_distance(sm_stars[s].x - sm_stars[player.system].x,
 														 sm_stars[s].y - sm_stars[player.system].y);
 						if (r < 100)
@@ -335,7 +336,7 @@ void starmap_exploreplanet()
 				s = -1;
 				while (s == -1)
 				{
-					s = rand()%shiptypes[0].num_systems;
+					s = rng_rand(&sm_rng)%shiptypes[0].num_systems;
 					if (shipsystems[shiptypes[0].system[s]].item == -1)
 						s = -1;
 				}
@@ -371,7 +372,7 @@ void starmap_exploreplanet()
 				{
 					ik_eventhandler();
 					n = 1;
-					i[s]=rand()%num_itemtypes;
+					i[s]=rng_rand(&sm_rng)%num_itemtypes;
 					if (s==1 && i[s]==i[0])
 						n=0;
 					else if (itemtypes[i[s]].flag & 1)
@@ -418,7 +419,7 @@ void starmap_exploreplanet()
 				{
 					ik_eventhandler();
 					n = 1;
-					i[s]=rand()%num_itemtypes;
+					i[s]=rng_rand(&sm_rng)%num_itemtypes;
 					if (s==1 && i[s]==i[0])
 						n=0;
 					else if (itemtypes[i[s]].flag & 1)
@@ -595,7 +596,7 @@ void starmap_exploreplanet()
 #ifndef DEMO_VERSION
 		if (itemtypes[it].flag & lifeform_hard)
 		{
-			h = itemtypes[it].cost/10 + rand()%(itemtypes[it].cost/10);
+			h = itemtypes[it].cost/10 + rng_rand(&sm_rng)%(itemtypes[it].cost/10);
 			sprintf(texty, textstring[STR_LIFEFORM_HARD], itemtypes[it].name, h);
 			if (!interface_popup(font_6x8, bx+16, by+96, 192, 0, STARMAP_INTERFACE_COLOR, 0, textstring[STR_LIFEFORM_HARDT], texty, textstring[STR_YES], textstring[STR_NO]))
 			{
@@ -754,8 +755,8 @@ int32 fleet_encounter(int32 flt, int32 inc)
 	t = sm_fleets[flt].num_ships;
 	for (c = 0; c < t; c++)
 	{
-		sx[c] = bx + 32 + (c*96+24+rand()%48)/t;
-		sy[c] =	by + 56 + rand()%16;
+		sx[c] = bx + 32 + (c*96+24+rng_rand(&sm_rng)%48)/t;
+		sy[c] =	by + 56 + rng_rand(&sm_rng)%16;
 	}
 
 	Play_Sound(WAV_RADAR, 15, 1);
@@ -946,13 +947,13 @@ void starmap_mantle(int32 flt)
 			switch(r)
 			{
 				case race_muktian:
-				c = STR_MANTLE_MUKTIAN + (rand()&1);
+				c = STR_MANTLE_MUKTIAN + (rng_rand(&sm_rng)&1);
 				break;
 				case race_garthan:
-				c = STR_MANTLE_GARTHAN + (rand()&1);
+				c = STR_MANTLE_GARTHAN + (rng_rand(&sm_rng)&1);
 				break;
 				case race_urluquai:
-				c = STR_MANTLE_URLUQUAI + (rand()&1);
+				c = STR_MANTLE_URLUQUAI + (rng_rand(&sm_rng)&1);
 				break;
 				default:
 				c = STR_MANTLE_MUKTIAN;
@@ -1022,32 +1023,32 @@ void enemy_encounter(int32 r)
 	ik_print(screen, font_6x8, bx+16, by+26, 3, textstring[STR_VIDCAST2]);
 
 	if (r == race_garthan)
-		sprintf(texty, "%s", textstring[STR_GARTHAN_WARN1+rand()%3]);
+		sprintf(texty, "%s", textstring[STR_GARTHAN_WARN1+rng_rand(&sm_rng)%3]);
 #ifndef DEMO_VERSION
 	else if (r == race_urluquai)
-		sprintf(texty, "%s", textstring[STR_URLUQUAI_WARN1+rand()%3]);
+		sprintf(texty, "%s", textstring[STR_URLUQUAI_WARN1+rng_rand(&sm_rng)%3]);
 	else // tan ru
 	{
 		// generate random tan ru message
 		tx = texty; c = 0;
 		while (c < 180)
 		{
-			mx = rand()%3;
+			mx = rng_rand(&sm_rng)%3;
 			switch (mx)
 			{
 				case 0:
-				*tx++ = 'A'+rand()%('Z'+1-'A');
-				*tx++ = 'A'+rand()%('Z'+1-'A');
-				*tx++ = 'A'+rand()%('Z'+1-'A');
+				*tx++ = 'A'+rng_rand(&sm_rng)%('Z'+1-'A');
+				*tx++ = 'A'+rng_rand(&sm_rng)%('Z'+1-'A');
+				*tx++ = 'A'+rng_rand(&sm_rng)%('Z'+1-'A');
 				*tx++ = ' ';
 				c+=4;
 				break;
 
 				case 1:
-				mc = 1+rand()%8;
+				mc = 1+rng_rand(&sm_rng)%8;
 				while (mc--)
 				{
-					*tx++ = '0'+(rand()&1);
+					*tx++ = '0'+(rng_rand(&sm_rng)&1);
 					c++;
 				}
 				*tx++ = ' ';
@@ -1056,7 +1057,7 @@ void enemy_encounter(int32 r)
 
 				case 2:
 				default:
-				mc = rand()%(strlen(textstring[STR_TANRU_WARN])/4 + 1);
+				mc = rng_rand(&sm_rng)%(strlen(textstring[STR_TANRU_WARN])/4 + 1);
 				*tx++ = textstring[STR_TANRU_WARN][mc*4];
 				*tx++ = textstring[STR_TANRU_WARN][mc*4+1];
 				*tx++ = textstring[STR_TANRU_WARN][mc*4+2];
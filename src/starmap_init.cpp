@@ -9,6 +9,7 @@
 #include <time.h>
 
 #include "typedefs.h"
+#include "rng.h"
 #include "iface_globals.h"
 #include "is_fileio.h"
 #include "gfx.h"
@@ -17,6 +18,7 @@
 #include "cards.h"
 #include "combat.h"
 #include "textstr.h"
+#include "gamedata.h"
 
 #include "starmap.h"
 
@@ -38,6 +40,7 @@ const char *planet_keywords[plkMax] =
 	"VALU",
 	"END",
 };
+t_inikeys planet_keys = { planet_keywords, plkMax };
 
 const char *star_keywords[stkMax] =
 {
@@ -46,6 +49,7 @@ const char *star_keywords[stkMax] =
 	"TEXT",
 	"END",
 };
+t_inikeys star_keys = { star_keywords, stkMax };
 
 const char *item_keywords[itkMax] =
 {
@@ -59,6 +63,7 @@ const char *item_keywords[itkMax] =
 	"SOND",
 	"END",
 };
+t_inikeys item_keys = { item_keywords, itkMax };
 
 const char *raceflt_keywords[rflMax] =
 {
@@ -73,6 +78,7 @@ const char *raceflt_keywords[rflMax] =
 	"HARD",
 	"END",
 };
+t_inikeys raceflt_keys = { raceflt_keywords, rflMax };
 
 // ----------------
 // GLOBAL VARIABLES
@@ -114,6 +120,7 @@ int32						num_racefleets;
 uint8						*sm_nebulamap;
 t_ik_image			*sm_nebulagfx;
 t_ik_image			*sm_starfield;
+t_ik_image			*sm_maplayer;
 
 t_fleet					sm_fleets[STARMAP_MAX_FLEETS];
 
@@ -132,6 +139,7 @@ char						holenames[128][32];
 int32						num_holenames;
 
 int32						homesystem;
+t_rng						sm_rng;		// galaxy generator, also seeds battles
 
 int32						kla_items[32];
 int32						kla_numitems;
@@ -187,9 +195,12 @@ void starmap_create_klakars(int32 num);
 void starmap_init()
 {
 	starmap_initsprites();
-	starmap_initplanettypes();
-	starmap_inititems();
-	starmap_initracefleets();
+	if (!gamedata_cached)
+	{
+		starmap_initplanettypes();
+		starmap_inititems();
+		starmap_initracefleets();
+	}
 	starmap_initshipnames();
 }
 
@@ -210,7 +221,7 @@ void waitsecs(int w, int l)
 	Stop_Sound(15);
 }
 */
-void starmap_create()
+void starmap_create(uint32 seed)
 {
 	int y = 0;
 
@@ -218,17 +229,19 @@ void starmap_create()
 	switch (settings.dif_nebula)
 	{
 		case 0:
-		srand( 123456 );
+		rng_seed(&sm_rng, 123456);
 		break;
 
 		case 1:
-		srand( 33003773 );
+		rng_seed(&sm_rng, 33003773);
 		break;
 
 		case 2:
-		srand( 911 );
+		rng_seed(&sm_rng, 911);
 		break;
 	}
+#else
+	rng_seed(&sm_rng, seed);
 #endif
 
 	prep_screen(); ik_print(screen, font_6x8, 8, y+=8, 0, "nebulas..."); ik_blit();
@@ -249,7 +262,7 @@ void starmap_create()
 #endif
 
 #ifdef DEMO_VERSION
-	srand( (unsigned)time( NULL ) );
+	rng_seed(&sm_rng, seed);
 #endif
 
 	prep_screen(); ik_print(screen, font_6x8, 8, y+=8, 0, "discoveries..."); ik_blit();
@@ -278,8 +291,8 @@ void player_init()
 	int c;
 	int s;
 
-//	strcpy(player.captname, captnames[rand()%num_captnames]);
-//	strcpy(player.shipname, shipnames[rand()%num_shipnames]);
+//	strcpy(player.captname, captnames[rng_rand(&sm_rng)%num_captnames]);
+//	strcpy(player.shipname, shipnames[rng_rand(&sm_rng)%num_shipnames]);
 
 	ik_print_log("initializing player...\n");
 
@@ -319,7 +332,7 @@ void player_init()
 
 	player.num_items = 0; //17;
 	for (c = 0; c < player.num_items; c++)
-		player.items[c] = rand()%num_itemtypes;
+		player.items[c] = rng_rand(&sm_rng)%num_itemtypes;
 
 #ifdef STARMAP_DEBUGDEVICES
 	for (c = 0; c < num_itemtypes; c++)
@@ -524,49 +537,44 @@ void starmap_deinitsprites()
 
 void starmap_initplanettypes()
 {
-	FILE* ini;
-	char s1[64], s2[256];
-	char end;
+	t_inifile *ini;
+	char *s1, *s2;
+	int32 ln;
 	int num;
 	int flag;
 	int n;
 	int com;
 	int tv1;
 
-	ini = myopen("gamedata/planets.ini", "rb");
+	ini = ini_open("gamedata/planets.ini", 1);
 	if (!ini)
 		return;
 
-	end = 0; num = 0; n = 0;
-	while (!end)
+	num = 0; n = 0;
+	for (ln = 0; ln < ini->num; ln++)
 	{
-		end = read_line(ini, s1, s2);
+		s1 = ini->line[ln].key; s2 = ini->line[ln].par;
 		if (!strcmp(s1, planet_keywords[plkBegin]))
 			num++;
 		if (!strcmp(s1, star_keywords[stkBegin]))
 			n++;
 	}
-	fclose(ini);
 
 	platypes = (t_planettype*)calloc(num, sizeof(t_planettype));
 	if (!platypes)
-		return;
+	{ ini_close(ini); return; }
 	num_platypes = num;
 
 	startypes = (t_startype*)calloc(n, sizeof(t_startype));
 	if (!startypes)
-		return;
+	{ ini_close(ini); return; }
 	num_startypes = n;
 
-	ini = myopen("gamedata/planets.ini", "rb");
-	end = 0; num = 0; flag = 0;
-	while (!end)
+	num = 0; flag = 0;
+	for (ln = 0; ln < ini->num; ln++)
 	{
-		end = read_line(ini, s1, s2);
-		com = -1;
-		for (n = 0; n < plkMax; n++)
-			if (!strcmp(s1, planet_keywords[n]))
-				com = n;
+		s1 = ini->line[ln].key; s2 = ini->line[ln].par;
+		com = ini_keyword(&planet_keys, &ini->line[ln]);
 
 		if (flag == 0)
 		{
@@ -598,17 +606,12 @@ void starmap_initplanettypes()
 		}
 
 	}
-	fclose(ini);
 
-	ini = myopen("gamedata/planets.ini", "rb");
-	end = 0; num = 0; flag = 0;
-	while (!end)
+	num = 0; flag = 0;
+	for (ln = 0; ln < ini->num; ln++)
 	{
-		end = read_line(ini, s1, s2);
-		com = -1;
-		for (n = 0; n < stkMax; n++)
-			if (!strcmp(s1, star_keywords[n]))
-				com = n;
+		s1 = ini->line[ln].key; s2 = ini->line[ln].par;
+		com = ini_keyword(&star_keys, &ini->line[ln]);
 
 		if (flag == 0)
 		{
@@ -635,17 +638,11 @@ void starmap_initplanettypes()
 		}
 
 	}
-	fclose(ini);
-
-	ini = myopen("gamedata/planets.ini", "rb");
-	if (!ini)
-		return;
 
 	num_planetnames = 0; num_starnames = 0; num_holenames = 0; num_plgfx = 0;
-	end = 0;
-	while (!end)
+	for (ln = 0; ln < ini->num; ln++)
 	{
-		end = read_line(ini, s1, s2);
+		s1 = ini->line[ln].key; s2 = ini->line[ln].par;
 		if (!strcmp(s1, "END"))
 			flag = 0;
 		else if (!strcmp(s1, "ENVIROS"))
@@ -700,14 +697,14 @@ void starmap_initplanettypes()
 		}
 
 	}
-	fclose(ini);
+	ini_close(ini);
 }
 
 void starmap_inititems()
 {
-	FILE* ini;
-	char s1[64], s2[256];
-	char end;
+	t_inifile *ini;
+	char *s1, *s2;
+	int32 ln;
 	int num;
 	int flag;
 	int n, com;
@@ -716,15 +713,15 @@ void starmap_inititems()
 	char itemtype[8][32];
 	int32 num_types;
 
-	ini = myopen("gamedata/items.ini", "rb");
+	ini = ini_open("gamedata/items.ini", 1);
 	if (!ini)
 		return;
 
-	end = 0; num = 0;
+	num = 0;
 	flag = 0; num_types = 0;
-	while (!end)
+	for (ln = 0; ln < ini->num; ln++)
 	{
-		end = read_line(ini, s1, s2);
+		s1 = ini->line[ln].key; s2 = ini->line[ln].par;
 		if (!strcmp(s1, item_keywords[itkBegin]))
 			num++;
 		if (!strcmp(s1, "ITEMTYPES"))
@@ -738,23 +735,17 @@ void starmap_inititems()
 		}
 
 	}
-	fclose(ini);
 
 	itemtypes = (t_itemtype*)calloc(num, sizeof(t_itemtype));
 	if (!itemtypes)
-		return;
+	{ ini_close(ini); return; }
 	num_itemtypes = num;
 
-	ini = myopen("gamedata/items.ini", "rb");
-
-	end = 0; num = 0; flag = 0;
-	while (!end)
+	num = 0; flag = 0;
+	for (ln = 0; ln < ini->num; ln++)
 	{
-		end = read_line(ini, s1, s2);
-		com = -1;
-		for (n = 0; n < itkMax; n++)
-			if (!strcmp(s1, item_keywords[n]))
-				com = n;
+		s1 = ini->line[ln].key; s2 = ini->line[ln].par;
+		com = ini_keyword(&item_keys, &ini->line[ln]);
 
 		if (flag == 0)
 		{
@@ -827,7 +818,7 @@ void starmap_inititems()
 		}
 
 	}
-	fclose(ini);
+	ini_close(ini);
 }
 
 void starmap_deinititems()
@@ -854,6 +845,8 @@ void starmap_deinitterrain()
 	if (sm_nebulamap) free(sm_nebulamap);
 	del_image(sm_nebulagfx);
 	del_image(sm_starfield);
+	del_image(sm_maplayer);
+	sm_maplayer = NULL;
 }
 
 void starmap_createstars(int n)
@@ -879,13 +872,13 @@ void starmap_createstars(int n)
 		while (!end && !must_quit)
 		{
 			end = 1;
-			sm_stars[c].x = rand()%420 - 210;
+			sm_stars[c].x = rng_rand(&sm_rng)%420 - 210;
 #ifndef DEMO_VERSION
-			sm_stars[c].y = rand()%364 - 182;
+			sm_stars[c].y = rng_rand(&sm_rng)%364 - 182;
 #else
 			sm_stars[c].y = -176 + 352 * c / (num_stars-1);
 #endif
-			sm_stars[c].color = rand()%8;
+			sm_stars[c].color = rng_rand(&sm_rng)%8;
 			for (t = 0; t < c; t++)
 			{
 				r = (int32)sqrt( (sm_stars[t].x-sm_stars[c].x)*(sm_stars[t].x-sm_stars[c].x) +
@@ -895,7 +888,7 @@ void starmap_createstars(int n)
 			}
 		}
 		// create planet
-		sm_stars[c].planet = star_env[sm_stars[c].color][rand()%8];
+		sm_stars[c].planet = star_env[sm_stars[c].color][rng_rand(&sm_rng)%8];
 		sm_stars[c].novadate = 0;
 		sm_stars[c].novatime = 0;
 		end=0;
@@ -903,7 +896,7 @@ void starmap_createstars(int n)
 		{
 			ik_eventhandler();
 			end=1;
-			sm_stars[c].planetgfx = rand()%num_plgfx;
+			sm_stars[c].planetgfx = rng_rand(&sm_rng)%num_plgfx;
 			if (plgfx_type[sm_stars[c].planetgfx]!=sm_stars[c].planet)
 				end=0;
 			r=1;
@@ -940,7 +933,7 @@ void starmap_createstars(int n)
 			end = 0;
 			while (!end)
 			{
-				r = rand()%num_starnames;
+				r = rng_rand(&sm_rng)%num_starnames;
 				if (starnametype[r] == sm_stars[c].color)
 					end=1;
 			}
@@ -956,7 +949,7 @@ void starmap_createstars(int n)
 			end = 0;
 			while (!end)
 			{
-				r = rand()%num_planetnames;
+				r = rng_rand(&sm_rng)%num_planetnames;
 				if (planetnametype[r] == sm_stars[c].planet)
 					end=1;
 			}
@@ -1046,7 +1039,7 @@ void starmap_createnebula(int n)
 
 	int32 num_groups;
 
-	num_groups = rand()%3 + 2;
+	num_groups = rng_rand(&sm_rng)%3 + 2;
 
 	num_nebula = n;
 	sm_nebula = (t_nebula *)calloc(num_nebula, sizeof(t_nebula));
@@ -1057,9 +1050,9 @@ void starmap_createnebula(int n)
 
 	for (c = 0; c < num_groups; c++)
 	{
-		sm_nebula[c].x = rand()%360 + 60;
-		sm_nebula[c].y = rand()%240 + 100;
-		sm_nebula[c].sprite = rand()%7;
+		sm_nebula[c].x = rng_rand(&sm_rng)%360 + 60;
+		sm_nebula[c].y = rng_rand(&sm_rng)%240 + 100;
+		sm_nebula[c].sprite = rng_rand(&sm_rng)%7;
 	}
 
 	for (c = num_groups; c < num_nebula; c++)
@@ -1070,9 +1063,9 @@ void starmap_createnebula(int n)
 		{
 			end = -1;
 			tries++;
-			sm_nebula[c].x = rand()%480;
-			sm_nebula[c].y = rand()%360;
-			sm_nebula[c].sprite = rand()%7;
+			sm_nebula[c].x = rng_rand(&sm_rng)%480;
+			sm_nebula[c].y = rng_rand(&sm_rng)%360;
+			sm_nebula[c].sprite = rng_rand(&sm_rng)%7;
 			for (t = 0; t < c; t++)
 			{
 				r = (int32)sqrt(	(sm_nebula[t].x - sm_nebula[c].x)*(sm_nebula[t].x - sm_nebula[c].x)	+
@@ -1160,6 +1153,10 @@ void starmap_createnebulagfx()
 	int32 c, t;
 	int32 x, y;
 
+	// starmap_display() draws the stars over the new nebula next time
+	del_image(sm_maplayer);
+	sm_maplayer = NULL;
+
 	ik_copybox(sm_starfield, sm_nebulagfx, 0, 0, 480, 480, 0, 0);
 
 	for (y = 0; y < 480; y++)
@@ -1221,8 +1218,8 @@ void starmap_createholes(int32 n)
 		{
 			end = 1;
 
-			sm_holes[c].x = rand()%420 - 210;
-			sm_holes[c].y = rand()%400 - 200;
+			sm_holes[c].x = rng_rand(&sm_rng)%420 - 210;
+			sm_holes[c].y = rng_rand(&sm_rng)%400 - 200;
 
 			for (t = 0; t < num_stars; t++)
 			{
@@ -1252,7 +1249,7 @@ void starmap_createholes(int32 n)
 		{
 			ik_eventhandler();
 			end = 1;
-			r = rand()%num_holenames;
+			r = rng_rand(&sm_rng)%num_holenames;
 			for (t = 0; t < c; t++)
 				if (!strcmp(sm_holes[t].name, holenames[r]))
 					end = 0;
@@ -1343,7 +1340,7 @@ void starmap_createfleets(int32 num) // create enemy fleets
 #endif
 			else
 #ifndef STARMAP_DEBUGTANRU
-				sm_fleets[c].race = enemies[rand()%num_enemies];
+				sm_fleets[c].race = enemies[rng_rand(&sm_rng)%num_enemies];
 #else
 				sm_fleets[c].race = race_tanru;
 #endif
@@ -1358,7 +1355,7 @@ void starmap_createfleets(int32 num) // create enemy fleets
 								!must_quit)
 				{
 					ik_eventhandler();
-					sm_fleets[c].ships[0] = rand()%num_shiptypes;
+					sm_fleets[c].ships[0] = rng_rand(&sm_rng)%num_shiptypes;
 				}
 			}
 			else
@@ -1367,7 +1364,7 @@ void starmap_createfleets(int32 num) // create enemy fleets
 				while (!end)
 				{
 					sm_fleets[c].num_ships = 0;
-					n = racefleets[races[sm_fleets[c].race].fleet].diff[dif][rand()%10];
+					n = racefleets[races[sm_fleets[c].race].fleet].diff[dif][rng_rand(&sm_rng)%10];
 					for (s=2; s>=0; s--)
 					{
 						end = racefleets[races[sm_fleets[c].race].fleet].fleets[n][s];
@@ -1406,7 +1403,7 @@ void starmap_createfleets(int32 num) // create enemy fleets
 			else
 			{
 #endif
-				sm_fleets[c].system = rand()%num_stars;
+				sm_fleets[c].system = rng_rand(&sm_rng)%num_stars;
 				sm_fleets[c].target = sm_fleets[c].system;
 				if (sm_fleets[c].system==homesystem)
 					end = 0;
@@ -1485,7 +1482,7 @@ void starmap_createfleets(int32 num) // create enemy fleets
 			{
 				ik_eventhandler();
 				end = 1;
-				sm_fleets[c].ships[0] = rand()%num_shiptypes;
+				sm_fleets[c].ships[0] = rng_rand(&sm_rng)%num_shiptypes;
 				if (shiptypes[sm_fleets[c].ships[0]].race != race_unknown)
 					end = 0;
 			}
@@ -1517,7 +1514,7 @@ void starmap_createcards(void)
 		while (!end)
 		{
 			end = 1;
-			s = rand()%num_stars;
+			s = rng_rand(&sm_rng)%num_stars;
 			if (s == homesystem)
 				end = 0;
 			if (sm_stars[s].planet == 0 || sm_stars[s].planet > 5)
@@ -1529,7 +1526,7 @@ void starmap_createcards(void)
 		while (!end)
 		{
 			end = 1;
-			i = rand()%num_ecards;
+			i = rng_rand(&sm_rng)%num_ecards;
 			if (ecards[i].type != card_lifeform)
 				end = 0;
 			for (t = 0; t < num_stars; t++)
@@ -1550,7 +1547,7 @@ void starmap_createcards(void)
 		while (!end)
 		{
 			end = 1;
-			i = rand()%num_ecards;
+			i = rng_rand(&sm_rng)%num_ecards;
 			if (ecards[i].type != card_ally)
 				end = 0;
 			else
@@ -1576,7 +1573,7 @@ void starmap_createcards(void)
 		while (!end)
 		{
 			end = 1; tries++;
-			s = rand()%num_stars;
+			s = rng_rand(&sm_rng)%num_stars;
 			if (s == homesystem)
 				end = 0;
 			if (sm_stars[s].card > -1)
@@ -1613,7 +1610,7 @@ void starmap_createcards(void)
 		while (!end)
 		{
 			end = 1;
-			sm_stars[c].card = 1+rand()%(num_ecards-1);
+			sm_stars[c].card = 1+rng_rand(&sm_rng)%(num_ecards-1);
 			t = ecards[sm_stars[c].card].type;
 			if (t == card_ally || t == card_lifeform)
 				end = 0;
@@ -1640,7 +1637,7 @@ void starmap_createcards(void)
 					end = 0;
 					while (!end)
 					{
-						end = rand()%num_planetnames;
+						end = rng_rand(&sm_rng)%num_planetnames;
 						if (planetnametype[end] == sm_stars[c].planet)
 						{	strcpy(sm_stars[c].planetname, planetnames[end]); end = 1; }
 						else
@@ -1650,7 +1647,7 @@ void starmap_createcards(void)
 					while (!end)
 					{
 						end = 1;
-						sm_stars[c].planetgfx = rand()%num_plgfx;
+						sm_stars[c].planetgfx = rng_rand(&sm_rng)%num_plgfx;
 						if (plgfx_type[sm_stars[c].planetgfx]!=sm_stars[c].planet)
 							end=0;
 					}
@@ -1679,7 +1676,7 @@ void starmap_create_klakars(int32 num)
 		while (!end)
 		{
 			end = 1;
-			kla_items[c] = rand()%num_itemtypes;
+			kla_items[c] = rng_rand(&sm_rng)%num_itemtypes;
 			if (itemtypes[kla_items[c]].flag & 1)
 				end = 0;
 			if (itemtypes[kla_items[c]].type != item_weapon)
@@ -1708,7 +1705,7 @@ void starmap_create_klakars(int32 num)
 		while (!end)
 		{
 			end = 1;
-			kla_items[c] = rand()%num_itemtypes;
+			kla_items[c] = rng_rand(&sm_rng)%num_itemtypes;
 			if (itemtypes[kla_items[c]].flag & 1)
 				end = 0;
 			if (itemtypes[kla_items[c]].type != item_system)
@@ -1737,7 +1734,7 @@ void starmap_create_klakars(int32 num)
 		while (!end)
 		{
 			end = 1;
-			kla_items[c] = rand()%num_itemtypes;
+			kla_items[c] = rng_rand(&sm_rng)%num_itemtypes;
 			if (itemtypes[kla_items[c]].flag & 1)
 				end = 0;
 			for (t = 0; t < c; t++)
@@ -1761,23 +1758,23 @@ void starmap_create_klakars(int32 num)
 
 void starmap_initshipnames()
 {
-	FILE* ini;
-	char s1[64];
-	char end;
+	t_inifile *ini;
+	char *s1;
+	int32 ln;
 	int num;
 	int flag;
 
-	ini = myopen("gamedata/names.ini", "rb");
+	ini = ini_open("gamedata/names.ini", 0);
 	if (!ini)
 		return;
 
 	num_captnames = 0;
 	num_shipnames = 0;
-	end = 0; num = 0;
+	num = 0;
 	flag = 0;
-	while (!end)
+	for (ln = 0; ln < ini->num; ln++)
 	{
-		end = read_line1(ini, s1);
+		s1 = ini->line[ln].key;
 		if (!strcmp(s1, item_keywords[itkBegin]))
 			num++;
 		if (!strcmp(s1, "CAPTNAMES"))
@@ -1796,33 +1793,32 @@ void starmap_initshipnames()
 		}
 
 	}
-	fclose(ini);
+	ini_close(ini);
 
 }
 
 void starmap_initracefleets()
 {
-	FILE* ini;
-	char s1[64], s2[256];
-	char end;
+	t_inifile *ini;
+	char *s1, *s2;
+	int32 ln;
 	int num;
 	int flag;
 	int n, com;
 	int tv1, tv2, tv3;
 
-	ini = myopen("gamedata/fleets.ini", "rb");
+	ini = ini_open("gamedata/fleets.ini", 1);
 	if (!ini)
 		return;
 
-	end = 0; num = 0;
+	num = 0;
 	flag = 0;
-	while (!end)
+	for (ln = 0; ln < ini->num; ln++)
 	{
-		end = read_line(ini, s1, s2);
+		s1 = ini->line[ln].key;
 		if (!strcmp(s1, item_keywords[rflBegin]))
 			num++;
 	}
-	fclose(ini);
 /*
 	racefleets = (t_racefleet*)calloc(num, sizeof(t_racefleet));
 	if (!racefleets)
@@ -1830,16 +1826,11 @@ void starmap_initracefleets()
 	*/
 	num_racefleets = num;
 
-	ini = myopen("gamedata/fleets.ini", "rb");
-
-	end = 0; num = 0; flag = 0;
-	while (!end)
+	num = 0; flag = 0;
+	for (ln = 0; ln < ini->num; ln++)
 	{
-		end = read_line(ini, s1, s2);
-		com = -1;
-		for (n = 0; n < rflMax; n++)
-			if (!strcmp(s1, raceflt_keywords[n]))
-				com = n;
+		s1 = ini->line[ln].key; s2 = ini->line[ln].par;
+		com = ini_keyword(&raceflt_keys, &ini->line[ln]);
 
 		if (flag == 0)
 		{
@@ -1891,7 +1882,7 @@ void starmap_initracefleets()
 		}
 
 	}
-	fclose(ini);
+	ini_close(ini);
 }
 
 void starmap_deinitracefleets()
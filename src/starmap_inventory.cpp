@@ -10,6 +10,7 @@
 #include <math.h>
 
 #include "typedefs.h"
+#include "rng.h"
 #include "is_fileio.h"
 
 #include "textstr.h"
@@ -1342,13 +1343,13 @@ int32 probe_fleet_encounter(int32 flt)
 	for (c = 0; c < sm_fleets[flt].num_ships; c++)
 	{
 		mc = hulls[shiptypes[sm_fleets[flt].ships[c]].hull].size;
-		sx[c] = bx + 70 + c * 16 - (sm_fleets[flt].num_ships-1) * 8 + rand()%12;
-		sy[c] =	by + 56 + rand()%16;
+		sx[c] = bx + 70 + c * 16 - (sm_fleets[flt].num_ships-1) * 8 + rng_rand(&sm_rng)%12;
+		sy[c] =	by + 56 + rng_rand(&sm_rng)%16;
 	}
 
 	if (r == race_klakar || races[r].met==2)	// klakar or friend-muktians
 		survive = 1;
-	else if (rand()&1)
+	else if (rng_rand(&sm_rng)&1)
 		survive = 1;
 	else
 		survive = 0;
@@ -1633,8 +1634,8 @@ void eledras_mirror(char *title)
 	if (sm_fleets[f].race == race_unknown)
 	{	// space hulk
 		c = 0;
-		if (!(rand()%5))
-			c = 1 + rand()%7;
+		if (!(rng_rand(&sm_rng)%5))
+			c = 1 + rng_rand(&sm_rng)%7;
 		Play_Sound(WAV_MUS_COMBAT, 15, 1);
 		interface_popup(font_6x8, SM_INV_X + 32*(SM_INV_X==0) - 64*(SM_INV_X>0), SM_INV_Y+40, 192, 80, STARMAP_INTERFACE_COLOR, 0,
 										title, textstring[STR_MIRROR_NOCANDO1+c], textstring[STR_OK]);
@@ -1771,7 +1772,7 @@ int32 eledras_bauble(char *title)
 		x = 0;
 		while (it == -1) // didn't find an item, produce random lifeform
 		{
-			it = rand()%num_itemtypes;
+			it = rng_rand(&sm_rng)%num_itemtypes;
 			if (itemtypes[it].flag & 2)
 				it = -1;
 			else if (itemtypes[it].type != item_lifeform)
@@ -9,6 +9,7 @@
 #include <math.h>
 
 #include "typedefs.h"
+#include "rng.h"
 #include "is_fileio.h"
 
 #include "textstr.h"
@@ -347,7 +348,7 @@ int32 startgame()
 
 	if (end > 1)
 	{
-		starmap_create();
+		starmap_create((uint32)time(NULL));
 		player_init();
 	}
 
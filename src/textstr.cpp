@@ -13,24 +13,24 @@ char *textstring[STR_MAX];
 
 void textstrings_init()
 {
-	FILE* ini;
-	char s1[64], s2[1024];
-	char end;
+	t_inifile *ini;
+	char *s1, *s2;
+	int32 ln;
 	int num;
 	int flag;
 	char *str;
 
-	ini = myopen("gamedata/strings.ini", "rb");
+	ini = ini_open("gamedata/strings.ini", 1);
 	if (!ini)
 		return;
 
 	textbuffer = (char *)calloc(STRINGBUFFER_SIZE,sizeof(char));
 
 	str = textbuffer;
-	end = 0; num = 0; flag = 0;
-	while (!end)
+	num = 0; flag = 0;
+	for (ln = 0; ln < ini->num; ln++)
 	{
-		end = read_line(ini, s1, s2);
+		s1 = ini->line[ln].key; s2 = ini->line[ln].par;
 		if (!strcmp(s1, "STRINGS"))
 			flag=1;
 		else if (!strcmp(s1, "END"))
@@ -43,7 +43,7 @@ void textstrings_init()
 			num++;
 		}
 	}
-	fclose(ini);
+	ini_close(ini);
 
 }
 
@@ -0,0 +1,824 @@
+// ----------------
+//     INCLUDES
+// ----------------
+
+#include <stdexcept>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef WINDOWS
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <dirent.h>
+#endif
+
+#include "typedefs.h"
+#include "iface_globals.h"
+#include "is_fileio.h"
+#include "vfs.h"
+
+// ----------------
+//		CONSTANTS
+// ----------------
+
+#define VFS_HEADER 16		// magic, version, files, size of the names
+#define VFS_ENTRY 16		// name, offset, size, packed size or 0 if stored
+
+// the folders the game's assets are in, anything else is left to the disk
+const char *vfs_roots[] =
+{
+	"graphics/",
+	"sounds/",
+	"gamedata/",
+};
+
+#define VFS_ROOTS ((int32)(sizeof(vfs_roots)/sizeof(vfs_roots[0])))
+
+// ----------------
+//     TYPEDEFS
+// ----------------
+
+// a file of the game or the mod, loose or in a pack
+typedef struct
+{
+	int32 name;			// in vfs_names, lower case
+	int32 path;			// in vfs_names, where it is on disk, -1 in a pack
+	int32 pack;
+	int32 offset, size, packed;		// in the pack, packed 0 if stored
+	int32 layer;		// VFS_BASE or VFS_MOD
+	int32 under;		// the file it overrides, -1 if none
+	uint32 hash;
+} t_vfsfile;
+
+typedef struct
+{
+	char name[256];
+	uint8 *map;
+	int32 mapsize;
+	int32 time;
+} t_vfspack;
+
+// a folder being read, the same on windows and elsewhere
+typedef struct
+{
+#ifdef WINDOWS
+	struct _finddata_t find;
+	long handle;
+	int32 first;
+#else
+	DIR *find;
+#endif
+	char dir[256];
+} t_vfsdir;
+
+// ----------------
+// GLOBAL VARIABLES
+// ----------------
+
+t_vfsfile		*vfs_file;
+int32				vfs_num, vfs_size;
+int32				vfs_basenum;		// the base game's come first and stay
+
+char				*vfs_names;			// names and paths of all of them
+int32				vfs_namelen, vfs_namesize;
+int32				vfs_basenamelen;
+
+int32				*vfs_hash;			// vfs_file of each name, -1 in empty slots
+int32				vfs_hashbits;
+
+t_vfspack		vfs_packs[2];		// one each for VFS_BASE and VFS_MOD
+char				vfs_moddir[256];
+int32				vfs_ready;
+
+// ----------------
+// LOCAL PROTOTYPES
+// ----------------
+
+void vfs_scan(const char *path, const char *name, int32 layer);
+void vfs_loadpack(const char *fname, int32 layer);
+void vfs_freepack(int32 layer);
+int32 vfs_add(const char *name, int32 path, int32 layer);
+int32 vfs_addname(const char *a, const char *b, int32 lower);
+void vfs_rehash();
+uint32 vfs_namehash(const char *s);
+int32 vfs_samename(const char *a, const char *b);
+uint8 *vfs_alloc(int32 size);
+int32 vfs_opendir(t_vfsdir *d, const char *dir);
+int32 vfs_readdir(t_vfsdir *d, char *name, int32 *isdir);
+void vfs_closedir(t_vfsdir *d);
+int32 vfs_lz4pack(uint8 *dst, uint8 *src, int32 size);
+int32 vfs_lz4unpack(uint8 *dst, int32 size, uint8 *src, int32 packed);
+int32 vfs_rd32(uint8 *p);
+void vfs_wr32(uint8 *p, int32 v);
+
+// ----------------
+// GLOBAL FUNCTIONS
+// ----------------
+
+// index the assets of the base game and of moddir, so they are found
+// without looking on disk. the base game's are read the first time only.
+// call before any loader threads start, the index is theirs to read
+// and not to change. files written later are found on disk as before.
+void vfs_setmod()
+{
+	int32 r;
+
+	if (vfs_ready && !strcmp(vfs_moddir, moddir))
+		return;
+
+	if (!vfs_ready)
+	{
+		vfs_num = 0;
+		vfs_namelen = 0;
+		vfs_loadpack(VFS_PACK, VFS_BASE);
+		for (r = 0; r < VFS_ROOTS; r++)
+			vfs_scan(vfs_roots[r], vfs_roots[r], VFS_BASE);
+		vfs_basenum = vfs_num;
+		vfs_basenamelen = vfs_namelen;
+		vfs_ready = 1;
+	}
+
+	vfs_num = vfs_basenum;
+	vfs_namelen = vfs_basenamelen;
+	vfs_freepack(VFS_MOD);
+	strcpy(vfs_moddir, moddir);
+
+	if (moddir[0])
+	{
+		char path[256];
+
+		sprintf(path, "%s%s", moddir, VFS_PACK);
+		vfs_loadpack(path, VFS_MOD);
+		for (r = 0; r < VFS_ROOTS; r++)
+		{
+			sprintf(path, "%s%s", moddir, vfs_roots[r]);
+			vfs_scan(path, vfs_roots[r], VFS_MOD);
+		}
+	}
+
+	vfs_rehash();
+}
+
+void vfs_deinit()
+{
+	vfs_freepack(VFS_BASE);
+	vfs_freepack(VFS_MOD);
+	free(vfs_file);
+	free(vfs_names);
+	free(vfs_hash);
+	vfs_file = NULL; vfs_names = NULL; vfs_hash = NULL;
+	vfs_num = vfs_size = vfs_basenum = 0;
+	vfs_namelen = vfs_namesize = vfs_basenamelen = 0;
+	vfs_ready = 0;
+}
+
+// the file fname is, -1 if the index hasn't got it. layer VFS_TOP for
+// the one the mod overrides the game with, VFS_BASE or VFS_MOD for
+// only the game's or only the mod's.
+int32 vfs_find(const char *fname, int32 layer)
+{
+	uint32 h, mask;
+	int32 s, f;
+
+	if (!vfs_hash)
+		return -1;
+
+	h = vfs_namehash(fname);
+	mask = (1 << vfs_hashbits) - 1;
+	for (s = h & mask; (f = vfs_hash[s]) >= 0; s = (s + 1) & mask)
+		if (vfs_file[f].hash == h && vfs_samename(vfs_names + vfs_file[f].name, fname))
+			break;
+
+	if (layer == VFS_BASE)
+		while (f >= 0 && vfs_file[f].layer != VFS_BASE)
+			f = vfs_file[f].under;
+	else if (layer == VFS_MOD && f >= 0 && vfs_file[f].layer != VFS_MOD)
+		f = -1;
+
+	return f;
+}
+
+// open file f for reading. one from a pack comes out into a temporary
+// file, for the readers that seek about in it.
+FILE *vfs_open(int32 f, const char *flags)
+{
+	FILE *fil;
+	uint8 *data;
+	int32 size;
+
+	if (vfs_file[f].path >= 0)
+		return fopen(vfs_names + vfs_file[f].path, flags);
+
+	data = vfs_map(f, &size);
+	if (!data)
+		return NULL;
+	fil = tmpfile();
+	if (fil && fwrite(data, 1, size, fil) != (size_t)size)
+	{	fclose(fil); fil = NULL; }
+	unmap_file(data, size);
+	if (fil)
+		rewind(fil);
+
+	return fil;
+}
+
+// the whole of file f, like map_file() and for unmap_file() to let go
+uint8 *vfs_map(int32 f, int32 *size)
+{
+	t_vfsfile *vf = &vfs_file[f];
+	t_vfspack *pk;
+	uint8 *data;
+
+	if (vf->path >= 0)
+		return map_file(vfs_names + vf->path, size);
+
+	if (vf->size <= 0)
+		return NULL;
+	data = vfs_alloc(vf->size);
+	if (!data)
+		return NULL;
+
+	pk = &vfs_packs[vf->pack];
+	if (!vf->packed)
+		memcpy(data, pk->map + vf->offset, vf->size);
+	else if (!vfs_lz4unpack(data, vf->size, pk->map + vf->offset, vf->packed))
+	{
+		fprintf(stderr, "%s in %s is damaged\n", vfs_names + vf->name, pk->name);
+		unmap_file(data, vf->size);
+		return NULL;
+	}
+
+	*size = vf->size;
+	return data;
+}
+
+// size and time of file f, for telling when it has changed. returns
+// VFS_MOD and VFS_PACKED bits for where it is, -1 if it has gone.
+int32 vfs_stat(int32 f, int32 *size, int32 *time)
+{
+	t_vfsfile *vf = &vfs_file[f];
+	struct stat s;
+
+	if (vf->path < 0)
+	{
+		*size = vf->size;
+		*time = vfs_packs[vf->pack].time;
+		return vf->layer | VFS_PACKED;
+	}
+
+	if (stat(vfs_names + vf->path, &s))
+		return -1;
+	*size = (int32)s.st_size;
+	*time = (int32)s.st_mtime;
+	return vf->layer;
+}
+
+// the folders in mods/, up to max of them, in no order
+int32 vfs_mods(char (*names)[32], int32 max)
+{
+	t_vfsdir d;
+	char name[256];
+	int32 isdir, n;
+
+	n = 0;
+	if (!vfs_opendir(&d, "mods/"))
+		return 0;
+	while (n < max && vfs_readdir(&d, name, &isdir))
+		if (isdir && strlen(name) < 32)
+			strcpy(names[n++], name);
+	vfs_closedir(&d);
+
+	return n;
+}
+
+// write the files of the mod, or of the game if there's no mod, into a
+// pack at fname. files lz4 makes smaller are packed, the rest stored.
+// returns how many files went in, -1 if it couldn't be written.
+int32 vfs_pack(const char *fname)
+{
+	FILE *fil;
+	uint8 *hdr, *data, *packed;
+	char *shadowed;
+	int32 layer, num, namesize, offset, total;
+	int32 f, n, p, size;
+
+	layer = moddir[0] ? VFS_MOD : VFS_BASE;
+	if (!strcmp(fname, vfs_packs[VFS_BASE].name) || !strcmp(fname, vfs_packs[VFS_MOD].name))
+	{
+		fprintf(stderr, "unable to write over %s while it is in use\n", fname);
+		return -1;
+	}
+
+	// a loose file hides one in the pack beside it, leave that out
+	shadowed = (char*)calloc(vfs_num + 1, 1);
+	if (!shadowed)
+		throw std::runtime_error("out of memory");
+	for (f = 0; f < vfs_num; f++)
+		if (vfs_file[f].under >= 0 && vfs_file[vfs_file[f].under].layer == vfs_file[f].layer)
+			shadowed[vfs_file[f].under] = 1;
+
+	num = 0; namesize = 0;
+	for (f = 0; f < vfs_num; f++)
+		if (vfs_file[f].layer == layer && !shadowed[f])
+		{
+			num++;
+			namesize += strlen(vfs_names + vfs_file[f].name) + 1;
+		}
+
+	hdr = (uint8*)calloc(VFS_HEADER + num*VFS_ENTRY + namesize, 1);
+	if (!hdr)
+	{	free(shadowed); throw std::runtime_error("out of memory"); }
+
+	fil = fopen(fname, "wb");
+	if (!fil)
+	{
+		fprintf(stderr, "unable to write %s\n", fname);
+		free(hdr); free(shadowed);
+		return -1;
+	}
+
+	memcpy(hdr, "SPAK", 4);
+	vfs_wr32(hdr + 4, VFS_VERSION);
+	vfs_wr32(hdr + 8, num);
+	vfs_wr32(hdr + 12, namesize);
+
+	n = 0; p = 0;
+	for (f = 0; f < vfs_num; f++)
+		if (vfs_file[f].layer == layer && !shadowed[f])
+		{
+			vfs_wr32(hdr + VFS_HEADER + n*VFS_ENTRY, p);
+			strcpy((char*)hdr + VFS_HEADER + num*VFS_ENTRY + p, vfs_names + vfs_file[f].name);
+			p += strlen(vfs_names + vfs_file[f].name) + 1;
+			n++;
+		}
+
+	// the entries are written again once the offsets are known
+	offset = VFS_HEADER + num*VFS_ENTRY + namesize;
+	fwrite(hdr, 1, offset, fil);
+
+	n = 0; total = 0;
+	for (f = 0; f < vfs_num; f++)
+		if (vfs_file[f].layer == layer && !shadowed[f])
+		{
+			size = 0; p = 0;
+			data = vfs_map(f, &size);
+			if (!data)
+				size = 0;
+			packed = NULL;
+			if (size > 0)
+				packed = (uint8*)malloc(size);
+			if (packed)
+				p = vfs_lz4pack(packed, data, size);
+
+			vfs_wr32(hdr + VFS_HEADER + n*VFS_ENTRY + 4, offset);
+			vfs_wr32(hdr + VFS_HEADER + n*VFS_ENTRY + 8, size);
+			vfs_wr32(hdr + VFS_HEADER + n*VFS_ENTRY + 12, p);
+			if (p)
+				fwrite(packed, 1, p, fil);
+			else if (size > 0)
+				fwrite(data, 1, size, fil);
+			offset += p ? p : size;
+			total += size;
+
+			free(packed);
+			if (data)
+				unmap_file(data, size);
+			n++;
+		}
+
+	fseek(fil, 0, SEEK_SET);
+	fwrite(hdr, 1, VFS_HEADER + num*VFS_ENTRY, fil);
+	free(hdr);
+	free(shadowed);
+
+	n = ferror(fil);
+	if (fclose(fil) || n)
+	{
+		fprintf(stderr, "unable to write %s\n", fname);
+		return -1;
+	}
+
+	printf("%s: %d files, %d bytes in %d\n", fname, num, total, offset);
+	return num;
+}
+
+// ----------------
+// LOCAL FUNCTIONS
+// ----------------
+
+// add the files in path and the folders under it, as name and so on
+void vfs_scan(const char *path, const char *name, int32 layer)
+{
+	t_vfsdir d;
+	char entry[256], subpath[256], subname[256];
+	int32 isdir;
+
+	if (!vfs_opendir(&d, path))
+		return;
+
+	while (vfs_readdir(&d, entry, &isdir))
+	{
+		if (strlen(path) + strlen(entry) + 2 > sizeof(subpath) ||
+				strlen(name) + strlen(entry) + 2 > sizeof(subname))
+			continue;
+		if (isdir)
+		{
+			sprintf(subpath, "%s%s/", path, entry);
+			sprintf(subname, "%s%s/", name, entry);
+			vfs_scan(subpath, subname, layer);
+		}
+		else
+		{
+			sprintf(subname, "%s%s", name, entry);
+			vfs_add(subname, vfs_addname(path, entry, 0), layer);
+		}
+	}
+
+	vfs_closedir(&d);
+}
+
+// add the files in the pack at fname, if there is one and it's sound
+void vfs_loadpack(const char *fname, int32 layer)
+{
+	t_vfspack *pk = &vfs_packs[layer];
+	struct stat s;
+	uint8 *e;
+	char *names;
+	int32 num, namesize, n, f, nm, offset, size, packed;
+
+	pk->map = map_file(fname, &pk->mapsize);
+	if (!pk->map)
+		return;
+	strcpy(pk->name, fname);
+	pk->time = 0;
+	if (!stat(fname, &s))
+		pk->time = (int32)s.st_mtime;
+
+	num = namesize = 0;
+	if (pk->mapsize >= VFS_HEADER && !memcmp(pk->map, "SPAK", 4) && vfs_rd32(pk->map + 4) == VFS_VERSION)
+	{
+		num = vfs_rd32(pk->map + 8);
+		namesize = vfs_rd32(pk->map + 12);
+	}
+	if (num <= 0 || namesize <= 0 || num > (pk->mapsize - VFS_HEADER) / VFS_ENTRY ||
+			namesize > pk->mapsize - VFS_HEADER - num*VFS_ENTRY || pk->map[VFS_HEADER + num*VFS_ENTRY + namesize - 1])
+	{
+		fprintf(stderr, "%s is not a pack\n", fname);
+		vfs_freepack(layer);
+		return;
+	}
+
+	names = (char*)pk->map + VFS_HEADER + num*VFS_ENTRY;
+	for (n = 0; n < num; n++)
+	{
+		e = pk->map + VFS_HEADER + n*VFS_ENTRY;
+		nm = vfs_rd32(e);
+		offset = vfs_rd32(e + 4);
+		size = vfs_rd32(e + 8);
+		packed = vfs_rd32(e + 12);
+		if (nm < 0 || nm >= namesize || offset < 0 || size < 0 || packed < 0 ||
+				(packed ? packed : size) > pk->mapsize - offset)
+		{
+			fprintf(stderr, "%s is damaged\n", fname);
+			continue;
+		}
+
+		f = vfs_add(names + nm, -1, layer);
+		vfs_file[f].pack = layer;
+		vfs_file[f].offset = offset;
+		vfs_file[f].size = size;
+		vfs_file[f].packed = packed;
+	}
+}
+
+void vfs_freepack(int32 layer)
+{
+	t_vfspack *pk = &vfs_packs[layer];
+
+	if (pk->map)
+		unmap_file(pk->map, pk->mapsize);
+	pk->map = NULL;
+	pk->mapsize = 0;
+	pk->name[0] = 0;
+}
+
+// a new file, vfs_rehash() puts it over any of the same name before it
+int32 vfs_add(const char *name, int32 path, int32 layer)
+{
+	t_vfsfile *vf;
+	int32 nm;
+
+	nm = vfs_addname(name, "", 1);
+	if (vfs_num == vfs_size)
+	{
+		vf = (t_vfsfile*)realloc(vfs_file, (vfs_size*2 + 256) * sizeof(t_vfsfile));
+		if (!vf)
+			throw std::runtime_error("out of memory");
+		vfs_file = vf;
+		vfs_size = vfs_size*2 + 256;
+	}
+
+	vf = &vfs_file[vfs_num];
+	memset(vf, 0, sizeof(t_vfsfile));
+	vf->name = nm;
+	vf->path = path;
+	vf->layer = layer;
+	vf->under = -1;
+	vf->hash = vfs_namehash(vfs_names + nm);
+
+	return vfs_num++;
+}
+
+// a then b into vfs_names, returns where
+int32 vfs_addname(const char *a, const char *b, int32 lower)
+{
+	char *names;
+	int32 la, lb, n, c;
+
+	la = strlen(a);
+	lb = strlen(b);
+	if (vfs_namelen + la + lb + 1 > vfs_namesize)
+	{
+		names = (char*)realloc(vfs_names, vfs_namesize*2 + la + lb + 4096);
+		if (!names)
+			throw std::runtime_error("out of memory");
+		vfs_names = names;
+		vfs_namesize = vfs_namesize*2 + la + lb + 4096;
+	}
+
+	n = vfs_namelen;
+	memcpy(vfs_names + n, a, la);
+	memcpy(vfs_names + n + la, b, lb + 1);
+	if (lower)
+		for (c = n; vfs_names[c]; c++)
+			vfs_names[c] = tolower((uint8)vfs_names[c]);
+	vfs_namelen += la + lb + 1;
+
+	return n;
+}
+
+// a table twice the size of the files, later ones taking over the
+// slots of earlier ones of the same name
+void vfs_rehash()
+{
+	uint32 mask;
+	int32 f, g, s;
+
+	vfs_hashbits = 4;
+	while ((1 << vfs_hashbits) < vfs_num * 2)
+		vfs_hashbits++;
+	free(vfs_hash);
+	vfs_hash = (int32*)malloc((1 << vfs_hashbits) * sizeof(int32));
+	if (!vfs_hash)
+		throw std::runtime_error("out of memory");
+	memset(vfs_hash, -1, (1 << vfs_hashbits) * sizeof(int32));
+
+	mask = (1 << vfs_hashbits) - 1;
+	for (f = 0; f < vfs_num; f++)
+	{
+		vfs_file[f].under = -1;
+		for (s = vfs_file[f].hash & mask; (g = vfs_hash[s]) >= 0; s = (s + 1) & mask)
+			if (vfs_file[g].hash == vfs_file[f].hash && !strcmp(vfs_names + vfs_file[g].name, vfs_names + vfs_file[f].name))
+			{
+				vfs_file[f].under = g;
+				break;
+			}
+		vfs_hash[s] = f;
+	}
+}
+
+// fnv-1a, without case as on windows
+uint32 vfs_namehash(const char *s)
+{
+	uint32 h = 2166136261u;
+
+	while (*s)
+		h = (h ^ tolower((uint8)*s++)) * 16777619u;
+	return h;
+}
+
+// a is an indexed name, already lower case
+int32 vfs_samename(const char *a, const char *b)
+{
+	while (*a && *a == tolower((uint8)*b))
+	{	a++; b++; }
+	return !*a && !*b;
+}
+
+// memory unmap_file() lets go of, as map_file() would have given it
+uint8 *vfs_alloc(int32 size)
+{
+#ifdef WINDOWS
+	return (uint8*)malloc(size);
+#else
+	uint8 *map;
+
+	map = (uint8*)mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if (map == (uint8*)MAP_FAILED)
+		return NULL;
+	return map;
+#endif
+}
+
+int32 vfs_opendir(t_vfsdir *d, const char *dir)
+{
+	sprintf(d->dir, "%s", dir);
+#ifdef WINDOWS
+	char pattern[256];
+
+	sprintf(pattern, "%s*.*", dir);
+	d->handle = _findfirst(pattern, &d->find);
+	d->first = 1;
+	return d->handle != -1;
+#else
+	d->find = opendir(dir);
+	return d->find != NULL;
+#endif
+}
+
+// the next file or folder in d, without . and ..
+int32 vfs_readdir(t_vfsdir *d, char *name, int32 *isdir)
+{
+#ifdef WINDOWS
+	for (;;)
+	{
+		if (!d->first && _findnext(d->handle, &d->find))
+			return 0;
+		d->first = 0;
+		if (!strcmp(d->find.name, ".") || !strcmp(d->find.name, ".."))
+			continue;
+		strcpy(name, d->find.name);
+		*isdir = (d->find.attrib & _A_SUBDIR) != 0;
+		return 1;
+	}
+#else
+	struct dirent *de;
+	struct stat s;
+	char path[512];
+
+	for (;;)
+	{
+		de = readdir(d->find);
+		if (!de)
+			return 0;
+		if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, ".."))
+			continue;
+		strncpy(name, de->d_name, 255);
+		name[255] = 0;
+		// network and overlay filesystems may not say, ask them
+		if (de->d_type == DT_UNKNOWN)
+		{
+			sprintf(path, "%s%s", d->dir, name);
+			*isdir = !stat(path, &s) && S_ISDIR(s.st_mode);
+		}
+		else
+			*isdir = (de->d_type == DT_DIR);
+		return 1;
+	}
+#endif
+}
+
+void vfs_closedir(t_vfsdir *d)
+{
+#ifdef WINDOWS
+	_findclose(d->handle);
+#else
+	closedir(d->find);
+#endif
+}
+
+// an lz4 block of src in dst, which holds size bytes. returns its size,
+// 0 if it doesn't come out smaller.
+int32 vfs_lz4pack(uint8 *dst, uint8 *src, int32 size)
+{
+	int32 table[4096];
+	uint32 v, w;
+	int32 s, r, lit, m, n, o, h;
+
+	memset(table, -1, sizeof(table));
+	s = lit = o = 0;
+
+	// the format wants the last match 12 bytes before the end, and the
+	// last 5 bytes as literals
+	while (s < size - 12)
+	{
+		memcpy(&v, src + s, 4);
+		h = (v * 2654435761u) >> 20;
+		r = table[h];
+		table[h] = s;
+		if (r < 0 || s - r > 65535)
+		{	s++; continue; }
+		memcpy(&w, src + r, 4);
+		if (v != w)
+		{	s++; continue; }
+
+		m = 4;
+		while (s + m < size - 5 && src[r + m] == src[s + m])
+			m++;
+
+		n = s - lit;
+		if (o + 1 + n/255 + 1 + n + 2 + (m-4)/255 + 1 >= size)
+			return 0;
+		dst[o++] = (MIN(n, 15) << 4) | MIN(m - 4, 15);
+		if (n >= 15)
+		{
+			for (n -= 15; n >= 255; n -= 255)
+				dst[o++] = 255;
+			dst[o++] = n;
+		}
+		memcpy(dst + o, src + lit, s - lit);
+		o += s - lit;
+		dst[o++] = (s - r) & 255;
+		dst[o++] = (s - r) >> 8;
+		if (m - 4 >= 15)
+		{
+			for (n = m - 4 - 15; n >= 255; n -= 255)
+				dst[o++] = 255;
+			dst[o++] = n;
+		}
+
+		s += m;
+		lit = s;
+	}
+
+	n = size - lit;
+	if (o + 1 + n/255 + 1 + n >= size)
+		return 0;
+	dst[o++] = MIN(n, 15) << 4;
+	if (n >= 15)
+	{
+		for (n -= 15; n >= 255; n -= 255)
+			dst[o++] = 255;
+		dst[o++] = n;
+	}
+	memcpy(dst + o, src + lit, size - lit);
+	o += size - lit;
+
+	return o;
+}
+
+// unpack an lz4 block, which must come out at exactly size bytes
+int32 vfs_lz4unpack(uint8 *dst, int32 size, uint8 *src, int32 packed)
+{
+	int32 s, d, n, m, off, c;
+
+	s = d = 0;
+	for (;;)
+	{
+		if (s >= packed)
+			return 0;
+		c = src[s++];
+
+		n = c >> 4;
+		if (n == 15)
+			do
+			{
+				if (s >= packed)
+					return 0;
+				n += src[s];
+			} while (src[s++] == 255);
+		if (n > packed - s || n > size - d)
+			return 0;
+		memcpy(dst + d, src + s, n);
+		s += n; d += n;
+
+		if (s == packed)
+			break;
+
+		if (s + 2 > packed)
+			return 0;
+		off = src[s] + (src[s+1] << 8);
+		s += 2;
+		m = (c & 15) + 4;
+		if ((c & 15) == 15)
+			do
+			{
+				if (s >= packed)
+					return 0;
+				m += src[s];
+			} while (src[s++] == 255);
+		if (off == 0 || off > d || m > size - d)
+			return 0;
+
+		// the match may run into itself, so a byte at a time
+		for (; m > 0; m--, d++)
+			dst[d] = dst[d - off];
+	}
+
+	return d == size;
+}
+
+int32 vfs_rd32(uint8 *p)
+{
+	return p[0] + (p[1] << 8) + (p[2] << 16) + (p[3] << 24);
+}
+
+void vfs_wr32(uint8 *p, int32 v)
+{
+	p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
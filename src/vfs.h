@@ -0,0 +1,24 @@
+// ----------------
+//    CONSTANTS
+// ----------------
+
+#define VFS_PACK "assets.pak"		// in the game's folder or the mod's
+#define VFS_VERSION 1
+
+#define VFS_TOP -1			// vfs_find() layers
+#define VFS_BASE 0
+#define VFS_MOD 1				// also a vfs_stat() bit, with VFS_PACKED
+#define VFS_PACKED 2
+
+// ----------------
+//    PROTOTYPES
+// ----------------
+
+void vfs_setmod();
+void vfs_deinit();
+int32 vfs_find(const char *fname, int32 base);
+FILE *vfs_open(int32 f, const char *flags);
+uint8 *vfs_map(int32 f, int32 *size);
+int32 vfs_stat(int32 f, int32 *size, int32 *time);
+int32 vfs_mods(char (*names)[32], int32 max);
+int32 vfs_pack(const char *fname);
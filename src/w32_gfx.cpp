@@ -57,8 +57,6 @@ int movrecord = 1;
 // blit screen
 void ik_blit()
 {
-	t_ik_sprite *cs = NULL;
-
 	// take screenshots here (!)
 #ifdef MOVIE
 	if (get_ik_timer(2) > when && movrecord == 1)
@@ -75,13 +73,12 @@ void ik_blit()
 
 	if ((settings.opt_mousemode&5)==0)
 	{
-		cs = get_sprite(screen, ik_mouse_x, ik_mouse_y, 16, 16);
+		gfx_saveunder(ik_mouse_x, ik_mouse_y, 16, 16);
 		ik_draw_mousecursor();
 	}
 	else if (settings.opt_mousemode & 4)
 	{
-//		cs = get_sprite(screen, ik_mouse_x-128, ik_mouse_y-128, 256, 256);
-		cs = get_sprite(screen, ik_mouse_x-192, ik_mouse_y-96, 384, 192);
+		gfx_saveunder(ik_mouse_x-192, ik_mouse_y-96, 384, 192);
 		gfx_magnify();
 		if (!(settings.opt_mousemode & 1))
 		{
@@ -92,26 +89,36 @@ void ik_blit()
 		gfx_blarg();
 #endif
 
-	g_scaled_video->dirtyRect(g_virtual_resolution);
+	// only what was drawn since the last frame goes out
 	g_scaled_video->update(true);
 
-	if ((settings.opt_mousemode&5)==0)
-	{
-		prep_screen();
-		ik_dsprite(screen, ik_mouse_x, ik_mouse_y, cs, 4);
-		free_screen();
-		free_sprite(cs);
-	}
-	else if (settings.opt_mousemode & 4)
+	if ((settings.opt_mousemode&5)==0 || (settings.opt_mousemode & 4))
 	{
 		prep_screen();
-//		ik_dsprite(screen, ik_mouse_x-128, ik_mouse_y-128, cs, 4);
-		ik_dsprite(screen, ik_mouse_x-192, ik_mouse_y-96, cs, 4);
+		gfx_restoreunder();
 		free_screen();
-		free_sprite(cs);
 	}
 }
 
+// note that x..xe-1, y..ye-1 of img was drawn to. if img is the screen
+// the next ik_blit() sends that area out, the rest is left as it was.
+void ik_dirty(t_ik_image *img, int32 xb, int32 yb, int32 xe, int32 ye)
+{
+	SDL_Rect r;
+
+	if (img != &screenbuf || !g_scaled_video)
+		return;
+
+	xb = MAX(xb, 0); yb = MAX(yb, 0);
+	xe = MIN(xe, img->w); ye = MIN(ye, img->h);
+	if (xb >= xe || yb >= ye)
+		return;
+
+	r.x = xb; r.y = yb;
+	r.w = xe - xb; r.h = ye - yb;
+	g_scaled_video->dirtyRect(r);
+}
+
 // palette stuff
 void update_palette()
 {
@@ -125,6 +132,10 @@ void update_palette()
 		spal[i].b = currentpal[i*3+2];
 	}
 	SDL_SetColors(sdlsurf, spal, 0, 256);
+
+	// every pixel may look different now
+	if (g_scaled_video)
+		g_scaled_video->dirtyRect(g_virtual_resolution);
 }
 
 void set_palette_entry(int n, int r, int g, int b)
@@ -32,6 +32,8 @@
 #include "iface_globals.h"
 #include "snd.h"
 #include "gfx.h"
+#include "is_fileio.h"
+#include "vfs.h"
 
 
 
@@ -61,11 +63,24 @@ int sound_init()
 Mix_Chunk *lsnd(int32 name)
 {
 	Mix_Chunk *wave;
+	uint8 *map;
+	int32 f, size;
 
 	wave = (Mix_Chunk*)wavesnd[name].wave;
 	if (!wave)
 	{
-		wavesnd[name].wave = Mix_LoadWAV(wavesnd[name].name);
+		// the mod's or the game's, loose or out of a pack
+		f = vfs_find(wavesnd[name].name, VFS_TOP);
+		map = NULL;
+		if (f >= 0)
+			map = vfs_map(f, &size);
+		if (map)
+		{
+			wavesnd[name].wave = Mix_LoadWAV_RW(SDL_RWFromMem(map, size), 1);
+			unmap_file(map, size);
+		}
+		else
+			wavesnd[name].wave = Mix_LoadWAV(wavesnd[name].name);
 		wave = (Mix_Chunk*)wavesnd[name].wave;
 	}
 
@@ -74,6 +89,10 @@ Mix_Chunk *lsnd(int32 name)
 
 int Load_WAV(const char *filename, int id)
 {
+	// load_splash_sfx() had it first, the splash screen may be playing it
+	if (wavesnd[id].wave)
+		return id;
+
 	sprintf(wavesnd[id].name, "%s", filename);
 	lsnd(id);
 	return id;